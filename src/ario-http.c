@@ -0,0 +1,744 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ario-http.h"
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+#include <config.h>
+#include "lib/ario-conf.h"
+#include "preferences/ario-preferences.h"
+#include "ario-util.h"
+#include "ario-debug.h"
+
+/* Limit downloaded file to 5MB */
+#define MAX_SIZE 5*1024*1024
+
+/* Number of unused curl handles kept for the next requests */
+#define MAX_IDLE_HANDLES 4
+
+/* Time after which a cached response is revalidated (in seconds),
+ * when the server gives no Cache-Control or Expires header */
+#define CACHE_TTL 3*24*60*60
+
+/* Maximum size of the disk cache, the oldest responses are removed
+ * until the cache is back under 3/4 of this size */
+#define MAX_CACHE_SIZE 64*1024*1024
+
+#define CACHE_META_SUFFIX ".meta"
+#define CACHE_GROUP "response"
+
+typedef struct
+{
+        GString *data;
+        gchar *etag;
+        gchar *last_modified;
+
+        /* Cache headers of the response */
+        gboolean no_store;
+        gboolean no_cache;
+        glong max_age;
+        gboolean has_expires;
+        time_t expires;
+        time_t date;
+} ArioHttpResponse;
+
+/* A request in progress, shared with the threads asking for the same uri */
+typedef struct
+{
+        GCond *cond;
+        gboolean done;
+        gint waiters;
+
+        int size;
+        char *data;
+} ArioHttpRequest;
+
+typedef struct
+{
+        gchar *path;
+        time_t mtime;
+        goffset size;
+} ArioHttpCacheFile;
+
+static GStaticMutex http_lock = G_STATIC_MUTEX_INIT;
+
+/* Locks of the data shared between curl handles */
+static GStaticMutex share_locks[CURL_LOCK_DATA_LAST];
+static CURLSH *share = NULL;
+
+/* Unused curl handles, they keep their connections opened */
+static GSList *idle_handles = NULL;
+
+/* Uri -> ArioHttpRequest */
+static GHashTable *requests = NULL;
+
+static gchar *cache_dir = NULL;
+/* Size of the files of the cache, -1 until it is computed */
+static goffset cache_size = -1;
+
+static void
+ario_http_share_lock (CURL *curl,
+                      curl_lock_data data,
+                      curl_lock_access access,
+                      void *user_data)
+{
+        g_static_mutex_lock (&share_locks[data]);
+}
+
+static void
+ario_http_share_unlock (CURL *curl,
+                        curl_lock_data data,
+                        void *user_data)
+{
+        g_static_mutex_unlock (&share_locks[data]);
+}
+
+void
+ario_http_init (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        int i;
+
+        for (i = 0; i < CURL_LOCK_DATA_LAST; ++i)
+                g_static_mutex_init (&share_locks[i]);
+
+        /* DNS cache, SSL sessions and connections are shared by all
+         * handles */
+        share = curl_share_init ();
+        if (share) {
+                curl_share_setopt (share, CURLSHOPT_LOCKFUNC, ario_http_share_lock);
+                curl_share_setopt (share, CURLSHOPT_UNLOCKFUNC, ario_http_share_unlock);
+                curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+#if LIBCURL_VERSION_NUM >= 0x071700
+                curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x073900
+                curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+        }
+
+        requests = g_hash_table_new (g_str_hash, g_str_equal);
+
+        cache_dir = g_build_filename (ario_util_config_dir (), "http-cache", NULL);
+        if (!ario_file_test (cache_dir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR))
+                ario_util_mkdir (cache_dir);
+}
+
+void
+ario_http_shutdown (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_static_mutex_lock (&http_lock);
+        g_slist_foreach (idle_handles, (GFunc) curl_easy_cleanup, NULL);
+        g_slist_free (idle_handles);
+        idle_handles = NULL;
+        g_static_mutex_unlock (&http_lock);
+
+        /* Fails if a download is still in progress in a thread: the
+         * share is then kept until exit */
+        if (share && curl_share_cleanup (share) == CURLSHE_OK)
+                share = NULL;
+}
+
+void
+ario_http_setup (gpointer curl)
+{
+        ARIO_LOG_FUNCTION_START;
+        const gchar* address;
+        int port;
+
+        if (share)
+                curl_easy_setopt (curl, CURLOPT_SHARE, share);
+        /* set timeout */
+        curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, 20);
+        /* set redirect */
+        curl_easy_setopt (curl, CURLOPT_FOLLOWLOCATION ,1);
+        /* set NO SIGNAL */
+        curl_easy_setopt (curl, CURLOPT_NOSIGNAL, TRUE);
+
+        /* Use a proxy if one is configured */
+        if (ario_conf_get_boolean (PREF_USE_PROXY, PREF_USE_PROXY_DEFAULT)) {
+                address = ario_conf_get_string (PREF_PROXY_ADDRESS, PREF_PROXY_ADDRESS_DEFAULT);
+                port =  ario_conf_get_integer (PREF_PROXY_PORT, PREF_PROXY_PORT_DEFAULT);
+                if (address) {
+                        curl_easy_setopt (curl, CURLOPT_PROXY, address);
+                        curl_easy_setopt (curl, CURLOPT_PROXYPORT, port);
+                } else {
+                        ARIO_LOG_DBG ("Proxy enabled, but no proxy defined");
+                }
+        }
+}
+
+static CURL *
+ario_http_get_handle (void)
+{
+        CURL *curl = NULL;
+
+        g_static_mutex_lock (&http_lock);
+        if (idle_handles) {
+                curl = idle_handles->data;
+                idle_handles = g_slist_delete_link (idle_handles, idle_handles);
+        }
+        g_static_mutex_unlock (&http_lock);
+
+        /* Options of the previous request are forgotten but the
+         * connections stay opened */
+        if (curl)
+                curl_easy_reset (curl);
+        else
+                curl = curl_easy_init ();
+
+        return curl;
+}
+
+static void
+ario_http_release_handle (CURL *curl)
+{
+        g_static_mutex_lock (&http_lock);
+        if (g_slist_length (idle_handles) < MAX_IDLE_HANDLES) {
+                idle_handles = g_slist_prepend (idle_handles, curl);
+                curl = NULL;
+        }
+        g_static_mutex_unlock (&http_lock);
+
+        if (curl)
+                curl_easy_cleanup (curl);
+}
+
+static size_t
+ario_http_write_data (void *buffer,
+                      size_t size,
+                      size_t nmemb,
+                      ArioHttpResponse *response)
+{
+        if (!size || !nmemb)
+                return 0;
+
+        /* Append received data to buffer */
+        g_string_append_len (response->data, buffer, size*nmemb);
+
+        if (response->data->len >= MAX_SIZE)
+                return 0;
+
+        return size*nmemb;
+}
+
+static void
+ario_http_parse_cache_control (const gchar *value,
+                               ArioHttpResponse *response)
+{
+        gchar **directives;
+        gchar *directive;
+        int i;
+
+        directives = g_strsplit (value, ",", -1);
+        for (i = 0; directives[i]; ++i) {
+                directive = g_strstrip (directives[i]);
+                if (!g_ascii_strcasecmp (directive, "no-store")) {
+                        response->no_store = TRUE;
+                } else if (!g_ascii_strcasecmp (directive, "no-cache")) {
+                        response->no_cache = TRUE;
+                } else if (!g_ascii_strncasecmp (directive, "max-age=", 8)) {
+                        response->max_age = MAX (strtol (directive + 8, NULL, 10), 0);
+                }
+        }
+        g_strfreev (directives);
+}
+
+static size_t
+ario_http_write_header (void *buffer,
+                        size_t size,
+                        size_t nmemb,
+                        ArioHttpResponse *response)
+{
+        gchar *header;
+
+        header = g_strstrip (g_strndup (buffer, size*nmemb));
+
+        /* Validators of the response */
+        if (!g_ascii_strncasecmp (header, "ETag:", 5)) {
+                g_free (response->etag);
+                response->etag = g_strstrip (g_strdup (header + 5));
+        } else if (!g_ascii_strncasecmp (header, "Last-Modified:", 14)) {
+                g_free (response->last_modified);
+                response->last_modified = g_strstrip (g_strdup (header + 14));
+        } else if (!g_ascii_strncasecmp (header, "HTTP/", 5)) {
+                /* New response after a redirection: forget the validators
+                 * and cache headers of the previous one */
+                g_free (response->etag);
+                response->etag = NULL;
+                g_free (response->last_modified);
+                response->last_modified = NULL;
+                response->no_store = FALSE;
+                response->no_cache = FALSE;
+                response->max_age = -1;
+                response->has_expires = FALSE;
+                response->date = 0;
+        } else if (!g_ascii_strncasecmp (header, "Cache-Control:", 14)) {
+                ario_http_parse_cache_control (header + 14, response);
+        } else if (!g_ascii_strncasecmp (header, "Expires:", 8)) {
+                /* An invalid date means already expired */
+                response->has_expires = TRUE;
+                response->expires = curl_getdate (g_strstrip (header + 8), NULL);
+        } else if (!g_ascii_strncasecmp (header, "Date:", 5)) {
+                response->date = curl_getdate (g_strstrip (header + 5), NULL);
+        }
+        g_free (header);
+
+        return size*nmemb;
+}
+
+static long
+ario_http_perform (const char *uri,
+                   const char *post_data,
+                   const int post_size,
+                   const struct curl_slist *headers,
+                   const gchar *etag,
+                   const gchar *last_modified,
+                   ArioHttpResponse *response)
+{
+        ARIO_LOG_FUNCTION_START;
+        ARIO_LOG_DBG ("Download:%s", uri);
+        CURL *curl;
+        struct curl_slist *conditions = NULL;
+        gchar *condition;
+        long code = 0;
+
+        response->data = g_string_new (NULL);
+        response->etag = NULL;
+        response->last_modified = NULL;
+        response->no_store = FALSE;
+        response->no_cache = FALSE;
+        response->max_age = -1;
+        response->has_expires = FALSE;
+        response->date = 0;
+
+        curl = ario_http_get_handle ();
+        if (!curl)
+                return 0;
+
+        /* set uri */
+        curl_easy_setopt (curl, CURLOPT_URL, uri);
+        /* set callback data */
+        curl_easy_setopt (curl, CURLOPT_WRITEDATA, response);
+        curl_easy_setopt (curl, CURLOPT_HEADERDATA, response);
+        /* set callback functions */
+        curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, (curl_write_callback) ario_http_write_data);
+        curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, (curl_write_callback) ario_http_write_header);
+        /* set timeouts, redirections and proxy */
+        ario_http_setup (curl);
+
+        /* Handles data for POST requests */
+        if (post_data) {
+                curl_easy_setopt (curl, CURLOPT_POST, TRUE);
+                curl_easy_setopt (curl, CURLOPT_POSTFIELDS, post_data);
+                curl_easy_setopt (curl, CURLOPT_POSTFIELDSIZE, post_size);
+        }
+
+        if (headers) {
+                curl_easy_setopt (curl, CURLOPT_HTTPHEADER, headers);
+        } else {
+                /* Revalidation of a cached response */
+                if (etag) {
+                        condition = g_strdup_printf ("If-None-Match: %s", etag);
+                        conditions = curl_slist_append (conditions, condition);
+                        g_free (condition);
+                }
+                if (last_modified) {
+                        condition = g_strdup_printf ("If-Modified-Since: %s", last_modified);
+                        conditions = curl_slist_append (conditions, condition);
+                        g_free (condition);
+                }
+                if (conditions)
+                        curl_easy_setopt (curl, CURLOPT_HTTPHEADER, conditions);
+        }
+
+        /* Performs the request */
+        if (curl_easy_perform (curl) == CURLE_OK)
+                curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &code);
+
+        curl_slist_free_all (conditions);
+        ario_http_release_handle (curl);
+
+        return code;
+}
+
+static void
+ario_http_response_free (ArioHttpResponse *response,
+                         int *size,
+                         char **data)
+{
+        if (size) {
+                /* The downloaded data are given to the caller */
+                *size = response->data->len;
+                *data = g_string_free (response->data, *size == 0);
+        } else {
+                g_string_free (response->data, TRUE);
+        }
+
+        g_free (response->etag);
+        g_free (response->last_modified);
+}
+
+/* Time during which the response can be used without revalidation,
+ * default_ttl if the server doesn't say */
+static gint
+ario_http_response_ttl (const ArioHttpResponse *response,
+                        const gint default_ttl)
+{
+        time_t now;
+
+        if (response->no_cache)
+                return 0;
+
+        if (response->max_age >= 0)
+                return MIN (response->max_age, G_MAXINT);
+
+        if (response->has_expires) {
+                if (response->expires < 0)
+                        return 0;
+                /* Expires is relative to the clock of the server */
+                now = response->date > 0 ? response->date : time (NULL);
+                return CLAMP (response->expires - now, 0, G_MAXINT);
+        }
+
+        return default_ttl;
+}
+
+static gchar *
+ario_http_cache_path (const gchar *key,
+                      const gchar *suffix)
+{
+        gchar *filename;
+        gchar *path;
+
+        filename = g_strconcat (key, suffix, NULL);
+        path = g_build_filename (cache_dir, filename, NULL);
+        g_free (filename);
+
+        return path;
+}
+
+static gboolean
+ario_http_cache_read_meta (const gchar *key,
+                           gchar **etag,
+                           gchar **last_modified,
+                           time_t *date,
+                           gint *ttl)
+{
+        GKeyFile *meta;
+        gchar *path;
+        gboolean ret;
+
+        meta = g_key_file_new ();
+        path = ario_http_cache_path (key, CACHE_META_SUFFIX);
+        ret = g_key_file_load_from_file (meta, path, G_KEY_FILE_NONE, NULL);
+        g_free (path);
+
+        if (ret) {
+                *etag = g_key_file_get_string (meta, CACHE_GROUP, "etag", NULL);
+                *last_modified = g_key_file_get_string (meta, CACHE_GROUP, "last_modified", NULL);
+                *date = (time_t) g_key_file_get_integer (meta, CACHE_GROUP, "date", NULL);
+                if (g_key_file_has_key (meta, CACHE_GROUP, "ttl", NULL))
+                        *ttl = g_key_file_get_integer (meta, CACHE_GROUP, "ttl", NULL);
+                else
+                        *ttl = CACHE_TTL;
+        }
+        g_key_file_free (meta);
+
+        return ret;
+}
+
+static void
+ario_http_cache_write_meta (const gchar *key,
+                            const gchar *uri,
+                            const gchar *etag,
+                            const gchar *last_modified,
+                            const gint ttl)
+{
+        GKeyFile *meta;
+        gchar *path;
+        gchar *contents;
+        gsize length;
+
+        meta = g_key_file_new ();
+        g_key_file_set_string (meta, CACHE_GROUP, "uri", uri);
+        if (etag)
+                g_key_file_set_string (meta, CACHE_GROUP, "etag", etag);
+        if (last_modified)
+                g_key_file_set_string (meta, CACHE_GROUP, "last_modified", last_modified);
+        g_key_file_set_integer (meta, CACHE_GROUP, "date", (gint) time (NULL));
+        g_key_file_set_integer (meta, CACHE_GROUP, "ttl", ttl);
+
+        contents = g_key_file_to_data (meta, &length, NULL);
+        path = ario_http_cache_path (key, CACHE_META_SUFFIX);
+        g_file_set_contents (path, contents, length, NULL);
+        g_free (path);
+        g_free (contents);
+        g_key_file_free (meta);
+}
+
+static gboolean
+ario_http_cache_read (const gchar *key,
+                      int *size,
+                      char **data)
+{
+        gchar *path;
+        gsize length;
+        gboolean ret;
+
+        path = ario_http_cache_path (key, "");
+        ret = g_file_get_contents (path, data, &length, NULL);
+        g_free (path);
+
+        *size = ret ? length : 0;
+
+        return ret;
+}
+
+static void
+ario_http_cache_remove (const gchar *key)
+{
+        gchar *path;
+
+        path = ario_http_cache_path (key, CACHE_META_SUFFIX);
+        g_unlink (path);
+        g_free (path);
+
+        path = ario_http_cache_path (key, "");
+        g_unlink (path);
+        g_free (path);
+}
+
+static gint
+ario_http_cache_compare_files (const ArioHttpCacheFile *a,
+                               const ArioHttpCacheFile *b)
+{
+        return (a->mtime > b->mtime) - (a->mtime < b->mtime);
+}
+
+static void
+ario_http_cache_free_file (ArioHttpCacheFile *file)
+{
+        g_free (file->path);
+        g_free (file);
+}
+
+/* Must be called with http_lock */
+static void
+ario_http_cache_trim (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        GDir *dir;
+        const gchar *name;
+        GSList *files = NULL;
+        GSList *tmp;
+        ArioHttpCacheFile *file;
+        struct stat st;
+        gchar *meta_path;
+
+        dir = g_dir_open (cache_dir, 0, NULL);
+        if (!dir)
+                return;
+
+        cache_size = 0;
+        while ((name = g_dir_read_name (dir))) {
+                if (g_str_has_suffix (name, CACHE_META_SUFFIX))
+                        continue;
+
+                file = (ArioHttpCacheFile *) g_malloc0 (sizeof (ArioHttpCacheFile));
+                file->path = g_build_filename (cache_dir, name, NULL);
+                if (g_stat (file->path, &st)) {
+                        ario_http_cache_free_file (file);
+                        continue;
+                }
+                file->mtime = st.st_mtime;
+                file->size = st.st_size;
+                cache_size += file->size;
+                files = g_slist_prepend (files, file);
+        }
+        g_dir_close (dir);
+
+        /* The oldest responses are removed first */
+        files = g_slist_sort (files, (GCompareFunc) ario_http_cache_compare_files);
+        for (tmp = files; tmp && cache_size > MAX_CACHE_SIZE / 4 * 3; tmp = g_slist_next (tmp)) {
+                file = tmp->data;
+                meta_path = g_strconcat (file->path, CACHE_META_SUFFIX, NULL);
+                g_unlink (meta_path);
+                g_unlink (file->path);
+                g_free (meta_path);
+                cache_size -= file->size;
+        }
+
+        g_slist_foreach (files, (GFunc) ario_http_cache_free_file, NULL);
+        g_slist_free (files);
+}
+
+static void
+ario_http_cache_write (const gchar *key,
+                       const gchar *uri,
+                       const ArioHttpResponse *response)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *path;
+
+        path = ario_http_cache_path (key, "");
+        if (g_file_set_contents (path, response->data->str, response->data->len, NULL))
+                ario_http_cache_write_meta (key, uri, response->etag, response->last_modified,
+                                            ario_http_response_ttl (response, CACHE_TTL));
+        g_free (path);
+
+        g_static_mutex_lock (&http_lock);
+        if (cache_size >= 0)
+                cache_size += response->data->len;
+        /* The size of the cache is computed on the first write */
+        if (cache_size < 0 || cache_size > MAX_CACHE_SIZE)
+                ario_http_cache_trim ();
+        g_static_mutex_unlock (&http_lock);
+}
+
+static void
+ario_http_cached_download (const char *uri,
+                           int *size,
+                           char **data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioHttpResponse response;
+        gchar *key;
+        gchar *etag = NULL;
+        gchar *last_modified = NULL;
+        time_t date = 0;
+        gint ttl = 0;
+        gboolean cached;
+        long code;
+
+        key = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+        cached = ario_http_cache_read_meta (key, &etag, &last_modified, &date, &ttl);
+
+        /* The cached response is recent enough */
+        if (cached
+            && time (NULL) - date < ttl
+            && ario_http_cache_read (key, size, data)) {
+                ARIO_LOG_DBG ("Cached:%s", uri);
+                g_free (etag);
+                g_free (last_modified);
+                g_free (key);
+                return;
+        }
+
+        code = ario_http_perform (uri, NULL, 0, NULL,
+                                  cached ? etag : NULL,
+                                  cached ? last_modified : NULL,
+                                  &response);
+
+        if (cached && code == 304 && ario_http_cache_read (key, size, data)) {
+                /* Not modified: the cached response is valid again */
+                if (response.no_store)
+                        ario_http_cache_remove (key);
+                else
+                        ario_http_cache_write_meta (key, uri, etag, last_modified,
+                                                    ario_http_response_ttl (&response, ttl));
+                ario_http_response_free (&response, NULL, NULL);
+        } else if (code == 200 && response.data->len > 0) {
+                /* The server may forbid to keep the response */
+                if (response.no_store) {
+                        if (cached)
+                                ario_http_cache_remove (key);
+                } else {
+                        ario_http_cache_write (key, uri, &response);
+                }
+                ario_http_response_free (&response, size, data);
+        } else if (cached && code == 0 && ario_http_cache_read (key, size, data)) {
+                /* The server can't be reached: an old response is better than nothing */
+                ario_http_response_free (&response, NULL, NULL);
+        } else {
+                ario_http_response_free (&response, size, data);
+        }
+
+        g_free (etag);
+        g_free (last_modified);
+        g_free (key);
+}
+
+void
+ario_http_download (const char *uri,
+                    const char *post_data,
+                    const int post_size,
+                    const struct curl_slist *headers,
+                    int *size,
+                    char **data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioHttpResponse response;
+        ArioHttpRequest *request;
+
+        *size = 0;
+        *data = NULL;
+
+        /* Only simple GET requests are cached and shared */
+        if (post_data || headers || !requests) {
+                ario_http_perform (uri, post_data, post_size, headers, NULL, NULL, &response);
+                ario_http_response_free (&response, size, data);
+                return;
+        }
+
+        g_static_mutex_lock (&http_lock);
+        request = g_hash_table_lookup (requests, uri);
+        if (request) {
+                /* The same file is already downloaded by another thread */
+                ++request->waiters;
+                while (!request->done)
+                        g_cond_wait (request->cond, g_static_mutex_get_mutex (&http_lock));
+
+                *size = request->size;
+                *data = request->data ? g_memdup (request->data, request->size + 1) : NULL;
+
+                if (--request->waiters == 0) {
+                        g_cond_free (request->cond);
+                        g_free (request->data);
+                        g_free (request);
+                }
+                g_static_mutex_unlock (&http_lock);
+                return;
+        }
+
+        request = (ArioHttpRequest *) g_malloc0 (sizeof (ArioHttpRequest));
+        request->cond = g_cond_new ();
+        g_hash_table_insert (requests, (gpointer) uri, request);
+        g_static_mutex_unlock (&http_lock);
+
+        ario_http_cached_download (uri, size, data);
+
+        g_static_mutex_lock (&http_lock);
+        g_hash_table_remove (requests, uri);
+        request->done = TRUE;
+        if (request->waiters > 0) {
+                /* The waiting threads get their own copy */
+                request->size = *size;
+                request->data = *data ? g_memdup (*data, *size + 1) : NULL;
+                g_cond_broadcast (request->cond);
+        } else {
+                g_cond_free (request->cond);
+                g_free (request);
+        }
+        g_static_mutex_unlock (&http_lock);
+}
@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_HTTP_H
+#define __ARIO_HTTP_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+struct curl_slist;
+
+/**
+ * HTTP client shared by all the downloads of Ario. Curl handles are
+ * kept between requests and share their DNS cache and connections, so
+ * that successive requests to the same server reuse the connection.
+ * Responses to simple GET requests are kept in a disk cache and
+ * revalidated with ETag/Last-Modified once they are too old. Identical
+ * requests made at the same time by several threads are only sent once.
+ */
+
+/**
+ * Initialize the HTTP client, must be called after g_thread_init
+ * and curl_global_init
+ */
+void                    ario_http_init                  (void);
+
+/**
+ * Release the curl handles kept by the HTTP client
+ */
+void                    ario_http_shutdown              (void);
+
+/**
+ * Set the options shared by all downloads (connection sharing, timeouts,
+ * redirections, proxy...) on a curl handle
+ *
+ * @param curl The CURL easy handle of the download
+ */
+void                    ario_http_setup                 (gpointer curl);
+
+/**
+ * Download a file, see ario_util_download_file
+ *
+ * @param uri The uri of the file to download
+ * @param post_data Post data to use for POST requests or NULL
+ * @param post_size The size of post data (no used if post_data is NULL)
+ * @param headers Http headers to use or NULL
+ * @param size A pointer to a int that will contain the size of the downloaded data
+ * @param data Newly allocated data containing the downloaded file
+ */
+void                    ario_http_download              (const char *uri,
+                                                         const char *post_data,
+                                                         const int post_size,
+                                                         const struct curl_slist *headers,
+                                                         int *size,
+                                                         char **data);
+
+G_END_DECLS
+
+#endif /* __ARIO_HTTP_H */
@@ -30,6 +30,7 @@
 #include "preferences/ario-preferences.h"
 #include "shell/ario-shell.h"
 #include "plugins/ario-plugins-engine.h"
+#include "ario-http.h"
 #include "ario-util.h"
 #include "ario-debug.h"
 #include "ario-profiles.h"
@@ -122,7 +123,8 @@ main (int argc, char *argv[])
         ario_util_init_stock_icons ();
 
         /* Initialisation of Curl */
-        curl_global_init (CURL_GLOBAL_WIN32);
+        curl_global_init (CURL_GLOBAL_WIN32);
+        ario_http_init ();
 
 #ifndef WIN32
         /* Set a specific profile */
@@ -150,6 +152,9 @@ main (int argc, char *argv[])
         /* Shutdown plugins engine */
         ario_plugins_engine_shutdown ();
 
+        /* Shutdown HTTP client */
+        ario_http_shutdown ();
+
         /* Shutdown configurations engine */
         ario_conf_shutdown ();
 
@@ -25,7 +25,6 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
-#include <curl/curl.h>
 #include <glib/gi18n.h>
 #include <gcrypt.h>
 #ifdef WIN32
@@ -33,6 +32,7 @@
 #endif
 
 #include "ario-debug.h"
+#include "ario-http.h"
 #include "covers/ario-cover.h"
 #include "lib/ario-conf.h"
 #include "preferences/ario-preferences.h"
@@ -315,44 +315,6 @@ ario_util_copy_file (const char *src_uri,
         g_free (contents);
 }
 
-typedef struct _download_struct{
-        char *data;
-        int size;
-} download_struct;
-
-/* Limit downloaded file to 5MB */
-#define MAX_SIZE 5*1024*1024
-
-static size_t
-ario_util_write_data(void *buffer,
-                     size_t size,
-                     size_t nmemb,
-                     download_struct *download_data)
-{
-        ARIO_LOG_FUNCTION_START;
-
-        if (!size || !nmemb)
-                return 0;
-
-        if (download_data->data == NULL)
-                download_data->size = 0;
-
-        /* Increase buffer size if needed */
-        download_data->data = g_realloc (download_data->data,
-                                         (gulong)(size*nmemb+download_data->size) + 1);
-
-        /* Append received data to buffer */
-        memset (&(download_data->data)[download_data->size], '\0', (size*nmemb)+1);
-        memcpy (&(download_data->data)[download_data->size], buffer, size*nmemb);
-
-        /* Increase size */
-        download_data->size += size*nmemb;
-        if (download_data->size >= MAX_SIZE)
-                return 0;
-
-        return size*nmemb;
-}
-
 void
 ario_util_download_file (const char *uri,
                          const char *post_data,
@@ -362,65 +324,11 @@ ario_util_download_file (const char *uri,
                          char** data)
 {
         ARIO_LOG_FUNCTION_START;
-        ARIO_LOG_DBG ("Download:%s", uri);
-        download_struct download_data;
-        const gchar* address;
-        int port;
-
-        /* Initialize curl */
-        CURL* curl = curl_easy_init ();
-        if (!curl)
-                return;
-
-        *size = 0;
-        *data = NULL;
-
-        download_data.size = 0;
-        download_data.data = NULL;
-
-        /* set uri */
-        curl_easy_setopt (curl, CURLOPT_URL, uri);
-        /* set callback data */
-        curl_easy_setopt (curl, CURLOPT_WRITEDATA, &download_data);
-        /* set callback function */
-        curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)ario_util_write_data);
-        /* set timeout */
-        curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, 20);
-        /* set redirect */
-        curl_easy_setopt (curl, CURLOPT_FOLLOWLOCATION ,1);
-        /* set NO SIGNAL */
-        curl_easy_setopt (curl, CURLOPT_NOSIGNAL, TRUE);
-
-        /* Use a proxy if one is configured */
-        if (ario_conf_get_boolean (PREF_USE_PROXY, PREF_USE_PROXY_DEFAULT)) {
-                address = ario_conf_get_string (PREF_PROXY_ADDRESS, PREF_PROXY_ADDRESS_DEFAULT);
-                port =  ario_conf_get_integer (PREF_PROXY_PORT, PREF_PROXY_PORT_DEFAULT);
-                if (address) {
-                        curl_easy_setopt (curl, CURLOPT_PROXY, address);
-                        curl_easy_setopt (curl, CURLOPT_PROXYPORT, port);
-                } else {
-                        ARIO_LOG_DBG ("Proxy enabled, but no proxy defined");
-                }
-        }
-
-        /* Handles data for POST requests */
-        if (post_data) {
-                curl_easy_setopt (curl, CURLOPT_POST, TRUE);
-                curl_easy_setopt (curl, CURLOPT_POSTFIELDS, post_data);
-                curl_easy_setopt (curl, CURLOPT_POSTFIELDSIZE, post_size);
-        }
-
-        if (headers) {
-                curl_easy_setopt (curl, CURLOPT_HTTPHEADER, headers);
-        }
-
-        /* Performs the request */
-        curl_easy_perform (curl);
-
-        *size = download_data.size;
-        *data = download_data.data;
-
-        curl_easy_cleanup (curl);
+        /* Connections and responses are shared by all downloads */
+        ario_http_download (uri,
+                            post_data, post_size,
+                            headers,
+                            size, data);
 }
 
 void
@@ -624,12 +532,10 @@ ario_util_get_dnd_pixbuf_from_albums (const GSList *albums)
         for (tmp = albums; tmp && len < MAX_COVERS_IN_DRAG; tmp = g_slist_next (tmp)) {
                 ario_server_album = tmp->data;
 
-                cover_path = ario_cover_make_cover_path (ario_server_album->artist, ario_server_album->album, SMALL_COVER);
-                if (ario_util_uri_exists (cover_path)) {
+                if (ario_cover_cover_file_exists (ario_server_album->artist, ario_server_album->album, SMALL_COVER)) {
+                        cover_path = ario_cover_make_cover_path (ario_server_album->artist, ario_server_album->album, SMALL_COVER);
                         covers = g_slist_append (covers, cover_path);
                         ++len;
-                } else {
-                        g_free (cover_path);
                 }
         }
 
@@ -668,12 +574,10 @@ ario_util_get_dnd_pixbuf (const GSList *criterias)
                 /* Get covers of albums */
                 for (album_tmp = albums; album_tmp && len < MAX_COVERS_IN_DRAG; album_tmp = g_slist_next (album_tmp)) {
                         server_album = album_tmp->data;
-                        cover_path = ario_cover_make_cover_path (server_album->artist, server_album->album, SMALL_COVER);
-                        if (ario_util_uri_exists (cover_path)) {
+                        if (ario_cover_cover_file_exists (server_album->artist, server_album->album, SMALL_COVER)) {
+                                cover_path = ario_cover_make_cover_path (server_album->artist, server_album->album, SMALL_COVER);
                                 covers = g_slist_append (covers, cover_path);
                                 ++len;
-                        } else {
-                                g_free (cover_path);
                         }
                 }
                 g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
@@ -825,33 +729,155 @@ ario_util_stristr (const char *haystack,
         return 0;
 }
 
+gchar *
+ario_util_casefold (const gchar *string)
+{
+        gchar *normalized;
+        gchar *ret;
+
+        if (!string)
+                return NULL;
+
+        normalized = g_utf8_normalize (string, -1, G_NORMALIZE_ALL);
+        if (!normalized)
+                return g_utf8_casefold (string, -1);
+
+        ret = g_utf8_casefold (normalized, -1);
+        g_free (normalized);
+
+        return ret;
+}
+
+gchar **
+ario_util_split_words (const gchar *string)
+{
+        GPtrArray *words;
+        gchar *folded;
+        gchar *p;
+        gchar *start = NULL;
+
+        words = g_ptr_array_new ();
+
+        folded = ario_util_casefold (string);
+        if (folded) {
+                for (p = folded; *p; p = g_utf8_next_char (p)) {
+                        if (g_unichar_isalnum (g_utf8_get_char (p))) {
+                                if (!start)
+                                        start = p;
+                        } else if (start) {
+                                g_ptr_array_add (words, g_strndup (start, p - start));
+                                start = NULL;
+                        }
+                }
+                if (start)
+                        g_ptr_array_add (words, g_strdup (start));
+                g_free (folded);
+        }
+        g_ptr_array_add (words, NULL);
+
+        return (gchar **) g_ptr_array_free (words, FALSE);
+}
+
 GSList *
 ario_util_gslist_randomize (GSList **list,
                             const int max)
 {
         ARIO_LOG_FUNCTION_START;
         GSList *ret = NULL, *tmp;
-        int i = 0;
+        GSList **links;
+        gboolean *chosen;
+        int *indexes;
+        int i, j, swap;
         int len = g_slist_length (*list);
+        int nb = MIN (max, len);
+
+        if (nb <= 0)
+                return NULL;
 
-        for (i = 0; i < max; ++i) {
-                if (len <= 0)
-                        break;
+        links = g_new (GSList *, len);
+        indexes = g_new (int, len);
+        chosen = g_new0 (gboolean, len);
+        for (tmp = *list, i = 0; tmp; tmp = g_slist_next (tmp), ++i) {
+                links[i] = tmp;
+                indexes[i] = i;
+        }
 
-                /* Get a random element in list */
-                tmp = g_slist_nth (*list, rand()%len);
+        /* Partial Fisher-Yates shuffle: the nb first indexes are a random
+         * sample of the list */
+        for (i = 0; i < nb; ++i) {
+                j = g_random_int_range (i, len);
+                swap = indexes[i];
+                indexes[i] = indexes[j];
+                indexes[j] = swap;
+                chosen[indexes[i]] = TRUE;
+        }
 
-                /* Remove the element from list */
-                *list = g_slist_remove_link (*list, tmp);
+        /* Link the elements of the new list, in random order */
+        for (i = nb - 1; i >= 0; --i) {
+                links[indexes[i]]->next = ret;
+                ret = links[indexes[i]];
+        }
 
-                /* Append the element to the new list */
-                ret = g_slist_concat (ret, tmp);
-                len--;
+        /* Link the other elements in their original order */
+        *list = NULL;
+        for (i = len - 1; i >= 0; --i) {
+                if (!chosen[i]) {
+                        links[i]->next = *list;
+                        *list = links[i];
+                }
         }
 
+        g_free (links);
+        g_free (indexes);
+        g_free (chosen);
+
         return ret;
 }
 
+gpointer
+ario_util_sample_add (GPtrArray *sample,
+                      const guint max,
+                      const guint seen,
+                      gpointer data)
+{
+        gpointer dropped;
+        guint i;
+
+        /* The sample is not full yet */
+        if (sample->len < max) {
+                g_ptr_array_add (sample, data);
+                return NULL;
+        }
+
+        /* The element replaces a random element of the sample with a
+         * probability of max/seen */
+        i = g_random_int_range (0, seen);
+        if (i >= max)
+                return data;
+
+        dropped = g_ptr_array_index (sample, i);
+        g_ptr_array_index (sample, i) = data;
+
+        return dropped;
+}
+
+void
+ario_util_ptr_array_shuffle (GPtrArray *array)
+{
+        gpointer swap;
+        guint i, j;
+
+        if (array->len < 2)
+                return;
+
+        for (i = array->len - 1; i > 0; --i) {
+                j = g_random_int_range (0, i + 1);
+                swap = g_ptr_array_index (array, i);
+                g_ptr_array_index (array, i) = g_ptr_array_index (array, j);
+                g_ptr_array_index (array, j) = swap;
+        }
+}
+
 gchar *
 ario_util_format_for_http (const gchar *text)
 {
@@ -286,6 +286,27 @@ gboolean                ario_file_test                       (const gchar *filen
 const char *            ario_util_stristr                    (const char *haystack,
                                                               const char *needle);
 
+/**
+ * Normalize and case fold a string so that strings matching without
+ * regard to case and accents composition can be compared with strstr
+ *
+ * @param string The UTF-8 string to fold, may be NULL
+ *
+ * @return A newly allocated string, NULL if string is NULL
+ */
+gchar *                 ario_util_casefold                   (const gchar *string);
+
+/**
+ * Split a string in case folded words (see ario_util_casefold), words
+ * being separated by any character that is not a letter or a digit
+ *
+ * @param string The UTF-8 string to split, may be NULL
+ *
+ * @return A newly allocated NULL-terminated array of words, to free
+ * with g_strfreev
+ */
+gchar **                ario_util_split_words                (const gchar *string);
+
 /**
  * Randomize a GSList
  *
@@ -300,6 +321,31 @@ const char *            ario_util_stristr                    (const char *haysta
 GSList *                ario_util_gslist_randomize           (GSList **list,
                                                               const int max);
 
+/**
+ * Add an element to a random sample of a stream of elements (reservoir
+ * sampling): after all elements have been added, each of them has the
+ * same probability to be in the sample.
+ *
+ * @param sample The array containing the sample
+ * @param max The size of the sample
+ * @param seen The number of elements added so far, including data
+ * @param data The new element
+ *
+ * @return The element that is not in the sample anymore (data or a
+ *         replaced element) so that it can be freed, or NULL
+ */
+gpointer                ario_util_sample_add                 (GPtrArray *sample,
+                                                              const guint max,
+                                                              const guint seen,
+                                                              gpointer data);
+
+/**
+ * Shuffle the elements of an array
+ *
+ * @param array The array to shuffle
+ */
+void                    ario_util_ptr_array_shuffle          (GPtrArray *array);
+
 /**
  * Format a string so that it can be used in an HTTP requests
  *
@@ -43,6 +43,13 @@ static GSList* ario_cover_amazon_parse_xml_file (char *xmldata,
                                                  int size,
                                                  ArioCoverProviderOperation operation,
                                                  const char *cover_size);
+static gchar* ario_cover_amazon_get_search_uri (ArioCoverProvider *cover_provider,
+                                                const char *artist,
+                                                const char *album);
+static GSList* ario_cover_amazon_parse_search (ArioCoverProvider *cover_provider,
+                                               char *data,
+                                               int size,
+                                               ArioCoverProviderOperation operation);
 gboolean ario_cover_amazon_get_covers (ArioCoverProvider *cover_provider,
                                        const char *artist,
                                        const char *album,
@@ -74,6 +81,8 @@ ario_cover_amazon_class_init (ArioCoverAmazonClass *klass)
         cover_provider_class->get_id = ario_cover_amazon_get_id;
         cover_provider_class->get_name = ario_cover_amazon_get_name;
         cover_provider_class->get_covers = ario_cover_amazon_get_covers;
+        cover_provider_class->get_search_uri = ario_cover_amazon_get_search_uri;
+        cover_provider_class->parse_search = ario_cover_amazon_parse_search;
 }
 
 static void
@@ -204,6 +213,37 @@ ario_cover_amazon_make_xml_uri (const char *artist,
         return xml_uri;
 }
 
+static gchar *
+ario_cover_amazon_get_search_uri (ArioCoverProvider *cover_provider,
+                                  const char *artist,
+                                  const char *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* We construct the uri to make a request on the amazon WebServices */
+        return ario_cover_amazon_make_xml_uri (artist,
+                                               album);
+}
+
+static GSList *
+ario_cover_amazon_parse_search (ArioCoverProvider *cover_provider,
+                                char *data,
+                                int size,
+                                ArioCoverProviderOperation operation)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (size == 0)
+                return NULL;
+
+        if (g_strrstr (data, "<ErrorMsg>") || g_strrstr (data, "<html>"))
+                return NULL;
+
+        /* We parse the xml file to extract the cover uris */
+        return ario_cover_amazon_parse_xml_file (data,
+                                                 size,
+                                                 operation,
+                                                 COVER_MEDIUM);
+}
+
 gboolean
 ario_cover_amazon_get_covers (ArioCoverProvider *cover_provider,
                               const char *artist,
@@ -223,9 +263,9 @@ ario_cover_amazon_get_covers (ArioCoverProvider *cover_provider,
         gboolean ret;
         GSList *ario_cover_uris;
 
-        /* We construct the uri to make a request on the amazon WebServices */
-        xml_uri = ario_cover_amazon_make_xml_uri (artist,
-                                                  album);
+        xml_uri = ario_cover_amazon_get_search_uri (cover_provider,
+                                                    artist,
+                                                    album);
 
         if (!xml_uri)
                 return FALSE;
@@ -237,20 +277,10 @@ ario_cover_amazon_get_covers (ArioCoverProvider *cover_provider,
                                  &xml_data);
         g_free (xml_uri);
 
-        if (xml_size == 0) {
-                return FALSE;
-        }
-
-        if (g_strrstr (xml_data, "<ErrorMsg>") || g_strrstr (xml_data, "<html>")) {
-                g_free (xml_data);
-                return FALSE;
-        }
-
-        /* We parse the xml file to extract the cover uris */
-        ario_cover_uris = ario_cover_amazon_parse_xml_file (xml_data,
-                                                            xml_size,
-                                                            operation,
-                                                            COVER_MEDIUM);
+        ario_cover_uris = ario_cover_amazon_parse_search (cover_provider,
+                                                          xml_data,
+                                                          xml_size,
+                                                          operation);
 
         g_free (xml_data);
 
@@ -0,0 +1,377 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "covers/ario-cover-cache.h"
+#include <gtk/gtk.h>
+#include <string.h>
+#include <config.h>
+#include "covers/ario-cover.h"
+#include "ario-debug.h"
+
+/* Maximum number of covers kept in memory */
+#define MAX_COVERS 512
+
+/* Number of threads decoding covers */
+#define DECODE_THREADS 2
+
+static void ario_cover_cache_finalize (GObject *object);
+static void ario_cover_cache_decode (gpointer data,
+                                     gpointer user_data);
+
+enum
+{
+        COVER_LOADED,
+        LAST_SIGNAL
+};
+static guint ario_cover_cache_signals[LAST_SIGNAL] = { 0 };
+
+typedef struct
+{
+        gchar *key;
+        /* NULL while the cover is decoded */
+        GdkPixbuf *pixbuf;
+        /* Load request whose result is expected */
+        guint generation;
+        /* Link in the list of recently used entries */
+        GList *link;
+} ArioCoverCacheEntry;
+
+typedef struct
+{
+        gchar *key;
+        gchar *artist;
+        gchar *album;
+        guint generation;
+        GdkPixbuf *pixbuf;
+} ArioCoverCacheJob;
+
+struct ArioCoverCachePrivate
+{
+        /* Key -> ArioCoverCacheEntry */
+        GHashTable *entries;
+        /* Entries, most recently used first */
+        GQueue *recent;
+
+        GThreadPool *pool;
+        guint generation;
+
+        /* Shown while a cover is loaded and for albums without cover */
+        GdkPixbuf *placeholder;
+};
+
+#define ARIO_COVER_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TYPE_ARIO_COVER_CACHE, ArioCoverCachePrivate))
+G_DEFINE_TYPE (ArioCoverCache, ario_cover_cache, G_TYPE_OBJECT)
+
+static ArioCoverCache *instance = NULL;
+
+static void
+ario_cover_cache_class_init (ArioCoverCacheClass *klass)
+{
+        ARIO_LOG_FUNCTION_START;
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+        object_class->finalize = ario_cover_cache_finalize;
+
+        ario_cover_cache_signals[COVER_LOADED] =
+                g_signal_new ("cover_loaded",
+                              G_OBJECT_CLASS_TYPE (object_class),
+                              G_SIGNAL_RUN_LAST,
+                              G_STRUCT_OFFSET (ArioCoverCacheClass, cover_loaded),
+                              NULL, NULL,
+                              g_cclosure_marshal_VOID__STRING,
+                              G_TYPE_NONE,
+                              1,
+                              G_TYPE_STRING);
+        g_type_class_add_private (klass, sizeof (ArioCoverCachePrivate));
+}
+
+static void
+ario_cover_cache_free_entry (ArioCoverCacheEntry *entry)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (entry->pixbuf)
+                g_object_unref (entry->pixbuf);
+        g_free (entry->key);
+        g_free (entry);
+}
+
+static void
+ario_cover_cache_free_job (ArioCoverCacheJob *job)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (job->pixbuf)
+                g_object_unref (job->pixbuf);
+        g_free (job->key);
+        g_free (job->artist);
+        g_free (job->album);
+        g_free (job);
+}
+
+static void
+ario_cover_cache_init (ArioCoverCache *cover_cache)
+{
+        ARIO_LOG_FUNCTION_START;
+        cover_cache->priv = ARIO_COVER_CACHE_GET_PRIVATE (cover_cache);
+
+        cover_cache->priv->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                            NULL,
+                                                            (GDestroyNotify) ario_cover_cache_free_entry);
+        cover_cache->priv->recent = g_queue_new ();
+        cover_cache->priv->pool = g_thread_pool_new (ario_cover_cache_decode, cover_cache,
+                                                     DECODE_THREADS, FALSE, NULL);
+
+        /* Transparent picture */
+        cover_cache->priv->placeholder = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, COVER_SIZE, COVER_SIZE);
+        gdk_pixbuf_fill (cover_cache->priv->placeholder, 0);
+}
+
+static void
+ario_cover_cache_finalize (GObject *object)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCache *cover_cache;
+
+        g_return_if_fail (object != NULL);
+        g_return_if_fail (IS_ARIO_COVER_CACHE (object));
+
+        cover_cache = ARIO_COVER_CACHE (object);
+
+        g_return_if_fail (cover_cache->priv != NULL);
+
+        /* Results of the remaining decodes are ignored */
+        instance = NULL;
+        g_thread_pool_free (cover_cache->priv->pool, TRUE, TRUE);
+
+        g_queue_free (cover_cache->priv->recent);
+        g_hash_table_destroy (cover_cache->priv->entries);
+        g_object_unref (cover_cache->priv->placeholder);
+
+        G_OBJECT_CLASS (ario_cover_cache_parent_class)->finalize (object);
+}
+
+ArioCoverCache *
+ario_cover_cache_get_instance (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!instance)
+                instance = g_object_new (TYPE_ARIO_COVER_CACHE, NULL);
+
+        return instance;
+}
+
+gchar *
+ario_cover_cache_make_key (const gchar *artist,
+                           const gchar *album)
+{
+        return g_strdup_printf ("%s\t%s", artist, album);
+}
+
+static void
+ario_cover_cache_trim (ArioCoverCache *cover_cache)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCacheEntry *entry;
+
+        /* Least recently used entries are dropped */
+        while (g_queue_get_length (cover_cache->priv->recent) > MAX_COVERS) {
+                entry = g_queue_pop_tail (cover_cache->priv->recent);
+                g_hash_table_remove (cover_cache->priv->entries, entry->key);
+        }
+}
+
+static gboolean
+ario_cover_cache_decoded (ArioCoverCacheJob *job)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCache *cover_cache = instance;
+        ArioCoverCacheEntry *entry;
+
+        if (!cover_cache) {
+                ario_cover_cache_free_job (job);
+                return FALSE;
+        }
+
+        entry = g_hash_table_lookup (cover_cache->priv->entries, job->key);
+        if (entry && entry->generation != job->generation) {
+                /* The cover has been requested again since this decode */
+                ario_cover_cache_free_job (job);
+                return FALSE;
+        }
+
+        if (!entry) {
+                /* The entry was dropped while the cover was decoded but
+                 * rows may still wait for it */
+                entry = (ArioCoverCacheEntry *) g_malloc0 (sizeof (ArioCoverCacheEntry));
+                entry->key = g_strdup (job->key);
+                entry->generation = job->generation;
+                g_queue_push_head (cover_cache->priv->recent, entry);
+                entry->link = g_queue_peek_head_link (cover_cache->priv->recent);
+                g_hash_table_insert (cover_cache->priv->entries, entry->key, entry);
+                ario_cover_cache_trim (cover_cache);
+        }
+
+        if (entry->pixbuf)
+                g_object_unref (entry->pixbuf);
+        if (job->pixbuf) {
+                entry->pixbuf = job->pixbuf;
+                job->pixbuf = NULL;
+        } else {
+                /* There is no cover */
+                entry->pixbuf = g_object_ref (cover_cache->priv->placeholder);
+        }
+
+        g_signal_emit (G_OBJECT (cover_cache), ario_cover_cache_signals[COVER_LOADED], 0, job->key);
+        ario_cover_cache_free_job (job);
+
+        return FALSE;
+}
+
+static void
+ario_cover_cache_decode (gpointer data,
+                         gpointer user_data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCacheJob *job = data;
+        gchar *cover_path;
+
+        /* Executed in a thread of the pool. Albums without cover are
+         * detected without trying to open the file */
+        if (ario_cover_cover_file_exists (job->artist, job->album, SMALL_COVER)) {
+                cover_path = ario_cover_make_cover_path (job->artist, job->album, SMALL_COVER);
+                job->pixbuf = gdk_pixbuf_new_from_file_at_size (cover_path, COVER_SIZE, COVER_SIZE, NULL);
+                g_free (cover_path);
+        }
+
+        g_idle_add ((GSourceFunc) ario_cover_cache_decoded, job);
+}
+
+static void
+ario_cover_cache_load (ArioCoverCache *cover_cache,
+                       ArioCoverCacheEntry *entry,
+                       const gchar *artist,
+                       const gchar *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCacheJob *job;
+
+        entry->generation = ++cover_cache->priv->generation;
+
+        job = (ArioCoverCacheJob *) g_malloc0 (sizeof (ArioCoverCacheJob));
+        job->key = g_strdup (entry->key);
+        job->artist = g_strdup (artist);
+        job->album = g_strdup (album);
+        job->generation = entry->generation;
+
+        g_thread_pool_push (cover_cache->priv->pool, job, NULL);
+}
+
+static ArioCoverCacheEntry *
+ario_cover_cache_add_entry (ArioCoverCache *cover_cache,
+                            const gchar *key,
+                            const gchar *artist,
+                            const gchar *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCacheEntry *entry;
+
+        entry = (ArioCoverCacheEntry *) g_malloc0 (sizeof (ArioCoverCacheEntry));
+        entry->key = g_strdup (key);
+        g_queue_push_head (cover_cache->priv->recent, entry);
+        entry->link = g_queue_peek_head_link (cover_cache->priv->recent);
+        g_hash_table_insert (cover_cache->priv->entries, entry->key, entry);
+
+        ario_cover_cache_load (cover_cache, entry, artist, album);
+        ario_cover_cache_trim (cover_cache);
+
+        return entry;
+}
+
+GdkPixbuf *
+ario_cover_cache_get_cover (ArioCoverCache *cover_cache,
+                            const gchar *artist,
+                            const gchar *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCacheEntry *entry;
+        gchar *key;
+
+        if (!artist || !album)
+                return cover_cache->priv->placeholder;
+
+        key = ario_cover_cache_make_key (artist, album);
+        entry = g_hash_table_lookup (cover_cache->priv->entries, key);
+        if (entry) {
+                /* Move the entry at the head of recently used entries */
+                g_queue_unlink (cover_cache->priv->recent, entry->link);
+                g_queue_push_head_link (cover_cache->priv->recent, entry->link);
+        } else {
+                entry = ario_cover_cache_add_entry (cover_cache, key, artist, album);
+        }
+        g_free (key);
+
+        return entry->pixbuf ? entry->pixbuf : cover_cache->priv->placeholder;
+}
+
+typedef struct
+{
+        gchar *artist;
+        gchar *album;
+} ArioCoverCacheAlbum;
+
+static gboolean
+ario_cover_cache_invalidate_idle (ArioCoverCacheAlbum *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCacheEntry *entry;
+        gchar *key;
+
+        if (instance) {
+                key = ario_cover_cache_make_key (data->artist, data->album);
+                entry = g_hash_table_lookup (instance->priv->entries, key);
+                /* Rows may show the cover even if the entry has been dropped */
+                if (entry)
+                        ario_cover_cache_load (instance, entry, data->artist, data->album);
+                else
+                        ario_cover_cache_add_entry (instance, key, data->artist, data->album);
+                g_free (key);
+        }
+
+        g_free (data->artist);
+        g_free (data->album);
+        g_free (data);
+
+        return FALSE;
+}
+
+void
+ario_cover_cache_invalidate (const gchar *artist,
+                             const gchar *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCacheAlbum *data;
+
+        if (!artist || !album)
+                return;
+
+        /* Entries are only modified in the main loop */
+        data = (ArioCoverCacheAlbum *) g_malloc0 (sizeof (ArioCoverCacheAlbum));
+        data->artist = g_strdup (artist);
+        data->album = g_strdup (album);
+        g_idle_add ((GSourceFunc) ario_cover_cache_invalidate_idle, data);
+}
@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_COVER_CACHE_H
+#define __ARIO_COVER_CACHE_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define TYPE_ARIO_COVER_CACHE         (ario_cover_cache_get_type ())
+#define ARIO_COVER_CACHE(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), TYPE_ARIO_COVER_CACHE, ArioCoverCache))
+#define ARIO_COVER_CACHE_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), TYPE_ARIO_COVER_CACHE, ArioCoverCacheClass))
+#define IS_ARIO_COVER_CACHE(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), TYPE_ARIO_COVER_CACHE))
+#define IS_ARIO_COVER_CACHE_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), TYPE_ARIO_COVER_CACHE))
+#define ARIO_COVER_CACHE_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), TYPE_ARIO_COVER_CACHE, ArioCoverCacheClass))
+
+typedef struct ArioCoverCachePrivate ArioCoverCachePrivate;
+
+/*
+ * ArioCoverCache keeps the small covers of the most recently displayed
+ * albums. Covers are decoded by worker threads: a placeholder is
+ * returned until the cover is loaded and the "cover_loaded" signal is
+ * emitted with the key of the album.
+ */
+typedef struct
+{
+        GObject parent;
+
+        ArioCoverCachePrivate *priv;
+} ArioCoverCache;
+
+typedef struct
+{
+        GObjectClass parent_class;
+
+        /* Signals */
+        void (*cover_loaded)            (ArioCoverCache *cover_cache,
+                                         const gchar *key);
+} ArioCoverCacheClass;
+
+GType              ario_cover_cache_get_type           (void) G_GNUC_CONST;
+
+ArioCoverCache *   ario_cover_cache_get_instance       (void);
+
+/* Key of an album in the cache, to free with g_free */
+gchar *            ario_cover_cache_make_key           (const gchar *artist,
+                                                        const gchar *album);
+
+/* Small cover of the album (not referenced): the placeholder is
+ * returned while the cover is loaded or if there is no cover */
+GdkPixbuf *        ario_cover_cache_get_cover          (ArioCoverCache *cover_cache,
+                                                        const gchar *artist,
+                                                        const gchar *album);
+
+/* Load the cover of the album again, can be called from any thread */
+void               ario_cover_cache_invalidate         (const gchar *artist,
+                                                        const gchar *album);
+
+G_END_DECLS
+
+#endif /* __ARIO_COVER_CACHE_H */
@@ -0,0 +1,568 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "covers/ario-cover-fetcher.h"
+#include <curl/curl.h>
+#include <string.h>
+#include <config.h>
+#include "covers/ario-cover.h"
+#include "ario-http.h"
+#include "ario-debug.h"
+
+/* Maximum number of downloads at the same time */
+#define MAX_TRANSFERS 16
+
+/* Maximum number of downloads at the same time on the same host */
+#define MAX_TRANSFERS_PER_HOST 4
+
+/* Maximum number of albums searched at the same time */
+#define MAX_ALBUMS 32
+
+/* Maximum size of a downloaded file */
+#define MAX_DOWNLOAD_SIZE 5*1024*1024
+
+/* Maximum time to wait for network activity before checking if the
+ * search has been cancelled (in ms) */
+#define WAIT_TIMEOUT 200
+
+typedef enum
+{
+        SEARCH_TRANSFER,
+        COVER_TRANSFER
+} ArioCoverFetcherTransferType;
+
+typedef struct
+{
+        /* Covers found by a provider */
+        GArray *file_size;
+        GSList *file_contents;
+
+        /* Number of downloads of the provider not finished */
+        gint pending;
+} ArioCoverFetcherResult;
+
+typedef struct
+{
+        const ArioServerAlbum *server_album;
+
+        /* One result per provider */
+        ArioCoverFetcherResult *results;
+
+        /* Downloads of the album not finished */
+        GSList *transfers;
+} ArioCoverFetcherJob;
+
+typedef struct
+{
+        /* Downloads waiting for a free slot */
+        GQueue *waiting;
+
+        /* Number of downloads in progress */
+        gint running;
+} ArioCoverFetcherHost;
+
+typedef struct
+{
+        /* NULL once the download is cancelled */
+        ArioCoverFetcherJob *job;
+
+        guint provider;
+        ArioCoverFetcherTransferType type;
+        gchar *uri;
+        ArioCoverFetcherHost *host;
+
+        /* NULL until the download is started */
+        CURL *curl;
+        GString *data;
+} ArioCoverFetcherTransfer;
+
+typedef struct
+{
+        ArioCoverProvider **providers;
+        guint n_providers;
+        ArioCoverProviderOperation operation;
+        ArioCoverFetcherFunc func;
+        gpointer user_data;
+
+        CURLM *multi;
+
+        /* Host name -> ArioCoverFetcherHost */
+        GHashTable *hosts;
+
+        /* Number of downloads in progress */
+        gint running;
+
+        /* Albums being searched (ArioCoverFetcherJob) */
+        GSList *jobs;
+        guint n_jobs;
+} ArioCoverFetcher;
+
+static gchar *
+ario_cover_fetcher_host_name (const gchar *uri)
+{
+        const gchar *start;
+        const gchar *end;
+
+        start = strstr (uri, "://");
+        start = start ? start + 3 : uri;
+        for (end = start; *end && *end != '/' && *end != ':'; ++end);
+
+        return g_strndup (start, end - start);
+}
+
+static size_t
+ario_cover_fetcher_write_data (void *buffer,
+                               size_t size,
+                               size_t nmemb,
+                               ArioCoverFetcherTransfer *transfer)
+{
+        if (!size || !nmemb)
+                return 0;
+
+        /* The file is too big: abort the download */
+        if (transfer->data->len + size*nmemb >= MAX_DOWNLOAD_SIZE)
+                return 0;
+
+        g_string_append_len (transfer->data, buffer, size*nmemb);
+
+        return size*nmemb;
+}
+
+static void
+ario_cover_fetcher_free_transfer (ArioCoverFetcherTransfer *transfer)
+{
+        g_free (transfer->uri);
+        if (transfer->data)
+                g_string_free (transfer->data, TRUE);
+        g_free (transfer);
+}
+
+static void
+ario_cover_fetcher_free_host (ArioCoverFetcherHost *host)
+{
+        /* Only cancelled downloads are still waiting */
+        g_queue_foreach (host->waiting, (GFunc) ario_cover_fetcher_free_transfer, NULL);
+        g_queue_free (host->waiting);
+        g_free (host);
+}
+
+static void
+ario_cover_fetcher_add_transfer (ArioCoverFetcher *fetcher,
+                                 ArioCoverFetcherJob *job,
+                                 const guint provider,
+                                 const ArioCoverFetcherTransferType type,
+                                 gchar *uri)
+{
+        ArioCoverFetcherTransfer *transfer;
+        ArioCoverFetcherHost *host;
+        gchar *host_name;
+
+        transfer = (ArioCoverFetcherTransfer *) g_malloc0 (sizeof (ArioCoverFetcherTransfer));
+        transfer->job = job;
+        transfer->provider = provider;
+        transfer->type = type;
+        transfer->uri = uri;
+
+        host_name = ario_cover_fetcher_host_name (uri);
+        host = g_hash_table_lookup (fetcher->hosts, host_name);
+        if (host) {
+                g_free (host_name);
+        } else {
+                host = (ArioCoverFetcherHost *) g_malloc0 (sizeof (ArioCoverFetcherHost));
+                host->waiting = g_queue_new ();
+                g_hash_table_insert (fetcher->hosts, host_name, host);
+        }
+        transfer->host = host;
+
+        job->transfers = g_slist_prepend (job->transfers, transfer);
+        ++job->results[provider].pending;
+
+        /* Covers are downloaded before new searches so that albums
+         * already in progress are finished first */
+        if (type == COVER_TRANSFER)
+                g_queue_push_head (host->waiting, transfer);
+        else
+                g_queue_push_tail (host->waiting, transfer);
+}
+
+static void
+ario_cover_fetcher_start_transfers (ArioCoverFetcher *fetcher)
+{
+        GHashTableIter iter;
+        ArioCoverFetcherHost *host;
+        ArioCoverFetcherTransfer *transfer;
+        CURL *curl;
+
+        g_hash_table_iter_init (&iter, fetcher->hosts);
+        while (fetcher->running < MAX_TRANSFERS
+               && g_hash_table_iter_next (&iter, NULL, (gpointer *) &host)) {
+                while (fetcher->running < MAX_TRANSFERS
+                       && host->running < MAX_TRANSFERS_PER_HOST
+                       && (transfer = g_queue_pop_head (host->waiting))) {
+                        /* Cancelled downloads are freed when they leave the queue */
+                        if (!transfer->job) {
+                                ario_cover_fetcher_free_transfer (transfer);
+                                continue;
+                        }
+
+                        curl = curl_easy_init ();
+                        if (!curl) {
+                                g_queue_push_head (host->waiting, transfer);
+                                return;
+                        }
+
+                        ARIO_LOG_DBG ("Download:%s", transfer->uri);
+                        transfer->curl = curl;
+                        transfer->data = g_string_new (NULL);
+
+                        curl_easy_setopt (curl, CURLOPT_URL, transfer->uri);
+                        curl_easy_setopt (curl, CURLOPT_WRITEDATA, transfer);
+                        curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, (curl_write_callback) ario_cover_fetcher_write_data);
+                        curl_easy_setopt (curl, CURLOPT_PRIVATE, transfer);
+                        ario_http_setup (curl);
+
+                        curl_multi_add_handle (fetcher->multi, curl);
+                        ++host->running;
+                        ++fetcher->running;
+                }
+        }
+}
+
+static void
+ario_cover_fetcher_stop_transfer (ArioCoverFetcher *fetcher,
+                                  ArioCoverFetcherTransfer *transfer)
+{
+        curl_multi_remove_handle (fetcher->multi, transfer->curl);
+        curl_easy_cleanup (transfer->curl);
+        transfer->curl = NULL;
+        --transfer->host->running;
+        --fetcher->running;
+
+        ario_cover_fetcher_free_transfer (transfer);
+}
+
+static void
+ario_cover_fetcher_cancel_transfers (ArioCoverFetcher *fetcher,
+                                     ArioCoverFetcherJob *job)
+{
+        GSList *tmp;
+        ArioCoverFetcherTransfer *transfer;
+
+        for (tmp = job->transfers; tmp; tmp = g_slist_next (tmp)) {
+                transfer = tmp->data;
+                if (transfer->curl)
+                        ario_cover_fetcher_stop_transfer (fetcher, transfer);
+                else
+                        /* Still in the queue of its host */
+                        transfer->job = NULL;
+        }
+        g_slist_free (job->transfers);
+        job->transfers = NULL;
+}
+
+static void
+ario_cover_fetcher_free_job (ArioCoverFetcher *fetcher,
+                             ArioCoverFetcherJob *job)
+{
+        guint i;
+
+        ario_cover_fetcher_cancel_transfers (fetcher, job);
+
+        for (i = 0; i < fetcher->n_providers; ++i) {
+                g_array_free (job->results[i].file_size, TRUE);
+                g_slist_foreach (job->results[i].file_contents, (GFunc) g_free, NULL);
+                g_slist_free (job->results[i].file_contents);
+        }
+        g_free (job->results);
+
+        fetcher->jobs = g_slist_remove (fetcher->jobs, job);
+        --fetcher->n_jobs;
+        g_free (job);
+}
+
+static gboolean
+ario_cover_fetcher_job_is_over (ArioCoverFetcher *fetcher,
+                                ArioCoverFetcherJob *job)
+{
+        guint i;
+
+        for (i = 0; i < fetcher->n_providers; ++i) {
+                /* All providers with a higher priority have failed and
+                 * this one has found a cover: the other ones are useless */
+                if (fetcher->operation == GET_FIRST_COVER
+                    && job->results[i].file_size->len > 0)
+                        return TRUE;
+
+                if (job->results[i].pending > 0)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+static void
+ario_cover_fetcher_job_end (ArioCoverFetcher *fetcher,
+                           ArioCoverFetcherJob *job)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverFetcherResult *result;
+        GArray *file_size;
+        GSList *file_contents = NULL;
+        guint i;
+
+        /* Requests still in progress are not needed anymore */
+        ario_cover_fetcher_cancel_transfers (fetcher, job);
+
+        /* Covers are given by provider priority */
+        file_size = g_array_new (TRUE, TRUE, sizeof (int));
+        for (i = 0; i < fetcher->n_providers; ++i) {
+                if (fetcher->operation == GET_FIRST_COVER && file_size->len > 0)
+                        break;
+
+                result = &job->results[i];
+                g_array_append_vals (file_size, result->file_size->data, result->file_size->len);
+                g_array_set_size (result->file_size, 0);
+                file_contents = g_slist_concat (file_contents, result->file_contents);
+                result->file_contents = NULL;
+        }
+
+        fetcher->func (job->server_album, file_size, file_contents, fetcher->user_data);
+
+        ario_cover_fetcher_free_job (fetcher, job);
+}
+
+static void
+ario_cover_fetcher_job_start (ArioCoverFetcher *fetcher,
+                              const ArioServerAlbum *server_album)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverFetcherJob *job;
+        ArioCoverFetcherResult *result;
+        ArioCoverProvider *cover_provider;
+        gchar *uri;
+        guint i;
+
+        job = (ArioCoverFetcherJob *) g_malloc0 (sizeof (ArioCoverFetcherJob));
+        job->server_album = server_album;
+        job->results = g_new0 (ArioCoverFetcherResult, fetcher->n_providers);
+        for (i = 0; i < fetcher->n_providers; ++i)
+                job->results[i].file_size = g_array_new (TRUE, TRUE, sizeof (int));
+
+        fetcher->jobs = g_slist_prepend (fetcher->jobs, job);
+        ++fetcher->n_jobs;
+
+        for (i = 0; i < fetcher->n_providers; ++i) {
+                cover_provider = fetcher->providers[i];
+                result = &job->results[i];
+
+                if (ario_cover_provider_has_search (cover_provider)) {
+                        /* The search is made with the downloads of the other albums */
+                        uri = ario_cover_provider_get_search_uri (cover_provider,
+                                                                  server_album->artist,
+                                                                  server_album->album);
+                        if (uri)
+                                ario_cover_fetcher_add_transfer (fetcher, job, i, SEARCH_TRANSFER, uri);
+                } else {
+                        ARIO_LOG_DBG ("looking for a cover using provider:%s for album:%s\n", ario_cover_provider_get_name (cover_provider), server_album->album);
+                        ario_cover_provider_get_covers (cover_provider,
+                                                        server_album->artist,
+                                                        server_album->album,
+                                                        server_album->path,
+                                                        &result->file_size,
+                                                        &result->file_contents,
+                                                        fetcher->operation);
+
+                        /* Providers with a lower priority are not needed */
+                        if (fetcher->operation == GET_FIRST_COVER
+                            && result->file_size->len > 0)
+                                break;
+                }
+        }
+
+        if (ario_cover_fetcher_job_is_over (fetcher, job))
+                ario_cover_fetcher_job_end (fetcher, job);
+}
+
+static void
+ario_cover_fetcher_transfer_done (ArioCoverFetcher *fetcher,
+                                  ArioCoverFetcherTransfer *transfer,
+                                  const gboolean success)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverFetcherJob *job = transfer->job;
+        ArioCoverFetcherResult *result = &job->results[transfer->provider];
+        ArioCoverProvider *cover_provider = fetcher->providers[transfer->provider];
+        GSList *uris;
+        GSList *tmp;
+        int size;
+
+        job->transfers = g_slist_remove (job->transfers, transfer);
+        size = transfer->data->len;
+
+        if (success && size > 0) {
+                switch (transfer->type) {
+                case SEARCH_TRANSFER:
+                        /* Download all the covers listed by the provider */
+                        uris = ario_cover_provider_parse_search (cover_provider,
+                                                                 transfer->data->str,
+                                                                 size,
+                                                                 fetcher->operation);
+                        for (tmp = uris; tmp; tmp = g_slist_next (tmp)) {
+                                if (tmp->data)
+                                        ario_cover_fetcher_add_transfer (fetcher, job, transfer->provider,
+                                                                         COVER_TRANSFER, g_strdup (tmp->data));
+                        }
+                        g_slist_foreach (uris, (GFunc) g_free, NULL);
+                        g_slist_free (uris);
+                        break;
+
+                case COVER_TRANSFER:
+                        /* The cover is not too big and not too small (blank image) */
+                        if (ario_cover_size_is_valid (size)) {
+                                g_array_append_val (result->file_size, size);
+                                result->file_contents = g_slist_append (result->file_contents,
+                                                                        g_string_free (transfer->data, FALSE));
+                                transfer->data = NULL;
+                        }
+                        break;
+
+                default:
+                        break;
+                }
+        }
+
+        --result->pending;
+        ario_cover_fetcher_stop_transfer (fetcher, transfer);
+
+        if (ario_cover_fetcher_job_is_over (fetcher, job))
+                ario_cover_fetcher_job_end (fetcher, job);
+}
+
+static void
+ario_cover_fetcher_read_messages (ArioCoverFetcher *fetcher)
+{
+        CURLMsg *msg;
+        int n_msgs;
+        gchar *transfer;
+        gboolean success;
+
+        while ((msg = curl_multi_info_read (fetcher->multi, &n_msgs))) {
+                if (msg->msg != CURLMSG_DONE)
+                        continue;
+
+                /* msg is not valid anymore once the handle is removed */
+                curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+                success = (msg->data.result == CURLE_OK);
+
+                ario_cover_fetcher_transfer_done (fetcher,
+                                                  (ArioCoverFetcherTransfer *) transfer,
+                                                  success);
+        }
+}
+
+static void
+ario_cover_fetcher_wait (ArioCoverFetcher *fetcher)
+{
+        fd_set read_fds;
+        fd_set write_fds;
+        fd_set except_fds;
+        int max_fd = -1;
+        long timeout = -1;
+        struct timeval tv;
+
+        curl_multi_timeout (fetcher->multi, &timeout);
+        if (timeout < 0 || timeout > WAIT_TIMEOUT)
+                timeout = WAIT_TIMEOUT;
+
+        FD_ZERO (&read_fds);
+        FD_ZERO (&write_fds);
+        FD_ZERO (&except_fds);
+        curl_multi_fdset (fetcher->multi, &read_fds, &write_fds, &except_fds, &max_fd);
+
+        if (max_fd == -1) {
+                /* Nothing to wait for yet (name resolution...) */
+                g_usleep (MIN (timeout, 100) * 1000);
+        } else {
+                tv.tv_sec = timeout / 1000;
+                tv.tv_usec = (timeout % 1000) * 1000;
+                select (max_fd + 1, &read_fds, &write_fds, &except_fds, &tv);
+        }
+}
+
+void
+ario_cover_fetcher_get_covers (const GSList *providers,
+                               const GSList *albums,
+                               ArioCoverProviderOperation operation,
+                               ArioCoverFetcherFunc func,
+                               gpointer user_data,
+                               const gboolean *cancelled)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverFetcher fetcher;
+        const GSList *tmp;
+        const GSList *next_album = albums;
+        int running;
+        guint i;
+
+        fetcher.n_providers = g_slist_length ((GSList *) providers);
+        fetcher.providers = g_new (ArioCoverProvider *, fetcher.n_providers);
+        for (tmp = providers, i = 0; tmp; tmp = g_slist_next (tmp), ++i)
+                fetcher.providers[i] = tmp->data;
+        fetcher.operation = operation;
+        fetcher.func = func;
+        fetcher.user_data = user_data;
+        fetcher.multi = curl_multi_init ();
+        fetcher.hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify) ario_cover_fetcher_free_host);
+        fetcher.running = 0;
+        fetcher.jobs = NULL;
+        fetcher.n_jobs = 0;
+
+        while (!(cancelled && *cancelled)) {
+                /* Start the search of new albums */
+                while (fetcher.n_jobs < MAX_ALBUMS && next_album) {
+                        ario_cover_fetcher_job_start (&fetcher, next_album->data);
+                        next_album = g_slist_next (next_album);
+                }
+
+                /* All albums are done */
+                if (!fetcher.jobs)
+                        break;
+
+                ario_cover_fetcher_start_transfers (&fetcher);
+
+                while (curl_multi_perform (fetcher.multi, &running) == CURLM_CALL_MULTI_PERFORM);
+                ario_cover_fetcher_read_messages (&fetcher);
+
+                if (fetcher.running > 0)
+                        ario_cover_fetcher_wait (&fetcher);
+                else if (fetcher.jobs)
+                        /* No download could be started */
+                        g_usleep (WAIT_TIMEOUT * 1000);
+        }
+
+        /* Cancelled search */
+        while (fetcher.jobs)
+                ario_cover_fetcher_free_job (&fetcher, fetcher.jobs->data);
+
+        g_hash_table_destroy (fetcher.hosts);
+        curl_multi_cleanup (fetcher.multi);
+        g_free (fetcher.providers);
+}
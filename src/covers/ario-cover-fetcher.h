@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_COVER_FETCHER_H
+#define __ARIO_COVER_FETCHER_H
+
+#include <glib.h>
+#include "covers/ario-cover-provider.h"
+#include "servers/ario-server.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Function called each time the search of an album is over
+ *
+ * @param server_album The album
+ * @param file_size The sizes of the covers found (empty if none), to free
+ * @param file_contents The data of the covers found, to free
+ * @param user_data The user data
+ */
+typedef void (*ArioCoverFetcherFunc) (const ArioServerAlbum *server_album,
+                                      GArray *file_size,
+                                      GSList *file_contents,
+                                      gpointer user_data);
+
+/**
+ * Search for the covers of several albums with several providers at
+ * the same time. Providers able to search on internet (see
+ * ario_cover_provider_has_search) share a pool of parallel downloads
+ * while the other ones are called synchronously. With GET_FIRST_COVER,
+ * the requests of an album are cancelled as soon as a cover is found
+ * by the first provider able to find one.
+ *
+ * This function blocks until all albums are done and should be called
+ * in a thread.
+ *
+ * @param providers The providers to use, by priority
+ * @param albums The albums (ArioServerAlbum) to search covers for
+ * @param operation GET_FIRST_COVER or GET_ALL_COVERS
+ * @param func Function called for each album
+ * @param user_data User data of func
+ * @param cancelled Pointer to a flag stopping the search when set to TRUE, or NULL
+ */
+void                    ario_cover_fetcher_get_covers   (const GSList *providers,
+                                                         const GSList *albums,
+                                                         ArioCoverProviderOperation operation,
+                                                         ArioCoverFetcherFunc func,
+                                                         gpointer user_data,
+                                                         const gboolean *cancelled);
+
+G_END_DECLS
+
+#endif /* __ARIO_COVER_FETCHER_H */
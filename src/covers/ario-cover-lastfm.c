@@ -44,6 +44,13 @@ static GSList* ario_cover_lastfm_parse_xml_file (char *xmldata,
                                                  int size,
                                                  ArioCoverProviderOperation operation,
                                                  const char *cover_size);
+static gchar* ario_cover_lastfm_get_search_uri (ArioCoverProvider *cover_provider,
+                                                const char *artist,
+                                                const char *album);
+static GSList* ario_cover_lastfm_parse_search (ArioCoverProvider *cover_provider,
+                                               char *data,
+                                               int size,
+                                               ArioCoverProviderOperation operation);
 gboolean ario_cover_lastfm_get_covers (ArioCoverProvider *cover_provider,
                                        const char *artist,
                                        const char *album,
@@ -75,6 +82,8 @@ ario_cover_lastfm_class_init (ArioCoverLastfmClass *klass)
         cover_provider_class->get_id = ario_cover_lastfm_get_id;
         cover_provider_class->get_name = ario_cover_lastfm_get_name;
         cover_provider_class->get_covers = ario_cover_lastfm_get_covers;
+        cover_provider_class->get_search_uri = ario_cover_lastfm_get_search_uri;
+        cover_provider_class->parse_search = ario_cover_lastfm_parse_search;
 }
 
 static void
@@ -202,6 +211,34 @@ ario_cover_lastfm_make_xml_uri (const char *artist,
         return xml_uri;
 }
 
+static gchar *
+ario_cover_lastfm_get_search_uri (ArioCoverProvider *cover_provider,
+                                  const char *artist,
+                                  const char *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* We construct the uri to make a request on the lastfm WebServices */
+        return ario_cover_lastfm_make_xml_uri (artist,
+                                               album);
+}
+
+static GSList *
+ario_cover_lastfm_parse_search (ArioCoverProvider *cover_provider,
+                                char *data,
+                                int size,
+                                ArioCoverProviderOperation operation)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (size == 0)
+                return NULL;
+
+        /* We parse the xml file to extract the cover uris */
+        return ario_cover_lastfm_parse_xml_file (data,
+                                                 size,
+                                                 operation,
+                                                 COVER_LARGE);
+}
+
 gboolean
 ario_cover_lastfm_get_covers (ArioCoverProvider *cover_provider,
                               const char *artist,
@@ -221,9 +258,9 @@ ario_cover_lastfm_get_covers (ArioCoverProvider *cover_provider,
         gboolean ret;
         GSList *ario_cover_uris;
 
-        /* We construct the uri to make a request on the lastfm WebServices */
-        xml_uri = ario_cover_lastfm_make_xml_uri (artist,
-                                                  album);
+        xml_uri = ario_cover_lastfm_get_search_uri (cover_provider,
+                                                    artist,
+                                                    album);
 
         if (!xml_uri)
                 return FALSE;
@@ -235,15 +272,10 @@ ario_cover_lastfm_get_covers (ArioCoverProvider *cover_provider,
                                  &xml_data);
         g_free (xml_uri);
 
-        if (xml_size == 0) {
-                return FALSE;
-        }
-
-        /* We parse the xml file to extract the cover uris */
-        ario_cover_uris = ario_cover_lastfm_parse_xml_file (xml_data,
-                                                            xml_size,
-                                                            operation,
-                                                            COVER_LARGE);
+        ario_cover_uris = ario_cover_lastfm_parse_search (cover_provider,
+                                                          xml_data,
+                                                          xml_size,
+                                                          operation);
 
         g_free (xml_data);
 
@@ -24,6 +24,7 @@
 #include <glib/gi18n.h>
 #include "lib/ario-conf.h"
 #include "covers/ario-cover-amazon.h"
+#include "covers/ario-cover-fetcher.h"
 #include "covers/ario-cover-lastfm.h"
 #include "covers/ario-cover-local.h"
 #include "preferences/ario-preferences.h"
@@ -213,6 +214,58 @@ ario_cover_manager_remove_provider (ArioCoverManager *cover_manager,
         cover_manager->priv->providers = g_slist_remove (cover_manager->priv->providers, cover_provider);
 }
 
+static GSList *
+ario_cover_manager_get_active_providers (ArioCoverManager *cover_manager)
+{
+        GSList *tmp;
+        GSList *providers = NULL;
+
+        for (tmp = cover_manager->priv->providers; tmp; tmp = g_slist_next (tmp)) {
+                if (ario_cover_provider_is_active (tmp->data))
+                        providers = g_slist_prepend (providers, tmp->data);
+        }
+
+        return g_slist_reverse (providers);
+}
+
+void
+ario_cover_manager_get_covers_from_albums (ArioCoverManager *cover_manager,
+                                           const GSList *albums,
+                                           ArioCoverProviderOperation operation,
+                                           ArioCoverFetcherFunc func,
+                                           gpointer user_data,
+                                           const gboolean *cancelled)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *providers;
+
+        providers = ario_cover_manager_get_active_providers (cover_manager);
+        ario_cover_fetcher_get_covers (providers,
+                                       albums,
+                                       operation,
+                                       func, user_data,
+                                       cancelled);
+        g_slist_free (providers);
+}
+
+typedef struct
+{
+        GArray **file_size;
+        GSList **file_contents;
+} ArioCoverManagerCovers;
+
+static void
+ario_cover_manager_get_covers_cb (const ArioServerAlbum *server_album,
+                                  GArray *file_size,
+                                  GSList *file_contents,
+                                  ArioCoverManagerCovers *covers)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_array_append_vals (*covers->file_size, file_size->data, file_size->len);
+        g_array_free (file_size, TRUE);
+        *covers->file_contents = g_slist_concat (*covers->file_contents, file_contents);
+}
+
 gboolean
 ario_cover_manager_get_covers (ArioCoverManager *cover_manager,
                                const char *artist,
@@ -223,27 +276,26 @@ ario_cover_manager_get_covers (ArioCoverManager *cover_manager,
                                ArioCoverProviderOperation operation)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *tmp;
-        ArioCoverProvider *cover_provider;
-        gboolean ret = FALSE;
-
-        for (tmp = cover_manager->priv->providers; tmp; tmp = g_slist_next (tmp)) {
-                cover_provider = tmp->data;
-                if (!ario_cover_provider_is_active (cover_provider))
-                        continue;
-                ARIO_LOG_DBG ("looking for a cover using provider:%s for album:%s\n", ario_cover_provider_get_name (cover_provider), album);
-
-                if (ario_cover_provider_get_covers (cover_provider,
-                                                    artist, album,
-                                                    file,
-                                                    file_size, file_contents,
-                                                    operation)) {
-                        ret = TRUE;
-                        if (operation == GET_FIRST_COVER)
-                                break;
-                }
-        }
-        return ret;
+        ArioServerAlbum server_album;
+        GSList albums = { &server_album, NULL };
+        ArioCoverManagerCovers covers;
+        guint len = (*file_size)->len;
+
+        server_album.artist = (gchar *) artist;
+        server_album.album = (gchar *) album;
+        server_album.path = (gchar *) file;
+        server_album.date = NULL;
+
+        covers.file_size = file_size;
+        covers.file_contents = file_contents;
+
+        /* All providers are queried at the same time */
+        ario_cover_manager_get_covers_from_albums (cover_manager,
+                                                   &albums,
+                                                   operation,
+                                                   (ArioCoverFetcherFunc) ario_cover_manager_get_covers_cb,
+                                                   &covers,
+                                                   NULL);
+
+        return (*file_size)->len > len;
 }
-
-
@@ -22,6 +22,7 @@
 
 #include <glib-object.h>
 #include "covers/ario-cover-provider.h"
+#include "covers/ario-cover-fetcher.h"
 
 G_BEGIN_DECLS
 
@@ -69,6 +70,15 @@ gboolean                ario_cover_manager_get_covers                   (ArioCov
                                                                          GArray **file_size,
                                                                          GSList **file_contents,
                                                                          ArioCoverProviderOperation operation);
+
+/* Search for the covers of many albums with all the active providers
+ * in parallel, see ario_cover_fetcher_get_covers */
+void                    ario_cover_manager_get_covers_from_albums       (ArioCoverManager *cover_manager,
+                                                                         const GSList *albums,
+                                                                         ArioCoverProviderOperation operation,
+                                                                         ArioCoverFetcherFunc func,
+                                                                         gpointer user_data,
+                                                                         const gboolean *cancelled);
 G_END_DECLS
 
 #endif /* __ARIO_COVER_MANAGER_H */
@@ -89,6 +89,41 @@ ario_cover_provider_get_covers (ArioCoverProvider *cover_provider,
                                                                            operation);
 }
 
+gboolean
+ario_cover_provider_has_search (ArioCoverProvider *cover_provider)
+{
+        ArioCoverProviderClass *klass;
+
+        g_return_val_if_fail (ARIO_IS_COVER_PROVIDER (cover_provider), FALSE);
+
+        klass = ARIO_COVER_PROVIDER_GET_CLASS (cover_provider);
+
+        return klass->get_search_uri && klass->parse_search;
+}
+
+gchar *
+ario_cover_provider_get_search_uri (ArioCoverProvider *cover_provider,
+                                    const char *artist,
+                                    const char *album)
+{
+        g_return_val_if_fail (ario_cover_provider_has_search (cover_provider), NULL);
+
+        return ARIO_COVER_PROVIDER_GET_CLASS (cover_provider)->get_search_uri (cover_provider,
+                                                                               artist, album);
+}
+
+GSList *
+ario_cover_provider_parse_search (ArioCoverProvider *cover_provider,
+                                  char *data,
+                                  int size,
+                                  ArioCoverProviderOperation operation)
+{
+        g_return_val_if_fail (ario_cover_provider_has_search (cover_provider), NULL);
+
+        return ARIO_COVER_PROVIDER_GET_CLASS (cover_provider)->parse_search (cover_provider,
+                                                                             data, size,
+                                                                             operation);
+}
 
 gboolean
 ario_cover_provider_is_active (ArioCoverProvider *cover_provider)
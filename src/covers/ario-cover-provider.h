@@ -70,6 +70,22 @@ typedef struct
                                                          GArray **file_size,
                                                          GSList **file_contents,
                                                          ArioCoverProviderOperation operation);
+
+        /* Optional methods of the providers searching covers on
+         * internet, used to make the requests of several providers in
+         * parallel (see ario-cover-fetcher.h) */
+
+        /* Uri of the request listing the covers of the album, NULL if
+         * the provider can't search for this album */
+        gchar*          (*get_search_uri)               (ArioCoverProvider *cover_provider,
+                                                         const char *artist,
+                                                         const char *album);
+
+        /* Uris of the covers listed in the response to the search request */
+        GSList*         (*parse_search)                 (ArioCoverProvider *cover_provider,
+                                                         char *data,
+                                                         int size,
+                                                         ArioCoverProviderOperation operation);
 } ArioCoverProviderClass;
 
 /*
@@ -89,6 +105,17 @@ gboolean        ario_cover_provider_get_covers          (ArioCoverProvider *cove
                                                          GSList **file_contents,
                                                          ArioCoverProviderOperation operation);
 
+gboolean        ario_cover_provider_has_search          (ArioCoverProvider *cover_provider);
+
+gchar*          ario_cover_provider_get_search_uri      (ArioCoverProvider *cover_provider,
+                                                         const char *artist,
+                                                         const char *album);
+
+GSList*         ario_cover_provider_parse_search        (ArioCoverProvider *cover_provider,
+                                                         char *data,
+                                                         int size,
+                                                         ArioCoverProviderOperation operation);
+
 gboolean        ario_cover_provider_is_active           (ArioCoverProvider *cover_provider);
 
 void            ario_cover_provider_set_active          (ArioCoverProvider *cover_provider,
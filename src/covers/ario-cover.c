@@ -20,20 +20,27 @@
 #include "covers/ario-cover.h"
 #include <glib.h>
 #include <gtk/gtk.h>
+#include <gio/gio.h>
 #include <string.h>
 #include <glib/gi18n.h>
+#include "covers/ario-cover-cache.h"
 #include "ario-util.h"
 #include "ario-debug.h"
 
 static void ario_cover_create_ario_cover_dir (void);
 
-gchar *
-ario_cover_make_cover_path (const gchar *artist,
-                            const gchar *album,
-                            const ArioCoverHomeCoversSize ario_cover_size)
+/* Names (UTF-8) of the files of the covers directory, loaded on first
+ * use and kept up to date with a file monitor */
+static GHashTable *cover_files = NULL;
+static GStaticMutex cover_files_lock = G_STATIC_MUTEX_INIT;
+static GFileMonitor *cover_monitor = NULL;
+
+static gchar *
+ario_cover_make_cover_filename (const gchar *artist,
+                                const gchar *album,
+                                const ArioCoverHomeCoversSize ario_cover_size)
 {
         ARIO_LOG_FUNCTION_START;
-        char *ario_cover_path;
         char *filename;
 
         if (!artist || !album)
@@ -48,6 +55,22 @@ ario_cover_make_cover_path (const gchar *artist,
 
         ario_util_sanitize_filename (filename);
 
+        return filename;
+}
+
+gchar *
+ario_cover_make_cover_path (const gchar *artist,
+                            const gchar *album,
+                            const ArioCoverHomeCoversSize ario_cover_size)
+{
+        ARIO_LOG_FUNCTION_START;
+        char *ario_cover_path;
+        char *filename;
+
+        filename = ario_cover_make_cover_filename (artist, album, ario_cover_size);
+        if (!filename)
+                return NULL;
+
         /* The returned path is ~/.config/ario/covers/filename */
         ario_cover_path = g_build_filename (ario_util_config_dir (), "covers", filename, NULL);
         g_free (filename);
@@ -55,33 +78,166 @@ ario_cover_make_cover_path (const gchar *artist,
         return ario_cover_path;
 }
 
+static void
+ario_cover_index_update (GFile *file,
+                         const gboolean exists)
+{
+        gchar *basename;
+        gchar *filename;
+
+        basename = g_file_get_basename (file);
+        filename = g_filename_to_utf8 (basename, -1, NULL, NULL, NULL);
+        g_free (basename);
+        if (!filename)
+                return;
+
+        g_static_mutex_lock (&cover_files_lock);
+        if (exists)
+                g_hash_table_insert (cover_files, filename, GINT_TO_POINTER (TRUE));
+        else
+                g_hash_table_remove (cover_files, filename);
+        g_static_mutex_unlock (&cover_files_lock);
+
+        if (!exists)
+                g_free (filename);
+}
+
+static void
+ario_cover_index_changed_cb (GFileMonitor *monitor,
+                             GFile *file,
+                             GFile *other_file,
+                             GFileMonitorEvent event_type,
+                             gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        switch (event_type) {
+        case G_FILE_MONITOR_EVENT_CREATED:
+                ario_cover_index_update (file, TRUE);
+                break;
+        case G_FILE_MONITOR_EVENT_DELETED:
+                ario_cover_index_update (file, FALSE);
+                break;
+        default:
+                break;
+        }
+}
+
+static gboolean
+ario_cover_index_monitor (gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *ario_cover_dir;
+        GFile *dir;
+
+        if (cover_monitor)
+                return FALSE;
+
+        /* Covers added or removed by other programs */
+        ario_cover_dir = g_build_filename (ario_util_config_dir (), "covers", NULL);
+        dir = g_file_new_for_path (ario_cover_dir);
+        cover_monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, NULL);
+        if (cover_monitor)
+                g_signal_connect (cover_monitor, "changed",
+                                  G_CALLBACK (ario_cover_index_changed_cb), NULL);
+        g_object_unref (dir);
+        g_free (ario_cover_dir);
+
+        return FALSE;
+}
+
+/* Must be called with cover_files_lock */
+static void
+ario_cover_index_load (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *ario_cover_dir;
+        GDir *dir;
+        const gchar *name;
+        gchar *filename;
+
+        cover_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        /* The directory is read once, existence checks are then only
+         * lookups in the index */
+        ario_cover_create_ario_cover_dir ();
+        ario_cover_dir = g_build_filename (ario_util_config_dir (), "covers", NULL);
+        dir = g_dir_open (ario_cover_dir, 0, NULL);
+        g_free (ario_cover_dir);
+        if (dir) {
+                while ((name = g_dir_read_name (dir))) {
+                        filename = g_filename_to_utf8 (name, -1, NULL, NULL, NULL);
+                        if (filename)
+                                g_hash_table_insert (cover_files, filename, GINT_TO_POINTER (TRUE));
+                }
+                g_dir_close (dir);
+        }
+
+        /* The monitor is created in the main loop */
+        g_idle_add (ario_cover_index_monitor, NULL);
+}
+
+static void
+ario_cover_index_set (const gchar *artist,
+                      const gchar *album,
+                      const gboolean exists)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *filename;
+        gchar *small_filename;
+
+        filename = ario_cover_make_cover_filename (artist, album, NORMAL_COVER);
+        small_filename = ario_cover_make_cover_filename (artist, album, SMALL_COVER);
+
+        g_static_mutex_lock (&cover_files_lock);
+        if (!cover_files)
+                ario_cover_index_load ();
+
+        if (exists) {
+                g_hash_table_insert (cover_files, filename, GINT_TO_POINTER (TRUE));
+                g_hash_table_insert (cover_files, small_filename, GINT_TO_POINTER (TRUE));
+        } else {
+                g_hash_table_remove (cover_files, filename);
+                g_hash_table_remove (cover_files, small_filename);
+                g_free (filename);
+                g_free (small_filename);
+        }
+        g_static_mutex_unlock (&cover_files_lock);
+}
+
 gboolean
-ario_cover_cover_exists (const gchar *artist,
-                         const gchar *album)
+ario_cover_cover_file_exists (const gchar *artist,
+                              const gchar *album,
+                              const ArioCoverHomeCoversSize ario_cover_size)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *ario_cover_path, *small_ario_cover_path;
+        gchar *filename;
         gboolean result;
 
-        /* The path for the normal cover */
-        ario_cover_path = ario_cover_make_cover_path (artist,
-                                                      album,
-                                                      NORMAL_COVER);
-
-        /* The path for the small cover */
-        small_ario_cover_path = ario_cover_make_cover_path (artist,
-                                                            album,
-                                                            SMALL_COVER);
+        filename = ario_cover_make_cover_filename (artist, album, ario_cover_size);
+        if (!filename)
+                return FALSE;
 
-        /* We consider that the cover exists only if the normal and small covers exist */
-        result = (ario_util_uri_exists (ario_cover_path) && ario_util_uri_exists (small_ario_cover_path));
+        g_static_mutex_lock (&cover_files_lock);
+        if (!cover_files)
+                ario_cover_index_load ();
+        result = (g_hash_table_lookup (cover_files, filename) != NULL);
+        g_static_mutex_unlock (&cover_files_lock);
 
-        g_free (ario_cover_path);
-        g_free (small_ario_cover_path);
+        g_free (filename);
 
         return result;
 }
 
+gboolean
+ario_cover_cover_exists (const gchar *artist,
+                         const gchar *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* We consider that the cover exists only if the normal and small covers exist */
+        return (ario_cover_cover_file_exists (artist, album, NORMAL_COVER)
+                && ario_cover_cover_file_exists (artist, album, SMALL_COVER));
+}
+
 void
 ario_cover_create_ario_cover_dir (void)
 {
@@ -126,6 +282,9 @@ ario_cover_remove_cover (const gchar *artist,
         if (ario_util_uri_exists (ario_cover_path))
                 ario_util_unlink_uri (ario_cover_path);
         g_free (ario_cover_path);
+
+        ario_cover_index_set (artist, album, FALSE);
+        ario_cover_cache_invalidate (artist, album);
 }
 
 static gboolean
@@ -244,6 +403,8 @@ ario_cover_save_cover (const gchar *artist,
                     gdk_pixbuf_save (small_pixbuf, small_ario_cover_path, "jpeg", NULL, "quality", "95", NULL)) {
                         /* If we succeed in the 2 operations, we return OK */
                         ret = TRUE;
+                        ario_cover_index_set (artist, album, TRUE);
+                        ario_cover_cache_invalidate (artist, album);
                 }
 
                 g_free (small_path_fse);
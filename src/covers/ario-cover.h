@@ -51,6 +51,10 @@ gboolean                     ario_cover_size_is_valid        (const int size);
 
 gboolean                     ario_cover_cover_exists         (const gchar *artist,
                                                               const gchar *album);
+/* Whether one of the 2 files of a cover exists, without access to the disk */
+gboolean                     ario_cover_cover_file_exists    (const gchar *artist,
+                                                              const gchar *album,
+                                                              const ArioCoverHomeCoversSize ario_cover_size);
 gchar*                       ario_cover_make_cover_path      (const gchar *artist,
                                                               const gchar *album,
                                                               const ArioCoverHomeCoversSize ario_cover_size);
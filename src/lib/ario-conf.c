@@ -26,37 +26,109 @@
 #include "ario-debug.h"
 #include "ario-util.h"
 
-static GHashTable *hash;
-static gboolean modified = FALSE;
-static GSList *notifications;
-static guint notification_counter = 1;
+/* Value of an option, parsed once when it is set */
+typedef struct
+{
+        char *value;
+        gboolean boolean_value;
+        int integer_value;
+        gfloat float_value;
+
+        /* Notifications registered on this option */
+        GSList *notifications;
+        /* Number of notification loops running on this option */
+        int dispatching;
+} ArioConfEntry;
 
 typedef struct
 {
         guint notification_id;
-        char *key;
+        ArioConfEntry *entry;
         ArioNotifyFunc notification_callback;
         gpointer callback_data;
+        /* Removed while notifications were running */
+        gboolean removed;
 } ArioConfNotifyData;
 
+/* Option name -> ArioConfEntry, entries are kept until shutdown */
+static GHashTable *hash;
+/* Notification id -> ArioConfNotifyData */
+static GHashTable *notifications;
+static guint notification_counter = 1;
+
+/* Changes are saved a few seconds after the last one */
+static guint save_timeout_id = 0;
+static GThread *save_thread = NULL;
+
 #define XML_ROOT_NAME (const unsigned char *)"ario-options"
 #define XML_VERSION (const unsigned char *)"1.0"
 
+/* Delay in seconds between a change and its save */
+#define SAVE_DELAY 2
+
+static gboolean ario_conf_save (G_GNUC_UNUSED gpointer data);
+
 static void
-ario_conf_free_notify_data (ArioConfNotifyData *data)
+ario_conf_free_entry (ArioConfEntry *entry)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_free (entry->value);
+        g_slist_free (entry->notifications);
+        g_free (entry);
+}
+
+static ArioConfEntry *
+ario_conf_get_entry (const char *key)
 {
         ARIO_LOG_FUNCTION_START;
-        if (data) {
-                g_free (data->key);
-                g_free (data);
+        ArioConfEntry *entry = g_hash_table_lookup (hash, key);
+
+        if (!entry) {
+                entry = (ArioConfEntry *) g_malloc0 (sizeof (ArioConfEntry));
+                g_hash_table_insert (hash, g_strdup (key), entry);
         }
+
+        return entry;
+}
+
+static void
+ario_conf_entry_set_value (ArioConfEntry *entry,
+                           char *value)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_free (entry->value);
+        entry->value = value;
+
+        /* Typed values are parsed here instead of on each read */
+        entry->boolean_value = value && !strcmp (value, "1");
+        entry->integer_value = value ? atoi (value) : 0;
+        entry->float_value = value ? atof (value) : 0.0;
 }
 
 static char *
 ario_conf_get (const char *key)
 {
         ARIO_LOG_FUNCTION_START;
-        return g_hash_table_lookup (hash, key);
+        ArioConfEntry *entry = g_hash_table_lookup (hash, key);
+
+        return entry ? entry->value : NULL;
+}
+
+static void
+ario_conf_sweep_notifications (ArioConfEntry *entry)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp, *next;
+        ArioConfNotifyData *data;
+
+        for (tmp = entry->notifications; tmp; tmp = next) {
+                next = g_slist_next (tmp);
+                data = tmp->data;
+                if (data->removed) {
+                        entry->notifications = g_slist_delete_link (entry->notifications, tmp);
+                        g_free (data);
+                }
+        }
 }
 
 static void
@@ -64,24 +136,34 @@ ario_conf_set (const char *key,
                char *value)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *tmp;
+        GSList *tmp, *next;
         ArioConfNotifyData *data;
+        ArioConfEntry *entry = ario_conf_get_entry (key);
 
-        if (!ario_util_strcmp (ario_conf_get (key), value)) {
+        if (!ario_util_strcmp (entry->value, value)) {
                 g_free (value);
                 return;
         }
-        g_hash_table_replace (hash, g_strdup (key), value);
-        modified = TRUE;
-
-        /* Notifications */
-        for (tmp = notifications; tmp; tmp = g_slist_next (tmp)) {
+        ario_conf_entry_set_value (entry, value);
+
+        /* Save the options once changes are over */
+        if (save_timeout_id)
+                g_source_remove (save_timeout_id);
+        save_timeout_id = g_timeout_add_seconds (SAVE_DELAY, (GSourceFunc) ario_conf_save, NULL);
+
+        /* Notifications: the ones removed by a callback stay in the list
+         * until the end of the loop */
+        ++entry->dispatching;
+        for (tmp = entry->notifications; tmp; tmp = next) {
+                next = g_slist_next (tmp);
                 data = tmp->data;
-                if (!strcmp (data->key, key)) {
-                        data->notification_callback (data->notification_id,
-                                                     data->callback_data);
-                }
+                if (data->removed)
+                        continue;
+                data->notification_callback (data->notification_id,
+                                             data->callback_data);
         }
+        if (--entry->dispatching == 0)
+                ario_conf_sweep_notifications (entry);
 }
 
 void
@@ -100,15 +182,12 @@ ario_conf_get_boolean (const char *key,
                        const gboolean default_value)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *value = ario_conf_get (key);
-        gboolean ret;
+        ArioConfEntry *entry = g_hash_table_lookup (hash, key);
 
-        if (!value)
+        if (!entry || !entry->value)
                 return default_value;
 
-        ret = !strcmp (value, "1");
-
-        return ret;
+        return entry->boolean_value;
 }
 
 void
@@ -124,15 +203,12 @@ ario_conf_get_integer (const char *key,
                        const int default_value)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *value = ario_conf_get (key);
-        int ret;
+        ArioConfEntry *entry = g_hash_table_lookup (hash, key);
 
-        if (!value)
+        if (!entry || !entry->value)
                 return default_value;
 
-        ret = atoi (value);
-
-        return ret;
+        return entry->integer_value;
 }
 
 void
@@ -148,14 +224,12 @@ ario_conf_get_float (const char *key,
                      const gfloat default_value)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *value = ario_conf_get (key);
-        gfloat ret;
+        ArioConfEntry *entry = g_hash_table_lookup (hash, key);
 
-        if (!value)
+        if (!entry || !entry->value)
                 return default_value;
 
-        ret = atof (value);
-        return ret;
+        return entry->float_value;
 }
 
 void
@@ -231,16 +305,37 @@ ario_conf_get_string_slist (const char *key,
 
 static void
 ario_conf_save_foreach (gchar *key,
-                        gchar *value,
+                        ArioConfEntry *entry,
                         xmlNodePtr root)
 {
         ARIO_LOG_FUNCTION_START;
         xmlNodePtr cur;
 
+        /* Entries created by notifications may have no value */
+        if (!entry->value)
+                return;
+
         /* We add a new "option" entry */
         cur = xmlNewChild (root, NULL, (const xmlChar *) "option", NULL);
         xmlSetProp (cur, (const xmlChar *) "key", (const xmlChar *) key);
-        xmlNodeAddContent (cur, (const xmlChar *) value);
+        xmlNodeAddContent (cur, (const xmlChar *) entry->value);
+}
+
+static gpointer
+ario_conf_save_thread (xmlDocPtr doc)
+{
+        ARIO_LOG_FUNCTION_START;
+        char *xml_filename;
+
+        xml_filename = g_build_filename (ario_util_config_dir (), "options.xml", NULL);
+
+        /* We save the xml file */
+        xmlSaveFormatFile (xml_filename, doc, TRUE);
+
+        g_free (xml_filename);
+        xmlFreeDoc (doc);
+
+        return NULL;
 }
 
 static gboolean
@@ -249,11 +344,8 @@ ario_conf_save (G_GNUC_UNUSED gpointer data)
         ARIO_LOG_FUNCTION_START;
         xmlNodePtr cur;
         xmlDocPtr doc;
-        char *xml_filename;
 
-        if (!modified)
-                return TRUE;
-        modified = FALSE;
+        save_timeout_id = 0;
 
         doc = xmlNewDoc (XML_VERSION);
         cur = xmlNewNode (NULL, (const xmlChar *) XML_ROOT_NAME);
@@ -263,15 +355,17 @@ ario_conf_save (G_GNUC_UNUSED gpointer data)
                               (GHFunc) ario_conf_save_foreach,
                               cur);
 
-        xml_filename = g_build_filename (ario_util_config_dir (), "options.xml", NULL);
-
-        /* We save the xml file */
-        xmlSaveFormatFile (xml_filename, doc, TRUE);
+        /* Previous save must be over so that files are written in order */
+        if (save_thread)
+                g_thread_join (save_thread);
 
-        g_free (xml_filename);
-        xmlFreeDoc (doc);
+        /* The file is written out of the main loop */
+        save_thread = g_thread_create ((GThreadFunc) ario_conf_save_thread,
+                                       doc, TRUE, NULL);
+        if (!save_thread)
+                ario_conf_save_thread (doc);
 
-        return TRUE;
+        return FALSE;
 }
 
 void
@@ -290,7 +384,9 @@ ario_conf_init (void)
         xmlKeepBlanksDefault (0);
 
         hash = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                      g_free, g_free);
+                                      g_free, (GDestroyNotify) ario_conf_free_entry);
+        notifications = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                               NULL, g_free);
 
         if (ario_util_uri_exists (xml_filename)) {
                 doc = xmlParseFile (xml_filename);
@@ -305,23 +401,35 @@ ario_conf_init (void)
                         if (!xmlStrcmp (cur->name, (const xmlChar *) "option")) {
                                 xml_key = xmlGetProp (cur, (const unsigned char *) "key");
                                 xml_value = xmlNodeGetContent (cur);
-                                g_hash_table_insert (hash, xml_key, xml_value);
+                                ario_conf_entry_set_value (ario_conf_get_entry ((const char *) xml_key),
+                                                           g_strdup ((const char *) xml_value));
+                                xmlFree (xml_key);
+                                xmlFree (xml_value);
                         }
                 }
 
                 xmlFreeDoc (doc);
+        } else {
+                g_free (xml_filename);
         }
-
-        g_timeout_add (5*1000, (GSourceFunc) ario_conf_save, NULL);
 }
 
 void
 ario_conf_shutdown (void)
 {
         ARIO_LOG_FUNCTION_START;
-        ario_conf_save (NULL);
+        /* Save pending changes and wait for the file to be written */
+        if (save_timeout_id) {
+                g_source_remove (save_timeout_id);
+                ario_conf_save (NULL);
+        }
+        if (save_thread) {
+                g_thread_join (save_thread);
+                save_thread = NULL;
+        }
+
         g_hash_table_remove_all (hash);
-        g_slist_foreach (notifications, (GFunc) ario_conf_free_notify_data, NULL);
+        g_hash_table_remove_all (notifications);
 }
 
 guint
@@ -334,11 +442,12 @@ ario_conf_notification_add (const char *key,
         ++notification_counter;
 
         data->notification_id = notification_counter;
-        data->key = g_strdup (key);
+        data->entry = ario_conf_get_entry (key);
         data->notification_callback = notification_callback;
         data->callback_data = callback_data;
 
-        notifications = g_slist_append (notifications, data);
+        data->entry->notifications = g_slist_append (data->entry->notifications, data);
+        g_hash_table_insert (notifications, GUINT_TO_POINTER (notification_counter), data);
 
         return notification_counter;
 }
@@ -347,15 +456,19 @@ void
 ario_conf_notification_remove (guint notification_id)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *tmp;
         ArioConfNotifyData *data;
 
-        for (tmp = notifications; tmp; tmp = g_slist_next (tmp)) {
-                data = tmp->data;
-                if (data->notification_id == notification_id) {
-                        notifications = g_slist_remove (notifications, data);
-                        ario_conf_free_notify_data (data);
-                }
+        data = g_hash_table_lookup (notifications, GUINT_TO_POINTER (notification_id));
+        if (!data)
+                return;
+
+        if (data->entry->dispatching) {
+                /* Notifications of this option are running: free it
+                 * at the end of the loop */
+                g_hash_table_steal (notifications, GUINT_TO_POINTER (notification_id));
+                data->removed = TRUE;
+        } else {
+                data->entry->notifications = g_slist_remove (data->entry->notifications, data);
+                g_hash_table_remove (notifications, GUINT_TO_POINTER (notification_id));
         }
 }
-
@@ -73,9 +73,11 @@
 #ifdef WIN32
 #  define SELECT_ERRNO_IGNORE   (errno == WSAEINTR || errno == WSAEINPROGRESS)
 #  define SENDRECV_ERRNO_IGNORE SELECT_ERRNO_IGNORE
+#  define RECV_ERRNO_WOULDBLOCK (WSAGetLastError() == WSAEWOULDBLOCK)
 #else
 #  define SELECT_ERRNO_IGNORE   (errno == EINTR)
 #  define SENDRECV_ERRNO_IGNORE (errno == EINTR || errno == EAGAIN)
+#  define RECV_ERRNO_WOULDBLOCK (errno == EAGAIN || errno == EWOULDBLOCK)
 #  define winsock_dll_error(c)  0
 #  define closesocket(s)        close(s)
 #  define WSACleanup()          do { /* nothing */ } while (0)
@@ -303,22 +305,6 @@ static char * mpd_sanitizeArg(const char * arg) {
 	return ret;
 }
 
-static mpd_ReturnElement * mpd_newReturnElement(const char * name, const char * value)
-{
-	mpd_ReturnElement * ret = malloc(sizeof(mpd_ReturnElement));
-
-	ret->name = strdup(name);
-	ret->value = strdup(value);
-
-	return ret;
-}
-
-static void mpd_freeReturnElement(mpd_ReturnElement * re) {
-	free(re->name);
-	free(re->value);
-	free(re);
-}
-
 void mpd_setConnectionTimeout(mpd_Connection * connection, float timeout) {
 	connection->timeout.tv_sec = (int)timeout;
 	connection->timeout.tv_usec = (int)(timeout*1e6 -
@@ -367,10 +353,13 @@ mpd_Connection * mpd_newConnection(const char * host, int port, float timeout) {
 	mpd_Connection * connection = malloc(sizeof(mpd_Connection));
 	struct timeval tv;
 	fd_set fds;
+	connection->bufsize = MPD_BUFFER_MAX_LENGTH;
+	connection->buffer = malloc(connection->bufsize+1);
 	strcpy(connection->buffer,"");
 	connection->sock = -1;
 	connection->buflen = 0;
 	connection->bufstart = 0;
+	connection->bufcheck = 0;
 	strcpy(connection->errorStr,"");
 	connection->error = 0;
 	connection->doneProcessing = 0;
@@ -402,7 +391,7 @@ mpd_Connection * mpd_newConnection(const char * host, int port, float timeout) {
 			int readed;
 			readed = recv(connection->sock,
 					&(connection->buffer[connection->buflen]),
-					MPD_BUFFER_MAX_LENGTH-connection->buflen,0);
+					connection->bufsize-connection->buflen,0);
 			if(readed<=0) {
 				snprintf(connection->errorStr,MPD_ERRORSTR_MAX_LENGTH,
 						"problems getting a response from"
@@ -452,7 +441,7 @@ void mpd_clearError(mpd_Connection * connection) {
 
 void mpd_closeConnection(mpd_Connection * connection) {
 	closesocket(connection->sock);
-	if(connection->returnElement) free(connection->returnElement);
+	free(connection->buffer);
 	if(connection->request) free(connection->request);
 	free(connection);
 	WSACleanup();
@@ -514,20 +503,89 @@ static void mpd_executeCommand(mpd_Connection * connection, char * command) {
 	}
 }
 
+/* make room at the end of the buffer for the next recv: drop the lines
+ * already consumed and grow the buffer when a single line fills it */
+static int mpd_reserveBuffer(mpd_Connection * connection) {
+	char * buffer;
+	int size;
+
+	if(connection->bufstart > 0 &&
+	   connection->bufsize-connection->buflen < connection->bufsize/2) {
+		/* only the beginning of the current line is left to move */
+		memmove(connection->buffer,
+				connection->buffer+connection->bufstart,
+				connection->buflen-connection->bufstart+1);
+		connection->buflen-=connection->bufstart;
+		connection->bufcheck-=connection->bufstart;
+		connection->bufstart = 0;
+	}
+
+	if(connection->buflen < connection->bufsize) return 0;
+
+	if(connection->bufsize >= MPD_BUFFER_LIMIT) return -1;
+	size = connection->bufsize*2;
+	if(size > MPD_BUFFER_LIMIT) size = MPD_BUFFER_LIMIT;
+	buffer = realloc(connection->buffer, size+1);
+	if(!buffer) return -1;
+	connection->buffer = buffer;
+	connection->bufsize = size;
+
+	return 0;
+}
+
+/* read as much as available from the socket, only waiting with select()
+ * when nothing is pending */
+static int mpd_fillBuffer(mpd_Connection * connection) {
+	fd_set fds;
+	struct timeval tv;
+	int readed;
+	int err;
+
+	if(mpd_reserveBuffer(connection) < 0) {
+		strcpy(connection->errorStr,"buffer overrun");
+		connection->error = MPD_ERROR_1_BUFFEROVERRUN;
+		return -1;
+	}
+
+	for(;;) {
+		readed = recv(connection->sock,
+				connection->buffer+connection->buflen,
+				connection->bufsize-connection->buflen,
+				MSG_DONTWAIT);
+		if(readed>0) {
+			connection->buflen+=readed;
+			connection->buffer[connection->buflen] = '\0';
+			return 0;
+		}
+		if(readed==0 || !(RECV_ERRNO_WOULDBLOCK || SENDRECV_ERRNO_IGNORE)) {
+			strcpy(connection->errorStr,"connection closed");
+			connection->error = MPD_ERROR_1_CONNCLOSED;
+			return -1;
+		}
+		if(!RECV_ERRNO_WOULDBLOCK) continue;
+
+		tv.tv_sec = connection->timeout.tv_sec;
+		tv.tv_usec = connection->timeout.tv_usec;
+		FD_ZERO(&fds);
+		FD_SET(connection->sock,&fds);
+		while((err = select(connection->sock+1,&fds,NULL,NULL,&tv)) < 0
+				&& SELECT_ERRNO_IGNORE);
+		if(err!=1) {
+			strcpy(connection->errorStr,"connection timeout");
+			connection->error = MPD_ERROR_1_TIMEOUT;
+			return -1;
+		}
+	}
+}
+
 static void mpd_getNextReturnElement(mpd_Connection * connection) {
 	char * output = NULL;
 	char * rt = NULL;
 	char * name = NULL;
 	char * value = NULL;
-	fd_set fds;
-	struct timeval tv;
 	char * tok = NULL;
-	int readed;
-	char * bufferCheck = NULL;
-	int err;
 	int pos;
 
-	if(connection->returnElement) mpd_freeReturnElement(connection->returnElement);
 	connection->returnElement = NULL;
 
 	if(connection->doneProcessing || (connection->listOks &&
@@ -538,53 +596,13 @@ static void mpd_getNextReturnElement(mpd_Connection * connection) {
 		return;
 	}
 
-	bufferCheck = connection->buffer+connection->bufstart;
-	while(connection->bufstart>=connection->buflen ||
-			!(rt = strchr(bufferCheck,'\n'))) {
-		if(connection->buflen>=MPD_BUFFER_MAX_LENGTH) {
-			memmove(connection->buffer,
-					connection->buffer+
-					connection->bufstart,
-					connection->buflen-
-					connection->bufstart+1);
-			connection->buflen-=connection->bufstart;
-			connection->bufstart = 0;
-		}
-		if(connection->buflen>=MPD_BUFFER_MAX_LENGTH) {
-			strcpy(connection->errorStr,"buffer overrun");
-			connection->error = MPD_ERROR_1_BUFFEROVERRUN;
-			connection->doneProcessing = 1;
-			connection->doneListOk = 0;
-			return;
-		}
-		bufferCheck = connection->buffer+connection->buflen;
-		tv.tv_sec = connection->timeout.tv_sec;
-		tv.tv_usec = connection->timeout.tv_usec;
-		FD_ZERO(&fds);
-		FD_SET(connection->sock,&fds);
-		if((err = select(connection->sock+1,&fds,NULL,NULL,&tv) == 1)) {
-			readed = recv(connection->sock,
-					connection->buffer+connection->buflen,
-					MPD_BUFFER_MAX_LENGTH-connection->buflen,
-					MSG_DONTWAIT);
-			if(readed<0 && SENDRECV_ERRNO_IGNORE) {
-				continue;
-			}
-			if(readed<=0) {
-				strcpy(connection->errorStr,"connection"
-				       " closed");
-				connection->error = MPD_ERROR_1_CONNCLOSED;
-				connection->doneProcessing = 1;
-				connection->doneListOk = 0;
-				return;
-			}
-			connection->buflen+=readed;
-			connection->buffer[connection->buflen] = '\0';
-		}
-		else if(err<0 && SELECT_ERRNO_IGNORE) continue;
-		else {
-			strcpy(connection->errorStr,"connection timeout");
-			connection->error = MPD_ERROR_1_TIMEOUT;
+	if(connection->bufcheck < connection->bufstart)
+		connection->bufcheck = connection->bufstart;
+	while(!(rt = memchr(connection->buffer+connection->bufcheck,'\n',
+				connection->buflen-connection->bufcheck))) {
+		/* never scan these bytes again */
+		connection->bufcheck = connection->buflen;
+		if(mpd_fillBuffer(connection) < 0) {
 			connection->doneProcessing = 1;
 			connection->doneListOk = 0;
 			return;
@@ -594,6 +612,7 @@ static void mpd_getNextReturnElement(mpd_Connection * connection) {
 	*rt = '\0';
 	output = connection->buffer+connection->bufstart;
 	connection->bufstart = rt - connection->buffer + 1;
+	connection->bufcheck = connection->bufstart;
 
 	if(strcmp(output,"OK")==0) {
 		if(connection->listOks > 0) {
@@ -650,7 +669,12 @@ static void mpd_getNextReturnElement(mpd_Connection * connection) {
 	name[pos] = '\0';
 
 	if(value[0]==' ') {
-		connection->returnElement = mpd_newReturnElement(name,&(value[1]));
+		/* no copy: the element points into the buffer until the next
+		 * call to mpd_getNextReturnElement */
+		connection->element.name = name;
+		connection->element.value = &(value[1]);
+		connection->element.nameLen = pos;
+		connection->returnElement = &connection->element;
 	}
 	else {
 		snprintf(connection->errorStr,MPD_ERRORSTR_MAX_LENGTH,
@@ -681,6 +705,180 @@ int mpd_nextListOkCommand(mpd_Connection * connection) {
 	return 0;
 }
 
+/* Keys of the responses are dispatched with a switch on their length and
+ * on one of their characters, then confirmed with a single memcmp: unknown
+ * keys (MUSICBRAINZ_*, Last-Modified, ...) are mostly skipped without any
+ * comparison at all */
+#define MPD_KEY_UNKNOWN	-1
+#define MPD_KEY(str, key) \
+	(memcmp(name, (str), sizeof(str)-1) ? MPD_KEY_UNKNOWN : (key))
+
+enum {
+	MPD_STATUS_KEY_VOLUME,
+	MPD_STATUS_KEY_REPEAT,
+	MPD_STATUS_KEY_RANDOM,
+	MPD_STATUS_KEY_CONSUME,
+	MPD_STATUS_KEY_PLAYLIST,
+	MPD_STATUS_KEY_PLAYLISTLENGTH,
+	MPD_STATUS_KEY_BITRATE,
+	MPD_STATUS_KEY_STATE,
+	MPD_STATUS_KEY_SONG,
+	MPD_STATUS_KEY_SONGID,
+	MPD_STATUS_KEY_TIME,
+	MPD_STATUS_KEY_ERROR,
+	MPD_STATUS_KEY_XFADE,
+	MPD_STATUS_KEY_UPDATING_DB,
+	MPD_STATUS_KEY_AUDIO
+};
+
+static int mpd_statusKey(const char * name, int len) {
+	switch(len) {
+	case 4:
+		if(name[0] == 's') return MPD_KEY("song", MPD_STATUS_KEY_SONG);
+		return MPD_KEY("time", MPD_STATUS_KEY_TIME);
+	case 5:
+		switch(name[0]) {
+		case 's': return MPD_KEY("state", MPD_STATUS_KEY_STATE);
+		case 'e': return MPD_KEY("error", MPD_STATUS_KEY_ERROR);
+		case 'x': return MPD_KEY("xfade", MPD_STATUS_KEY_XFADE);
+		case 'a': return MPD_KEY("audio", MPD_STATUS_KEY_AUDIO);
+		}
+		break;
+	case 6:
+		switch(name[2]) {
+		case 'l': return MPD_KEY("volume", MPD_STATUS_KEY_VOLUME);
+		case 'p': return MPD_KEY("repeat", MPD_STATUS_KEY_REPEAT);
+		case 'n':
+			if(name[0] == 'r')
+				return MPD_KEY("random", MPD_STATUS_KEY_RANDOM);
+			return MPD_KEY("songid", MPD_STATUS_KEY_SONGID);
+		}
+		break;
+	case 7:
+		if(name[0] == 'c') return MPD_KEY("consume", MPD_STATUS_KEY_CONSUME);
+		return MPD_KEY("bitrate", MPD_STATUS_KEY_BITRATE);
+	case 8:
+		return MPD_KEY("playlist", MPD_STATUS_KEY_PLAYLIST);
+	case 11:
+		return MPD_KEY("updating_db", MPD_STATUS_KEY_UPDATING_DB);
+	case 14:
+		return MPD_KEY("playlistlength", MPD_STATUS_KEY_PLAYLISTLENGTH);
+	}
+	return MPD_KEY_UNKNOWN;
+}
+
+enum {
+	MPD_STATS_KEY_ARTISTS,
+	MPD_STATS_KEY_ALBUMS,
+	MPD_STATS_KEY_SONGS,
+	MPD_STATS_KEY_UPTIME,
+	MPD_STATS_KEY_DB_UPDATE,
+	MPD_STATS_KEY_PLAYTIME,
+	MPD_STATS_KEY_DB_PLAYTIME
+};
+
+static int mpd_statsKey(const char * name, int len) {
+	switch(len) {
+	case 5:
+		return MPD_KEY("songs", MPD_STATS_KEY_SONGS);
+	case 6:
+		if(name[0] == 'a') return MPD_KEY("albums", MPD_STATS_KEY_ALBUMS);
+		return MPD_KEY("uptime", MPD_STATS_KEY_UPTIME);
+	case 7:
+		return MPD_KEY("artists", MPD_STATS_KEY_ARTISTS);
+	case 8:
+		return MPD_KEY("playtime", MPD_STATS_KEY_PLAYTIME);
+	case 9:
+		return MPD_KEY("db_update", MPD_STATS_KEY_DB_UPDATE);
+	case 11:
+		return MPD_KEY("db_playtime", MPD_STATS_KEY_DB_PLAYTIME);
+	}
+	return MPD_KEY_UNKNOWN;
+}
+
+/* the string tags come first, in the order of mpd_songTagOffsets */
+enum {
+	MPD_SONG_KEY_ARTIST,
+	MPD_SONG_KEY_ALBUM,
+	MPD_SONG_KEY_ALBUM_ARTIST,
+	MPD_SONG_KEY_TITLE,
+	MPD_SONG_KEY_TRACK,
+	MPD_SONG_KEY_NAME,
+	MPD_SONG_KEY_DATE,
+	MPD_SONG_KEY_GENRE,
+	MPD_SONG_KEY_COMPOSER,
+	MPD_SONG_KEY_PERFORMER,
+	MPD_SONG_KEY_DISC,
+	MPD_SONG_KEY_COMMENT,
+	MPD_SONG_KEY_NUM_TAGS,
+	MPD_SONG_KEY_TIME = MPD_SONG_KEY_NUM_TAGS,
+	MPD_SONG_KEY_POS,
+	MPD_SONG_KEY_ID,
+	/* these ones start a new entity */
+	MPD_SONG_KEY_FILE,
+	MPD_SONG_KEY_DIRECTORY,
+	MPD_SONG_KEY_PLAYLIST,
+	MPD_SONG_KEY_CPOS
+};
+
+static const size_t mpd_songTagOffsets[MPD_SONG_KEY_NUM_TAGS] = {
+	offsetof(mpd_Song, artist),
+	offsetof(mpd_Song, album),
+	offsetof(mpd_Song, album_artist),
+	offsetof(mpd_Song, title),
+	offsetof(mpd_Song, track),
+	offsetof(mpd_Song, name),
+	offsetof(mpd_Song, date),
+	offsetof(mpd_Song, genre),
+	offsetof(mpd_Song, composer),
+	offsetof(mpd_Song, performer),
+	offsetof(mpd_Song, disc),
+	offsetof(mpd_Song, comment)
+};
+
+static int mpd_songKey(const char * name, int len) {
+	switch(len) {
+	case 2:
+		return MPD_KEY("Id", MPD_SONG_KEY_ID);
+	case 3:
+		return MPD_KEY("Pos", MPD_SONG_KEY_POS);
+	case 4:
+		switch(name[0]) {
+		case 'f': return MPD_KEY("file", MPD_SONG_KEY_FILE);
+		case 'c': return MPD_KEY("cpos", MPD_SONG_KEY_CPOS);
+		case 'N': return MPD_KEY("Name", MPD_SONG_KEY_NAME);
+		case 'T': return MPD_KEY("Time", MPD_SONG_KEY_TIME);
+		case 'D':
+			if(name[1] == 'a')
+				return MPD_KEY("Date", MPD_SONG_KEY_DATE);
+			return MPD_KEY("Disc", MPD_SONG_KEY_DISC);
+		}
+		break;
+	case 5:
+		switch(name[1]) {
+		case 'l': return MPD_KEY("Album", MPD_SONG_KEY_ALBUM);
+		case 'i': return MPD_KEY("Title", MPD_SONG_KEY_TITLE);
+		case 'r': return MPD_KEY("Track", MPD_SONG_KEY_TRACK);
+		case 'e': return MPD_KEY("Genre", MPD_SONG_KEY_GENRE);
+		}
+		break;
+	case 6:
+		return MPD_KEY("Artist", MPD_SONG_KEY_ARTIST);
+	case 7:
+		return MPD_KEY("Comment", MPD_SONG_KEY_COMMENT);
+	case 8:
+		if(name[0] == 'p') return MPD_KEY("playlist", MPD_SONG_KEY_PLAYLIST);
+		return MPD_KEY("Composer", MPD_SONG_KEY_COMPOSER);
+	case 9:
+		if(name[0] == 'd')
+			return MPD_KEY("directory", MPD_SONG_KEY_DIRECTORY);
+		return MPD_KEY("Performer", MPD_SONG_KEY_PERFORMER);
+	case 11:
+		return MPD_KEY("AlbumArtist", MPD_SONG_KEY_ALBUM_ARTIST);
+	}
+	return MPD_KEY_UNKNOWN;
+}
+
 void mpd_sendStatusCommand(mpd_Connection * connection) {
 	mpd_executeCommand(connection,"status\n");
 }
@@ -726,28 +924,29 @@ mpd_Status * mpd_getStatus(mpd_Connection * connection) {
 	}
 	while(connection->returnElement) {
 		mpd_ReturnElement * re = connection->returnElement;
-		if(strcmp(re->name,"volume")==0) {
+		switch(mpd_statusKey(re->name, re->nameLen)) {
+		case MPD_STATUS_KEY_VOLUME:
 			status->volume = atoi(re->value);
-		}
-		else if(strcmp(re->name,"repeat")==0) {
+			break;
+		case MPD_STATUS_KEY_REPEAT:
 			status->repeat = atoi(re->value);
-		}
-		else if(strcmp(re->name,"random")==0) {
+			break;
+		case MPD_STATUS_KEY_RANDOM:
 			status->random = atoi(re->value);
-		}
-		else if(strcmp(re->name,"consume")==0) {
+			break;
+		case MPD_STATUS_KEY_CONSUME:
 			status->consume = atoi(re->value);
-		}
-		else if(strcmp(re->name,"playlist")==0) {
+			break;
+		case MPD_STATUS_KEY_PLAYLIST:
 			status->playlist = strtol(re->value,NULL,10);
-		}
-		else if(strcmp(re->name,"playlistlength")==0) {
+			break;
+		case MPD_STATUS_KEY_PLAYLISTLENGTH:
 			status->playlistLength = atoi(re->value);
-		}
-		else if(strcmp(re->name,"bitrate")==0) {
+			break;
+		case MPD_STATUS_KEY_BITRATE:
 			status->bitRate = atoi(re->value);
-		}
-		else if(strcmp(re->name,"state")==0) {
+			break;
+		case MPD_STATUS_KEY_STATE:
 			if(strcmp(re->value,"play")==0) {
 				status->state = MPD_STATUS_STATE_PLAY;
 			}
@@ -760,14 +959,14 @@ mpd_Status * mpd_getStatus(mpd_Connection * connection) {
 			else {
 				status->state = MPD_STATUS_STATE_UNKNOWN;
 			}
-		}
-		else if(strcmp(re->name,"song")==0) {
+			break;
+		case MPD_STATUS_KEY_SONG:
 			status->song = atoi(re->value);
-		}
-		else if(strcmp(re->name,"songid")==0) {
+			break;
+		case MPD_STATUS_KEY_SONGID:
 			status->songid = atoi(re->value);
-		}
-		else if(strcmp(re->name,"time")==0) {
+			break;
+		case MPD_STATUS_KEY_TIME: {
 			char * tok = strchr(re->value,':');
 			/* the second strchr below is a safety check */
 			if (tok && (strchr(tok,0) > (tok+1))) {
@@ -775,17 +974,18 @@ mpd_Status * mpd_getStatus(mpd_Connection * connection) {
 				status->elapsedTime = atoi(re->value);
 				status->totalTime = atoi(tok+1);
 			}
+			break;
 		}
-		else if(strcmp(re->name,"error")==0) {
+		case MPD_STATUS_KEY_ERROR:
 			status->error = strdup(re->value);
-		}
-		else if(strcmp(re->name,"xfade")==0) {
+			break;
+		case MPD_STATUS_KEY_XFADE:
 			status->crossfade = atoi(re->value);
-		}
-		else if(strcmp(re->name,"updating_db")==0) {
+			break;
+		case MPD_STATUS_KEY_UPDATING_DB:
 			status->updatingDb = atoi(re->value);
-		}
-		else if(strcmp(re->name,"audio")==0) {
+			break;
+		case MPD_STATUS_KEY_AUDIO: {
 			char * tok = strchr(re->value,':');
 			if (tok && (strchr(tok,0) > (tok+1))) {
 				status->sampleRate = atoi(re->value);
@@ -794,6 +994,8 @@ mpd_Status * mpd_getStatus(mpd_Connection * connection) {
 				if (tok && (strchr(tok,0) > (tok+1)))
 					status->channels = atoi(tok+1);
 			}
+			break;
+		}
 		}
 
 		mpd_getNextReturnElement(connection);
@@ -856,26 +1058,28 @@ mpd_Stats * mpd_getStats(mpd_Connection * connection) {
 	}
 	while(connection->returnElement) {
 		mpd_ReturnElement * re = connection->returnElement;
-		if(strcmp(re->name,"artists")==0) {
+		switch(mpd_statsKey(re->name, re->nameLen)) {
+		case MPD_STATS_KEY_ARTISTS:
 			stats->numberOfArtists = atoi(re->value);
-		}
-		else if(strcmp(re->name,"albums")==0) {
+			break;
+		case MPD_STATS_KEY_ALBUMS:
 			stats->numberOfAlbums = atoi(re->value);
-		}
-		else if(strcmp(re->name,"songs")==0) {
+			break;
+		case MPD_STATS_KEY_SONGS:
 			stats->numberOfSongs = atoi(re->value);
-		}
-		else if(strcmp(re->name,"uptime")==0) {
+			break;
+		case MPD_STATS_KEY_UPTIME:
 			stats->uptime = strtol(re->value,NULL,10);
-		}
-		else if(strcmp(re->name,"db_update")==0) {
+			break;
+		case MPD_STATS_KEY_DB_UPDATE:
 			stats->dbUpdateTime = strtol(re->value,NULL,10);
-		}
-		else if(strcmp(re->name,"playtime")==0) {
+			break;
+		case MPD_STATS_KEY_PLAYTIME:
 			stats->playTime = strtol(re->value,NULL,10);
-		}
-		else if(strcmp(re->name,"db_playtime")==0) {
+			break;
+		case MPD_STATS_KEY_DB_PLAYTIME:
 			stats->dbPlayTime = strtol(re->value,NULL,10);
+			break;
 		}
 
 		mpd_getNextReturnElement(connection);
@@ -1077,6 +1281,93 @@ mpd_PlaylistFile * mpd_playlistFileDup(mpd_PlaylistFile * playlist) {
 	return ret;
 }
 
+/* Size of the chunks allocated by an arena, bigger strings get their own */
+#define MPD_ARENA_CHUNK_SIZE	(64*1024)
+/* Alignment of the blocks returned by an arena */
+#define MPD_ARENA_ALIGN		(sizeof(void *) > sizeof(double) ? \
+				 sizeof(void *) : sizeof(double))
+#define MPD_ARENA_ROUND(x)	(((x) + MPD_ARENA_ALIGN - 1) & \
+				 ~(MPD_ARENA_ALIGN - 1))
+
+mpd_Arena * mpd_newArena(void) {
+	mpd_Arena * arena = malloc(sizeof(mpd_Arena));
+
+	arena->chunks = NULL;
+
+	return arena;
+}
+
+static void mpd_freeArenaChunks(mpd_ArenaChunk * chunk) {
+	mpd_ArenaChunk * next;
+
+	while(chunk) {
+		next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+}
+
+void mpd_clearArena(mpd_Arena * arena) {
+	mpd_ArenaChunk * last;
+
+	if(!arena->chunks) return;
+
+	/* keep the oldest chunk (the last one in the list) for next use */
+	for(last = arena->chunks; last->next; last = last->next);
+	if(last != arena->chunks) {
+		mpd_ArenaChunk * chunk;
+		for(chunk = arena->chunks; chunk->next != last;
+				chunk = chunk->next);
+		chunk->next = NULL;
+		mpd_freeArenaChunks(arena->chunks);
+	}
+	last->used = 0;
+	arena->chunks = last;
+}
+
+void mpd_freeArena(mpd_Arena * arena) {
+	mpd_freeArenaChunks(arena->chunks);
+	free(arena);
+}
+
+static void * mpd_arenaAlloc(mpd_Arena * arena, size_t size) {
+	mpd_ArenaChunk * chunk = arena->chunks;
+	size_t header = MPD_ARENA_ROUND(sizeof(mpd_ArenaChunk));
+	size_t chunkSize;
+	void * ret;
+
+	size = MPD_ARENA_ROUND(size);
+
+	if(!chunk || chunk->used + size > chunk->size) {
+		chunkSize = size > MPD_ARENA_CHUNK_SIZE - header ?
+			size : MPD_ARENA_CHUNK_SIZE - header;
+		chunk = malloc(header + chunkSize);
+		chunk->size = chunkSize;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	ret = (char *) chunk + header + chunk->used;
+	chunk->used += size;
+
+	return ret;
+}
+
+/* strdup in the arena, or with malloc when there is no arena */
+static char * mpd_arenaStrdup(mpd_Arena * arena, const char * str) {
+	size_t len;
+	char * ret;
+
+	if(!arena) return strdup(str);
+
+	len = strlen(str) + 1;
+	ret = mpd_arenaAlloc(arena, len);
+	memcpy(ret, str, len);
+
+	return ret;
+}
+
 static void mpd_initInfoEntity(mpd_InfoEntity * entity) {
 	entity->info.directory = NULL;
 }
@@ -1112,7 +1403,45 @@ static void mpd_sendInfoCommand(mpd_Connection * connection, char * command) {
 	mpd_executeCommand(connection,command);
 }
 
-mpd_InfoEntity * mpd_getNextInfoEntity(mpd_Connection * connection) {
+/* allocates an entity of _type_ with malloc, or in _arena_ if not NULL */
+static mpd_InfoEntity * mpd_newInfoEntityIn(mpd_Arena * arena, int type) {
+	mpd_InfoEntity * entity;
+
+	if(!arena) {
+		entity = mpd_newInfoEntity();
+		entity->type = type;
+		if(type == MPD_INFO_ENTITY_TYPE_SONG)
+			entity->info.song = mpd_newSong();
+		else if(type == MPD_INFO_ENTITY_TYPE_DIRECTORY)
+			entity->info.directory = mpd_newDirectory();
+		else if(type == MPD_INFO_ENTITY_TYPE_PLAYLISTFILE)
+			entity->info.playlistFile = mpd_newPlaylistFile();
+		return entity;
+	}
+
+	entity = mpd_arenaAlloc(arena, sizeof(mpd_InfoEntity));
+	entity->type = type;
+	if(type == MPD_INFO_ENTITY_TYPE_SONG) {
+		entity->info.song = mpd_arenaAlloc(arena, sizeof(mpd_Song));
+		mpd_initSong(entity->info.song);
+	}
+	else if(type == MPD_INFO_ENTITY_TYPE_DIRECTORY) {
+		entity->info.directory = mpd_arenaAlloc(arena,
+				sizeof(mpd_Directory));
+		mpd_initDirectory(entity->info.directory);
+	}
+	else if(type == MPD_INFO_ENTITY_TYPE_PLAYLISTFILE) {
+		entity->info.playlistFile = mpd_arenaAlloc(arena,
+				sizeof(mpd_PlaylistFile));
+		mpd_initPlaylistFile(entity->info.playlistFile);
+	}
+
+	return entity;
+}
+
+static mpd_InfoEntity * mpd_getNextInfoEntityIn(mpd_Connection * connection,
+		mpd_Arena * arena)
+{
 	mpd_InfoEntity * entity = NULL;
 
 	if(connection->doneProcessing || (connection->listOks &&
@@ -1124,35 +1453,33 @@ mpd_InfoEntity * mpd_getNextInfoEntity(mpd_Connection * connection) {
 	if(!connection->returnElement) mpd_getNextReturnElement(connection);
 
 	if(connection->returnElement) {
-		if(strcmp(connection->returnElement->name,"file")==0) {
-			entity = mpd_newInfoEntity();
-			entity->type = MPD_INFO_ENTITY_TYPE_SONG;
-			entity->info.song = mpd_newSong();
+		mpd_ReturnElement * re = connection->returnElement;
+
+		switch(mpd_songKey(re->name, re->nameLen)) {
+		case MPD_SONG_KEY_FILE:
+			entity = mpd_newInfoEntityIn(arena,
+					MPD_INFO_ENTITY_TYPE_SONG);
 			entity->info.song->file =
-				strdup(connection->returnElement->value);
-		}
-		else if(strcmp(connection->returnElement->name,
-					"directory")==0) {
-			entity = mpd_newInfoEntity();
-			entity->type = MPD_INFO_ENTITY_TYPE_DIRECTORY;
-			entity->info.directory = mpd_newDirectory();
+				mpd_arenaStrdup(arena, re->value);
+			break;
+		case MPD_SONG_KEY_DIRECTORY:
+			entity = mpd_newInfoEntityIn(arena,
+					MPD_INFO_ENTITY_TYPE_DIRECTORY);
 			entity->info.directory->path =
-				strdup(connection->returnElement->value);
-		}
-		else if(strcmp(connection->returnElement->name,"playlist")==0) {
-			entity = mpd_newInfoEntity();
-			entity->type = MPD_INFO_ENTITY_TYPE_PLAYLISTFILE;
-			entity->info.playlistFile = mpd_newPlaylistFile();
+				mpd_arenaStrdup(arena, re->value);
+			break;
+		case MPD_SONG_KEY_PLAYLIST:
+			entity = mpd_newInfoEntityIn(arena,
+					MPD_INFO_ENTITY_TYPE_PLAYLISTFILE);
 			entity->info.playlistFile->path =
-				strdup(connection->returnElement->value);
-		}
-		else if(strcmp(connection->returnElement->name, "cpos") == 0){
-			entity = mpd_newInfoEntity();
-			entity->type = MPD_INFO_ENTITY_TYPE_SONG;
-			entity->info.song = mpd_newSong();
-			entity->info.song->pos = atoi(connection->returnElement->value);
-		}
-		else {
+				mpd_arenaStrdup(arena, re->value);
+			break;
+		case MPD_SONG_KEY_CPOS:
+			entity = mpd_newInfoEntityIn(arena,
+					MPD_INFO_ENTITY_TYPE_SONG);
+			entity->info.song->pos = atoi(re->value);
+			break;
+		default:
 			connection->error = 1;
 			strcpy(connection->errorStr,"problem parsing song info");
 			return NULL;
@@ -1163,79 +1490,33 @@ mpd_InfoEntity * mpd_getNextInfoEntity(mpd_Connection * connection) {
 	mpd_getNextReturnElement(connection);
 	while(connection->returnElement) {
 		mpd_ReturnElement * re = connection->returnElement;
-
-		if(strcmp(re->name,"file")==0) return entity;
-		else if(strcmp(re->name,"directory")==0) return entity;
-		else if(strcmp(re->name,"playlist")==0) return entity;
-		else if(strcmp(re->name,"cpos")==0) return entity;
-
-		if(entity->type == MPD_INFO_ENTITY_TYPE_SONG &&
-				strlen(re->value)) {
-			if(!entity->info.song->artist &&
-					strcmp(re->name,"Artist")==0) {
-				entity->info.song->artist = strdup(re->value);
-			}
-			else if(!entity->info.song->album &&
-					strcmp(re->name,"Album")==0) {
-				entity->info.song->album = strdup(re->value);
-			}
-			else if(!entity->info.song->album_artist &&
-					strcmp(re->name,"AlbumArtist")==0) {
-				entity->info.song->album_artist = strdup(re->value);
-			}
-			else if(!entity->info.song->title &&
-					strcmp(re->name,"Title")==0) {
-				entity->info.song->title = strdup(re->value);
-			}
-			else if(!entity->info.song->track &&
-					strcmp(re->name,"Track")==0) {
-				entity->info.song->track = strdup(re->value);
-			}
-			else if(!entity->info.song->name &&
-					strcmp(re->name,"Name")==0) {
-				entity->info.song->name = strdup(re->value);
-			}
-			else if(entity->info.song->time==MPD_SONG_NO_TIME &&
-					strcmp(re->name,"Time")==0) {
-				entity->info.song->time = atoi(re->value);
-			}
-			else if(entity->info.song->pos==MPD_SONG_NO_NUM &&
-					strcmp(re->name,"Pos")==0) {
-				entity->info.song->pos = atoi(re->value);
-			}
-			else if(entity->info.song->id==MPD_SONG_NO_ID &&
-					strcmp(re->name,"Id")==0) {
-				entity->info.song->id = atoi(re->value);
-			}
-			else if(!entity->info.song->date &&
-					strcmp(re->name, "Date") == 0) {
-				entity->info.song->date = strdup(re->value);
+		mpd_Song * song = entity->info.song;
+		int key = mpd_songKey(re->name, re->nameLen);
+
+		if(key >= MPD_SONG_KEY_FILE) return entity;
+
+		if(key != MPD_KEY_UNKNOWN &&
+				entity->type == MPD_INFO_ENTITY_TYPE_SONG &&
+				re->value[0]) {
+			if(key < MPD_SONG_KEY_NUM_TAGS) {
+				char ** slot = (char **) ((char *) song +
+						mpd_songTagOffsets[key]);
+				if(!*slot) *slot = mpd_arenaStrdup(arena,
+						re->value);
 			}
-			else if(!entity->info.song->genre &&
-					strcmp(re->name, "Genre") == 0) {
-				entity->info.song->genre = strdup(re->value);
+			else if(key == MPD_SONG_KEY_TIME &&
+					song->time==MPD_SONG_NO_TIME) {
+				song->time = atoi(re->value);
 			}
-			else if(!entity->info.song->composer &&
-					strcmp(re->name, "Composer") == 0) {
-				entity->info.song->composer = strdup(re->value);
+			else if(key == MPD_SONG_KEY_POS &&
+					song->pos==MPD_SONG_NO_NUM) {
+				song->pos = atoi(re->value);
 			}
-			else if(!entity->info.song->performer &&
-					strcmp(re->name, "Performer") == 0) {
-				entity->info.song->performer = strdup(re->value);
-			}
-			else if(!entity->info.song->disc &&
-					strcmp(re->name, "Disc") == 0) {
-				entity->info.song->disc = strdup(re->value);
-			}
-			else if(!entity->info.song->comment &&
-					strcmp(re->name, "Comment") == 0) {
-				entity->info.song->comment = strdup(re->value);
+			else if(key == MPD_SONG_KEY_ID &&
+					song->id==MPD_SONG_NO_ID) {
+				song->id = atoi(re->value);
 			}
 		}
-		else if(entity->type == MPD_INFO_ENTITY_TYPE_DIRECTORY) {
-		}
-		else if(entity->type == MPD_INFO_ENTITY_TYPE_PLAYLISTFILE) {
-		}
 
 		mpd_getNextReturnElement(connection);
 	}
@@ -1243,6 +1524,16 @@ mpd_InfoEntity * mpd_getNextInfoEntity(mpd_Connection * connection) {
 	return entity;
 }
 
+mpd_InfoEntity * mpd_getNextInfoEntity(mpd_Connection * connection) {
+	return mpd_getNextInfoEntityIn(connection, NULL);
+}
+
+mpd_InfoEntity * mpd_getNextInfoEntityArena(mpd_Connection * connection,
+		mpd_Arena * arena)
+{
+	return mpd_getNextInfoEntityIn(connection, arena);
+}
+
 static char * mpd_getNextReturnElementNamed(mpd_Connection * connection,
 		const char * name)
 {
@@ -1423,6 +1714,19 @@ int mpd_sendAddIdCommand(mpd_Connection *connection, const char *file)
 	return retval;
 }
 
+void mpd_sendAddIdToCommand(mpd_Connection *connection, const char *file,
+                            int to)
+{
+	char *sFile = mpd_sanitizeArg(file);
+	int len = strlen("addid")+2+strlen(sFile)+3+INTLEN+3;
+	char *string = malloc(len);
+
+	snprintf(string, len, "addid \"%s\" \"%i\"\n", sFile, to);
+	mpd_executeCommand(connection, string);
+	free(string);
+	free(sFile);
+}
+
 void mpd_sendDeleteCommand(mpd_Connection * connection, int songPos) {
 	int len = strlen("delete")+2+INTLEN+3;
 	char *string = malloc(len);
@@ -1431,6 +1735,14 @@ void mpd_sendDeleteCommand(mpd_Connection * connection, int songPos) {
 	free(string);
 }
 
+void mpd_sendDeleteRangeCommand(mpd_Connection * connection, int start, int end) {
+	int len = strlen("delete")+2+INTLEN+1+INTLEN+3;
+	char *string = malloc(len);
+	snprintf(string, len, "delete \"%i:%i\"\n", start, end);
+	mpd_sendInfoCommand(connection,string);
+	free(string);
+}
+
 void mpd_sendDeleteIdCommand(mpd_Connection * connection, int id) {
 	int len = strlen("deleteid")+2+INTLEN+3;
 	char *string = malloc(len);
@@ -1531,6 +1843,14 @@ void mpd_sendMoveCommand(mpd_Connection * connection, int from, int to) {
 	free(string);
 }
 
+void mpd_sendMoveRangeCommand(mpd_Connection * connection, int start, int end, int to) {
+	int len = strlen("move")+2+INTLEN+1+INTLEN+3+INTLEN+3;
+	char *string = malloc(len);
+	snprintf(string, len, "move \"%i:%i\" \"%i\"\n", start, end, to);
+	mpd_sendInfoCommand(connection,string);
+	free(string);
+}
+
 void mpd_sendMoveIdCommand(mpd_Connection * connection, int id, int to) {
 	int len = strlen("moveid")+2+INTLEN+3+INTLEN+3;
 	char *string = malloc(len);
@@ -2066,12 +2386,28 @@ void mpd_stopIdle(mpd_Connection *connection)
 }
 
 #ifdef MPD_GLIB
+static void (*mpd_glibLock) (void) = NULL;
+static void (*mpd_glibUnlock) (void) = NULL;
+
 static gboolean mpd_glibReadCb (GIOChannel *iochan, GIOCondition cond, gpointer data)
 {
 	mpd_Connection *connection = data;
 
+	if (mpd_glibLock)
+		mpd_glibLock();
+
+	/* another thread left idle mode while we were waiting for the
+	 * lock, the connection is not ours to read anymore */
+	if (g_source_is_destroyed (g_main_current_source ())) {
+		if (mpd_glibUnlock)
+			mpd_glibUnlock();
+		return FALSE;
+	}
+
 	if (!connection->idle) {
 		connection->source_id = 0;
+		if (mpd_glibUnlock)
+			mpd_glibUnlock();
 		return FALSE;
 	}
 
@@ -2084,6 +2420,9 @@ static gboolean mpd_glibReadCb (GIOChannel *iochan, GIOCondition cond, gpointer
 	     mpd_readChanges(connection);
 	}
 
+	if (mpd_glibUnlock)
+		mpd_glibUnlock();
+
 	return TRUE;
 }
 
@@ -2118,5 +2457,11 @@ void mpd_glibInit(mpd_Connection *connection)
 	connection->startIdle = mpd_glibStartIdle;
 	connection->stopIdle = mpd_glibStopIdle;
 }
+
+void mpd_glibSetLock(void (*lock) (void), void (*unlock) (void))
+{
+	mpd_glibLock = lock;
+	mpd_glibUnlock = unlock;
+}
 #endif
 
@@ -39,11 +39,15 @@
 
 #include <sys/time.h>
 #include <stdarg.h>
+#include <stddef.h>
 #ifdef MPD_GLIB
 #include <glib.h>
 #endif
 
+/* initial size of the receive buffer, it grows for longer lines */
 #define MPD_BUFFER_MAX_LENGTH	50000
+/* a line longer than this trips MPD_ERROR_1_BUFFEROVERRUN */
+#define MPD_BUFFER_LIMIT	(64*1024*1024)
 #define MPD_ERRORSTR_MAX_LENGTH	1000
 #define MPD_WELCOME_MESSAGE	"OK MPD "
 
@@ -100,12 +104,31 @@ typedef enum mpd_TagItems
 
 extern char * mpdTagItemKeys[MPD_TAG_NUM_OF_ITEM_TYPES];
 
-/* internal stuff don't touch this struct */
+/* internal stuff don't touch this struct
+ * name and value point directly into the receive buffer of the connection,
+ * they are only valid until the next element is read
+ */
 typedef struct _mpd_ReturnElement {
 	char * name;
 	char * value;
+	int nameLen;
 } mpd_ReturnElement;
 
+/* mpd_Arena
+ * chunked allocator used to parse big responses (listallinfo, ...) without
+ * one malloc per string: everything allocated from it is released in one go
+ * with mpd_clearArena or mpd_freeArena
+ */
+typedef struct _mpd_ArenaChunk {
+	struct _mpd_ArenaChunk * next;
+	size_t size;
+	size_t used;
+} mpd_ArenaChunk;
+
+typedef struct _mpd_Arena {
+	mpd_ArenaChunk * chunks;
+} mpd_Arena;
+
 enum {
 	/** song database has been updated*/
 	IDLE_DATABASE = 0x1,
@@ -148,14 +171,18 @@ typedef struct _mpd_Connection {
 	int error;
 	/* DON'T TOUCH any of the rest of this stuff */
 	int sock;
-	char buffer[MPD_BUFFER_MAX_LENGTH+1];
+	char * buffer;
+	int bufsize;
 	int buflen;
 	int bufstart;
+	/* bytes before this offset are known not to contain a newline */
+	int bufcheck;
 	int doneProcessing;
 	int listOks;
 	int doneListOk;
 	int commandList;
 	mpd_ReturnElement * returnElement;
+	mpd_ReturnElement element;
 	struct timeval timeout;
 	char *request;
 	int idle;
@@ -437,11 +464,35 @@ mpd_InfoEntity * mpd_newInfoEntity(void);
 
 void mpd_freeInfoEntity(mpd_InfoEntity * entity);
 
+/* ARENA STUFF */
+
+/* mpd_newArena
+ * allocates a new empty arena, free it with mpd_freeArena
+ */
+mpd_Arena * mpd_newArena(void);
+
+/* mpd_clearArena
+ * releases everything allocated from the arena, the first chunk is kept
+ * so that the arena can be reused without calling malloc again
+ */
+void mpd_clearArena(mpd_Arena * arena);
+
+/* mpd_freeArena
+ * releases everything allocated from the arena and the arena itself
+ */
+void mpd_freeArena(mpd_Arena * arena);
+
 /* INFO COMMANDS AND STUFF */
 
 /* use this function to loop over after calling Info/Listall functions */
 mpd_InfoEntity * mpd_getNextInfoEntity(mpd_Connection * connection);
 
+/* same as mpd_getNextInfoEntity, but the entity and all its strings are
+ * allocated from _arena_: don't free it with mpd_freeInfoEntity, it will
+ * be released with the next mpd_clearArena or mpd_freeArena */
+mpd_InfoEntity * mpd_getNextInfoEntityArena(mpd_Connection * connection,
+		mpd_Arena * arena);
+
 /* fetches the currently seeletect song (the song referenced by status->song
  * and status->songid*/
 void mpd_sendCurrentSongCommand(mpd_Connection * connection);
@@ -507,8 +558,16 @@ void mpd_sendAddCommand(mpd_Connection * connection, const char * file);
 
 int mpd_sendAddIdCommand(mpd_Connection *connection, const char *file);
 
+/* add file at position to (MPD >= 0.14), the returned Id is not read so
+ * that it can be sent in a command list */
+void mpd_sendAddIdToCommand(mpd_Connection *connection, const char *file,
+                            int to);
+
 void mpd_sendDeleteCommand(mpd_Connection * connection, int songNum);
 
+/* delete songs from position start to end excluded (MPD >= 0.15) */
+void mpd_sendDeleteRangeCommand(mpd_Connection * connection, int start, int end);
+
 void mpd_sendDeleteIdCommand(mpd_Connection * connection, int songNum);
 
 void mpd_sendSaveCommand(mpd_Connection * connection, const char * name);
@@ -541,6 +600,9 @@ void mpd_sendPrevCommand(mpd_Connection * connection);
 
 void mpd_sendMoveCommand(mpd_Connection * connection, int from, int to);
 
+/* move songs from position start to end excluded at position to (MPD >= 0.15) */
+void mpd_sendMoveRangeCommand(mpd_Connection * connection, int start, int end, int to);
+
 void mpd_sendMoveIdCommand(mpd_Connection * connection, int id, int to);
 
 void mpd_sendSwapCommand(mpd_Connection * connection, int song1, int song2);
@@ -718,6 +780,13 @@ void mpd_stopIdle(mpd_Connection *connection);
 
 #ifdef MPD_GLIB
 void mpd_glibInit(mpd_Connection *connection);
+
+/* mpd_glibSetLock
+ * the idle watch runs _lock_ and _unlock_ around its reads, so that
+ * an application sharing the connection with other threads can
+ * serialize its accesses
+ */
+void mpd_glibSetLock(void (*lock) (void), void (*unlock) (void));
 #endif
 
 #ifdef __cplusplus
@@ -24,15 +24,21 @@
 #include "playlist/ario-playlist-dynamic.h"
 #include "shell/ario-shell-similarartists.h"
 #include "servers/ario-server.h"
+#include "servers/ario-server-interface.h"
+#include "widgets/ario-playlist.h"
 #include "ario-util.h"
 #include "preferences/ario-preferences.h"
 #include "ario-debug.h"
 
 static void ario_playlist_dynamic_class_init (ArioPlaylistDynamicClass *klass);
 static void ario_playlist_dynamic_init (ArioPlaylistDynamic *playlist_dynamic);
+static void ario_playlist_dynamic_next_song (ArioPlaylistMode *playlist_mode,
+                                             ArioPlaylist *playlist);
 static void ario_playlist_dynamic_last_song (ArioPlaylistMode *playlist_mode,
                                              ArioPlaylist *playlist);
 static GtkWidget* ario_playlist_dynamic_get_config (ArioPlaylistMode *playlist_mode);
+static void ario_playlist_dynamic_library_changed_cb (ArioServer *server,
+                                                      ArioPlaylistDynamic *dynamic);
 
 static GObjectClass *parent_class = NULL;
 
@@ -42,7 +48,8 @@ typedef enum
         SONGS_FROM_SAME_ALBUM,
         SONGS_FROM_SIMILAR_ARTISTS,
         ALBUMS_FROM_SAME_ARTIST,
-        ALBUMS_FROM_SIMILAR_ARTISTS
+        ALBUMS_FROM_SIMILAR_ARTISTS,
+        N_DYNAMIC_TYPES
 } ArioDynamicType;
 
 static const char *dynamic_type[] = {
@@ -54,6 +61,69 @@ static const char *dynamic_type[] = {
         NULL
 };
 
+/* A pool keeps POOL_FACTOR times the number of items added at once */
+#define POOL_FACTOR 3
+
+/* Number of files recently played or added that are not proposed again */
+#define HISTORY_SIZE 500
+
+/* The pool is prepared when there are less than PREFETCH_DISTANCE songs
+ * after the current one */
+#define PREFETCH_DISTANCE 3
+
+/* Candidates prepared in advance for a mode */
+typedef struct
+{
+        /* Song the candidates were computed for */
+        gchar *artist;
+        gchar *album;
+
+        /* Candidates in random order: each one is a list of files (a song
+         * or the songs of an album) */
+        GSList *candidates;
+        gint length;
+
+        /* Incremented each time the pool is emptied, so that the results
+         * of previous requests are ignored */
+        guint serial;
+        gboolean refilling;
+} ArioPlaylistDynamicPool;
+
+/* Request to fill a pool: the similar artists are looked up by the
+ * thread, then the candidates are computed in the server thread */
+typedef struct
+{
+        ArioPlaylistDynamic *dynamic;
+        ArioDynamicType type;
+        gchar *artist;
+        gchar *album;
+        gint needed;
+        guint serial;
+
+        /* Artists whose songs or albums are candidates */
+        GSList *artists;
+} ArioPlaylistDynamicRequest;
+
+struct ArioPlaylistDynamicPrivate
+{
+        /* Lock protecting pools, history and thread */
+        GStaticMutex lock;
+
+        ArioPlaylistDynamicPool pools[N_DYNAMIC_TYPES];
+
+        /* Files recently played or added, oldest first */
+        GQueue *history;
+        GHashTable *history_files;
+
+        /* Thread looking up the similar artists on last.fm */
+        GThread *thread;
+        GAsyncQueue *requests;
+
+        /* Number of items to add to the playlist as soon as the pool is
+         * filled (main loop only) */
+        gint pending;
+};
+
 #define ARIO_PLAYLIST_DYNAMIC_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TYPE_ARIO_PLAYLIST_DYNAMIC, ArioPlaylistDynamicPrivate))
 G_DEFINE_TYPE (ArioPlaylistDynamic, ario_playlist_dynamic, ARIO_TYPE_PLAYLIST_MODE)
 
@@ -79,14 +149,24 @@ ario_playlist_dynamic_class_init (ArioPlaylistDynamicClass *klass)
 
         playlist_mode_class->get_id = ario_playlist_dynamic_get_id;
         playlist_mode_class->get_name = ario_playlist_dynamic_get_name;
+        playlist_mode_class->next_song = ario_playlist_dynamic_next_song;
         playlist_mode_class->last_song = ario_playlist_dynamic_last_song;
         playlist_mode_class->get_config = ario_playlist_dynamic_get_config;
+
+        /* Private attributes */
+        g_type_class_add_private (klass, sizeof (ArioPlaylistDynamicPrivate));
 }
 
 static void
 ario_playlist_dynamic_init (ArioPlaylistDynamic *playlist_dynamic)
 {
         ARIO_LOG_FUNCTION_START;
+        playlist_dynamic->priv = ARIO_PLAYLIST_DYNAMIC_GET_PRIVATE (playlist_dynamic);
+
+        g_static_mutex_init (&playlist_dynamic->priv->lock);
+        playlist_dynamic->priv->history = g_queue_new ();
+        playlist_dynamic->priv->history_files = g_hash_table_new (g_str_hash, g_str_equal);
+        playlist_dynamic->priv->requests = g_async_queue_new ();
 }
 
 ArioPlaylistMode*
@@ -94,139 +174,606 @@ ario_playlist_dynamic_new (void)
 {
         ARIO_LOG_FUNCTION_START;
         ArioPlaylistDynamic *dynamic;
+        ArioServer *server = ario_server_get_instance ();
 
         dynamic = g_object_new (TYPE_ARIO_PLAYLIST_DYNAMIC,
                                 NULL);
 
+        /* Candidates are computed again when the library changes */
+        g_signal_connect_object (server,
+                                 "connectivity_changed",
+                                 G_CALLBACK (ario_playlist_dynamic_library_changed_cb),
+                                 dynamic, 0);
+        g_signal_connect_object (server,
+                                 "updatingdb_changed",
+                                 G_CALLBACK (ario_playlist_dynamic_library_changed_cb),
+                                 dynamic, 0);
+
         return ARIO_PLAYLIST_MODE (dynamic);
 }
 
 static void
-ario_playlist_dynamic_last_song (ArioPlaylistMode *playlist_mode,
-                                 ArioPlaylist *playlist)
+ario_playlist_dynamic_free_candidate (GSList *candidate)
+{
+        g_slist_foreach (candidate, (GFunc) g_free, NULL);
+        g_slist_free (candidate);
+}
+
+static void
+ario_playlist_dynamic_free_candidates (GSList *candidates)
+{
+        g_slist_foreach (candidates, (GFunc) ario_playlist_dynamic_free_candidate, NULL);
+        g_slist_free (candidates);
+}
+
+static void
+ario_playlist_dynamic_free_request (ArioPlaylistDynamicRequest *request)
+{
+        g_free (request->artist);
+        g_free (request->album);
+        g_slist_foreach (request->artists, (GFunc) g_free, NULL);
+        g_slist_free (request->artists);
+        g_free (request);
+}
+
+/* Must be called with the lock */
+static void
+ario_playlist_dynamic_pool_clear (ArioPlaylistDynamicPool *pool)
+{
+        g_free (pool->artist);
+        pool->artist = NULL;
+        g_free (pool->album);
+        pool->album = NULL;
+
+        g_slist_foreach (pool->candidates, (GFunc) ario_playlist_dynamic_free_candidate, NULL);
+        g_slist_free (pool->candidates);
+        pool->candidates = NULL;
+        pool->length = 0;
+
+        ++pool->serial;
+        pool->refilling = FALSE;
+}
+
+static gboolean
+ario_playlist_dynamic_pool_is_for (const ArioPlaylistDynamicPool *pool,
+                                   const gchar *artist,
+                                   const gchar *album)
+{
+        return !g_strcmp0 (pool->artist, artist)
+                && !g_strcmp0 (pool->album, album);
+}
+
+/* Only the mode with songs of the same album depends on the album */
+static const gchar *
+ario_playlist_dynamic_get_seed_album (const ArioDynamicType type,
+                                      const gchar *album)
+{
+        return type == SONGS_FROM_SAME_ALBUM ? album : NULL;
+}
+
+/* Must be called with the lock */
+static void
+ario_playlist_dynamic_history_add (ArioPlaylistDynamic *dynamic,
+                                   const gchar *file)
+{
+        gchar *old;
+        gchar *new;
+
+        if (!file || g_hash_table_lookup (dynamic->priv->history_files, file))
+                return;
+
+        new = g_strdup (file);
+        g_queue_push_tail (dynamic->priv->history, new);
+        g_hash_table_insert (dynamic->priv->history_files, new, new);
+
+        if (g_queue_get_length (dynamic->priv->history) > HISTORY_SIZE) {
+                old = g_queue_pop_head (dynamic->priv->history);
+                g_hash_table_remove (dynamic->priv->history_files, old);
+                g_free (old);
+        }
+}
+
+static gboolean
+ario_playlist_dynamic_is_recent (ArioPlaylistDynamic *dynamic,
+                                 const gchar *file)
+{
+        gboolean ret;
+
+        g_static_mutex_lock (&dynamic->priv->lock);
+        ret = g_hash_table_lookup (dynamic->priv->history_files, file) != NULL;
+        g_static_mutex_unlock (&dynamic->priv->lock);
+
+        return ret;
+}
+
+static GSList *
+ario_playlist_dynamic_get_files (const gchar *artist,
+                                 const gchar *album)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *artists = NULL;
-        GSList *albums = NULL, *tmp, *tmp_artist;
         ArioServerAtomicCriteria atomic_criteria1;
         ArioServerAtomicCriteria atomic_criteria2;
         ArioServerCriteria *criteria = NULL;
-        GSList *criterias = NULL;
-        int nbitems = ario_conf_get_integer (PREF_DYNAMIC_NBITEMS, PREF_DYNAMIC_NBITEMS_DEFAULT);
-        char * artist = ario_server_get_current_artist ();
-
-        if (!artist)
-                return;
-
-        switch (ario_conf_get_integer (PREF_DYNAMIC_TYPE, PREF_DYNAMIC_TYPE_DEFAULT)) {
-        case SONGS_FROM_SAME_ARTIST:
-                artists = g_slist_append (artists, artist);
-                ario_server_playlist_append_artists (artists, PLAYLIST_ADD, nbitems);
-                g_slist_free (artists);
-                break;
-        case SONGS_FROM_SAME_ALBUM:
-                atomic_criteria1.tag = ARIO_TAG_ARTIST;
-                atomic_criteria1.value = artist;
+        GSList *songs, *tmp;
+        GSList *files = NULL;
+        ArioServerSong *song;
+
+        atomic_criteria1.tag = ARIO_TAG_ARTIST;
+        atomic_criteria1.value = (gchar *) artist;
+        criteria = g_slist_append (criteria, &atomic_criteria1);
+        if (album) {
                 atomic_criteria2.tag = ARIO_TAG_ALBUM;
-                atomic_criteria2.value = ario_server_get_current_album ();
-
-                criteria = g_slist_append (criteria, &atomic_criteria1);
+                atomic_criteria2.value = (gchar *) album;
                 criteria = g_slist_append (criteria, &atomic_criteria2);
+        }
 
-                criterias = g_slist_append (criterias, criteria);
+        songs = ario_server_get_songs (criteria, TRUE);
+        g_slist_free (criteria);
 
-                ario_server_playlist_append_criterias (criterias, PLAYLIST_ADD, nbitems);
+        /* Keep the file names only */
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
+                song = tmp->data;
+                files = g_slist_prepend (files, song->file);
+                song->file = NULL;
+        }
+        g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
+        g_slist_free (songs);
 
-                g_slist_free (criteria);
-                g_slist_free (criterias);
-                break;
-        case SONGS_FROM_SIMILAR_ARTISTS:
-                ario_shell_similarartists_add_similar_to_playlist (artist,
-                                                                   nbitems);
-                break;
-        case ALBUMS_FROM_SAME_ARTIST:
-                atomic_criteria1.tag = ARIO_TAG_ARTIST;
-                atomic_criteria1.value = ario_server_get_current_artist ();
+        return g_slist_reverse (files);
+}
 
-                criteria = g_slist_append (criteria, &atomic_criteria1);
-                albums = ario_server_get_albums (criteria);
-                g_slist_free (criteria);
+static GSList *
+ario_playlist_dynamic_get_albums (const gchar *artist)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerAtomicCriteria atomic_criteria;
+        ArioServerCriteria *criteria = NULL;
+        GSList *albums;
 
-                tmp = ario_util_gslist_randomize (&albums, nbitems);
-                g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
-                g_slist_free (albums);
-                albums = tmp;
+        atomic_criteria.tag = ARIO_TAG_ARTIST;
+        atomic_criteria.value = (gchar *) artist;
+        criteria = g_slist_append (criteria, &atomic_criteria);
 
-                for (tmp = albums; tmp; tmp = g_slist_next (tmp)) {
-                        ArioServerAlbum *album = tmp->data;
+        albums = ario_server_get_albums (criteria);
+        g_slist_free (criteria);
 
-                        atomic_criteria1.tag = ARIO_TAG_ARTIST;
-                        atomic_criteria1.value = album->artist;
-                        atomic_criteria2.tag = ARIO_TAG_ALBUM;
-                        atomic_criteria2.value = album->album;
+        return albums;
+}
 
-                        criteria = NULL;
-                        criteria = g_slist_append (criteria, &atomic_criteria1);
-                        criteria = g_slist_append (criteria, &atomic_criteria2);
+/* Random songs of files that were not played recently, or random songs
+ * among all of them if all were played recently */
+static GSList *
+ario_playlist_dynamic_pick_songs (ArioPlaylistDynamic *dynamic,
+                                  GSList *files,
+                                  const gint needed)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp, *randomized;
+        GSList *candidates = NULL;
+        GSList *recent = NULL;
+        gint nb = 0, nb_recent = 0;
+
+        randomized = ario_util_gslist_randomize (&files, g_slist_length (files));
+        g_slist_free (files);
+
+        for (tmp = randomized; tmp; tmp = g_slist_next (tmp)) {
+                if (nb < needed
+                    && !ario_playlist_dynamic_is_recent (dynamic, tmp->data)) {
+                        candidates = g_slist_prepend (candidates, g_slist_prepend (NULL, tmp->data));
+                        ++nb;
+                } else if (nb_recent < needed) {
+                        recent = g_slist_prepend (recent, g_slist_prepend (NULL, tmp->data));
+                        ++nb_recent;
+                } else {
+                        g_free (tmp->data);
+                }
+        }
+        g_slist_free (randomized);
 
-                        criterias = NULL;
-                        criterias = g_slist_append (criterias, criteria);
+        if (candidates) {
+                g_slist_foreach (recent, (GFunc) ario_playlist_dynamic_free_candidate, NULL);
+                g_slist_free (recent);
+        } else {
+                candidates = recent;
+        }
 
-                        ario_server_playlist_append_criterias (criterias, PLAYLIST_ADD, -1);
+        return candidates;
+}
 
-                        g_slist_free (criteria);
-                        g_slist_free (criterias);
+/* Songs of random albums that were not played recently, or of random
+ * albums among all of them if all were played recently */
+static GSList *
+ario_playlist_dynamic_pick_albums (ArioPlaylistDynamic *dynamic,
+                                   GSList *albums,
+                                   const gint needed)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp, *randomized;
+        GSList *candidates = NULL;
+        GSList *recent = NULL;
+        GSList *files;
+        ArioServerAlbum *album;
+        gint nb = 0;
+
+        randomized = ario_util_gslist_randomize (&albums, g_slist_length (albums));
+        g_slist_free (albums);
+
+        /* Songs are only looked up for the albums needed */
+        for (tmp = randomized; tmp && nb < needed; tmp = g_slist_next (tmp)) {
+                album = tmp->data;
+                files = ario_playlist_dynamic_get_files (album->artist, album->album);
+                if (!files)
+                        continue;
+
+                if (!ario_playlist_dynamic_is_recent (dynamic, files->data)) {
+                        candidates = g_slist_prepend (candidates, files);
+                        ++nb;
+                } else if (!recent) {
+                        recent = g_slist_prepend (recent, files);
+                } else {
+                        ario_playlist_dynamic_free_candidate (files);
                 }
+        }
+        g_slist_foreach (randomized, (GFunc) ario_server_free_album, NULL);
+        g_slist_free (randomized);
+
+        if (candidates) {
+                g_slist_foreach (recent, (GFunc) ario_playlist_dynamic_free_candidate, NULL);
+                g_slist_free (recent);
+        } else {
+                candidates = recent;
+        }
+
+        return candidates;
+}
+
+static GSList *
+ario_playlist_dynamic_get_similar_artists (const gchar *artist)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *similar_artists, *tmp;
+        GSList *artists = NULL;
+        ArioSimilarArtist *similar_artist;
+
+        similar_artists = ario_shell_similarartists_get_similar_artists (artist);
+        for (tmp = similar_artists; tmp; tmp = g_slist_next (tmp)) {
+                similar_artist = tmp->data;
+                if (similar_artist->name)
+                        artists = g_slist_prepend (artists, g_strdup ((gchar *) similar_artist->name));
+        }
+        g_slist_foreach (similar_artists, (GFunc) ario_shell_similarartists_free_similarartist, NULL);
+        g_slist_free (similar_artists);
+
+        return g_slist_reverse (artists);
+}
 
-                g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
-                g_slist_free (albums);
+/* Called in the server thread, without the lock: all the queries of
+ * a request are made in one call */
+static GSList *
+ario_playlist_dynamic_get_candidates (ArioPlaylistDynamicRequest *request)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp;
+        GSList *files = NULL;
+        GSList *albums = NULL;
+        GSList *candidates = NULL;
+
+        switch (request->type) {
+        case SONGS_FROM_SAME_ARTIST:
+        case SONGS_FROM_SAME_ALBUM:
+        case SONGS_FROM_SIMILAR_ARTISTS:
+                for (tmp = request->artists; tmp; tmp = g_slist_next (tmp))
+                        files = g_slist_concat (files, ario_playlist_dynamic_get_files (tmp->data, request->album));
+                candidates = ario_playlist_dynamic_pick_songs (request->dynamic, files, request->needed);
                 break;
+        case ALBUMS_FROM_SAME_ARTIST:
         case ALBUMS_FROM_SIMILAR_ARTISTS:
-                artists = ario_shell_similarartists_get_similar_artists (artist);
-                for (tmp_artist = artists; tmp_artist; tmp_artist = g_slist_next (tmp_artist)) {
-                        ArioSimilarArtist *artist = tmp_artist->data;
-                        atomic_criteria1.tag = ARIO_TAG_ARTIST;
-                        atomic_criteria1.value = (gchar*) artist->name;
-
-                        criteria = NULL;
-                        criteria = g_slist_append (criteria, &atomic_criteria1);
-                        albums = g_slist_concat (albums, ario_server_get_albums (criteria));
-                        g_slist_free (criteria);
+                for (tmp = request->artists; tmp; tmp = g_slist_next (tmp))
+                        albums = g_slist_concat (albums, ario_playlist_dynamic_get_albums (tmp->data));
+                candidates = ario_playlist_dynamic_pick_albums (request->dynamic, albums, request->needed);
+                break;
+        default:
+                break;
+        }
+
+        return candidates;
+}
+
+/* Must be called with the lock */
+static void
+ario_playlist_dynamic_pool_add (ArioPlaylistDynamicPool *pool,
+                                GSList *candidates)
+{
+        GHashTable *files;
+        GSList *tmp;
+        GSList *candidate;
+
+        /* Candidates already in the pool are skipped */
+        files = g_hash_table_new (g_str_hash, g_str_equal);
+        for (tmp = pool->candidates; tmp; tmp = g_slist_next (tmp)) {
+                candidate = tmp->data;
+                g_hash_table_insert (files, candidate->data, candidate->data);
+        }
+
+        for (tmp = candidates; tmp; tmp = g_slist_next (tmp)) {
+                candidate = tmp->data;
+                if (g_hash_table_lookup (files, candidate->data)) {
+                        ario_playlist_dynamic_free_candidate (candidate);
+                        tmp->data = NULL;
+                } else {
+                        g_hash_table_insert (files, candidate->data, candidate->data);
+                        ++pool->length;
                 }
-                g_slist_foreach (artists, (GFunc) ario_shell_similarartists_free_similarartist, NULL);
-                g_slist_free (artists);
+        }
+        g_hash_table_destroy (files);
 
-                tmp = ario_util_gslist_randomize (&albums, nbitems);
-                g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
-                g_slist_free (albums);
-                albums = tmp;
+        candidates = g_slist_remove_all (candidates, NULL);
+        pool->candidates = g_slist_concat (pool->candidates, candidates);
+}
 
-                for (tmp = albums; tmp; tmp = g_slist_next (tmp)) {
-                        ArioServerAlbum *album = tmp->data;
+static gboolean ario_playlist_dynamic_pool_filled_cb (ArioPlaylistDynamic *dynamic);
 
-                        atomic_criteria1.tag = ARIO_TAG_ARTIST;
-                        atomic_criteria1.value = album->artist;
-                        atomic_criteria2.tag = ARIO_TAG_ALBUM;
-                        atomic_criteria2.value = album->album;
+static void
+ario_playlist_dynamic_get_candidates_cb (GObject *source_object,
+                                         GAsyncResult *result,
+                                         ArioPlaylistDynamicRequest *request)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistDynamic *dynamic = request->dynamic;
+        ArioPlaylistDynamicPool *pool;
+        GSList *candidates;
+
+        candidates = ario_server_interface_call_finish (result, NULL);
+
+        g_static_mutex_lock (&dynamic->priv->lock);
+        pool = &dynamic->priv->pools[request->type];
+        if (pool->serial == request->serial) {
+                ario_playlist_dynamic_pool_add (pool, candidates);
+                pool->refilling = FALSE;
+                candidates = NULL;
+        }
+        g_static_mutex_unlock (&dynamic->priv->lock);
 
-                        criteria = NULL;
-                        criteria = g_slist_append (criteria, &atomic_criteria1);
-                        criteria = g_slist_append (criteria, &atomic_criteria2);
+        ario_playlist_dynamic_free_candidates (candidates);
 
-                        criterias = NULL;
-                        criterias = g_slist_append (criterias, criteria);
+        ario_playlist_dynamic_pool_filled_cb (dynamic);
+}
 
-                        ario_server_playlist_append_criterias (criterias, PLAYLIST_ADD, -1);
+/* Queries of the server are made in the server thread, the request is
+ * freed with the call, after the callback */
+static void
+ario_playlist_dynamic_get_candidates_async (ArioPlaylistDynamicRequest *request)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_interface_call_async (G_OBJECT (ario_server_get_instance ()),
+                                          (ArioServerAsyncFunc) ario_playlist_dynamic_get_candidates,
+                                          request,
+                                          (GDestroyNotify) ario_playlist_dynamic_free_request,
+                                          (GDestroyNotify) ario_playlist_dynamic_free_candidates,
+                                          NULL,
+                                          (GAsyncReadyCallback) ario_playlist_dynamic_get_candidates_cb,
+                                          request);
+}
 
-                        g_slist_free (criteria);
-                        g_slist_free (criterias);
+static gpointer
+ario_playlist_dynamic_fill_thread (ArioPlaylistDynamic *dynamic)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistDynamicRequest *request;
+
+        for (;;) {
+                /* The thread stops when there is nothing more to do */
+                g_static_mutex_lock (&dynamic->priv->lock);
+                request = g_async_queue_try_pop (dynamic->priv->requests);
+                if (!request) {
+                        dynamic->priv->thread = NULL;
+                        g_static_mutex_unlock (&dynamic->priv->lock);
+                        break;
                 }
-                g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
-                g_slist_free (albums);
-                break;
-        default:
-                break;
+                g_static_mutex_unlock (&dynamic->priv->lock);
+
+                /* Slow part: last.fm */
+                request->artists = ario_playlist_dynamic_get_similar_artists (request->artist);
+
+                ario_playlist_dynamic_get_candidates_async (request);
         }
+
+        return NULL;
+}
+
+/* Prepare candidates for songs of artist/album in the background, if the
+ * pool doesn't have enough of them */
+static void
+ario_playlist_dynamic_refill (ArioPlaylistDynamic *dynamic,
+                              const ArioDynamicType type,
+                              const gchar *artist,
+                              const gchar *album,
+                              const gint nbitems)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistDynamicPool *pool = &dynamic->priv->pools[type];
+        ArioPlaylistDynamicRequest *request;
+        gint target = nbitems * POOL_FACTOR;
+
+        g_static_mutex_lock (&dynamic->priv->lock);
+        if (!ario_playlist_dynamic_pool_is_for (pool, artist, album)) {
+                /* Candidates for another song are useless */
+                ario_playlist_dynamic_pool_clear (pool);
+                pool->artist = g_strdup (artist);
+                pool->album = g_strdup (album);
+        }
+
+        if (!pool->refilling && pool->length < target) {
+                request = (ArioPlaylistDynamicRequest *) g_malloc0 (sizeof (ArioPlaylistDynamicRequest));
+                request->dynamic = dynamic;
+                request->type = type;
+                request->artist = g_strdup (artist);
+                request->album = g_strdup (album);
+                request->needed = target - pool->length;
+                request->serial = pool->serial;
+                pool->refilling = TRUE;
+
+                if (type == SONGS_FROM_SIMILAR_ARTISTS
+                    || type == ALBUMS_FROM_SIMILAR_ARTISTS) {
+                        /* Similar artists are looked up first by the thread */
+                        g_async_queue_push (dynamic->priv->requests, request);
+                        if (!dynamic->priv->thread) {
+                                dynamic->priv->thread = g_thread_create ((GThreadFunc) ario_playlist_dynamic_fill_thread,
+                                                                         dynamic,
+                                                                         FALSE,
+                                                                         NULL);
+                        }
+                } else {
+                        request->artists = g_slist_prepend (NULL, g_strdup (artist));
+                        ario_playlist_dynamic_get_candidates_async (request);
+                }
+        }
+        g_static_mutex_unlock (&dynamic->priv->lock);
+}
+
+/* Add up to nbitems candidates of the pool to the playlist and return
+ * the number of candidates added */
+static gint
+ario_playlist_dynamic_append (ArioPlaylistDynamic *dynamic,
+                              const ArioDynamicType type,
+                              const gchar *artist,
+                              const gchar *album,
+                              const gint nbitems)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistDynamicPool *pool = &dynamic->priv->pools[type];
+        GSList *candidate, *tmp;
+        GSList *files = NULL;
+        gint added = 0;
+
+        g_static_mutex_lock (&dynamic->priv->lock);
+        if (ario_playlist_dynamic_pool_is_for (pool, artist, album)) {
+                while (pool->candidates && added < nbitems) {
+                        candidate = pool->candidates->data;
+                        pool->candidates = g_slist_delete_link (pool->candidates, pool->candidates);
+                        --pool->length;
+
+                        /* Skip songs added to the playlist since the pool was filled */
+                        if (ario_playlist_has_file (candidate->data)) {
+                                ario_playlist_dynamic_free_candidate (candidate);
+                                continue;
+                        }
+
+                        for (tmp = candidate; tmp; tmp = g_slist_next (tmp))
+                                ario_playlist_dynamic_history_add (dynamic, tmp->data);
+                        files = g_slist_concat (files, candidate);
+                        ++added;
+                }
+        }
+        g_static_mutex_unlock (&dynamic->priv->lock);
+
+        if (files) {
+                ario_server_playlist_append_songs (files, PLAYLIST_ADD);
+                ario_playlist_dynamic_free_candidate (files);
+        }
+
+        return added;
+}
+
+static gboolean
+ario_playlist_dynamic_pool_filled_cb (ArioPlaylistDynamic *dynamic)
+{
+        ARIO_LOG_FUNCTION_START;
+        gint type = ario_conf_get_integer (PREF_DYNAMIC_TYPE, PREF_DYNAMIC_TYPE_DEFAULT);
+        int nbitems = ario_conf_get_integer (PREF_DYNAMIC_NBITEMS, PREF_DYNAMIC_NBITEMS_DEFAULT);
+        const gchar *artist = ario_server_get_current_artist ();
+        const gchar *album = ario_playlist_dynamic_get_seed_album (type, ario_server_get_current_album ());
+        gint added;
+
+        if (dynamic->priv->pending <= 0
+            || !artist
+            || type < 0 || type >= N_DYNAMIC_TYPES)
+                return FALSE;
+
+        /* Items that were missing when the last song started */
+        added = ario_playlist_dynamic_append (dynamic, type, artist, album, dynamic->priv->pending);
+        dynamic->priv->pending -= added;
+
+        /* Keep the pool filled for the next time */
+        if (added > 0)
+                ario_playlist_dynamic_refill (dynamic, type, artist, album, nbitems);
+
+        return FALSE;
+}
+
+static void
+ario_playlist_dynamic_library_changed_cb (ArioServer *server,
+                                          ArioPlaylistDynamic *dynamic)
+{
+        ARIO_LOG_FUNCTION_START;
+        int i;
+
+        g_static_mutex_lock (&dynamic->priv->lock);
+        for (i = 0; i < N_DYNAMIC_TYPES; ++i)
+                ario_playlist_dynamic_pool_clear (&dynamic->priv->pools[i]);
+        g_static_mutex_unlock (&dynamic->priv->lock);
+}
+
+static void
+ario_playlist_dynamic_next_song (ArioPlaylistMode *playlist_mode,
+                                 ArioPlaylist *playlist)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistDynamic *dynamic = ARIO_PLAYLIST_DYNAMIC (playlist_mode);
+        ArioServerSong *song = ario_server_get_current_song ();
+        int length = ario_server_get_current_playlist_length ();
+        gint type = ario_conf_get_integer (PREF_DYNAMIC_TYPE, PREF_DYNAMIC_TYPE_DEFAULT);
+        int nbitems = ario_conf_get_integer (PREF_DYNAMIC_NBITEMS, PREF_DYNAMIC_NBITEMS_DEFAULT);
+        const gchar *artist;
+        const gchar *album;
+
+        if (!song)
+                return;
+
+        /* Songs played are not proposed again */
+        g_static_mutex_lock (&dynamic->priv->lock);
+        ario_playlist_dynamic_history_add (dynamic, song->file);
+        g_static_mutex_unlock (&dynamic->priv->lock);
+
+        /* The last song is handled by ario_playlist_dynamic_last_song */
+        if (song->pos >= length - 1
+            || song->pos < length - 1 - PREFETCH_DISTANCE
+            || type < 0 || type >= N_DYNAMIC_TYPES)
+                return;
+
+        /* Prepare the songs that will be added after the last one */
+        artist = ario_playlist_get_tag (length - 1, ARIO_TAG_ARTIST);
+        album = ario_playlist_get_tag (length - 1, ARIO_TAG_ALBUM);
+        if (!artist)
+                return;
+
+        ario_playlist_dynamic_refill (dynamic, type,
+                                      artist, ario_playlist_dynamic_get_seed_album (type, album),
+                                      nbitems);
+}
+
+static void
+ario_playlist_dynamic_last_song (ArioPlaylistMode *playlist_mode,
+                                 ArioPlaylist *playlist)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistDynamic *dynamic = ARIO_PLAYLIST_DYNAMIC (playlist_mode);
+        gint type = ario_conf_get_integer (PREF_DYNAMIC_TYPE, PREF_DYNAMIC_TYPE_DEFAULT);
+        int nbitems = ario_conf_get_integer (PREF_DYNAMIC_NBITEMS, PREF_DYNAMIC_NBITEMS_DEFAULT);
+        const gchar *artist = ario_server_get_current_artist ();
+        const gchar *album = ario_playlist_dynamic_get_seed_album (type, ario_server_get_current_album ());
+        gint added;
+
+        if (!artist
+            || type < 0 || type >= N_DYNAMIC_TYPES)
+                return;
+
+        /* Use the candidates prepared in advance: the other ones are added
+         * as soon as they are found */
+        added = ario_playlist_dynamic_append (dynamic, type, artist, album, nbitems);
+        dynamic->priv->pending = nbitems - added;
+
+        ario_playlist_dynamic_refill (dynamic, type, artist, album, nbitems);
 }
 
 static void
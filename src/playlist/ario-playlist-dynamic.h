@@ -32,9 +32,18 @@ G_BEGIN_DECLS
 #define IS_ARIO_PLAYLIST_DYNAMIC_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), TYPE_ARIO_PLAYLIST_DYNAMIC))
 #define ARIO_PLAYLIST_DYNAMIC_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), TYPE_ARIO_PLAYLIST_DYNAMIC, ArioPlaylistDynamicClass))
 
+typedef struct ArioPlaylistDynamicPrivate ArioPlaylistDynamicPrivate;
+
+/*
+ * ArioPlaylistDynamic adds songs at the end of the playlist. Candidates
+ * are prepared in a thread before the last song starts so that nothing
+ * blocks when they are added.
+ */
 typedef struct
 {
         ArioPlaylistMode parent;
+
+        ArioPlaylistDynamicPrivate *priv;
 } ArioPlaylistDynamic;
 
 typedef struct
@@ -86,7 +86,6 @@ ario_playlist_queue_next_song (ArioPlaylistMode *playlist_mode,
 {
         ARIO_LOG_FUNCTION_START;
         ArioServerSong *song = ario_server_get_current_song ();
-        int i;
         int state = ario_server_get_current_state ();
 
         if (state != ARIO_STATE_PLAY
@@ -96,9 +95,8 @@ ario_playlist_queue_next_song (ArioPlaylistMode *playlist_mode,
                 return;
         if (!song->pos)
                 return;
-        for (i=0; i<song->pos; ++i) {
-                ario_server_queue_delete_pos (0);
-        }
+        /* Remove all songs before the current one */
+        ario_server_queue_delete_range (0, song->pos);
         ario_server_queue_commit ();
 }
 
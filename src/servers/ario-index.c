@@ -0,0 +1,972 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "servers/ario-index.h"
+#include <string.h>
+#include <config.h>
+#include <glib/gi18n.h>
+#include "servers/ario-song-array.h"
+#include "ario-util.h"
+#include "ario-debug.h"
+
+/* Tags with a list of songs for each value, filename and 'any' are
+ * not indexed */
+#define ARIO_INDEX_TAG_COUNT ARIO_TAG_FILENAME
+
+/* Snapshot file format, the version must be increased each time
+ * the format changes. Integers are in host byte order: a file written
+ * on another architecture has a wrong magic or version and is ignored. */
+#define ARIO_INDEX_MAGIC "ARIO"
+#define ARIO_INDEX_VERSION 1
+/* Number of string fields in ArioServerSong */
+#define ARIO_INDEX_STRING_FIELDS 13
+/* Offset of a NULL string */
+#define ARIO_INDEX_NO_STRING G_MAXUINT32
+
+/* Relevance of a match on a tag that is not in the word index */
+#define ARIO_INDEX_OTHER_WEIGHT 2
+
+/*
+ * Snapshot file: header, table of NUL-terminated strings (each string
+ * only once) padded to 4 bytes, then one record per song.
+ */
+typedef struct
+{
+        gchar magic[4];
+        guint32 version;
+        guint64 last_update;
+        guint32 n_songs;
+        guint32 strings_size;
+        /* MD5 of everything after the header */
+        gchar checksum[32];
+} ArioIndexHeader;
+
+typedef struct
+{
+        /* Offsets in the table of strings */
+        guint32 strings[ARIO_INDEX_STRING_FIELDS];
+        gint32 time;
+} ArioIndexRecord;
+
+struct ArioIndex
+{
+        /* Songs, with the pool of interned strings */
+        ArioSongArray *songs;
+
+        /* For each tag: interned value -> GArray of song indexes */
+        GHashTable *postings[ARIO_INDEX_TAG_COUNT];
+
+        /* Interned ARIO_SERVER_UNKNOWN, used for songs without tag */
+        const gchar *unknown;
+
+        unsigned long last_update;
+
+        /* Snapshot the index was loaded from: interned strings may
+         * point into it */
+        GMappedFile *map;
+
+        /* Word index for full-text searches, built on first search:
+         * ArioIndexWord sorted by word, words are stored in word_chunk */
+        GArray *words;
+        GStringChunk *word_chunk;
+};
+
+/* Tags of the word index used by full-text searches, with the
+ * relevance of a match on each of them. A posting of the word index is
+ * (song index << 2 | number of the tag in this table). */
+static const struct
+{
+        ArioServerTag tag;
+        guint weight;
+} ario_index_search_tags[] = {
+        { ARIO_TAG_TITLE, 8 },
+        { ARIO_TAG_ARTIST, 6 },
+        { ARIO_TAG_ALBUM, 4 },
+        { ARIO_TAG_FILENAME, 1 }
+};
+#define ARIO_INDEX_SEARCH_TAG_COUNT G_N_ELEMENTS (ario_index_search_tags)
+#define ARIO_INDEX_SEARCH_TAG_BITS 2
+
+typedef struct
+{
+        const gchar *word;
+        GArray *posting;
+} ArioIndexWord;
+
+/* Song index with its relevance, for sorts */
+typedef struct
+{
+        guint pos;
+        guint score;
+        const gchar *file;
+} ArioIndexResult;
+
+/* Atomic criteria with interned value */
+typedef struct
+{
+        ArioServerTag tag;
+        const gchar *value;
+} ArioIndexConstraint;
+
+static void
+ario_index_posting_free (GArray *posting)
+{
+        g_array_free (posting, TRUE);
+}
+
+ArioIndex *
+ario_index_new (unsigned long last_update)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioIndex *index;
+        int i;
+
+        index = (ArioIndex *) g_malloc0 (sizeof (ArioIndex));
+        index->songs = ario_song_array_new ();
+        for (i = 0; i < ARIO_INDEX_TAG_COUNT; ++i)
+                index->postings[i] = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                            NULL, (GDestroyNotify) ario_index_posting_free);
+        index->unknown = ario_song_array_intern (index->songs, ARIO_SERVER_UNKNOWN);
+        index->last_update = last_update;
+
+        return index;
+}
+
+void
+ario_index_free (ArioIndex *index)
+{
+        ARIO_LOG_FUNCTION_START;
+        int i;
+
+        if (!index)
+                return;
+
+        for (i = 0; i < ARIO_INDEX_TAG_COUNT; ++i)
+                g_hash_table_destroy (index->postings[i]);
+        if (index->words) {
+                for (i = 0; i < index->words->len; ++i)
+                        g_array_free (g_array_index (index->words, ArioIndexWord, i).posting, TRUE);
+                g_array_free (index->words, TRUE);
+                g_string_chunk_free (index->word_chunk);
+        }
+        ario_song_array_free (index->songs);
+        if (index->map)
+                g_mapped_file_free (index->map);
+        g_free (index);
+}
+
+unsigned long
+ario_index_get_last_update (ArioIndex *index)
+{
+        return index->last_update;
+}
+
+/* Value of tag used for the lists of songs */
+static const gchar *
+ario_index_song_get_tag (ArioIndex *index,
+                         const guint pos,
+                         ArioServerTag tag)
+{
+        const gchar *value = ario_song_array_get_tag (index->songs, pos, tag);
+
+        return value ? value : index->unknown;
+}
+
+void
+ario_index_add_song (const ArioServerSong *song,
+                     ArioIndex *index)
+{
+        GArray *posting;
+        const gchar *value;
+        guint pos;
+        int i;
+
+        pos = ario_song_array_append (index->songs, song);
+
+        /* Add song to the list of each of its tag values */
+        for (i = 0; i < ARIO_INDEX_TAG_COUNT; ++i) {
+                value = ario_index_song_get_tag (index, pos, i);
+                posting = g_hash_table_lookup (index->postings[i], value);
+                if (!posting) {
+                        posting = g_array_new (FALSE, FALSE, sizeof (guint));
+                        g_hash_table_insert (index->postings[i], (gpointer) value, posting);
+                }
+                g_array_append_val (posting, pos);
+        }
+}
+
+static gboolean
+ario_index_song_matches (ArioIndex *index,
+                         const guint pos,
+                         const ArioIndexConstraint *constraints,
+                         const int n_constraints)
+{
+        int i;
+
+        for (i = 0; i < n_constraints; ++i) {
+                /* Values are interned: compare pointers */
+                if (ario_index_song_get_tag (index, pos, constraints[i].tag) != constraints[i].value)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+/*
+ * Fill matches with the indexes of songs matching criteria, matches
+ * is set to NULL when there is no criteria (all songs match).
+ */
+static gboolean
+ario_index_match (ArioIndex *index,
+                  const ArioServerCriteria *criteria,
+                  GArray **matches)
+{
+        const GSList *tmp;
+        ArioServerAtomicCriteria *atomic_criteria;
+        ArioIndexConstraint *constraints;
+        GArray *posting, *shortest = NULL;
+        const gchar *value;
+        int n_constraints = 0;
+        guint i, pos;
+
+        *matches = NULL;
+        if (!criteria)
+                return TRUE;
+
+        for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
+                atomic_criteria = tmp->data;
+                if (atomic_criteria->tag >= ARIO_INDEX_TAG_COUNT)
+                        return FALSE;
+        }
+
+        *matches = g_array_new (FALSE, FALSE, sizeof (guint));
+        constraints = g_new (ArioIndexConstraint, g_slist_length ((GSList *) criteria));
+
+        for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
+                atomic_criteria = tmp->data;
+
+                /* A value unknown to the index matches no song */
+                value = ario_song_array_lookup (index->songs, atomic_criteria->value);
+                posting = value ? g_hash_table_lookup (index->postings[atomic_criteria->tag], value) : NULL;
+                if (!posting) {
+                        g_free (constraints);
+                        return TRUE;
+                }
+
+                /* Songs are read in the shortest list and checked against other criteria */
+                if (!shortest || posting->len < shortest->len)
+                        shortest = posting;
+
+                constraints[n_constraints].tag = atomic_criteria->tag;
+                constraints[n_constraints].value = value;
+                ++n_constraints;
+        }
+
+        for (i = 0; i < shortest->len; ++i) {
+                pos = g_array_index (shortest, guint, i);
+                if (ario_index_song_matches (index, pos, constraints, n_constraints))
+                        g_array_append_val (*matches, pos);
+        }
+        g_free (constraints);
+
+        return TRUE;
+}
+
+static void
+ario_index_list_tags_foreach (const gchar *value,
+                              gpointer data,
+                              GSList **tags)
+{
+        *tags = g_slist_prepend (*tags, g_strdup (value));
+}
+
+gboolean
+ario_index_list_tags (ArioIndex *index,
+                      const ArioServerTag tag,
+                      const ArioServerCriteria *criteria,
+                      GSList **tags)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *matches;
+        GHashTable *values;
+        guint i;
+
+        *tags = NULL;
+        if (tag >= ARIO_INDEX_TAG_COUNT)
+                return FALSE;
+
+        if (!ario_index_match (index, criteria, &matches))
+                return FALSE;
+
+        if (!matches) {
+                /* No criteria: every value of the tag */
+                g_hash_table_foreach (index->postings[tag],
+                                      (GHFunc) ario_index_list_tags_foreach,
+                                      tags);
+                return TRUE;
+        }
+
+        /* Each value only once */
+        values = g_hash_table_new (g_direct_hash, g_direct_equal);
+        for (i = 0; i < matches->len; ++i)
+                g_hash_table_insert (values,
+                                     (gpointer) ario_index_song_get_tag (index, g_array_index (matches, guint, i), tag),
+                                     NULL);
+        g_hash_table_foreach (values, (GHFunc) ario_index_list_tags_foreach, tags);
+        g_hash_table_destroy (values);
+        g_array_free (matches, TRUE);
+
+        return TRUE;
+}
+
+gboolean
+ario_index_get_albums (ArioIndex *index,
+                       const ArioServerCriteria *criteria,
+                       GSList **albums)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *matches;
+        GHashTable *seen;
+        ArioServerAlbum *album;
+        const gchar *value, *file;
+        guint i, n, pos;
+
+        *albums = NULL;
+        if (!ario_index_match (index, criteria, &matches))
+                return FALSE;
+
+        /* Albums are described by the first song found, like the server does */
+        seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+        n = matches ? matches->len : ario_song_array_get_length (index->songs);
+        for (i = 0; i < n; ++i) {
+                pos = matches ? g_array_index (matches, guint, i) : i;
+                value = ario_index_song_get_tag (index, pos, ARIO_TAG_ALBUM);
+                if (g_hash_table_lookup (seen, value))
+                        continue;
+                g_hash_table_insert (seen, (gpointer) value, GINT_TO_POINTER (1));
+
+                album = (ArioServerAlbum *) g_malloc (sizeof (ArioServerAlbum));
+                album->album = g_strdup (value);
+                album->artist = g_strdup (ario_index_song_get_tag (index, pos, ARIO_TAG_ARTIST));
+                file = ario_song_array_get_tag (index->songs, pos, ARIO_TAG_FILENAME);
+                album->path = file ? g_path_get_dirname (file) : NULL;
+                album->date = g_strdup (ario_song_array_get_tag (index->songs, pos, ARIO_TAG_DATE));
+
+                *albums = g_slist_prepend (*albums, album);
+        }
+        g_hash_table_destroy (seen);
+        if (matches)
+                g_array_free (matches, TRUE);
+
+        return TRUE;
+}
+
+gboolean
+ario_index_get_songs (ArioIndex *index,
+                      const ArioServerCriteria *criteria,
+                      GSList **songs)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *matches;
+        ArioServerSong song;
+        guint i, n;
+
+        *songs = NULL;
+        if (!ario_index_match (index, criteria, &matches))
+                return FALSE;
+
+        /* Songs are returned in database order */
+        n = matches ? matches->len : ario_song_array_get_length (index->songs);
+        for (i = n; i > 0; --i) {
+                ario_song_array_get (index->songs,
+                                     matches ? g_array_index (matches, guint, i - 1) : i - 1,
+                                     &song);
+                *songs = g_slist_prepend (*songs, ario_server_copy_song (&song));
+        }
+        if (matches)
+                g_array_free (matches, TRUE);
+
+        return TRUE;
+}
+
+static guint
+ario_index_search_value_score (const gchar *value,
+                               const gchar *word,
+                               const guint weight)
+{
+        gchar **words;
+        guint score = 0;
+        int i;
+
+        if (!value)
+                return 0;
+
+        /* A word matches when it starts with the searched one, whole
+         * words are more relevant */
+        words = ario_util_split_words (value);
+        for (i = 0; words[i]; ++i) {
+                if (!g_str_has_prefix (words[i], word))
+                        continue;
+                if (!strcmp (words[i], word)) {
+                        score = 2 * weight;
+                        break;
+                }
+                score = weight;
+        }
+        g_strfreev (words);
+
+        return score;
+}
+
+static gboolean
+ario_index_search_is_indexed (const ArioServerTag tag)
+{
+        guint i;
+
+        if (tag == ARIO_TAG_ANY)
+                return TRUE;
+
+        for (i = 0; i < ARIO_INDEX_SEARCH_TAG_COUNT; ++i) {
+                if (ario_index_search_tags[i].tag == tag)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+static guint
+ario_index_search_criteria_score (const ArioServerSong *song,
+                                  const ArioServerAtomicCriteria *atomic_criteria)
+{
+        guint score = 0;
+        guint i;
+
+        if (!ario_index_search_is_indexed (atomic_criteria->tag))
+                return ario_index_search_value_score (ario_server_song_get_tag (song, atomic_criteria->tag),
+                                                      atomic_criteria->value,
+                                                      ARIO_INDEX_OTHER_WEIGHT);
+
+        /* Best match in the tags of the word index */
+        for (i = 0; i < ARIO_INDEX_SEARCH_TAG_COUNT; ++i) {
+                if (atomic_criteria->tag == ARIO_TAG_ANY
+                    || atomic_criteria->tag == ario_index_search_tags[i].tag)
+                        score = MAX (score, ario_index_search_value_score (ario_server_song_get_tag (song, ario_index_search_tags[i].tag),
+                                                                           atomic_criteria->value,
+                                                                           ario_index_search_tags[i].weight));
+        }
+
+        return score;
+}
+
+guint
+ario_index_search_score (const ArioServerSong *song,
+                         const ArioServerCriteria *criteria)
+{
+        const GSList *tmp;
+        guint score = 0;
+        guint criteria_score;
+
+        for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
+                criteria_score = ario_index_search_criteria_score (song, tmp->data);
+                if (!criteria_score)
+                        return 0;
+                score += criteria_score;
+        }
+
+        return score;
+}
+
+static gint
+ario_index_word_compare (const ArioIndexWord *a,
+                         const ArioIndexWord *b)
+{
+        return strcmp (a->word, b->word);
+}
+
+static void
+ario_index_build_words_foreach (const gchar *word,
+                                GArray *posting,
+                                GArray *words)
+{
+        ArioIndexWord index_word;
+
+        index_word.word = word;
+        index_word.posting = posting;
+        g_array_append_val (words, index_word);
+}
+
+void
+ario_index_build_words (ArioIndex *index)
+{
+        ARIO_LOG_FUNCTION_START;
+        GHashTable *postings;
+        GHashTable *values;
+        GArray *posting;
+        const gchar *value;
+        gchar **words;
+        guint pos, n, i, entry;
+        int j;
+
+        if (index->words)
+                return;
+
+        index->word_chunk = g_string_chunk_new (64 * 1024);
+        postings = g_hash_table_new (g_str_hash, g_str_equal);
+        /* Values are interned and shared by many songs (artists,
+         * albums...): each of them is only split once */
+        values = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                        NULL, (GDestroyNotify) g_strfreev);
+
+        n = ario_song_array_get_length (index->songs);
+        for (pos = 0; pos < n; ++pos) {
+                for (i = 0; i < ARIO_INDEX_SEARCH_TAG_COUNT; ++i) {
+                        value = ario_song_array_get_tag (index->songs, pos, ario_index_search_tags[i].tag);
+                        if (!value)
+                                continue;
+
+                        words = g_hash_table_lookup (values, value);
+                        if (!words) {
+                                words = ario_util_split_words (value);
+                                g_hash_table_insert (values, (gpointer) value, words);
+                        }
+
+                        entry = pos << ARIO_INDEX_SEARCH_TAG_BITS | i;
+                        for (j = 0; words[j]; ++j) {
+                                posting = g_hash_table_lookup (postings, words[j]);
+                                if (!posting) {
+                                        posting = g_array_new (FALSE, FALSE, sizeof (guint));
+                                        g_hash_table_insert (postings,
+                                                             g_string_chunk_insert_const (index->word_chunk, words[j]),
+                                                             posting);
+                                }
+                                /* Once per song and tag */
+                                if (!posting->len
+                                    || g_array_index (posting, guint, posting->len - 1) != entry)
+                                        g_array_append_val (posting, entry);
+                        }
+                }
+        }
+        g_hash_table_destroy (values);
+
+        /* Words are sorted so that words starting with a prefix are
+         * found with a binary search */
+        index->words = g_array_sized_new (FALSE, FALSE, sizeof (ArioIndexWord),
+                                          g_hash_table_size (postings));
+        g_hash_table_foreach (postings, (GHFunc) ario_index_build_words_foreach, index->words);
+        g_hash_table_destroy (postings);
+        g_array_sort (index->words, (GCompareFunc) ario_index_word_compare);
+}
+
+/*
+ * Relevance of each song for one atomic criteria, read in the word
+ * index: touched receives the indexes of songs with a score
+ */
+static void
+ario_index_search_postings (ArioIndex *index,
+                            const ArioServerAtomicCriteria *atomic_criteria,
+                            guint *scores,
+                            GArray *touched)
+{
+        ArioIndexWord *index_word;
+        guint low, high, middle;
+        guint i, j, entry, pos, tag, score;
+        gboolean exact;
+
+        /* First word starting with the value */
+        low = 0;
+        high = index->words->len;
+        while (low < high) {
+                middle = (low + high) / 2;
+                if (strcmp (g_array_index (index->words, ArioIndexWord, middle).word, atomic_criteria->value) < 0)
+                        low = middle + 1;
+                else
+                        high = middle;
+        }
+
+        for (i = low; i < index->words->len; ++i) {
+                index_word = &g_array_index (index->words, ArioIndexWord, i);
+                if (!g_str_has_prefix (index_word->word, atomic_criteria->value))
+                        break;
+                exact = !strcmp (index_word->word, atomic_criteria->value);
+
+                for (j = 0; j < index_word->posting->len; ++j) {
+                        entry = g_array_index (index_word->posting, guint, j);
+                        pos = entry >> ARIO_INDEX_SEARCH_TAG_BITS;
+                        tag = entry & ((1 << ARIO_INDEX_SEARCH_TAG_BITS) - 1);
+                        if (atomic_criteria->tag != ARIO_TAG_ANY
+                            && atomic_criteria->tag != ario_index_search_tags[tag].tag)
+                                continue;
+
+                        score = ario_index_search_tags[tag].weight * (exact ? 2 : 1);
+                        if (!scores[pos])
+                                g_array_append_val (touched, pos);
+                        if (score > scores[pos])
+                                scores[pos] = score;
+                }
+        }
+}
+
+/* Best matches first, then by filename */
+static gint
+ario_index_result_compare (const ArioIndexResult *a,
+                           const ArioIndexResult *b)
+{
+        if (a->score != b->score)
+                return a->score > b->score ? -1 : 1;
+
+        return g_strcmp0 (a->file, b->file);
+}
+
+GSList *
+ario_index_search (ArioIndex *index,
+                   const ArioServerCriteria *criteria)
+{
+        ARIO_LOG_FUNCTION_START;
+        const GSList *tmp;
+        ArioServerAtomicCriteria *atomic_criteria;
+        ArioServerCriteria *other_criteria = NULL;
+        ArioServerSong song;
+        ArioIndexResult *results;
+        GArray *candidates = NULL;
+        GArray *touched;
+        guint *totals, *scores;
+        guint i, n, pos, score, n_results = 0;
+        GSList *songs = NULL;
+
+        if (!criteria)
+                return NULL;
+
+        ario_index_build_words (index);
+
+        n = ario_song_array_get_length (index->songs);
+        totals = g_new0 (guint, n);
+        scores = g_new0 (guint, n);
+        touched = g_array_new (FALSE, FALSE, sizeof (guint));
+
+        /* Criteria on indexed tags are answered by the word index,
+         * each one removing candidates */
+        for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
+                atomic_criteria = tmp->data;
+                if (!ario_index_search_is_indexed (atomic_criteria->tag)) {
+                        other_criteria = g_slist_prepend (other_criteria, atomic_criteria);
+                        continue;
+                }
+
+                g_array_set_size (touched, 0);
+                ario_index_search_postings (index, atomic_criteria, scores, touched);
+
+                if (!candidates) {
+                        candidates = g_array_sized_new (FALSE, FALSE, sizeof (guint), touched->len);
+                        for (i = 0; i < touched->len; ++i) {
+                                pos = g_array_index (touched, guint, i);
+                                totals[pos] = scores[pos];
+                                g_array_append_val (candidates, pos);
+                        }
+                } else {
+                        for (i = 0; i < candidates->len;) {
+                                pos = g_array_index (candidates, guint, i);
+                                if (scores[pos]) {
+                                        totals[pos] += scores[pos];
+                                        ++i;
+                                } else {
+                                        g_array_remove_index_fast (candidates, i);
+                                }
+                        }
+                }
+
+                for (i = 0; i < touched->len; ++i)
+                        scores[g_array_index (touched, guint, i)] = 0;
+
+                if (!candidates->len)
+                        break;
+        }
+        g_array_free (touched, TRUE);
+        g_free (scores);
+
+        results = g_new (ArioIndexResult, candidates ? candidates->len : n);
+        for (i = 0; i < (candidates ? candidates->len : n); ++i) {
+                pos = candidates ? g_array_index (candidates, guint, i) : i;
+                score = totals[pos];
+
+                /* Other tags are checked song by song */
+                if (other_criteria) {
+                        ario_song_array_get (index->songs, pos, &song);
+                        score = ario_index_search_score (&song, other_criteria);
+                        if (!score)
+                                continue;
+                        score += totals[pos];
+                }
+
+                results[n_results].pos = pos;
+                results[n_results].score = score;
+                results[n_results].file = ario_song_array_get_tag (index->songs, pos, ARIO_TAG_FILENAME);
+                ++n_results;
+        }
+        g_slist_free (other_criteria);
+        if (candidates)
+                g_array_free (candidates, TRUE);
+        g_free (totals);
+
+        g_qsort_with_data (results, n_results, sizeof (ArioIndexResult),
+                           (GCompareDataFunc) ario_index_result_compare, NULL);
+
+        for (i = n_results; i > 0; --i) {
+                ario_song_array_get (index->songs, results[i - 1].pos, &song);
+                songs = g_slist_prepend (songs, ario_server_copy_song (&song));
+        }
+        g_free (results);
+
+        return songs;
+}
+
+typedef struct
+{
+        ArioServerSong *song;
+        guint score;
+} ArioIndexFilterResult;
+
+static gint
+ario_index_filter_result_compare (const ArioIndexFilterResult *a,
+                                  const ArioIndexFilterResult *b)
+{
+        if (a->score != b->score)
+                return a->score > b->score ? -1 : 1;
+
+        return g_strcmp0 (a->song->file, b->song->file);
+}
+
+GSList *
+ario_index_search_filter (GSList *songs,
+                          const ArioServerCriteria *criteria)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioIndexFilterResult *results;
+        ArioServerSong *song;
+        GSList *tmp;
+        GSList *ret = NULL;
+        guint i, score, n_results = 0;
+
+        results = g_new (ArioIndexFilterResult, g_slist_length (songs));
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
+                song = tmp->data;
+                score = ario_index_search_score (song, criteria);
+                if (score) {
+                        results[n_results].song = song;
+                        results[n_results].score = score;
+                        ++n_results;
+                } else {
+                        ario_server_free_song (song);
+                }
+        }
+        g_slist_free (songs);
+
+        g_qsort_with_data (results, n_results, sizeof (ArioIndexFilterResult),
+                           (GCompareDataFunc) ario_index_filter_result_compare, NULL);
+
+        for (i = n_results; i > 0; --i)
+                ret = g_slist_prepend (ret, results[i - 1].song);
+        g_free (results);
+
+        return ret;
+}
+
+/* Addresses of the string fields of song, in snapshot order */
+static void
+ario_index_song_strings (ArioServerSong *song,
+                         gchar **fields[ARIO_INDEX_STRING_FIELDS])
+{
+        fields[0] = &song->file;
+        fields[1] = &song->artist;
+        fields[2] = &song->title;
+        fields[3] = &song->album;
+        fields[4] = &song->album_artist;
+        fields[5] = &song->track;
+        fields[6] = &song->name;
+        fields[7] = &song->date;
+        fields[8] = &song->genre;
+        fields[9] = &song->composer;
+        fields[10] = &song->performer;
+        fields[11] = &song->disc;
+        fields[12] = &song->comment;
+}
+
+static guint32
+ario_index_save_string (GHashTable *offsets,
+                        GString *strings,
+                        const gchar *string)
+{
+        guint32 offset;
+
+        if (!string)
+                return ARIO_INDEX_NO_STRING;
+
+        /* Strings are interned: offsets are stored by address (+1 to
+         * distinguish offset 0 from a missing one) */
+        offset = GPOINTER_TO_UINT (g_hash_table_lookup (offsets, string));
+        if (offset)
+                return offset - 1;
+
+        offset = strings->len;
+        g_string_append_len (strings, string, strlen (string) + 1);
+        g_hash_table_insert (offsets, (gpointer) string, GUINT_TO_POINTER (offset + 1));
+
+        return offset;
+}
+
+gboolean
+ario_index_save (ArioIndex *index,
+                 const gchar *filename)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioIndexHeader header;
+        ArioIndexRecord *records;
+        ArioServerSong song;
+        gchar **fields[ARIO_INDEX_STRING_FIELDS];
+        GHashTable *offsets;
+        GString *data;
+        gchar *checksum;
+        gboolean ret;
+        guint i, n_songs;
+        int j;
+
+        n_songs = ario_song_array_get_length (index->songs);
+        records = g_new (ArioIndexRecord, n_songs);
+        data = g_string_sized_new (64 * 1024);
+        offsets = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+        ario_index_song_strings (&song, fields);
+        for (i = 0; i < n_songs; ++i) {
+                ario_song_array_get (index->songs, i, &song);
+                for (j = 0; j < ARIO_INDEX_STRING_FIELDS; ++j)
+                        records[i].strings[j] = ario_index_save_string (offsets, data, *fields[j]);
+                records[i].time = song.time;
+        }
+        g_hash_table_destroy (offsets);
+
+        /* Records are aligned */
+        while (data->len % 4)
+                g_string_append_c (data, '\0');
+
+        memset (&header, 0, sizeof (ArioIndexHeader));
+        memcpy (header.magic, ARIO_INDEX_MAGIC, sizeof (header.magic));
+        header.version = ARIO_INDEX_VERSION;
+        header.last_update = index->last_update;
+        header.n_songs = n_songs;
+        header.strings_size = data->len;
+
+        g_string_append_len (data, (gchar *) records, n_songs * sizeof (ArioIndexRecord));
+        g_free (records);
+
+        checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5, (guchar *) data->str, data->len);
+        memcpy (header.checksum, checksum, sizeof (header.checksum));
+        g_free (checksum);
+
+        g_string_prepend_len (data, (gchar *) &header, sizeof (ArioIndexHeader));
+
+        ret = ario_file_set_contents (filename, data->str, data->len, NULL);
+        g_string_free (data, TRUE);
+
+        return ret;
+}
+
+ArioIndex *
+ario_index_load (const gchar *filename)
+{
+        ARIO_LOG_FUNCTION_START;
+        GMappedFile *map;
+        const ArioIndexHeader *header;
+        const ArioIndexRecord *records;
+        const gchar *contents, *strings, *string;
+        gchar **fields[ARIO_INDEX_STRING_FIELDS];
+        ArioServerSong song;
+        ArioIndex *index;
+        gchar *filename_fse;
+        gchar *checksum;
+        gsize length;
+        gboolean valid;
+        guint i;
+        int j;
+
+        filename_fse = g_filename_from_utf8 (filename, -1, NULL, NULL, NULL);
+        if (!filename_fse)
+                return NULL;
+
+        map = g_mapped_file_new (filename_fse, FALSE, NULL);
+        g_free (filename_fse);
+        if (!map)
+                return NULL;
+
+        contents = g_mapped_file_get_contents (map);
+        length = g_mapped_file_get_length (map);
+        header = (const ArioIndexHeader *) contents;
+
+        /* Check that the snapshot is complete and written by this version */
+        valid = length >= sizeof (ArioIndexHeader)
+                && !memcmp (header->magic, ARIO_INDEX_MAGIC, sizeof (header->magic))
+                && header->version == ARIO_INDEX_VERSION
+                && header->strings_size % 4 == 0
+                && header->strings_size <= length - sizeof (ArioIndexHeader)
+                && header->n_songs == (length - sizeof (ArioIndexHeader) - header->strings_size) / sizeof (ArioIndexRecord)
+                && length == sizeof (ArioIndexHeader) + header->strings_size + header->n_songs * sizeof (ArioIndexRecord)
+                && (header->strings_size == 0 || contents[sizeof (ArioIndexHeader) + header->strings_size - 1] == '\0');
+        if (valid) {
+                checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+                                                        (const guchar *) contents + sizeof (ArioIndexHeader),
+                                                        length - sizeof (ArioIndexHeader));
+                valid = !memcmp (header->checksum, checksum, sizeof (header->checksum));
+                g_free (checksum);
+        }
+        if (!valid) {
+                ARIO_LOG_DBG ("Ignore invalid library snapshot %s", filename);
+                g_mapped_file_free (map);
+                return NULL;
+        }
+
+        index = ario_index_new ((unsigned long) header->last_update);
+        index->map = map;
+        strings = contents + sizeof (ArioIndexHeader);
+        records = (const ArioIndexRecord *) (strings + header->strings_size);
+
+        /* Strings of the snapshot are interned without copy */
+        for (string = strings; string < strings + header->strings_size; string += strlen (string) + 1) {
+                if (*string)
+                        ario_song_array_intern_static (index->songs, string);
+        }
+
+        song.pos = -1;
+        song.id = -1;
+        ario_index_song_strings (&song, fields);
+        for (i = 0; i < header->n_songs; ++i) {
+                for (j = 0; j < ARIO_INDEX_STRING_FIELDS; ++j) {
+                        if (records[i].strings[j] == ARIO_INDEX_NO_STRING) {
+                                *fields[j] = NULL;
+                        } else if (records[i].strings[j] < header->strings_size) {
+                                *fields[j] = (gchar *) strings + records[i].strings[j];
+                        } else {
+                                ARIO_LOG_DBG ("Ignore invalid library snapshot %s", filename);
+                                ario_index_free (index);
+                                return NULL;
+                        }
+                }
+                song.time = records[i].time;
+                ario_index_add_song (&song, index);
+        }
+
+        return index;
+}
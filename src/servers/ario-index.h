@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_INDEX_H
+#define __ARIO_INDEX_H
+
+#include <glib.h>
+#include "servers/ario-server.h"
+
+G_BEGIN_DECLS
+
+/**
+ * ArioIndex is a copy of the music library kept in memory. It is
+ * filled once with every song of the server database and then
+ * answers browsing queries without any request to the server.
+ * Tag values are interned so that songs can be compared with
+ * pointers, and each tag value has the list of songs using it.
+ */
+typedef struct ArioIndex ArioIndex;
+
+ArioIndex *             ario_index_new                  (unsigned long last_update);
+
+void                    ario_index_free                 (ArioIndex *index);
+
+void                    ario_index_add_song             (const ArioServerSong *song,
+                                                         ArioIndex *index);
+
+unsigned long           ario_index_get_last_update      (ArioIndex *index);
+
+/* Snapshot of the index on disk, loaded with mmap. NULL is returned
+ * when the file is missing or invalid */
+gboolean                ario_index_save                 (ArioIndex *index,
+                                                         const gchar *filename);
+
+ArioIndex *             ario_index_load                 (const gchar *filename);
+
+/* The functions below return FALSE when criteria can not be
+ * answered by the index (filename or 'any' tag criteria) */
+gboolean                ario_index_list_tags            (ArioIndex *index,
+                                                         const ArioServerTag tag,
+                                                         const ArioServerCriteria *criteria,
+                                                         GSList **tags);
+
+gboolean                ario_index_get_albums           (ArioIndex *index,
+                                                         const ArioServerCriteria *criteria,
+                                                         GSList **albums);
+
+gboolean                ario_index_get_songs            (ArioIndex *index,
+                                                         const ArioServerCriteria *criteria,
+                                                         GSList **songs);
+
+/* Word index of the full-text search, built on the first search if
+ * this was not called before */
+void                    ario_index_build_words          (ArioIndex *index);
+
+/* Full-text search. Values of criteria are words folded with
+ * ario_util_split_words: a song matches when, for each of them, a word
+ * of the tag (title, artist, album or filename for ARIO_TAG_ANY) starts
+ * with the value. Songs are returned best matches first. */
+GSList *                ario_index_search               (ArioIndex *index,
+                                                         const ArioServerCriteria *criteria);
+
+/* Relevance of song for a full-text search, 0 if it does not match */
+guint                   ario_index_search_score         (const ArioServerSong *song,
+                                                         const ArioServerCriteria *criteria);
+
+/* Keep the songs matching a full-text search, best matches first.
+ * Other songs are freed. */
+GSList *                ario_index_search_filter        (GSList *songs,
+                                                         const ArioServerCriteria *criteria);
+
+G_END_DECLS
+
+#endif /* __ARIO_INDEX_H */
@@ -44,11 +44,11 @@
 /* Try to reconnect 5 times */
 #define RECONNECT_TENTATIVES 5
 
+/* Number of songs looked up in one command list */
+#define SONGS_INFO_CHUNK 256
+
 static void ario_mpd_finalize (GObject *object);
-static gboolean ario_mpd_connect_to (ArioMpd *mpd,
-                                     gchar *hostname,
-                                     int port,
-                                     float timeout);
+static gboolean ario_mpd_connect_to (ArioMpd *mpd);
 static void ario_mpd_connect (void);
 static void ario_mpd_disconnect (void);
 static void ario_mpd_update_db (const gchar *path);
@@ -65,6 +65,7 @@ static GSList * ario_mpd_get_songs_from_playlist (char *playlist);
 static GSList * ario_mpd_get_playlists (void);
 static GSList * ario_mpd_get_playlist_changes (gint64 playlist_id);
 static gboolean ario_mpd_update_status (void);
+static gboolean ario_mpd_update_status_events (const unsigned events);
 static ArioServerSong * ario_mpd_get_current_song_on_server (void);
 static int ario_mpd_get_current_playlist_total_time (void);
 static unsigned long ario_mpd_get_last_update (void);
@@ -95,6 +96,9 @@ static ArioServerStats * ario_mpd_get_stats (void);
 static GList * ario_mpd_get_songs_info (GSList *paths);
 static ArioServerFileList * ario_mpd_list_files (const char *path,
                                                  gboolean recursive);
+static gboolean ario_mpd_foreach_song (ArioServerSongFunc func,
+                                       gpointer data);
+static gboolean ario_mpd_thread_connect (void);
 
 /* Private attributes */
 struct ArioMpdPrivate
@@ -103,6 +107,12 @@ struct ArioMpdPrivate
         mpd_Connection *connection;
         mpd_Stats *stats;
 
+        /* Connection used for the queries of the server thread, opened
+         * again when connection_serial changes */
+        mpd_Connection *thread_connection;
+        gint thread_serial;
+        gint connection_serial;
+
         guint timeout_id;
 
         gboolean support_empty_tags;
@@ -110,10 +120,17 @@ struct ArioMpdPrivate
 
         gboolean is_updating;
 
+        /* Idle events received but not handled yet */
+        unsigned idle_events;
+        guint idle_dispatch_id;
+
         int elapsed;
         int reconnect_time;
 };
 
+/* Idle events that are handled with the status of the server */
+#define ARIO_MPD_STATUS_EVENTS (IDLE_DATABASE | IDLE_PLAYLIST | IDLE_PLAYER | IDLE_MIXER | IDLE_OPTIONS)
+
 #define ARIO_MPD_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TYPE_ARIO_MPD, ArioMpdPrivate))
 G_DEFINE_TYPE (ArioMpd, ario_mpd, TYPE_ARIO_SERVER_INTERFACE)
 
@@ -168,6 +185,8 @@ ario_mpd_class_init (ArioMpdClass *klass)
         server_class->get_stats = ario_mpd_get_stats;
         server_class->get_songs_info = ario_mpd_get_songs_info;
         server_class->list_files = ario_mpd_list_files;
+        server_class->foreach_song = ario_mpd_foreach_song;
+        server_class->thread_connect = ario_mpd_thread_connect;
 
         /* Private attributes */
         g_type_class_add_private (klass, sizeof (ArioMpdPrivate));
@@ -197,6 +216,8 @@ ario_mpd_finalize (GObject *object)
         /* Close connection to MPD */
         if (mpd->priv->connection)
                 mpd_closeConnection (mpd->priv->connection);
+        if (mpd->priv->thread_connection)
+                mpd_closeConnection (mpd->priv->thread_connection);
 
         /* Free a few data */
         if (mpd->priv->status)
@@ -281,6 +302,46 @@ ario_mpd_launch_idle_timeout (void)
 }
 #endif
 
+static gboolean
+ario_mpd_idle_dispatch (gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        unsigned events = instance->priv->idle_events;
+
+        instance->priv->idle_events = 0;
+        instance->priv->idle_dispatch_id = 0;
+
+        /* Stored playlists changed, update list */
+        if (events & IDLE_STORED_PLAYLIST)
+                g_signal_emit_by_name (G_OBJECT (server_instance), "storedplaylists_changed");
+
+        /* The library may have changed even if no update was seen */
+        if (events & IDLE_DATABASE)
+                instance->parent.signals_to_emit |= SERVER_UPDATINGDB_CHANGED_FLAG;
+
+        /* Update what has changed in MPD status */
+        if (events & ARIO_MPD_STATUS_EVENTS)
+                ario_mpd_update_status_events (events);
+
+        return FALSE;
+}
+
+static void
+ario_mpd_idle_queue (const unsigned events,
+                     const guint delay)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Events received before the dispatch are handled together */
+        instance->priv->idle_events |= events;
+        if (instance->priv->idle_dispatch_id)
+                return;
+
+        if (delay)
+                instance->priv->idle_dispatch_id = g_timeout_add (delay, ario_mpd_idle_dispatch, NULL);
+        else
+                instance->priv->idle_dispatch_id = g_idle_add (ario_mpd_idle_dispatch, NULL);
+}
+
 static void
 ario_mpd_idle_cb (mpd_Connection *connection,
                   unsigned flags,
@@ -288,18 +349,9 @@ ario_mpd_idle_cb (mpd_Connection *connection,
 {
         ARIO_LOG_FUNCTION_START;
 
-        /* Update MPD status */
-        /* TODO: Be more selective depending on flags */
-        if (flags & IDLE_DATABASE
-            || flags & IDLE_PLAYLIST
-            || flags & IDLE_PLAYER
-            || flags & IDLE_MIXER
-            || flags & IDLE_OPTIONS)
-                ario_mpd_update_status ();
-
-        /* Stored playlists changed, update list */
-        if (flags & IDLE_STORED_PLAYLIST)
-                g_signal_emit_by_name (G_OBJECT (server_instance), "storedplaylists_changed");
+        /* Handle changes in the next main loop iteration */
+        if (flags & (ARIO_MPD_STATUS_EVENTS | IDLE_STORED_PLAYLIST))
+                ario_mpd_idle_queue (flags & (ARIO_MPD_STATUS_EVENTS | IDLE_STORED_PLAYLIST), 0);
 
         /* Diconnected from MPD: check errors */
         if (flags & IDLE_DISCONNECT)
@@ -310,37 +362,64 @@ ario_mpd_idle_cb (mpd_Connection *connection,
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 }
 
-static gboolean
-ario_mpd_connect_to (ArioMpd *mpd,
-                     gchar *hostname,
-                     int port,
-                     float timeout)
+static mpd_Connection *
+ario_mpd_new_connection (void)
 {
         ARIO_LOG_FUNCTION_START;
+        gchar *hostname;
+        int port;
+        float timeout;
         gchar *password;
+        ArioProfile *profile;
         mpd_Connection *connection;
 
+        profile = ario_profiles_get_current (ario_profiles_get ());
+        hostname = profile->host;
+        port = profile->port;
+        timeout = 5.0;
+
+        if (hostname == NULL)
+                hostname = "localhost";
+
+        if (port == 0)
+                port = 6600;
+
         /* Connect to MPD */
         connection = mpd_newConnection (hostname, port, timeout);
         if (!connection)
-                return FALSE;
+                return NULL;
 
         /* Check connection errors */
         if  (connection->error) {
                 ARIO_LOG_ERROR("%s", connection->errorStr);
                 mpd_clearError (connection);
                 mpd_closeConnection (connection);
-                return FALSE;
+                return NULL;
         }
 
         /* Send password if one is set in profile */
-        password = ario_profiles_get_current (ario_profiles_get ())->password;
+        password = profile->password;
         if (password) {
                 mpd_sendPasswordCommand (connection, password);
                 mpd_finishCommand (connection);
         }
 
+        return connection;
+}
+
+static gboolean
+ario_mpd_connect_to (ArioMpd *mpd)
+{
+        ARIO_LOG_FUNCTION_START;
+        mpd_Connection *connection;
+
+        connection = ario_mpd_new_connection ();
+        if (!connection)
+                return FALSE;
+
         mpd->priv->connection = connection;
+        /* Connection of the server thread must be opened again */
+        g_atomic_int_inc (&mpd->priv->connection_serial);
 
         /* Check if idle is supported by MPD server */
         ario_mpd_check_idle (mpd);
@@ -349,6 +428,7 @@ ario_mpd_connect_to (ArioMpd *mpd,
 #ifdef ENABLE_MPDIDLE
                 /* Initialise Idle mode */
                 mpd_glibInit (instance->priv->connection);
+                mpd_glibSetLock (ario_server_interface_lock, ario_server_interface_unlock);
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
                 g_idle_add ((GSourceFunc) ario_mpd_update_status, NULL);
 
@@ -367,23 +447,8 @@ static gpointer
 ario_mpd_connect_thread (ArioServer *server)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *hostname;
-        int port;
-        float timeout;
-        ArioProfile *profile;
-
-        profile = ario_profiles_get_current (ario_profiles_get ());
-        hostname = profile->host;
-        port = profile->port;
-        timeout = 5.0;
-
-        if (hostname == NULL)
-                hostname = "localhost";
-
-        if (port == 0)
-                port = 6600;
 
-        if (!ario_mpd_connect_to (instance, hostname, port, timeout)) {
+        if (!ario_mpd_connect_to (instance)) {
                 ario_mpd_disconnect ();
         }
 
@@ -461,12 +526,19 @@ ario_mpd_disconnect (void)
                 mpd_stopIdle (instance->priv->connection);
         mpd_closeConnection (instance->priv->connection);
         instance->priv->connection = NULL;
+        g_atomic_int_inc (&instance->priv->connection_serial);
 
         if (instance->priv->timeout_id) {
                 g_source_remove (instance->priv->timeout_id);
                 instance->priv->timeout_id = 0;
         }
 
+        if (instance->priv->idle_dispatch_id) {
+                g_source_remove (instance->priv->idle_dispatch_id);
+                instance->priv->idle_dispatch_id = 0;
+        }
+        instance->priv->idle_events = 0;
+
         ario_mpd_update_status ();
 }
 
@@ -506,6 +578,17 @@ ario_mpd_try_reconnect (gpointer data)
         return FALSE;
 }
 
+static gboolean
+ario_mpd_check_errors_idle (gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_interface_lock ();
+        ario_mpd_check_errors ();
+        ario_server_interface_unlock ();
+
+        return FALSE;
+}
+
 static gboolean
 ario_mpd_check_errors (void)
 {
@@ -515,6 +598,12 @@ ario_mpd_check_errors (void)
                 return FALSE;
 
         if  (instance->priv->connection->error) {
+                /* Error in server thread: disconnection is done in main loop */
+                if (!g_main_context_is_owner (NULL)) {
+                        g_idle_add ((GSourceFunc) ario_mpd_check_errors_idle, NULL);
+                        return TRUE;
+                }
+
                 ARIO_LOG_ERROR("%s", instance->priv->connection->errorStr);
                 mpd_clearError (instance->priv->connection);
                 ario_server_disconnect ();
@@ -536,43 +625,112 @@ ario_mpd_is_connected (void)
         return (instance->priv->connection != NULL);
 }
 
+static gboolean
+ario_mpd_thread_connect (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        gint serial = g_atomic_int_get (&instance->priv->connection_serial);
+
+        /* Main connection has changed since the last call */
+        if (instance->priv->thread_connection
+            && instance->priv->thread_serial != serial) {
+                mpd_closeConnection (instance->priv->thread_connection);
+                instance->priv->thread_connection = NULL;
+        }
+
+        /* Queries will see there is no connection */
+        if (!instance->priv->connection)
+                return TRUE;
+
+        if (!instance->priv->thread_connection) {
+                instance->priv->thread_connection = ario_mpd_new_connection ();
+                instance->priv->thread_serial = serial;
+        }
+
+        /* Share the main connection if a new one can't be opened */
+        return instance->priv->thread_connection != NULL;
+}
+
+/* Connection for the queries of the calling thread */
+static mpd_Connection *
+ario_mpd_get_connection (void)
+{
+        if (!instance->priv->connection)
+                return NULL;
+
+        if (ario_server_interface_thread_connection ())
+                return instance->priv->thread_connection;
+
+        return instance->priv->connection;
+}
+
+/* Must be called at the end of a query on connection, returns FALSE
+ * in case of error */
+static gboolean
+ario_mpd_finish_query (mpd_Connection *connection)
+{
+        ARIO_LOG_FUNCTION_START;
+        gboolean ret;
+
+        if (connection == instance->priv->thread_connection) {
+                if (!connection->error)
+                        return TRUE;
+
+                /* Connection of the server thread is opened again by
+                 * the next call */
+                ARIO_LOG_ERROR ("%s", connection->errorStr);
+                mpd_closeConnection (connection);
+                instance->priv->thread_connection = NULL;
+                return FALSE;
+        }
+
+        ret = !ario_mpd_check_errors ();
+
+        if (instance->priv->support_idle && instance->priv->connection)
+                mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
+
+        return ret;
+}
+
 static GSList *
 ario_mpd_list_tags (const ArioServerTag tag,
                     const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
+        mpd_Connection *connection;
         gchar *value;
         const GSList *tmp;
         GSList *values = NULL;
         ArioServerAtomicCriteria *atomic_criteria;
 
         /* check if there is a connection */
-        if (!instance->priv->connection)
+        connection = ario_mpd_get_connection ();
+        if (!connection)
                 return NULL;
 
-        mpd_startFieldSearch (instance->priv->connection, tag);
+        mpd_startFieldSearch (connection, tag);
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (instance->priv->support_empty_tags
                     && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_addConstraintSearch (instance->priv->connection, atomic_criteria->tag, "");
+                        mpd_addConstraintSearch (connection, atomic_criteria->tag, "");
                 else
-                        mpd_addConstraintSearch (instance->priv->connection, atomic_criteria->tag, atomic_criteria->value);
+                        mpd_addConstraintSearch (connection, atomic_criteria->tag, atomic_criteria->value);
         }
-        mpd_commitSearch (instance->priv->connection);
+        mpd_commitSearch (connection);
 
-        while ((value = mpd_getNextTag (instance->priv->connection, tag))) {
+        while ((value = mpd_getNextTag (connection, tag))) {
                 if (*value)
-                        values = g_slist_append (values, value);
+                        values = g_slist_prepend (values, value);
                 else {
                         g_free (value);
-                        values = g_slist_append (values, g_strdup (ARIO_SERVER_UNKNOWN));
+                        values = g_slist_prepend (values, g_strdup (ARIO_SERVER_UNKNOWN));
                         instance->priv->support_empty_tags = TRUE;
                 }
         }
+        values = g_slist_reverse (values);
 
-        if (instance->priv->support_idle && instance->priv->connection)
-                mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
+        ario_mpd_finish_query (connection);
 
         return values;
 }
@@ -589,97 +747,73 @@ static GSList *
 ario_mpd_get_albums (const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
+        mpd_Connection *connection;
         GHashTable *albums;
         const GSList *tmp;
         GList *values;
         GSList *result = NULL;
         mpd_InfoEntity *entity = NULL;
+        mpd_Song *song;
+        mpd_Arena *arena;
         ArioServerAlbum *mpd_album;
         ArioServerAtomicCriteria *atomic_criteria;
 
         /* check if there is a connection */
-        if (!instance->priv->connection)
+        connection = ario_mpd_get_connection ();
+        if (!connection)
                 return NULL;
 
         albums = g_hash_table_new (g_str_hash, g_str_equal);
 
         if (!criteria) {
-                mpd_sendListallInfoCommand (instance->priv->connection, "/");
+                mpd_sendListallInfoCommand (connection, "/");
         } else {
-                mpd_startSearch (instance->priv->connection, TRUE);
+                mpd_startSearch (connection, TRUE);
                 for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                         atomic_criteria = tmp->data;
 
                         if (instance->priv->support_empty_tags
                             && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                                mpd_addConstraintSearch (instance->priv->connection,
+                                mpd_addConstraintSearch (connection,
                                                          atomic_criteria->tag,
                                                          "");
                         else
-                                mpd_addConstraintSearch (instance->priv->connection,
+                                mpd_addConstraintSearch (connection,
                                                          atomic_criteria->tag,
                                                          atomic_criteria->value);
                 }
-                mpd_commitSearch (instance->priv->connection);
+                mpd_commitSearch (connection);
         }
 
-        while ((entity = mpd_getNextInfoEntity (instance->priv->connection))) {
-                if (entity->type != MPD_INFO_ENTITY_TYPE_SONG) {
-                        mpd_freeInfoEntity (entity);
+        /* Nothing is kept from the songs but a few strings copied once per album:
+         * parse them in an arena reset after each song to avoid one malloc
+         * per tag */
+        arena = mpd_newArena ();
+        while ((entity = mpd_getNextInfoEntityArena (connection, arena))) {
+                song = entity->info.song;
+                if (entity->type != MPD_INFO_ENTITY_TYPE_SONG
+                    || ario_mpd_album_is_present (albums, song->album ? song->album : ARIO_SERVER_UNKNOWN)) {
+                        mpd_clearArena (arena);
                         continue;
                 }
 
-                if (!entity->info.song->album) {
-                        if (ario_mpd_album_is_present (albums, ARIO_SERVER_UNKNOWN)) {
-                                mpd_freeInfoEntity (entity);
-                                continue;
-                        }
-                } else {
-                        if (ario_mpd_album_is_present (albums, entity->info.song->album)) {
-                                mpd_freeInfoEntity (entity);
-                                continue;
-                        }
-                }
-
                 mpd_album = (ArioServerAlbum *) g_malloc (sizeof (ArioServerAlbum));
-                if (entity->info.song->album) {
-                        mpd_album->album = entity->info.song->album;
-                        entity->info.song->album = NULL;
-                } else {
-                        mpd_album->album = g_strdup (ARIO_SERVER_UNKNOWN);
-                }
-
-                if (entity->info.song->artist) {
-                        mpd_album->artist = entity->info.song->artist;
-                        entity->info.song->artist = NULL;
-                } else {
-                        mpd_album->artist = g_strdup (ARIO_SERVER_UNKNOWN);
-                }
-
-                if (entity->info.song->file) {
-                        mpd_album->path = g_path_get_dirname (entity->info.song->file);
-                } else {
-                        mpd_album->path = NULL;
-                }
-
-                if (entity->info.song->date) {
-                        mpd_album->date = entity->info.song->date;
-                        entity->info.song->date = NULL;
-                } else {
-                        mpd_album->date = NULL;
-                }
+                mpd_album->album = g_strdup (song->album ? song->album : ARIO_SERVER_UNKNOWN);
+                mpd_album->artist = g_strdup (song->artist ? song->artist : ARIO_SERVER_UNKNOWN);
+                mpd_album->path = song->file ? g_path_get_dirname (song->file) : NULL;
+                mpd_album->date = g_strdup (song->date);
 
                 g_hash_table_insert(albums, mpd_album->album, (gpointer) mpd_album);
 
-                mpd_freeInfoEntity (entity);
+                mpd_clearArena (arena);
         }
-        mpd_finishCommand (instance->priv->connection);
+        mpd_freeArena (arena);
+        mpd_finishCommand (connection);
 
-        if (instance->priv->support_idle && instance->priv->connection)
-                mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
+        ario_mpd_finish_query (connection);
 
         for (values = g_hash_table_get_values (albums); values; values = g_list_next (values))
-                result = g_slist_append (result, values->data);
+                result = g_slist_prepend (result, values->data);
 
         /*
          * we don't need to free neither the keys nor the values since
@@ -695,6 +829,7 @@ ario_mpd_get_songs (const ArioServerCriteria *criteria,
                     const gboolean exact)
 {
         ARIO_LOG_FUNCTION_START;
+        mpd_Connection *connection;
         GSList *songs = NULL;
         mpd_InfoEntity *entity = NULL;
         const GSList *tmp;
@@ -702,7 +837,8 @@ ario_mpd_get_songs (const ArioServerCriteria *criteria,
         ArioServerAtomicCriteria *atomic_criteria;
 
         /* check if there is a connection */
-        if (!instance->priv->connection)
+        connection = ario_mpd_get_connection ();
+        if (!connection)
                 return NULL;
 
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
@@ -712,35 +848,35 @@ ario_mpd_get_songs (const ArioServerCriteria *criteria,
                         is_album_unknown = TRUE;
         }
 
-        mpd_startSearch (instance->priv->connection, exact);
+        mpd_startSearch (connection, exact);
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (instance->priv->support_empty_tags
                     && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_addConstraintSearch (instance->priv->connection,
+                        mpd_addConstraintSearch (connection,
                                                  atomic_criteria->tag,
                                                  "");
                 else if (atomic_criteria->tag != ARIO_TAG_ALBUM
                          || g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_addConstraintSearch (instance->priv->connection,
+                        mpd_addConstraintSearch (connection,
                                                  atomic_criteria->tag,
                                                  atomic_criteria->value);
         }
-        mpd_commitSearch (instance->priv->connection);
+        mpd_commitSearch (connection);
 
-        while ((entity = mpd_getNextInfoEntity (instance->priv->connection))) {
+        while ((entity = mpd_getNextInfoEntity (connection))) {
                 if (entity->type == MPD_INFO_ENTITY_TYPE_SONG && entity->info.song) {
                         if (instance->priv->support_empty_tags || !is_album_unknown || !entity->info.song->album) {
-                                songs = g_slist_append (songs, entity->info.song);
+                                songs = g_slist_prepend (songs, entity->info.song);
                                 entity->info.song = NULL;
                         }
                 }
                 mpd_freeInfoEntity (entity);
         }
-        mpd_finishCommand (instance->priv->connection);
+        mpd_finishCommand (connection);
+        songs = g_slist_reverse (songs);
 
-        if (instance->priv->support_idle && instance->priv->connection)
-                mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
+        ario_mpd_finish_query (connection);
 
         return songs;
 }
@@ -758,11 +894,12 @@ ario_mpd_get_songs_from_playlist (char *playlist)
 
         mpd_sendListPlaylistInfoCommand (instance->priv->connection, playlist);
         while ((ent = mpd_getNextInfoEntity (instance->priv->connection))) {
-                songs = g_slist_append (songs, ent->info.song);
+                songs = g_slist_prepend (songs, ent->info.song);
                 ent->info.song = NULL;
                 mpd_freeInfoEntity (ent);
         }
         mpd_finishCommand (instance->priv->connection);
+        songs = g_slist_reverse (songs);
 
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
@@ -785,11 +922,12 @@ ario_mpd_get_playlists (void)
 
         while ((ent = mpd_getNextInfoEntity (instance->priv->connection))) {
                 if (ent->type == MPD_INFO_ENTITY_TYPE_PLAYLISTFILE) {
-                        playlists = g_slist_append (playlists, g_strdup (ent->info.playlistFile->path));
+                        playlists = g_slist_prepend (playlists, g_strdup (ent->info.playlistFile->path));
                 }
                 mpd_freeInfoEntity (ent);
         }
         mpd_finishCommand (instance->priv->connection);
+        playlists = g_slist_reverse (playlists);
 
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
@@ -811,12 +949,13 @@ ario_mpd_get_playlist_changes (gint64 playlist_id)
         mpd_sendPlChangesCommand (instance->priv->connection, (long long) playlist_id);
         while ((entity = mpd_getNextInfoEntity (instance->priv->connection))) {
                 if (entity->info.song) {
-                        songs = g_slist_append (songs, entity->info.song);
+                        songs = g_slist_prepend (songs, entity->info.song);
                         entity->info.song = NULL;
                 }
                 mpd_freeInfoEntity (entity);
         }
         mpd_finishCommand (instance->priv->connection);
+        songs = g_slist_reverse (songs);
 
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
@@ -826,12 +965,25 @@ ario_mpd_get_playlist_changes (gint64 playlist_id)
 
 static gboolean
 ario_mpd_update_status (void)
+{
+        return ario_mpd_update_status_events (ARIO_MPD_STATUS_EVENTS);
+}
+
+static gboolean
+ario_mpd_update_status_events (const unsigned events)
 {
         // desactivated to make the logs more readable
         //ARIO_LOG_FUNCTION_START;
 
         if (instance->priv->is_updating)
                 return !instance->priv->support_idle;
+
+        /* The server thread is using the connection: try again later */
+        if (!ario_server_interface_trylock ()) {
+                if (instance->priv->support_idle)
+                        ario_mpd_idle_queue (events, NORMAL_TIMEOUT);
+                return !instance->priv->support_idle;
+        }
         instance->priv->is_updating = TRUE;
 
         /* check if there is a connection */
@@ -846,38 +998,48 @@ ario_mpd_update_status (void)
                 if (ario_mpd_check_errors ()) {
                         ario_server_interface_set_default (ARIO_SERVER_INTERFACE (instance));
                 } else if (instance->priv->status) {
-                        if (instance->parent.song_id != instance->priv->status->songid
-                            || instance->parent.playlist_id != (gint64) instance->priv->status->playlist)
+                        /* Only the attributes related to the events are updated */
+                        if (events & (IDLE_PLAYER | IDLE_PLAYLIST)
+                            && (instance->parent.song_id != instance->priv->status->songid
+                                || instance->parent.playlist_id != (gint64) instance->priv->status->playlist))
                                 g_object_set (G_OBJECT (instance), "song_id", instance->priv->status->songid, NULL);
 
-                        if ((gint) instance->parent.state != instance->priv->status->state)
-                                g_object_set (G_OBJECT (instance), "state", instance->priv->status->state, NULL);
+                        if (events & IDLE_PLAYER) {
+                                if ((gint) instance->parent.state != instance->priv->status->state)
+                                        g_object_set (G_OBJECT (instance), "state", instance->priv->status->state, NULL);
 
-                        if (instance->parent.volume != instance->priv->status->volume)
-                                g_object_set (G_OBJECT (instance), "volume", instance->priv->status->volume, NULL);
-
-                        if ((gint) instance->parent.elapsed != instance->priv->status->elapsedTime) {
-                                g_object_set (G_OBJECT (instance), "elapsed", instance->priv->status->elapsedTime, NULL);
-                                instance->priv->elapsed = instance->priv->status->elapsedTime;
+                                if ((gint) instance->parent.elapsed != instance->priv->status->elapsedTime) {
+                                        g_object_set (G_OBJECT (instance), "elapsed", instance->priv->status->elapsedTime, NULL);
+                                        instance->priv->elapsed = instance->priv->status->elapsedTime;
+                                }
                         }
 
-                        if (instance->parent.playlist_id != (gint64) instance->priv->status->playlist) {
+                        if (events & IDLE_MIXER
+                            && instance->parent.volume != instance->priv->status->volume)
+                                g_object_set (G_OBJECT (instance), "volume", instance->priv->status->volume, NULL);
+
+                        if (events & IDLE_PLAYLIST
+                            && instance->parent.playlist_id != (gint64) instance->priv->status->playlist) {
                                 g_object_set (G_OBJECT (instance), "playlist_id", (gint64) instance->priv->status->playlist, NULL);
                                 instance->parent.playlist_length = instance->priv->status->playlistLength;
                         }
 
-                        if (instance->parent.random != (gboolean) instance->priv->status->random)
-                                g_object_set (G_OBJECT (instance), "random", instance->priv->status->random, NULL);
+                        if (events & IDLE_OPTIONS) {
+                                if (instance->parent.random != (gboolean) instance->priv->status->random)
+                                        g_object_set (G_OBJECT (instance), "random", instance->priv->status->random, NULL);
 
-                        if (instance->parent.consume != (gboolean) instance->priv->status->consume)
-                                g_object_set (G_OBJECT (instance), "consume", instance->priv->status->consume, NULL);
+                                if (instance->parent.consume != (gboolean) instance->priv->status->consume)
+                                        g_object_set (G_OBJECT (instance), "consume", instance->priv->status->consume, NULL);
 
-                        if (instance->parent.repeat != (gboolean) instance->priv->status->repeat)
-                                g_object_set (G_OBJECT (instance), "repeat", instance->priv->status->repeat, NULL);
+                                if (instance->parent.repeat != (gboolean) instance->priv->status->repeat)
+                                        g_object_set (G_OBJECT (instance), "repeat", instance->priv->status->repeat, NULL);
+                                instance->parent.crossfade = instance->priv->status->crossfade;
+                        }
 
-                        if ((gint) instance->parent.updatingdb != instance->priv->status->updatingDb)
-                                g_object_set (G_OBJECT (instance), "updatingdb", instance->priv->status->updatingDb, NULL);
-                        instance->parent.crossfade = instance->priv->status->crossfade;
+                        if (events & IDLE_DATABASE) {
+                                if ((gint) instance->parent.updatingdb != instance->priv->status->updatingDb)
+                                        g_object_set (G_OBJECT (instance), "updatingdb", instance->priv->status->updatingDb, NULL);
+                        }
                 }
         }
         ario_server_interface_emit (ARIO_SERVER_INTERFACE (instance), server_instance);
@@ -888,6 +1050,8 @@ ario_mpd_update_status (void)
             && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
+        ario_server_interface_unlock ();
+
         return !instance->priv->support_idle;
 }
 
@@ -921,7 +1085,7 @@ ario_mpd_get_current_playlist_total_time (void)
         if (!instance->priv->connection)
                 return 0;
 
-        /* Compute it from playlist widget (quite coslty but not often called) */
+        /* Sum maintained by the playlist widget from playlist changes */
         return ario_playlist_get_total_time ();
 }
 
@@ -929,24 +1093,26 @@ static unsigned long
 ario_mpd_get_last_update (void)
 {
         ARIO_LOG_FUNCTION_START;
+        mpd_Connection *connection;
+        mpd_Stats *stats;
+        unsigned long ret = 0;
+
         /* check if there is a connection */
-        if (!instance->priv->connection)
+        connection = ario_mpd_get_connection ();
+        if (!connection)
                 return 0;
 
-        if (instance->priv->stats)
-                mpd_freeStats (instance->priv->stats);
-        mpd_sendStatsCommand (instance->priv->connection);
-        instance->priv->stats = mpd_getStats (instance->priv->connection);
-
-        ario_mpd_check_errors ();
+        /* Stats of ario_mpd_get_stats belong to the main loop */
+        mpd_sendStatsCommand (connection);
+        stats = mpd_getStats (connection);
+        if (stats) {
+                ret = stats->dbUpdateTime;
+                mpd_freeStats (stats);
+        }
 
-        if (instance->priv->support_idle && instance->priv->connection)
-                mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
+        ario_mpd_finish_query (connection);
 
-        if (instance->priv->stats)
-                return instance->priv->stats->dbUpdateTime;
-        else
-                return 0;
+        return ret;
 }
 
 static void
@@ -1175,6 +1341,11 @@ ario_mpd_queue_commit (void)
         if (!instance->priv->connection)
                 return;
 
+        /* Ranges are only supported since MPD 0.15 */
+        if (instance->priv->connection->version[0] == 0
+            && instance->priv->connection->version[1] < 15)
+                ario_server_queue_expand_ranges ();
+
         mpd_sendCommandListBegin(instance->priv->connection);
 
         for (temp = instance->parent.queue; temp; temp = g_slist_next (temp)) {
@@ -1199,6 +1370,10 @@ ario_mpd_queue_commit (void)
                         if (queue_action->id >= 0) {
                                 mpd_sendMoveIdCommand(instance->priv->connection, queue_action->old_pos, queue_action->new_pos);
                         }
+                } else if (queue_action->type == ARIO_SERVER_ACTION_DELETE_RANGE) {
+                        mpd_sendDeleteRangeCommand(instance->priv->connection, queue_action->start, queue_action->end);
+                } else if (queue_action->type == ARIO_SERVER_ACTION_MOVE_RANGE) {
+                        mpd_sendMoveRangeCommand(instance->priv->connection, queue_action->start, queue_action->end, queue_action->to);
                 }
         }
         mpd_sendCommandListEnd (instance->priv->connection);
@@ -1221,18 +1396,43 @@ ario_mpd_insert_at (const GSList *songs,
         int end, offset = 0;
         const GSList *tmp;
 
-        end = instance->parent.playlist_length;
+        /* check if there is a connection */
+        if (!instance->priv->connection)
+                return;
 
-        /* For each filename :*/
+        /* MPD < 0.14 can't add songs at a position: add them at the end
+         * and move them one by one */
+        if (instance->priv->connection->version[0] == 0
+            && instance->priv->connection->version[1] < 14) {
+                end = instance->parent.playlist_length;
+
+                /* For each filename :*/
+                for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
+                        /* Add it in the playlist*/
+                        ario_server_queue_add (tmp->data);
+                        ++offset;
+                        /* move it in the right place */
+                        ario_server_queue_move (end + offset - 1, pos + offset);
+                }
+
+                /* Queue actions are prepended: let the server put them in order */
+                ario_server_queue_commit ();
+                return;
+        }
+
+        /* Add each song directly at its position, in one command list */
+        mpd_sendCommandListBegin (instance->priv->connection);
         for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
-                /* Add it in the playlist*/
-                ario_server_queue_add (tmp->data);
+                mpd_sendAddIdToCommand (instance->priv->connection, tmp->data, pos + offset + 1);
                 ++offset;
-                /* move it in the right place */
-                ario_server_queue_move (end + offset - 1, pos + offset);
         }
+        mpd_sendCommandListEnd (instance->priv->connection);
+        mpd_finishCommand (instance->priv->connection);
+        ario_mpd_check_errors ();
+        ario_mpd_update_status ();
 
-        ario_mpd_queue_commit ();
+        if (instance->priv->support_idle && instance->priv->connection)
+                mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 }
 
 static int
@@ -1275,7 +1475,8 @@ ario_mpd_get_outputs (void)
         mpd_sendOutputsCommand (instance->priv->connection);
 
         while ((output_ent = mpd_getNextOutput (instance->priv->connection)))
-                outputs = g_slist_append (outputs, output_ent);
+                outputs = g_slist_prepend (outputs, output_ent);
+        outputs = g_slist_reverse (outputs);
 
         mpd_finishCommand (instance->priv->connection);
 
@@ -1328,32 +1529,51 @@ static GList *
 ario_mpd_get_songs_info (GSList *paths)
 {
         ARIO_LOG_FUNCTION_START;
-        const gchar *path = NULL;
-        GSList *temp;
+        GSList *temp, *chunk;
         GList *songs = NULL;
         mpd_InfoEntity *ent;
+        int i, n;
 
         /* check if there is a connection */
         if (!instance->priv->connection)
                 return NULL;
 
-        for (temp = paths; temp; temp = g_slist_next (temp)) {
-                path = temp->data;
-
-                mpd_sendListallInfoCommand (instance->priv->connection, path);
-
-                ent = mpd_getNextInfoEntity (instance->priv->connection);
-
+        temp = paths;
+        while (temp && instance->priv->connection) {
+                /* Send lookups of a chunk of paths at once */
+                mpd_sendCommandListOkBegin (instance->priv->connection);
+                for (chunk = temp, n = 0; chunk && n < SONGS_INFO_CHUNK; chunk = g_slist_next (chunk), ++n)
+                        mpd_sendListallInfoCommand (instance->priv->connection, chunk->data);
+                mpd_sendCommandListEnd (instance->priv->connection);
+
+                /* Read results: each one ends with a list_OK */
+                for (i = 0; i < n && !instance->priv->connection->error; ++i) {
+                        ent = mpd_getNextInfoEntity (instance->priv->connection);
+                        if (ent) {
+                                if (ent->type == MPD_INFO_ENTITY_TYPE_SONG) {
+                                        songs = g_list_prepend (songs, ent->info.song);
+                                        ent->info.song = NULL;
+                                }
+                                mpd_freeInfoEntity (ent);
+                        }
+                        if (instance->priv->connection->error)
+                                break;
+                        mpd_nextListOkCommand (instance->priv->connection);
+                        temp = g_slist_next (temp);
+                }
                 mpd_finishCommand (instance->priv->connection);
-                if (!ent)
-                        continue;
 
-                songs = g_list_append (songs, ent->info.song);
-                ent->info.song = NULL;
-
-                mpd_freeInfoEntity (ent);
-                ario_mpd_check_errors ();
+                if (instance->priv->connection->error == MPD_ERROR_1_ACK) {
+                        /* MPD stops the list at the first unknown path: skip
+                         * it and send the remaining paths again */
+                        ARIO_LOG_ERROR ("%s", instance->priv->connection->errorStr);
+                        mpd_clearError (instance->priv->connection);
+                        temp = g_slist_next (temp);
+                } else if (ario_mpd_check_errors ()) {
+                        break;
+                }
         }
+        songs = g_list_reverse (songs);
 
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
@@ -1366,33 +1586,64 @@ ario_mpd_list_files (const char *path,
                      gboolean recursive)
 {
         ARIO_LOG_FUNCTION_START;
+        mpd_Connection *connection;
         mpd_InfoEntity *entity;
         ArioServerFileList *files = (ArioServerFileList *) g_malloc0 (sizeof (ArioServerFileList));
 
         /* check if there is a connection */
-        if (!instance->priv->connection)
+        connection = ario_mpd_get_connection ();
+        if (!connection)
                 return files;
 
         if (recursive)
-                mpd_sendListallCommand (instance->priv->connection, path);
+                mpd_sendListallCommand (connection, path);
         else
-                mpd_sendLsInfoCommand (instance->priv->connection, path);
+                mpd_sendLsInfoCommand (connection, path);
 
-        while ((entity = mpd_getNextInfoEntity (instance->priv->connection))) {
+        while ((entity = mpd_getNextInfoEntity (connection))) {
                 if (entity->type == MPD_INFO_ENTITY_TYPE_DIRECTORY) {
-                        files->directories = g_slist_append (files->directories, entity->info.directory->path);
+                        files->directories = g_slist_prepend (files->directories, entity->info.directory->path);
                         entity->info.directory->path = NULL;
                 } else if (entity->type == MPD_INFO_ENTITY_TYPE_SONG) {
-                        files->songs = g_slist_append (files->songs, entity->info.song);
+                        files->songs = g_slist_prepend (files->songs, entity->info.song);
                         entity->info.song = NULL;
                 }
 
                 mpd_freeInfoEntity(entity);
         }
+        files->directories = g_slist_reverse (files->directories);
+        files->songs = g_slist_reverse (files->songs);
 
-        if (instance->priv->support_idle && instance->priv->connection)
-                mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
+        ario_mpd_finish_query (connection);
 
         return files;
 }
 
+
+static gboolean
+ario_mpd_foreach_song (ArioServerSongFunc func,
+                       gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        mpd_Connection *connection;
+        mpd_InfoEntity *entity;
+        mpd_Arena *arena;
+
+        /* check if there is a connection */
+        connection = ario_mpd_get_connection ();
+        if (!connection)
+                return FALSE;
+
+        /* Songs only live during the call of func: parse them in an arena */
+        mpd_sendListallInfoCommand (connection, "/");
+        arena = mpd_newArena ();
+        while ((entity = mpd_getNextInfoEntityArena (connection, arena))) {
+                if (entity->type == MPD_INFO_ENTITY_TYPE_SONG && entity->info.song)
+                        func ((ArioServerSong *) entity->info.song, data);
+                mpd_clearArena (arena);
+        }
+        mpd_freeArena (arena);
+        mpd_finishCommand (connection);
+
+        return ario_mpd_finish_query (connection);
+}
@@ -45,11 +45,18 @@
 /* Reconnect timeout will never exceed 8 seconds */
 #define RECONNECT_MAXIMUM_TIMEOUT 8000
 
+/* Number of songs looked up in one command list */
+#define SONGS_INFO_CHUNK 256
+
+/* Range deletions and moves are available since libmpdclient 2.3 */
+#ifdef LIBMPDCLIENT_CHECK_VERSION
+#if LIBMPDCLIENT_CHECK_VERSION(2, 3, 0)
+#define ARIO_MPD_RANGES
+#endif
+#endif
+
 static void ario_mpd_finalize (GObject *object);
-static gboolean ario_mpd_connect_to (ArioMpd *mpd,
-                                     gchar *hostname,
-                                     int port,
-                                     guint timeout);
+static gboolean ario_mpd_connect_to (ArioMpd *mpd);
 static void ario_mpd_connect (void);
 static void ario_mpd_disconnect (void);
 static void ario_mpd_update_db (const gchar *path);
@@ -66,6 +73,7 @@ static GSList * ario_mpd_get_songs_from_playlist (char *playlist);
 static GSList * ario_mpd_get_playlists (void);
 static GSList * ario_mpd_get_playlist_changes (gint64 playlist_id);
 static gboolean ario_mpd_update_status (void);
+static gboolean ario_mpd_update_status_events (const enum mpd_idle events);
 static ArioServerSong * ario_mpd_get_current_song_on_server (void);
 static int ario_mpd_get_current_playlist_total_time (void);
 static unsigned long ario_mpd_get_last_update (void);
@@ -96,10 +104,13 @@ static ArioServerStats * ario_mpd_get_stats (void);
 static GList * ario_mpd_get_songs_info (GSList *paths);
 static ArioServerFileList * ario_mpd_list_files (const char *path,
                                                  gboolean recursive);
+static gboolean ario_mpd_foreach_song (ArioServerSongFunc func,
+                                       gpointer data);
 // Return TRUE on error
 static gboolean ario_mpd_command_preinvoke (void);
 static void ario_mpd_command_postinvoke (void);
 static void ario_mpd_idle_start (void);
+static gboolean ario_mpd_thread_connect (void);
 static void ario_mpd_server_state_changed_cb (ArioServer *server,
                                               gpointer data);
 /* Private attributes */
@@ -109,6 +120,12 @@ struct ArioMpdPrivate
         struct mpd_connection *connection;
         ArioServerStats *stats;
 
+        /* Connection used for the queries of the server thread, opened
+         * again when connection_serial changes */
+        struct mpd_connection *thread_connection;
+        gint thread_serial;
+        gint connection_serial;
+
         guint timeout_id;
 
         gboolean support_empty_tags;
@@ -122,9 +139,16 @@ struct ArioMpdPrivate
         int idle;
         int source_id;
 
+        /* Idle events received but not handled yet */
+        enum mpd_idle idle_events;
+        guint idle_dispatch_id;
+
         gboolean supported[ARIO_TAG_COUNT];
 };
 
+/* Idle events that are handled with the status of the server */
+#define ARIO_MPD_STATUS_EVENTS (MPD_IDLE_QUEUE | MPD_IDLE_PLAYER | MPD_IDLE_MIXER | MPD_IDLE_OPTIONS | MPD_IDLE_UPDATE)
+
 #define ARIO_MPD_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TYPE_ARIO_MPD, ArioMpdPrivate))
 G_DEFINE_TYPE (ArioMpd, ario_mpd, TYPE_ARIO_SERVER_INTERFACE)
 
@@ -179,6 +203,8 @@ ario_mpd_class_init (ArioMpdClass *klass)
         server_class->get_stats = ario_mpd_get_stats;
         server_class->get_songs_info = ario_mpd_get_songs_info;
         server_class->list_files = ario_mpd_list_files;
+        server_class->foreach_song = ario_mpd_foreach_song;
+        server_class->thread_connect = ario_mpd_thread_connect;
 
         /* Private attributes */
         g_type_class_add_private (klass, sizeof (ArioMpdPrivate));
@@ -208,6 +234,8 @@ ario_mpd_finalize (GObject *object)
         /* Close connection to MPD */
         if (mpd->priv->connection)
                 mpd_connection_free (mpd->priv->connection);
+        if (mpd->priv->thread_connection)
+                mpd_connection_free (mpd->priv->thread_connection);
 
         /* Free a few data */
         if (mpd->priv->status)
@@ -282,9 +310,10 @@ ario_mpd_check_tags (ArioMpd *mpd)
         mpd_send_list_tag_types (mpd->priv->connection);
         while ((pair = mpd_recv_tag_type_pair (mpd->priv->connection))) {
                 /* Add them to the list */
-                mpd->priv->supported_tags = g_slist_append (mpd->priv->supported_tags, g_strdup (pair->value));
+                mpd->priv->supported_tags = g_slist_prepend (mpd->priv->supported_tags, g_strdup (pair->value));
                 mpd_return_pair (mpd->priv->connection, pair);
         }
+        mpd->priv->supported_tags = g_slist_reverse (mpd->priv->supported_tags);
 }
 
 static void
@@ -310,17 +339,53 @@ ario_mpd_update_elapsed (gpointer data)
 }
 
 static gboolean
-ario_mpd_emit_storedplaylist (gpointer not_used)
+ario_mpd_idle_dispatch (gpointer data)
 {
-        g_signal_emit_by_name (G_OBJECT (server_instance), "storedplaylists_changed");
+        ARIO_LOG_FUNCTION_START;
+        enum mpd_idle events = instance->priv->idle_events;
 
         /*
-         * We're being hooked into the main loop using g_idle_add and
-         * want to be called just once
+         * We're being hooked into the main loop and want to be called
+         * just once for all the events received since the last call
          */
+        instance->priv->idle_events = 0;
+        instance->priv->idle_dispatch_id = 0;
+
+        /* Stored playlists changed, update list */
+        if (events & MPD_IDLE_STORED_PLAYLIST)
+                g_signal_emit_by_name (G_OBJECT (server_instance), "storedplaylists_changed");
+
+        /* Songs of the library changed: no need to ask the server, the
+         * library cache is checked again on next use */
+        if (events & MPD_IDLE_DATABASE) {
+                instance->parent.signals_to_emit |= SERVER_UPDATINGDB_CHANGED_FLAG;
+                if (!(events & ARIO_MPD_STATUS_EVENTS))
+                        ario_server_interface_emit (ARIO_SERVER_INTERFACE (instance), server_instance);
+        }
+
+        /* Update what has changed in MPD status */
+        if (events & ARIO_MPD_STATUS_EVENTS)
+                ario_mpd_update_status_events (events);
+
         return FALSE;
 }
 
+static void
+ario_mpd_idle_queue (const enum mpd_idle events,
+                     const guint delay)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Events received before the dispatch are handled together */
+        instance->priv->idle_events |= events;
+        if (instance->priv->idle_dispatch_id)
+                return;
+
+        if (delay)
+                instance->priv->idle_dispatch_id = g_timeout_add (delay, ario_mpd_idle_dispatch, NULL);
+        else
+                instance->priv->idle_dispatch_id = g_idle_add (ario_mpd_idle_dispatch, NULL);
+}
+
 static void
 ario_mpd_idle_read (void)
 {
@@ -329,18 +394,9 @@ ario_mpd_idle_read (void)
         enum mpd_idle flags = mpd_recv_idle (instance->priv->connection, FALSE);
         ario_mpd_check_errors ();
 
-        /* Update MPD status */
-        /* TODO: Be more selective depending on flags */
-        if (flags & MPD_IDLE_DATABASE
-            || flags & MPD_IDLE_QUEUE
-            || flags & MPD_IDLE_PLAYER
-            || flags & MPD_IDLE_MIXER
-            || flags & MPD_IDLE_OPTIONS)
-                g_idle_add ((GSourceFunc) ario_mpd_update_status, NULL);
-
-        /* Stored playlists changed, update list */
-        if (flags & MPD_IDLE_STORED_PLAYLIST)
-                g_idle_add ((GSourceFunc) ario_mpd_emit_storedplaylist, NULL);
+        /* Handle changes in the next main loop iteration */
+        if (flags & (ARIO_MPD_STATUS_EVENTS | MPD_IDLE_DATABASE | MPD_IDLE_STORED_PLAYLIST))
+                ario_mpd_idle_queue (flags & (ARIO_MPD_STATUS_EVENTS | MPD_IDLE_DATABASE | MPD_IDLE_STORED_PLAYLIST), 0);
 }
 
 static gboolean
@@ -349,8 +405,17 @@ ario_mpd_idle_read_cb (GIOChannel *iochan,
                        gpointer data)
 {
         ARIO_LOG_FUNCTION_START;
+        ario_server_interface_lock ();
+
+        /* Server thread left idle mode while we were waiting for the lock */
+        if (g_source_is_destroyed (g_main_current_source ())) {
+                ario_server_interface_unlock ();
+                return FALSE;
+        }
+
         if (!instance->priv->idle) {
                 instance->priv->source_id = 0;
+                ario_server_interface_unlock ();
                 return FALSE;
         }
 
@@ -362,6 +427,7 @@ ario_mpd_idle_read_cb (GIOChannel *iochan,
                 }
                 ario_mpd_idle_read ();
         }
+        ario_server_interface_unlock ();
 
         return TRUE;
 }
@@ -426,36 +492,63 @@ ario_mpd_idle_free (void)
         }
 }
 
-static gboolean
-ario_mpd_connect_to (ArioMpd *mpd,
-                     gchar *hostname,
-                     int port,
-                     guint timeout)
+static struct mpd_connection *
+ario_mpd_new_connection (void)
 {
         ARIO_LOG_FUNCTION_START;
+        gchar *hostname;
+        int port;
+        guint timeout;
         gchar *password;
+        ArioProfile *profile;
         struct mpd_connection *connection;
 
+        profile = ario_profiles_get_current (ario_profiles_get ());
+        hostname = profile->host;
+        port = profile->port;
+        timeout = profile->timeout;
+
+        if (hostname == NULL)
+                hostname = "localhost";
+
+        if (port == 0)
+                port = 6600;
+
         /* Connect to MPD */
         connection = mpd_connection_new (hostname, port, timeout);
         if (!connection)
-                return FALSE;
+                return NULL;
 
         /* Check connection errors */
         if  (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
                 ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (connection));
                 mpd_connection_clear_error (connection);
                 mpd_connection_free (connection);
-                return FALSE;
+                return NULL;
         }
 
         /* Send password if one is set in profile */
-        password = ario_profiles_get_current (ario_profiles_get ())->password;
+        password = profile->password;
         if (password) {
                 mpd_run_password (connection, password);
         }
 
+        return connection;
+}
+
+static gboolean
+ario_mpd_connect_to (ArioMpd *mpd)
+{
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
+
+        connection = ario_mpd_new_connection ();
+        if (!connection)
+                return FALSE;
+
         mpd->priv->connection = connection;
+        /* Connection of the server thread must be opened again */
+        g_atomic_int_inc (&mpd->priv->connection_serial);
 
         /* Check if idle is supported by MPD server */
         ario_mpd_check_idle (mpd);
@@ -486,23 +579,8 @@ static gpointer
 ario_mpd_connect_thread (ArioServer *server)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *hostname;
-        int port;
-        guint timeout;
-        ArioProfile *profile;
 
-        profile = ario_profiles_get_current (ario_profiles_get ());
-        hostname = profile->host;
-        port = profile->port;
-        timeout = profile->timeout;
-
-        if (hostname == NULL)
-                hostname = "localhost";
-
-        if (port == 0)
-                port = 6600;
-
-        if (!ario_mpd_connect_to (instance, hostname, port, timeout)) {
+        if (!ario_mpd_connect_to (instance)) {
                 ario_mpd_disconnect ();
         }
 
@@ -591,12 +669,19 @@ ario_mpd_disconnect (void)
 
         mpd_connection_free (instance->priv->connection);
         instance->priv->connection = NULL;
+        g_atomic_int_inc (&instance->priv->connection_serial);
 
         if (instance->priv->timeout_id) {
                 g_source_remove (instance->priv->timeout_id);
                 instance->priv->timeout_id = 0;
         }
 
+        if (instance->priv->idle_dispatch_id) {
+                g_source_remove (instance->priv->idle_dispatch_id);
+                instance->priv->idle_dispatch_id = 0;
+        }
+        instance->priv->idle_events = 0;
+
         ario_mpd_update_status ();
 }
 
@@ -630,6 +715,17 @@ ario_mpd_try_reconnect (gpointer data)
         return FALSE;
 }
 
+static gboolean
+ario_mpd_check_errors_idle (gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_interface_lock ();
+        ario_mpd_check_errors ();
+        ario_server_interface_unlock ();
+
+        return FALSE;
+}
+
 static gboolean
 ario_mpd_check_errors (void)
 {
@@ -639,6 +735,12 @@ ario_mpd_check_errors (void)
                 return FALSE;
 
         if  (mpd_connection_get_error (instance->priv->connection) != MPD_ERROR_SUCCESS) {
+                /* Error in server thread: disconnection is done in main loop */
+                if (!g_main_context_is_owner (NULL)) {
+                        g_idle_add ((GSourceFunc) ario_mpd_check_errors_idle, NULL);
+                        return TRUE;
+                }
+
                 ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (instance->priv->connection));
                 mpd_connection_clear_error (instance->priv->connection);
                 ario_server_disconnect ();
@@ -660,6 +762,74 @@ ario_mpd_is_connected (void)
         return (instance->priv->connection != NULL);
 }
 
+static gboolean
+ario_mpd_thread_connect (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        gint serial = g_atomic_int_get (&instance->priv->connection_serial);
+
+        /* Main connection has changed since the last call */
+        if (instance->priv->thread_connection
+            && instance->priv->thread_serial != serial) {
+                mpd_connection_free (instance->priv->thread_connection);
+                instance->priv->thread_connection = NULL;
+        }
+
+        /* Queries will see there is no connection */
+        if (!instance->priv->connection)
+                return TRUE;
+
+        if (!instance->priv->thread_connection) {
+                instance->priv->thread_connection = ario_mpd_new_connection ();
+                instance->priv->thread_serial = serial;
+        }
+
+        /* Share the main connection if a new one can't be opened */
+        return instance->priv->thread_connection != NULL;
+}
+
+/* Connection for the queries of the calling thread, NULL if there is
+ * no connection */
+static struct mpd_connection *
+ario_mpd_query_preinvoke (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (ario_server_interface_thread_connection ())
+                return instance->priv->connection ? instance->priv->thread_connection : NULL;
+
+        if (ario_mpd_command_preinvoke ())
+                return NULL;
+
+        return instance->priv->connection;
+}
+
+/* Must be called at the end of a query on connection, returns FALSE
+ * in case of error */
+static gboolean
+ario_mpd_query_postinvoke (struct mpd_connection *connection)
+{
+        ARIO_LOG_FUNCTION_START;
+        gboolean ret;
+
+        if (connection == instance->priv->thread_connection) {
+                if (mpd_connection_get_error (connection) == MPD_ERROR_SUCCESS)
+                        return TRUE;
+
+                /* Connection of the server thread is opened again by
+                 * the next call */
+                ARIO_LOG_ERROR ("%s", mpd_connection_get_error_message (connection));
+                mpd_connection_free (connection);
+                instance->priv->thread_connection = NULL;
+                return FALSE;
+        }
+
+        ret = !ario_mpd_check_errors ();
+
+        ario_mpd_command_postinvoke ();
+
+        return ret;
+}
+
 static ArioServerTag
 ario_mpd_filter_tag (const ArioServerTag tag)
 {
@@ -687,41 +857,44 @@ ario_mpd_list_tags (const ArioServerTag server_tag,
                     const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
         const GSList *tmp;
         GSList *values = NULL;
         ArioServerAtomicCriteria *atomic_criteria;
         struct mpd_pair *pair;
         ArioServerTag tag = ario_mpd_filter_tag(server_tag);
 
-        if (ario_mpd_command_preinvoke ())
+        connection = ario_mpd_query_preinvoke ();
+        if (!connection)
                 return NULL;
 
-        mpd_search_db_tags (instance->priv->connection, tag);
+        mpd_search_db_tags (connection, tag);
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (instance->priv->support_empty_tags
                     && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_search_add_tag_constraint (instance->priv->connection,
+                        mpd_search_add_tag_constraint (connection,
                                                        MPD_OPERATOR_DEFAULT,
                                                        ario_mpd_filter_tag (atomic_criteria->tag), "");
                 else
-                        mpd_search_add_tag_constraint (instance->priv->connection,
+                        mpd_search_add_tag_constraint (connection,
                                                        MPD_OPERATOR_DEFAULT,
                                                        ario_mpd_filter_tag (atomic_criteria->tag), atomic_criteria->value);
         }
-        mpd_search_commit (instance->priv->connection);
+        mpd_search_commit (connection);
 
-        while ((pair = mpd_recv_pair_tag (instance->priv->connection, tag))) {
+        while ((pair = mpd_recv_pair_tag (connection, tag))) {
                 if (*pair->value)
-                        values = g_slist_append (values, g_strdup(pair->value));
+                        values = g_slist_prepend (values, g_strdup(pair->value));
                 else {
-                        values = g_slist_append (values, g_strdup (ARIO_SERVER_UNKNOWN));
+                        values = g_slist_prepend (values, g_strdup (ARIO_SERVER_UNKNOWN));
                         instance->priv->support_empty_tags = TRUE;
                 }
-                mpd_return_pair (instance->priv->connection, pair);
+                mpd_return_pair (connection, pair);
         }
+        values = g_slist_reverse (values);
 
-        ario_mpd_command_postinvoke ();
+        ario_mpd_query_postinvoke (connection);
 
         return values;
 }
@@ -738,6 +911,7 @@ static GSList *
 ario_mpd_get_albums (const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
         GHashTable *albums;
         const GSList *tmp;
         GList *values;
@@ -746,34 +920,35 @@ ario_mpd_get_albums (const ArioServerCriteria *criteria)
         ArioServerAlbum *mpd_album;
         ArioServerAtomicCriteria *atomic_criteria;
 
-        if (ario_mpd_command_preinvoke ())
+        connection = ario_mpd_query_preinvoke ();
+        if (!connection)
                 return NULL;
 
         albums = g_hash_table_new (g_str_hash, g_str_equal);
 
         if (!criteria) {
-                mpd_send_list_all_meta (instance->priv->connection, "/");
+                mpd_send_list_all_meta (connection, "/");
         } else {
-                mpd_search_db_songs (instance->priv->connection, TRUE);
+                mpd_search_db_songs (connection, TRUE);
                 for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                         atomic_criteria = tmp->data;
 
                         if (instance->priv->support_empty_tags
                             && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                                mpd_search_add_tag_constraint (instance->priv->connection,
+                                mpd_search_add_tag_constraint (connection,
                                                                MPD_OPERATOR_DEFAULT,
                                                                ario_mpd_filter_tag (atomic_criteria->tag),
                                                                "");
                         else
-                                mpd_search_add_tag_constraint (instance->priv->connection,
+                                mpd_search_add_tag_constraint (connection,
                                                                MPD_OPERATOR_DEFAULT,
                                                                ario_mpd_filter_tag (atomic_criteria->tag),
                                                                atomic_criteria->value);
                 }
-                mpd_search_commit (instance->priv->connection);
+                mpd_search_commit (connection);
         }
 
-        while ((song = mpd_recv_song (instance->priv->connection))) {
+        while ((song = mpd_recv_song (connection))) {
                 const char *artist;
                 const char *album;
                 const char *file;
@@ -820,12 +995,12 @@ ario_mpd_get_albums (const ArioServerCriteria *criteria)
 
                 mpd_song_free (song);
         }
-        mpd_response_finish (instance->priv->connection);
+        mpd_response_finish (connection);
 
-        ario_mpd_command_postinvoke ();
+        ario_mpd_query_postinvoke (connection);
 
         for (values = g_hash_table_get_values (albums); values; values = g_list_next (values))
-                result = g_slist_append (result, values->data);
+                result = g_slist_prepend (result, values->data);
 
         /*
          * we don't need to free neither the keys nor the values since
@@ -900,13 +1075,15 @@ ario_mpd_get_songs (const ArioServerCriteria *criteria,
                     const gboolean exact)
 {
         ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
         GSList *songs = NULL;
         struct mpd_song *song;
         const GSList *tmp;
         gboolean is_album_unknown = FALSE;
         ArioServerAtomicCriteria *atomic_criteria;
 
-        if (ario_mpd_command_preinvoke ())
+        connection = ario_mpd_query_preinvoke ();
+        if (!connection)
                 return NULL;
 
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
@@ -916,39 +1093,40 @@ ario_mpd_get_songs (const ArioServerCriteria *criteria,
                         is_album_unknown = TRUE;
         }
 
-        mpd_search_db_songs (instance->priv->connection, exact);
+        mpd_search_db_songs (connection, exact);
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (atomic_criteria->tag == ARIO_TAG_ANY)
-                        mpd_search_add_any_tag_constraint (instance->priv->connection,
+                        mpd_search_add_any_tag_constraint (connection,
                                                            MPD_OPERATOR_DEFAULT,
                                                            atomic_criteria->value);
                 else if (instance->priv->support_empty_tags
                          && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_search_add_tag_constraint (instance->priv->connection,
+                        mpd_search_add_tag_constraint (connection,
                                                        MPD_OPERATOR_DEFAULT,
                                                        ario_mpd_filter_tag (atomic_criteria->tag),
                                                        "");
                 else if (atomic_criteria->tag != ARIO_TAG_ALBUM
                          || g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_search_add_tag_constraint (instance->priv->connection,
+                        mpd_search_add_tag_constraint (connection,
                                                        MPD_OPERATOR_DEFAULT,
                                                        ario_mpd_filter_tag (atomic_criteria->tag),
                                                        atomic_criteria->value);
         }
-        mpd_search_commit (instance->priv->connection);
+        mpd_search_commit (connection);
 
-        while ((song = mpd_recv_song (instance->priv->connection))) {
+        while ((song = mpd_recv_song (connection))) {
                 if (instance->priv->support_empty_tags
                     || !is_album_unknown
                     || !mpd_song_get_tag (song, MPD_TAG_ALBUM, 0)) {
-                        songs = g_slist_append (songs, ario_mpd_build_ario_song (song));
+                        songs = g_slist_prepend (songs, ario_mpd_build_ario_song (song));
                 }
                 mpd_song_free (song);
         }
-        mpd_response_finish (instance->priv->connection);
+        mpd_response_finish (connection);
+        songs = g_slist_reverse (songs);
 
-        ario_mpd_command_postinvoke ();
+        ario_mpd_query_postinvoke (connection);
 
         return songs;
 }
@@ -965,10 +1143,11 @@ ario_mpd_get_songs_from_playlist (char *playlist)
 
         mpd_send_list_playlist_meta (instance->priv->connection, playlist);
         while ((song = mpd_recv_song (instance->priv->connection))) {
-                songs = g_slist_append (songs, ario_mpd_build_ario_song (song));
+                songs = g_slist_prepend (songs, ario_mpd_build_ario_song (song));
                 mpd_song_free (song);
         }
         mpd_response_finish (instance->priv->connection);
+        songs = g_slist_reverse (songs);
 
         ario_mpd_command_postinvoke ();
 
@@ -990,11 +1169,12 @@ ario_mpd_get_playlists (void)
         while ((ent = mpd_recv_entity (instance->priv->connection))) {
                 if (mpd_entity_get_type (ent) == MPD_ENTITY_TYPE_PLAYLIST) {
                         const struct mpd_playlist * playlist = mpd_entity_get_playlist (ent);
-                        playlists = g_slist_append (playlists, g_strdup (mpd_playlist_get_path (playlist)));
+                        playlists = g_slist_prepend (playlists, g_strdup (mpd_playlist_get_path (playlist)));
                 }
                 mpd_entity_free (ent);
         }
         mpd_response_finish (instance->priv->connection);
+        playlists = g_slist_reverse (playlists);
 
         ario_mpd_command_postinvoke ();
 
@@ -1013,10 +1193,11 @@ ario_mpd_get_playlist_changes (gint64 playlist_id)
 
         mpd_send_queue_changes_meta (instance->priv->connection, (unsigned) playlist_id);
         while ((song = mpd_recv_song (instance->priv->connection))) {
-                songs = g_slist_append (songs, ario_mpd_build_ario_song (song));
+                songs = g_slist_prepend (songs, ario_mpd_build_ario_song (song));
                 mpd_song_free (song);
         }
         mpd_response_finish (instance->priv->connection);
+        songs = g_slist_reverse (songs);
 
         ario_mpd_command_postinvoke ();
 
@@ -1025,11 +1206,24 @@ ario_mpd_get_playlist_changes (gint64 playlist_id)
 
 static gboolean
 ario_mpd_update_status (void)
+{
+        return ario_mpd_update_status_events (ARIO_MPD_STATUS_EVENTS);
+}
+
+static gboolean
+ario_mpd_update_status_events (const enum mpd_idle events)
 {
         // desactivated to make the logs more readable
         //ARIO_LOG_FUNCTION_START;
         if (instance->priv->is_updating)
                 return !instance->priv->support_idle;
+
+        /* The server thread is using the connection: try again later */
+        if (!ario_server_interface_trylock ()) {
+                if (instance->priv->support_idle)
+                        ario_mpd_idle_queue (events, NORMAL_TIMEOUT);
+                return !instance->priv->support_idle;
+        }
         instance->priv->is_updating = TRUE;
 
         /* check if there is a connection */
@@ -1045,44 +1239,55 @@ ario_mpd_update_status (void)
                 if (ario_mpd_check_errors ()) {
                         ario_server_interface_set_default (ARIO_SERVER_INTERFACE (instance));
                 } else if (instance->priv->status) {
-                        if (instance->parent.song_id != mpd_status_get_song_id (instance->priv->status)
-                            || instance->parent.playlist_id != (gint64) mpd_status_get_queue_version (instance->priv->status))
+                        /* Only the attributes related to the events are updated */
+                        if (events & (MPD_IDLE_PLAYER | MPD_IDLE_QUEUE)
+                            && (instance->parent.song_id != mpd_status_get_song_id (instance->priv->status)
+                                || instance->parent.playlist_id != (gint64) mpd_status_get_queue_version (instance->priv->status)))
                                 g_object_set (G_OBJECT (instance), "song_id", mpd_status_get_song_id (instance->priv->status), NULL);
 
-                        if (instance->parent.state != mpd_status_get_state (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "state", mpd_status_get_state (instance->priv->status), NULL);
+                        if (events & MPD_IDLE_PLAYER) {
+                                if (instance->parent.state != mpd_status_get_state (instance->priv->status))
+                                        g_object_set (G_OBJECT (instance), "state", mpd_status_get_state (instance->priv->status), NULL);
 
-                        if (instance->parent.volume != mpd_status_get_volume (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "volume", mpd_status_get_volume (instance->priv->status), NULL);
-
-                        if (instance->parent.elapsed != mpd_status_get_elapsed_time (instance->priv->status)) {
-                                g_object_set (G_OBJECT (instance), "elapsed", mpd_status_get_elapsed_time (instance->priv->status), NULL);
-                                instance->priv->elapsed = mpd_status_get_elapsed_time (instance->priv->status);
+                                if (instance->parent.elapsed != mpd_status_get_elapsed_time (instance->priv->status)) {
+                                        g_object_set (G_OBJECT (instance), "elapsed", mpd_status_get_elapsed_time (instance->priv->status), NULL);
+                                        instance->priv->elapsed = mpd_status_get_elapsed_time (instance->priv->status);
+                                }
                         }
 
-                        if (instance->parent.playlist_id != (gint64) mpd_status_get_queue_version (instance->priv->status)) {
+                        if (events & MPD_IDLE_MIXER
+                            && instance->parent.volume != mpd_status_get_volume (instance->priv->status))
+                                g_object_set (G_OBJECT (instance), "volume", mpd_status_get_volume (instance->priv->status), NULL);
+
+                        if (events & MPD_IDLE_QUEUE
+                            && instance->parent.playlist_id != (gint64) mpd_status_get_queue_version (instance->priv->status)) {
                                 g_object_set (G_OBJECT (instance), "playlist_id", (gint64) mpd_status_get_queue_version (instance->priv->status), NULL);
                                 instance->parent.playlist_length = mpd_status_get_queue_length (instance->priv->status);
                         }
 
-                        if (instance->parent.consume != mpd_status_get_consume (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "consume", mpd_status_get_consume (instance->priv->status), NULL);
+                        if (events & MPD_IDLE_OPTIONS) {
+                                if (instance->parent.consume != mpd_status_get_consume (instance->priv->status))
+                                        g_object_set (G_OBJECT (instance), "consume", mpd_status_get_consume (instance->priv->status), NULL);
 
-                        if (instance->parent.random != mpd_status_get_random (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "random", mpd_status_get_random (instance->priv->status), NULL);
+                                if (instance->parent.random != mpd_status_get_random (instance->priv->status))
+                                        g_object_set (G_OBJECT (instance), "random", mpd_status_get_random (instance->priv->status), NULL);
 
-                        if (instance->parent.repeat != mpd_status_get_repeat (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "repeat", mpd_status_get_repeat (instance->priv->status), NULL);
+                                if (instance->parent.repeat != mpd_status_get_repeat (instance->priv->status))
+                                        g_object_set (G_OBJECT (instance), "repeat", mpd_status_get_repeat (instance->priv->status), NULL);
+                                instance->parent.crossfade = mpd_status_get_crossfade (instance->priv->status);
+                        }
 
-                        if (instance->parent.updatingdb != mpd_status_get_update_id (instance->priv->status))
+                        if (events & MPD_IDLE_UPDATE
+                            && instance->parent.updatingdb != mpd_status_get_update_id (instance->priv->status))
                                 g_object_set (G_OBJECT (instance), "updatingdb", mpd_status_get_update_id (instance->priv->status), NULL);
-                        instance->parent.crossfade = mpd_status_get_crossfade (instance->priv->status);
                 }
         }
         ario_server_interface_emit (ARIO_SERVER_INTERFACE (instance), server_instance);
 
         instance->priv->is_updating = FALSE;
 
+        ario_server_interface_unlock ();
+
         return !instance->priv->support_idle;
 }
 
@@ -1117,7 +1322,7 @@ ario_mpd_get_current_playlist_total_time (void)
         if (!instance->priv->connection)
                 return 0;
 
-        /* Compute it from playlist widget (quite coslty but not often called) */
+        /* Sum maintained by the playlist widget from playlist changes */
         return ario_playlist_get_total_time ();
 }
 
@@ -1125,13 +1330,24 @@ static unsigned long
 ario_mpd_get_last_update (void)
 {
         ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
+        struct mpd_stats *stats;
+        unsigned long ret = 0;
 
-        ario_mpd_get_stats ();
-
-        if (instance->priv->stats)
-                return instance->priv->stats->dbUpdateTime;
-        else
+        connection = ario_mpd_query_preinvoke ();
+        if (!connection)
                 return 0;
+
+        /* Stats of ario_mpd_get_stats belong to the main loop */
+        stats = mpd_run_stats (connection);
+        if (stats) {
+                ret = mpd_stats_get_db_update_time (stats);
+                mpd_stats_free (stats);
+        }
+
+        ario_mpd_query_postinvoke (connection);
+
+        return ret;
 }
 
 static void
@@ -1306,6 +1522,18 @@ ario_mpd_shuffle (void)
         ario_mpd_update_status ();
 }
 
+static gboolean
+ario_mpd_support_ranges (void)
+{
+#ifdef ARIO_MPD_RANGES
+        const unsigned *version = mpd_connection_get_server_version (instance->priv->connection);
+
+        return version[0] > 0 || version[1] >= 15;
+#else
+        return FALSE;
+#endif
+}
+
 static void
 ario_mpd_queue_commit (void)
 {
@@ -1316,6 +1544,10 @@ ario_mpd_queue_commit (void)
         if (ario_mpd_command_preinvoke ())
                 return;
 
+        /* Ranges are only supported since MPD 0.15 and libmpdclient 2.3 */
+        if (!ario_mpd_support_ranges ())
+                ario_server_queue_expand_ranges ();
+
         mpd_command_list_begin (instance->priv->connection, FALSE);
 
         for (temp = instance->parent.queue; temp; temp = g_slist_next (temp)) {
@@ -1340,6 +1572,12 @@ ario_mpd_queue_commit (void)
                         if (queue_action->id >= 0) {
                                 mpd_send_move_id (instance->priv->connection, queue_action->old_pos, queue_action->new_pos);
                         }
+#ifdef ARIO_MPD_RANGES
+                } else if (queue_action->type == ARIO_SERVER_ACTION_DELETE_RANGE) {
+                        mpd_send_delete_range (instance->priv->connection, queue_action->start, queue_action->end);
+                } else if (queue_action->type == ARIO_SERVER_ACTION_MOVE_RANGE) {
+                        mpd_send_move_range (instance->priv->connection, queue_action->start, queue_action->end, queue_action->to);
+#endif
                 }
         }
         mpd_command_list_end (instance->priv->connection);
@@ -1426,9 +1664,10 @@ ario_mpd_get_outputs (void)
         mpd_send_outputs (instance->priv->connection);
 
         while ((output_ent = mpd_recv_output (instance->priv->connection))) {
-                outputs = g_slist_append (outputs, ario_mpd_build_ario_output (output_ent));
+                outputs = g_slist_prepend (outputs, ario_mpd_build_ario_output (output_ent));
                 mpd_output_free (output_ent);
         }
+        outputs = g_slist_reverse (outputs);
 
         mpd_response_finish (instance->priv->connection);
 
@@ -1483,30 +1722,47 @@ static GList *
 ario_mpd_get_songs_info (GSList *paths)
 {
         ARIO_LOG_FUNCTION_START;
-        const gchar *path = NULL;
-        GSList *temp;
+        GSList *temp, *chunk;
         GList *songs = NULL;
         struct mpd_song *song;
+        int i, n;
 
         if (ario_mpd_command_preinvoke ())
                 return NULL;
 
-        for (temp = paths; temp; temp = g_slist_next (temp)) {
-                path = temp->data;
-
-                mpd_send_list_all_meta (instance->priv->connection, path);
-
-                song = mpd_recv_song (instance->priv->connection);
-
+        temp = paths;
+        while (temp && instance->priv->connection) {
+                /* Send lookups of a chunk of paths at once */
+                mpd_command_list_begin (instance->priv->connection, TRUE);
+                for (chunk = temp, n = 0; chunk && n < SONGS_INFO_CHUNK; chunk = g_slist_next (chunk), ++n)
+                        mpd_send_list_all_meta (instance->priv->connection, chunk->data);
+                mpd_command_list_end (instance->priv->connection);
+
+                /* Read results: each one ends with a list_OK */
+                for (i = 0; i < n; ++i) {
+                        song = mpd_recv_song (instance->priv->connection);
+                        if (song) {
+                                songs = g_list_prepend (songs, ario_mpd_build_ario_song (song));
+                                mpd_song_free (song);
+                        }
+                        if (mpd_connection_get_error (instance->priv->connection) != MPD_ERROR_SUCCESS)
+                                break;
+                        temp = g_slist_next (temp);
+                        mpd_response_next (instance->priv->connection);
+                }
                 mpd_response_finish (instance->priv->connection);
-                if (!song)
-                        continue;
 
-                songs = g_list_append (songs, ario_mpd_build_ario_song (song));
-                mpd_song_free (song);
-
-                ario_mpd_check_errors ();
+                if (mpd_connection_get_error (instance->priv->connection) == MPD_ERROR_SERVER) {
+                        /* MPD stops the list at the first unknown path: skip
+                         * it and send the remaining paths again */
+                        ARIO_LOG_ERROR ("%s", mpd_connection_get_error_message (instance->priv->connection));
+                        mpd_connection_clear_error (instance->priv->connection);
+                        temp = g_slist_next (temp);
+                } else if (ario_mpd_check_errors ()) {
+                        break;
+                }
         }
+        songs = g_list_reverse (songs);
 
         ario_mpd_command_postinvoke ();
 
@@ -1518,35 +1774,80 @@ ario_mpd_list_files (const char *path,
                      gboolean recursive)
 {
         ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
         struct mpd_entity *entity;
         ArioServerFileList *files = (ArioServerFileList *) g_malloc0 (sizeof (ArioServerFileList));
 
-        if (ario_mpd_command_preinvoke ())
+        connection = ario_mpd_query_preinvoke ();
+        if (!connection)
                 return files;
 
         if (recursive)
-                mpd_send_list_all_meta (instance->priv->connection, path);
+                mpd_send_list_all_meta (connection, path);
         else
-                mpd_send_list_meta (instance->priv->connection, path);
+                mpd_send_list_meta (connection, path);
 
-        while ((entity = mpd_recv_entity (instance->priv->connection))) {
+        while ((entity = mpd_recv_entity (connection))) {
                 enum mpd_entity_type type = mpd_entity_get_type (entity);
                 if (type == MPD_ENTITY_TYPE_DIRECTORY) {
                         const struct mpd_directory * directory = mpd_entity_get_directory (entity);
-                        files->directories = g_slist_append (files->directories, g_strdup (mpd_directory_get_path (directory)));
+                        files->directories = g_slist_prepend (files->directories, g_strdup (mpd_directory_get_path (directory)));
                 } else if (type == MPD_ENTITY_TYPE_SONG) {
                         const struct mpd_song * song = mpd_entity_get_song (entity);
-                        files->songs = g_slist_append (files->songs, ario_mpd_build_ario_song (song));
+                        files->songs = g_slist_prepend (files->songs, ario_mpd_build_ario_song (song));
                 }
 
                 mpd_entity_free(entity);
         }
+        files->directories = g_slist_reverse (files->directories);
+        files->songs = g_slist_reverse (files->songs);
 
-        ario_mpd_command_postinvoke ();
+        ario_mpd_query_postinvoke (connection);
 
         return files;
 }
 
+static gboolean
+ario_mpd_foreach_song (ArioServerSongFunc func,
+                       gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
+        struct mpd_song *song;
+        ArioServerSong ario_song;
+
+        connection = ario_mpd_query_preinvoke ();
+        if (!connection)
+                return FALSE;
+
+        mpd_send_list_all_meta (connection, "/");
+        while ((song = mpd_recv_song (connection))) {
+                /* Strings are not copied: song only lives during the call of func */
+                ario_song.file = (char *) mpd_song_get_uri (song);
+                ario_song.artist = (char *) mpd_song_get_tag (song, MPD_TAG_ARTIST, 0);
+                ario_song.title = (char *) mpd_song_get_tag (song, MPD_TAG_TITLE, 0);
+                ario_song.album = (char *) mpd_song_get_tag (song, MPD_TAG_ALBUM, 0);
+                ario_song.album_artist  = (char *) mpd_song_get_tag (song, MPD_TAG_ALBUM_ARTIST, 0);
+                ario_song.track = (char *) mpd_song_get_tag (song, MPD_TAG_TRACK, 0);
+                ario_song.name = (char *) mpd_song_get_tag (song, MPD_TAG_NAME, 0);
+                ario_song.date = (char *) mpd_song_get_tag (song, MPD_TAG_DATE, 0);
+                ario_song.genre = (char *) mpd_song_get_tag (song, MPD_TAG_GENRE, 0);
+                ario_song.composer = (char *) mpd_song_get_tag (song, MPD_TAG_COMPOSER, 0);
+                ario_song.performer = (char *) mpd_song_get_tag (song, MPD_TAG_PERFORMER, 0);
+                ario_song.disc = (char *) mpd_song_get_tag (song, MPD_TAG_DISC, 0);
+                ario_song.comment = (char *) mpd_song_get_tag (song, MPD_TAG_COMMENT, 0);
+                ario_song.time = mpd_song_get_duration (song);
+                ario_song.pos = mpd_song_get_pos (song);
+                ario_song.id = mpd_song_get_id (song);
+
+                func (&ario_song, data);
+                mpd_song_free (song);
+        }
+        mpd_response_finish (connection);
+
+        return ario_mpd_query_postinvoke (connection);
+}
+
 static gboolean
 ario_mpd_command_preinvoke (void)
 {
@@ -48,6 +48,29 @@ enum
         PROP_REPEAT
 };
 
+/* Asynchronous call waiting for the server thread */
+typedef struct
+{
+        ArioServerAsyncFunc func;
+        gpointer data;
+        GDestroyNotify data_destroy;
+        gpointer result;
+        GDestroyNotify result_destroy;
+        GCancellable *cancellable;
+} ArioServerAsyncCall;
+
+/* Serialize the accesses to the server connection between the main
+ * loop and the server thread */
+static GStaticRecMutex server_lock = G_STATIC_REC_MUTEX_INIT;
+
+/* Set in the server thread while it uses its own connection: it
+ * doesn't need server_lock then */
+static GStaticPrivate thread_connection = G_STATIC_PRIVATE_INIT;
+
+/* Queue of GSimpleAsyncResult waiting for the server thread */
+static GAsyncQueue *async_queue = NULL;
+static GStaticMutex async_queue_lock = G_STATIC_MUTEX_INIT;
+
 G_DEFINE_TYPE (ArioServerInterface, ario_server_interface, G_TYPE_OBJECT)
 
         /* Dummy methods for default behavior */
@@ -128,6 +151,13 @@ dummy_pointer_int (gint64 playlist_id)
         return NULL;
 }
 
+static int
+dummy_int_pointer_pointer (const gpointer *a,
+                           const gpointer *b)
+{
+        return 0;
+}
+
 static void
 ario_server_interface_class_init (ArioServerInterfaceClass *klass)
 {
@@ -177,6 +207,8 @@ ario_server_interface_class_init (ArioServerInterfaceClass *klass)
         klass->get_stats = (ArioServerStats* (*) (void)) dummy_pointer_void;
         klass->get_songs_info = (GList* (*) (GSList *)) dummy_pointer_pointer;
         klass->list_files = (ArioServerFileList* (*) (const char *, const int)) dummy_pointer_pointer_int;
+        klass->foreach_song = (gboolean (*) (ArioServerSongFunc, gpointer)) dummy_int_pointer_pointer;
+        klass->thread_connect = dummy_int_void;
 
         /* Object properties */
         g_object_class_install_property (object_class,
@@ -504,3 +536,142 @@ ario_server_interface_emit (ArioServerInterface *server_interface,
                 g_signal_emit_by_name (G_OBJECT (server), "updatingdb_changed");
         server_interface->signals_to_emit = 0;
 }
+
+void
+ario_server_interface_lock (void)
+{
+        if (ario_server_interface_thread_connection ())
+                return;
+        g_static_rec_mutex_lock (&server_lock);
+}
+
+gboolean
+ario_server_interface_trylock (void)
+{
+        if (ario_server_interface_thread_connection ())
+                return TRUE;
+        return g_static_rec_mutex_trylock (&server_lock);
+}
+
+void
+ario_server_interface_unlock (void)
+{
+        if (ario_server_interface_thread_connection ())
+                return;
+        g_static_rec_mutex_unlock (&server_lock);
+}
+
+gboolean
+ario_server_interface_thread_connection (void)
+{
+        return g_static_private_get (&thread_connection) != NULL;
+}
+
+static void
+ario_server_interface_async_call_free (ArioServerAsyncCall *call)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (call->data_destroy)
+                call->data_destroy (call->data);
+        if (call->result && call->result_destroy)
+                call->result_destroy (call->result);
+        if (call->cancellable)
+                g_object_unref (call->cancellable);
+        g_free (call);
+}
+
+static gpointer
+ario_server_interface_async_thread (gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSimpleAsyncResult *simple;
+        ArioServerAsyncCall *call;
+
+        /* The thread lives as long as the application and runs
+         * calls one after the other in the order they were made */
+        while ((simple = g_async_queue_pop (async_queue))) {
+                call = g_simple_async_result_get_op_res_gpointer (simple);
+
+                /* Nobody waits for the result anymore */
+                if (!g_cancellable_is_cancelled (call->cancellable)) {
+                        /* With its own connection, the server thread
+                         * doesn't make the main loop wait */
+                        g_static_private_set (&thread_connection,
+                                              GINT_TO_POINTER (ario_server_thread_connect ()),
+                                              NULL);
+                        ario_server_interface_lock ();
+                        call->result = call->func (call->data);
+                        ario_server_interface_unlock ();
+                }
+
+                /* Callback is called in the main loop */
+                g_simple_async_result_complete_in_idle (simple);
+                g_object_unref (simple);
+        }
+
+        return NULL;
+}
+
+void
+ario_server_interface_call_async (GObject *source_object,
+                                  ArioServerAsyncFunc func,
+                                  gpointer data,
+                                  GDestroyNotify data_destroy,
+                                  GDestroyNotify result_destroy,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSimpleAsyncResult *simple;
+        ArioServerAsyncCall *call;
+
+        call = (ArioServerAsyncCall *) g_malloc0 (sizeof (ArioServerAsyncCall));
+        call->func = func;
+        call->data = data;
+        call->data_destroy = data_destroy;
+        call->result_destroy = result_destroy;
+        if (cancellable)
+                call->cancellable = g_object_ref (cancellable);
+
+        simple = g_simple_async_result_new (source_object, callback, user_data,
+                                            ario_server_interface_call_async);
+        g_simple_async_result_set_op_res_gpointer (simple, call,
+                                                   (GDestroyNotify) ario_server_interface_async_call_free);
+
+        /* Launch server thread on first asynchronous call, calls can be
+         * made from other threads than the main loop */
+        g_static_mutex_lock (&async_queue_lock);
+        if (!async_queue) {
+                async_queue = g_async_queue_new ();
+                g_thread_create ((GThreadFunc) ario_server_interface_async_thread,
+                                 NULL, FALSE, NULL);
+        }
+        g_static_mutex_unlock (&async_queue_lock);
+
+        g_async_queue_push (async_queue, simple);
+}
+
+gpointer
+ario_server_interface_call_finish (GAsyncResult *result,
+                                   GError **error)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerAsyncCall *call;
+        gpointer ret;
+
+        g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (result), NULL);
+        g_return_val_if_fail (g_simple_async_result_get_source_tag (G_SIMPLE_ASYNC_RESULT (result)) == ario_server_interface_call_async, NULL);
+
+        call = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+
+        /* Selection changed since the call was made: result is dropped */
+        if (g_cancellable_set_error_if_cancelled (call->cancellable, error))
+                return NULL;
+
+        /* Caller becomes owner of the result */
+        ret = call->result;
+        call->result = NULL;
+
+        return ret;
+}
@@ -21,6 +21,7 @@
 #define __ARIO_SERVER_INTERFACE_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 #include "ario-server.h"
 
 G_BEGIN_DECLS
@@ -52,6 +53,7 @@ typedef struct
         guint updatingdb;
         int crossfade;
 
+        /* Queued actions, most recent first until ario_server_queue_commit */
         GSList *queue;
 
         gboolean connecting;
@@ -125,18 +127,60 @@ typedef struct
                                                                        const gboolean enabled);
         ArioServerStats *      (*get_stats)                           (void);
 
+        /* Songs at paths: lookups are sent in batches instead of
+         * waiting for the answer of each path */
         GList *             (*get_songs_info)                         (GSList *paths);
 
         ArioServerFileList*    (*list_files)                          (const char *path,
                                                                        const gboolean recursive);
+
+        /* Calls func for every song of the database, returns FALSE if not supported */
+        gboolean            (*foreach_song)                           (ArioServerSongFunc func,
+                                                                       gpointer data);
+
+        /* Called in the server thread before each asynchronous call.
+         * Returns TRUE if the server thread has its own connection for
+         * the queries (list_tags, get_albums, get_songs, list_files,
+         * foreach_song and get_last_update), FALSE if it shares the
+         * connection of the main loop */
+        gboolean            (*thread_connect)                         (void);
 } ArioServerInterfaceClass;
 
+/**
+ * Function run in the server thread for an asynchronous call.
+ * It receives the data given to ario_server_interface_call_async
+ * and returns the result passed to the callback.
+ */
+typedef gpointer        (*ArioServerAsyncFunc)                        (gpointer data);
+
 GType                   ario_server_interface_get_type                (void) G_GNUC_CONST;
 
 void                    ario_server_interface_set_default             (ArioServerInterface *server_interface);
 
 void                    ario_server_interface_emit                    (ArioServerInterface *server_interface,
                                                                        ArioServer *server);
+
+void                    ario_server_interface_lock                    (void);
+
+gboolean                ario_server_interface_trylock                 (void);
+
+void                    ario_server_interface_unlock                  (void);
+
+/* TRUE in the server thread when it uses its own connection: the
+ * lock functions above do nothing then */
+gboolean                ario_server_interface_thread_connection       (void);
+
+void                    ario_server_interface_call_async              (GObject *source_object,
+                                                                       ArioServerAsyncFunc func,
+                                                                       gpointer data,
+                                                                       GDestroyNotify data_destroy,
+                                                                       GDestroyNotify result_destroy,
+                                                                       GCancellable *cancellable,
+                                                                       GAsyncReadyCallback callback,
+                                                                       gpointer user_data);
+
+gpointer                ario_server_interface_call_finish             (GAsyncResult *result,
+                                                                       GError **error);
 G_END_DECLS
 
 #endif /* __ARIO_SERVER_INTERFACE_H */
@@ -27,6 +27,7 @@
 #include <glib/gi18n.h>
 #include "lib/ario-conf.h"
 #include "servers/ario-mpd.h"
+#include "servers/ario-index.h"
 #include "ario-util.h"
 #ifdef ENABLE_XMMS2
 #include "servers/ario-xmms.h"
@@ -63,12 +64,47 @@ G_DEFINE_TYPE (ArioServer, ario_server, G_TYPE_OBJECT)
         static ArioServer *instance = NULL;
         static ArioServerInterface *interface = NULL;
 
+/* In memory copy of the library used to answer browsing queries */
+static ArioIndex *library_index = NULL;
+/* FALSE when the database may have changed since the index was checked */
+static gboolean library_index_checked = FALSE;
+/* Id of the last index build asked to the server thread */
+static guint library_index_build = 0;
+/* The index is used by the main loop and by the server thread, which
+ * doesn't always hold the server lock */
+static GStaticMutex library_index_lock = G_STATIC_MUTEX_INIT;
+
+static ArioIndex *ario_server_lock_index (void);
+static void ario_server_unlock_index (void);
+
+static void
+ario_server_library_changed (ArioServer *server)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Index will be checked against last update time on next query */
+        g_static_mutex_lock (&library_index_lock);
+        library_index_checked = FALSE;
+        g_static_mutex_unlock (&library_index_lock);
+
+        /* Start to build it now if needed, unless the connection is
+         * busy: the next query will do it */
+        if (ario_server_interface_trylock ()) {
+                ario_server_lock_index ();
+                ario_server_unlock_index ();
+                ario_server_interface_unlock ();
+        }
+}
+
 static void
 ario_server_class_init (ArioServerClass *klass)
 {
         ARIO_LOG_FUNCTION_START;
         GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
+        /* Signals default handlers */
+        klass->connectivity_changed = ario_server_library_changed;
+        klass->updatingdb_changed = ario_server_library_changed;
+
         /* Object Signals */
         ario_server_signals[SERVER_SONG_CHANGED] =
                 g_signal_new ("song_changed",
@@ -278,7 +314,9 @@ ario_server_disconnect (void)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->disconnect ();
+        ario_server_interface_unlock ();
         g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_CONNECTIVITY_CHANGED], 0);
 }
 
@@ -302,7 +340,9 @@ ario_server_update_db (const gchar *path)
 {
         ARIO_LOG_FUNCTION_START;
         interface->updatingdb = 1;
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->update_db (path);
+        ario_server_interface_unlock ();
 }
 
 gboolean
@@ -315,21 +355,252 @@ ario_server_is_connected (void)
         return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->is_connected ();
 }
 
+gboolean
+ario_server_thread_connect (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Call virtual method */
+        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->thread_connect ();
+}
+
+/* Snapshot of the library index for the current profile */
+static gchar *
+ario_server_get_index_filename (void)
+{
+        ArioProfile *profile;
+        gchar *host;
+        gchar *name;
+        gchar *ret;
+
+        profile = ario_profiles_get_current (ario_profiles_get ());
+        if (!profile || !profile->host)
+                return NULL;
+
+        host = g_strdelimit (g_strdup (profile->host), G_DIR_SEPARATOR_S ":", '_');
+        name = g_strdup_printf ("%s-%d.db", host, profile->port);
+        ret = g_build_filename (ario_util_config_dir (), "library", name, NULL);
+        g_free (name);
+        g_free (host);
+
+        return ret;
+}
+
+/* Arguments of an index build, owned by the server thread */
+typedef struct
+{
+        guint id;
+        unsigned long last_update;
+        gchar *filename;
+} ArioServerIndexBuild;
+
+static void
+ario_server_index_build_free (ArioServerIndexBuild *build)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_free (build->filename);
+        g_free (build);
+}
+
+static gboolean
+ario_server_index_build_is_current (ArioServerIndexBuild *build)
+{
+        gboolean ret;
+
+        g_static_mutex_lock (&library_index_lock);
+        ret = (build->id == library_index_build);
+        g_static_mutex_unlock (&library_index_lock);
+
+        return ret;
+}
+
+/* Called in the server thread with the server lock held (unless it has
+ * its own connection): only the listing of the songs needs the
+ * connection, the lock is released for the rest of the build */
+static gpointer
+ario_server_build_index_thread (ArioServerIndexBuild *build)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioIndex *index = NULL;
+        gchar *dir;
+        gboolean supported;
+
+        /* Database has changed again since this build was asked */
+        if (!ario_server_index_build_is_current (build)
+            || !ario_server_is_connected ())
+                return NULL;
+
+        ario_server_interface_unlock ();
+
+        /* Use the snapshot saved by a previous session if the database
+         * has not changed since */
+        if (build->filename) {
+                index = ario_index_load (build->filename);
+                if (index
+                    && ario_index_get_last_update (index) != build->last_update) {
+                        ario_index_free (index);
+                        index = NULL;
+                }
+        }
+
+        if (!index) {
+                /* Build a new index with every song of the database */
+                index = ario_index_new (build->last_update);
+                ario_server_interface_lock ();
+                supported = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->foreach_song ((ArioServerSongFunc) ario_index_add_song,
+                                                                                       index);
+                ario_server_interface_unlock ();
+
+                if (!supported) {
+                        /* Not supported by server: queries are sent to server */
+                        ario_index_free (index);
+                        index = NULL;
+                } else if (build->filename) {
+                        dir = g_path_get_dirname (build->filename);
+                        ario_util_mkdir (dir);
+                        g_free (dir);
+                        ario_index_save (index, build->filename);
+                }
+        }
+
+        /* Searches don't have to wait for the word index */
+        if (index)
+                ario_index_build_words (index);
+
+        ario_server_interface_lock ();
+
+        return index;
+}
+
+static void
+ario_server_build_index_cb (GObject *source_object,
+                            GAsyncResult *result,
+                            ArioServerIndexBuild *build)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioIndex *index;
+
+        index = ario_server_interface_call_finish (result, NULL);
+        if (!index)
+                return;
+
+        /* Swap in the new index, unless a newer one is being built */
+        g_static_mutex_lock (&library_index_lock);
+        if (build->id == library_index_build) {
+                ario_index_free (library_index);
+                library_index = index;
+        } else {
+                ario_index_free (index);
+        }
+        g_static_mutex_unlock (&library_index_lock);
+}
+
+/* Must be called with library_index_lock held */
+static void
+ario_server_build_index (unsigned long last_update)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerIndexBuild *build;
+
+        ario_index_free (library_index);
+        library_index = NULL;
+
+        /* Build the index in the server thread, previous builds are
+         * dropped */
+        build = (ArioServerIndexBuild *) g_malloc0 (sizeof (ArioServerIndexBuild));
+        build->id = ++library_index_build;
+        build->last_update = last_update;
+        build->filename = ario_server_get_index_filename ();
+
+        /* The build is also the data of the callback: it is freed
+         * with the call */
+        ario_server_interface_call_async (G_OBJECT (instance),
+                                          (ArioServerAsyncFunc) ario_server_build_index_thread,
+                                          build,
+                                          (GDestroyNotify) ario_server_index_build_free,
+                                          (GDestroyNotify) ario_index_free,
+                                          NULL,
+                                          (GAsyncReadyCallback) ario_server_build_index_cb,
+                                          build);
+}
+
+/* Must be called with the server lock held. Returns with
+ * library_index_lock held, ario_server_unlock_index must be called
+ * once the index is not used anymore. NULL is returned while the index
+ * is built by the server thread: queries are then sent to server */
+static ArioIndex *
+ario_server_lock_index (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        unsigned long last_update;
+
+        g_static_mutex_lock (&library_index_lock);
+        if (!ario_server_is_connected ())
+                return NULL;
+
+        if (library_index_checked)
+                return library_index;
+        library_index_checked = TRUE;
+        g_static_mutex_unlock (&library_index_lock);
+
+        /* Other threads can use the index during the request */
+        last_update = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_last_update ();
+
+        /* Database has changed: build a new index */
+        g_static_mutex_lock (&library_index_lock);
+        if (!library_index
+            || ario_index_get_last_update (library_index) != last_update)
+                ario_server_build_index (last_update);
+
+        return library_index;
+}
+
+static void
+ario_server_unlock_index (void)
+{
+        g_static_mutex_unlock (&library_index_lock);
+}
+
 GSList *
 ario_server_list_tags (const ArioServerTag tag,
                        const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
-        /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->list_tags (tag, criteria);
+        GSList *ret;
+        ArioIndex *index;
+        gboolean answered;
+
+        ario_server_interface_lock ();
+        index = ario_server_lock_index ();
+        answered = index && ario_index_list_tags (index, tag, criteria, &ret);
+        ario_server_unlock_index ();
+        if (!answered) {
+                /* Call virtual method */
+                ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->list_tags (tag, criteria);
+        }
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 GSList *
 ario_server_get_albums (const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
-        /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_albums (criteria);
+        GSList *ret;
+        ArioIndex *index;
+        gboolean answered;
+
+        ario_server_interface_lock ();
+        index = ario_server_lock_index ();
+        answered = index && ario_index_get_albums (index, criteria, &ret);
+        ario_server_unlock_index ();
+        if (!answered) {
+                /* Call virtual method */
+                ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_albums (criteria);
+        }
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 GSList *
@@ -337,32 +608,113 @@ ario_server_get_songs (const ArioServerCriteria *criteria,
                        const gboolean exact)
 {
         ARIO_LOG_FUNCTION_START;
-        /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_songs (criteria, exact);
+        GSList *ret;
+        ArioIndex *index;
+        gboolean answered = FALSE;
+
+        ario_server_interface_lock ();
+        /* Only exact searches can be answered by the index */
+        if (exact) {
+                index = ario_server_lock_index ();
+                answered = index && ario_index_get_songs (index, criteria, &ret);
+                ario_server_unlock_index ();
+        }
+        if (!answered) {
+                /* Call virtual method */
+                ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_songs (criteria, exact);
+        }
+        ario_server_interface_unlock ();
+
+        return ret;
+}
+
+GSList *
+ario_server_search (const ArioServerCriteria *criteria,
+                    gboolean *complete)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *ret = NULL;
+        ArioServerCriteria *server_criteria = NULL;
+        const GSList *tmp;
+        ArioServerAtomicCriteria *atomic_criteria;
+        ArioIndex *index;
+        gboolean answered;
+        gboolean all_searched = TRUE;
+
+        ario_server_interface_lock ();
+        index = ario_server_lock_index ();
+        answered = (index != NULL);
+        if (index)
+                ret = ario_index_search (index, criteria);
+        ario_server_unlock_index ();
+
+        if (!answered) {
+                /* Without index, the server only searches words of at
+                 * least 3 chars as it would return most of the library
+                 * otherwise. Results are then filtered and ranked like
+                 * results of the index. */
+                for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
+                        atomic_criteria = tmp->data;
+                        if (g_utf8_strlen (atomic_criteria->value, -1) > 2)
+                                server_criteria = g_slist_prepend (server_criteria, atomic_criteria);
+                        else
+                                all_searched = FALSE;
+                }
+                if (server_criteria) {
+                        /* Call virtual method */
+                        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_songs (server_criteria, FALSE);
+                        g_slist_free (server_criteria);
+                }
+                ret = ario_index_search_filter (ret, criteria);
+        }
+        ario_server_interface_unlock ();
+
+        if (complete)
+                *complete = all_searched;
+
+        return ret;
 }
 
 GSList *
 ario_server_get_songs_from_playlist (char *playlist)
 {
         ARIO_LOG_FUNCTION_START;
+        GSList *ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_songs_from_playlist (playlist);
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_songs_from_playlist (playlist);
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 GSList *
 ario_server_get_playlists (void)
 {
         ARIO_LOG_FUNCTION_START;
+        GSList *ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_playlists ();
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_playlists ();
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 GSList *
 ario_server_get_playlist_changes (gint64 playlist_id)
 {
         ARIO_LOG_FUNCTION_START;
+        GSList *ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_playlist_changes (playlist_id);
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_playlist_changes (playlist_id);
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 gboolean
@@ -376,8 +728,14 @@ ArioServerSong *
 ario_server_get_current_song_on_server (void)
 {
         ARIO_LOG_FUNCTION_START;
+        ArioServerSong *ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_current_song_on_server ();
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_current_song_on_server ();
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 ArioServerSong *
@@ -476,8 +834,14 @@ int
 ario_server_get_current_playlist_total_time (void)
 {
         ARIO_LOG_FUNCTION_START;
+        int ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_current_playlist_total_time ();
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_current_playlist_total_time ();
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 int
@@ -521,8 +885,14 @@ ario_server_get_updating (void)
 unsigned long
 ario_server_get_last_update (void)
 {
+        unsigned long ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_last_update ();
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_last_update ();
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 gboolean
@@ -537,7 +907,9 @@ ario_server_do_next (void)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->do_next ();
+        ario_server_interface_unlock ();
 }
 
 void
@@ -545,7 +917,9 @@ ario_server_do_prev (void)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->do_prev ();
+        ario_server_interface_unlock ();
 }
 
 void
@@ -553,7 +927,9 @@ ario_server_do_play (void)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->do_play ();
+        ario_server_interface_unlock ();
 }
 
 void
@@ -561,7 +937,9 @@ ario_server_do_play_pos (gint id)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->do_play_pos (id);
+        ario_server_interface_unlock ();
 }
 
 void
@@ -569,7 +947,9 @@ ario_server_do_pause (void)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->do_pause ();
+        ario_server_interface_unlock ();
 }
 
 void
@@ -577,7 +957,9 @@ ario_server_do_stop (void)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->do_stop ();
+        ario_server_interface_unlock ();
 }
 
 void
@@ -615,7 +997,9 @@ ario_server_set_current_elapsed (const gint elapsed)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->set_current_elapsed (elapsed);
+        ario_server_interface_unlock ();
 }
 
 void
@@ -623,7 +1007,9 @@ ario_server_set_current_volume (const gint volume)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->set_current_volume (volume);
+        ario_server_interface_unlock ();
 }
 
 void
@@ -631,7 +1017,9 @@ ario_server_set_current_consume (const gboolean consume)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->set_current_consume (consume);
+        ario_server_interface_unlock ();
 }
 
 void
@@ -639,7 +1027,9 @@ ario_server_set_current_random (const gboolean random)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->set_current_random (random);
+        ario_server_interface_unlock ();
 }
 
 void
@@ -647,7 +1037,9 @@ ario_server_set_current_repeat (const gboolean repeat)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->set_current_repeat (repeat);
+        ario_server_interface_unlock ();
 }
 
 void
@@ -655,7 +1047,9 @@ ario_server_set_crossfadetime (const int crossfadetime)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->set_crossfadetime (crossfadetime);
+        ario_server_interface_unlock ();
 }
 
 void
@@ -663,7 +1057,9 @@ ario_server_clear (void)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->clear ();
+        ario_server_interface_unlock ();
 }
 
 void
@@ -671,7 +1067,9 @@ ario_server_shuffle (void)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->shuffle ();
+        ario_server_interface_unlock ();
 }
 
 void
@@ -679,35 +1077,35 @@ ario_server_queue_add (const char *path)
 {
         ARIO_LOG_FUNCTION_START;
 
-        /* Append a queue action to list */
+        /* Add a queue action to list */
         ArioServerQueueAction *queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
         queue_action->type = ARIO_SERVER_ACTION_ADD;
         queue_action->path = path;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        interface->queue = g_slist_prepend (interface->queue, queue_action);
 }
 
 void
 ario_server_queue_delete_id (const int id)
 {
-        /* Append a queue action to list */
+        /* Add a queue action to list */
         ArioServerQueueAction *queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
         queue_action->type = ARIO_SERVER_ACTION_DELETE_ID;
         queue_action->id = id;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        interface->queue = g_slist_prepend (interface->queue, queue_action);
 }
 
 void
 ario_server_queue_delete_pos (const int pos)
 {
         ARIO_LOG_FUNCTION_START;
-        /* Append a queue action to list */
+        /* Add a queue action to list */
         ArioServerQueueAction *queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
         queue_action->type = ARIO_SERVER_ACTION_DELETE_POS;
         queue_action->pos = pos;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        interface->queue = g_slist_prepend (interface->queue, queue_action);
 }
 
 void
@@ -715,13 +1113,13 @@ ario_server_queue_move (const int old_pos,
                         const int new_pos)
 {
         ARIO_LOG_FUNCTION_START;
-        /* Append a queue action to list */
+        /* Add a queue action to list */
         ArioServerQueueAction *queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
         queue_action->type = ARIO_SERVER_ACTION_MOVE;
         queue_action->old_pos = old_pos;
         queue_action->new_pos = new_pos;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        interface->queue = g_slist_prepend (interface->queue, queue_action);
 }
 
 void
@@ -729,21 +1127,232 @@ ario_server_queue_moveid (const int id,
                           const int pos)
 {
         ARIO_LOG_FUNCTION_START;
-        /* Append a queue action to list */
+        /* Add a queue action to list */
         ArioServerQueueAction *queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
         queue_action->type = ARIO_SERVER_ACTION_MOVEID;
         queue_action->old_pos = id;
         queue_action->new_pos = pos;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        interface->queue = g_slist_prepend (interface->queue, queue_action);
+}
+
+void
+ario_server_queue_delete_range (const int start,
+                                const int end)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerQueueAction *queue_action;
+
+        if (start < 0 || end <= start)
+                return;
+
+        /* Add a queue action to list */
+        queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
+        queue_action->type = ARIO_SERVER_ACTION_DELETE_RANGE;
+        queue_action->start = start;
+        queue_action->end = end;
+
+        interface->queue = g_slist_prepend (interface->queue, queue_action);
+}
+
+void
+ario_server_queue_move_range (const int start,
+                              const int end,
+                              const int to)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerQueueAction *queue_action;
+
+        if (start < 0 || end <= start || to < 0 || to == start)
+                return;
+
+        /* Add a queue action to list */
+        queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
+        queue_action->type = ARIO_SERVER_ACTION_MOVE_RANGE;
+        queue_action->start = start;
+        queue_action->end = end;
+        queue_action->to = to;
+
+        interface->queue = g_slist_prepend (interface->queue, queue_action);
+}
+
+static void
+ario_server_queue_to_range (ArioServerQueueAction *queue_action)
+{
+        int pos, new_pos;
+
+        /* start/end share their storage with pos and old_pos/new_pos:
+         * read the values before writing the range */
+        if (queue_action->type == ARIO_SERVER_ACTION_DELETE_POS
+            && queue_action->pos >= 0) {
+                pos = queue_action->pos;
+                queue_action->type = ARIO_SERVER_ACTION_DELETE_RANGE;
+                queue_action->start = pos;
+                queue_action->end = pos + 1;
+        } else if (queue_action->type == ARIO_SERVER_ACTION_MOVE
+                   && queue_action->old_pos >= 0) {
+                pos = queue_action->old_pos;
+                new_pos = queue_action->new_pos;
+                queue_action->type = ARIO_SERVER_ACTION_MOVE_RANGE;
+                queue_action->start = pos;
+                queue_action->end = pos + 1;
+                queue_action->to = new_pos;
+        }
+}
+
+static void
+ario_server_queue_from_range (ArioServerQueueAction *queue_action)
+{
+        int pos, new_pos;
+
+        /* Ranges of one song are sent as single actions */
+        if (queue_action->type == ARIO_SERVER_ACTION_DELETE_RANGE
+            && queue_action->end - queue_action->start == 1) {
+                pos = queue_action->start;
+                queue_action->type = ARIO_SERVER_ACTION_DELETE_POS;
+                queue_action->pos = pos;
+        } else if (queue_action->type == ARIO_SERVER_ACTION_MOVE_RANGE
+                   && queue_action->end - queue_action->start == 1) {
+                pos = queue_action->start;
+                new_pos = queue_action->to;
+                queue_action->type = ARIO_SERVER_ACTION_MOVE;
+                queue_action->old_pos = pos;
+                queue_action->new_pos = new_pos;
+        }
+}
+
+static gboolean
+ario_server_queue_merge (ArioServerQueueAction *last,
+                         const ArioServerQueueAction *queue_action)
+{
+        int size;
+
+        if (last->type != queue_action->type)
+                return FALSE;
+
+        size = queue_action->end - queue_action->start;
+
+        if (last->type == ARIO_SERVER_ACTION_DELETE_RANGE) {
+                /* Songs following the deleted range */
+                if (queue_action->start == last->start) {
+                        last->end += size;
+                        return TRUE;
+                }
+                /* Songs preceding the deleted range */
+                if (queue_action->end == last->start) {
+                        last->start = queue_action->start;
+                        return TRUE;
+                }
+        } else if (last->type == ARIO_SERVER_ACTION_MOVE_RANGE) {
+                /* Songs preceding a range moved down, put just before it */
+                if (last->to > last->start
+                    && queue_action->end == last->start
+                    && queue_action->to == last->to - size) {
+                        last->start = queue_action->start;
+                        last->to = queue_action->to;
+                        return TRUE;
+                }
+                /* Songs preceding a range moved up (they are now just after
+                 * it), put just before it */
+                if (last->to < last->start
+                    && queue_action->start == last->end - size
+                    && queue_action->end == last->end
+                    && queue_action->to == last->to) {
+                        last->start -= size;
+                        return TRUE;
+                }
+        }
+
+        return FALSE;
+}
+
+/* Merge successive deletions and moves of adjacent songs in range
+ * actions so that a server renumbers its queue once per range instead
+ * of once per song */
+static void
+ario_server_queue_coalesce (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp;
+        GSList *coalesced = NULL;
+        ArioServerQueueAction *queue_action;
+
+        for (tmp = interface->queue; tmp; tmp = g_slist_next (tmp)) {
+                queue_action = (ArioServerQueueAction *) tmp->data;
+                ario_server_queue_to_range (queue_action);
+
+                if (coalesced
+                    && ario_server_queue_merge (coalesced->data, queue_action)) {
+                        g_free (queue_action);
+                } else {
+                        coalesced = g_slist_prepend (coalesced, queue_action);
+                }
+        }
+        g_slist_free (interface->queue);
+
+        g_slist_foreach (coalesced, (GFunc) ario_server_queue_from_range, NULL);
+        interface->queue = g_slist_reverse (coalesced);
+}
+
+void
+ario_server_queue_expand_ranges (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp;
+        GSList *expanded = NULL;
+        ArioServerQueueAction *queue_action;
+        ArioServerQueueAction *single;
+        int i, size;
+
+        for (tmp = interface->queue; tmp; tmp = g_slist_next (tmp)) {
+                queue_action = (ArioServerQueueAction *) tmp->data;
+                if (queue_action->type == ARIO_SERVER_ACTION_DELETE_RANGE) {
+                        /* Following songs take the place of the deleted one */
+                        for (i = queue_action->start; i < queue_action->end; ++i) {
+                                single = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
+                                single->type = ARIO_SERVER_ACTION_DELETE_POS;
+                                single->pos = queue_action->start;
+                                expanded = g_slist_prepend (expanded, single);
+                        }
+                        g_free (queue_action);
+                } else if (queue_action->type == ARIO_SERVER_ACTION_MOVE_RANGE) {
+                        size = queue_action->end - queue_action->start;
+                        for (i = 0; i < size; ++i) {
+                                single = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
+                                single->type = ARIO_SERVER_ACTION_MOVE;
+                                if (queue_action->to < queue_action->start) {
+                                        /* Moved up: songs are moved from the first one */
+                                        single->old_pos = queue_action->start + i;
+                                        single->new_pos = queue_action->to + i;
+                                } else {
+                                        /* Moved down: the first song of the range is
+                                         * always moved after the ones already moved */
+                                        single->old_pos = queue_action->start;
+                                        single->new_pos = queue_action->to + size - 1;
+                                }
+                                expanded = g_slist_prepend (expanded, single);
+                        }
+                        g_free (queue_action);
+                } else {
+                        expanded = g_slist_prepend (expanded, queue_action);
+                }
+        }
+        g_slist_free (interface->queue);
+        interface->queue = g_slist_reverse (expanded);
 }
 
 void
 ario_server_queue_commit (void)
 {
         ARIO_LOG_FUNCTION_START;
+        /* Actions are prepended: put them back in the order they were queued */
+        interface->queue = g_slist_reverse (interface->queue);
+        ario_server_queue_coalesce ();
+
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->queue_commit ();
+        ario_server_interface_unlock ();
 }
 
 void
@@ -752,15 +1361,21 @@ ario_server_insert_at (const GSList *songs,
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->insert_at (songs, pos);
+        ario_server_interface_unlock ();
 }
 
 int
 ario_server_save_playlist (const char *name)
 {
         ARIO_LOG_FUNCTION_START;
+        int ret;
+
         /* Call virtual method */
-        int ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->save_playlist (name);
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->save_playlist (name);
+        ario_server_interface_unlock ();
 
 #ifndef ENABLE_MPDIDLE
         g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_STOREDPLAYLISTS_CHANGED], 0);
@@ -774,7 +1389,9 @@ ario_server_delete_playlist (const char *name)
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->delete_playlist (name);
+        ario_server_interface_unlock ();
 
 #ifndef ENABLE_MPDIDLE
         g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_STOREDPLAYLISTS_CHANGED], 0);
@@ -785,8 +1402,14 @@ GSList *
 ario_server_get_outputs (void)
 {
         ARIO_LOG_FUNCTION_START;
+        GSList *ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_outputs ();
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_outputs ();
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 void
@@ -795,23 +1418,37 @@ ario_server_enable_output (int id,
 {
         ARIO_LOG_FUNCTION_START;
         /* Call virtual method */
+        ario_server_interface_lock ();
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->enable_output (id, enabled);
+        ario_server_interface_unlock ();
 }
 
 ArioServerStats *
 ario_server_get_stats (void)
 {
         ARIO_LOG_FUNCTION_START;
+        ArioServerStats *ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_stats ();
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_stats ();
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 GList *
 ario_server_get_songs_info (GSList *paths)
 {
         ARIO_LOG_FUNCTION_START;
+        GList *ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_songs_info (paths);
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_songs_info (paths);
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 ArioServerFileList *
@@ -819,8 +1456,14 @@ ario_server_list_files (const char *path,
                         gboolean recursive)
 {
         ARIO_LOG_FUNCTION_START;
+        ArioServerFileList *ret;
+
         /* Call virtual method */
-        return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->list_files (path, recursive);
+        ario_server_interface_lock ();
+        ret = ARIO_SERVER_INTERFACE_GET_CLASS (interface)->list_files (path, recursive);
+        ario_server_interface_unlock ();
+
+        return ret;
 }
 
 void
@@ -836,6 +1479,162 @@ ario_server_free_file_list (ArioServerFileList *files)
         }
 }
 
+/* Arguments of an asynchronous call, owned by the server thread */
+typedef struct
+{
+        ArioServerTag tag;
+        ArioServerCriteria *criteria;
+        gboolean exact;
+} ArioServerAsyncData;
+
+static void
+ario_server_async_data_free (ArioServerAsyncData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_criteria_free (data->criteria);
+        g_free (data);
+}
+
+static void
+ario_server_free_tags (GSList *tags)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_slist_foreach (tags, (GFunc) g_free, NULL);
+        g_slist_free (tags);
+}
+
+static void
+ario_server_free_albums (GSList *albums)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
+        g_slist_free (albums);
+}
+
+static void
+ario_server_free_songs (GSList *songs)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
+        g_slist_free (songs);
+}
+
+static gpointer
+ario_server_list_tags_thread (ArioServerAsyncData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        return ario_server_list_tags (data->tag, data->criteria);
+}
+
+void
+ario_server_list_tags_async (const ArioServerTag tag,
+                             const ArioServerCriteria *criteria,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerAsyncData *data;
+
+        /* Copy criteria as they could be destroyed before the end */
+        data = (ArioServerAsyncData *) g_malloc0 (sizeof (ArioServerAsyncData));
+        data->tag = tag;
+        data->criteria = ario_server_criteria_copy (criteria);
+
+        ario_server_interface_call_async (G_OBJECT (instance),
+                                          (ArioServerAsyncFunc) ario_server_list_tags_thread,
+                                          data,
+                                          (GDestroyNotify) ario_server_async_data_free,
+                                          (GDestroyNotify) ario_server_free_tags,
+                                          cancellable,
+                                          callback,
+                                          user_data);
+}
+
+GSList *
+ario_server_list_tags_finish (GAsyncResult *result,
+                              GError **error)
+{
+        ARIO_LOG_FUNCTION_START;
+        return ario_server_interface_call_finish (result, error);
+}
+
+static gpointer
+ario_server_get_albums_thread (ArioServerAsyncData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        return ario_server_get_albums (data->criteria);
+}
+
+void
+ario_server_get_albums_async (const ArioServerCriteria *criteria,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer user_data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerAsyncData *data;
+
+        data = (ArioServerAsyncData *) g_malloc0 (sizeof (ArioServerAsyncData));
+        data->criteria = ario_server_criteria_copy (criteria);
+
+        ario_server_interface_call_async (G_OBJECT (instance),
+                                          (ArioServerAsyncFunc) ario_server_get_albums_thread,
+                                          data,
+                                          (GDestroyNotify) ario_server_async_data_free,
+                                          (GDestroyNotify) ario_server_free_albums,
+                                          cancellable,
+                                          callback,
+                                          user_data);
+}
+
+GSList *
+ario_server_get_albums_finish (GAsyncResult *result,
+                               GError **error)
+{
+        ARIO_LOG_FUNCTION_START;
+        return ario_server_interface_call_finish (result, error);
+}
+
+static gpointer
+ario_server_get_songs_thread (ArioServerAsyncData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        return ario_server_get_songs (data->criteria, data->exact);
+}
+
+void
+ario_server_get_songs_async (const ArioServerCriteria *criteria,
+                             const gboolean exact,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerAsyncData *data;
+
+        data = (ArioServerAsyncData *) g_malloc0 (sizeof (ArioServerAsyncData));
+        data->criteria = ario_server_criteria_copy (criteria);
+        data->exact = exact;
+
+        ario_server_interface_call_async (G_OBJECT (instance),
+                                          (ArioServerAsyncFunc) ario_server_get_songs_thread,
+                                          data,
+                                          (GDestroyNotify) ario_server_async_data_free,
+                                          (GDestroyNotify) ario_server_free_songs,
+                                          cancellable,
+                                          callback,
+                                          user_data);
+}
+
+GSList *
+ario_server_get_songs_finish (GAsyncResult *result,
+                              GError **error)
+{
+        ARIO_LOG_FUNCTION_START;
+        return ario_server_interface_call_finish (result, error);
+}
+
 void
 ario_server_criteria_free (ArioServerCriteria *criteria)
 {
@@ -866,10 +1665,10 @@ ario_server_criteria_copy (const ArioServerCriteria *criteria)
                         new_atomic_criteria = (ArioServerAtomicCriteria *) g_malloc0 (sizeof (ArioServerAtomicCriteria));
                         new_atomic_criteria->tag = atomic_criteria->tag;
                         new_atomic_criteria->value = g_strdup (atomic_criteria->value);
-                        ret = g_slist_append (ret, new_atomic_criteria);
+                        ret = g_slist_prepend (ret, new_atomic_criteria);
                 }
         }
-        return ret;
+        return g_slist_reverse (ret);
 }
 
 gchar **
@@ -962,8 +1761,9 @@ ario_server_playlist_add_dir (const gchar *dir,
         for (tmp = files->songs; tmp; tmp = g_slist_next (tmp)) {
                 song = tmp->data;
                 /* Append file to list */
-                char_songs = g_slist_append (char_songs, song->file);
+                char_songs = g_slist_prepend (char_songs, song->file);
         }
+        char_songs = g_slist_reverse (char_songs);
 
         /* Append all files to playlist */
         ario_server_playlist_add_songs (char_songs, pos, action);
@@ -978,10 +1778,18 @@ ario_server_playlist_add_criterias (const GSList *criterias,
                                     const gint nb_entries)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *filenames = NULL, *tmp_filenames = NULL, *songs = NULL;
+        GSList *filenames = NULL, *songs = NULL;
         const GSList *tmp_criteria, *tmp_songs;
         const ArioServerCriteria *criteria;
         ArioServerSong *server_song;
+        GPtrArray *sample = NULL;
+        guint nb_songs = 0;
+        gint i;
+
+        /* Need to only add a limited number of songs: we keep a random
+         * sample of all the songs of all the criterias */
+        if (nb_entries > 0)
+                sample = g_ptr_array_sized_new (nb_entries);
 
         /* For each criteria :*/
         for (tmp_criteria = criterias; tmp_criteria; tmp_criteria = g_slist_next (tmp_criteria)) {
@@ -990,9 +1798,14 @@ ario_server_playlist_add_criterias (const GSList *criterias,
 
                 /* For each song */
                 for (tmp_songs = songs; tmp_songs; tmp_songs = g_slist_next (tmp_songs)) {
-                        /* Append song filename to list */
                         server_song = tmp_songs->data;
-                        filenames = g_slist_append (filenames, server_song->file);
+                        if (sample) {
+                                /* Add song filename to the sample */
+                                g_free (ario_util_sample_add (sample, nb_entries, ++nb_songs, server_song->file));
+                        } else {
+                                /* Append song filename to list */
+                                filenames = g_slist_prepend (filenames, server_song->file);
+                        }
                         server_song->file = NULL;
                 }
 
@@ -1000,14 +1813,14 @@ ario_server_playlist_add_criterias (const GSList *criterias,
                 g_slist_free (songs);
         }
 
-        /* Need to only add a limited number of songs */
-        if (nb_entries > 0 && filenames) {
-                /* Randomly get some songs in list */
-                tmp_filenames = ario_util_gslist_randomize (&filenames, nb_entries);
-                g_slist_foreach (filenames, (GFunc) g_free, NULL);
-                g_slist_free (filenames);
-
-                filenames = tmp_filenames;
+        if (sample) {
+                /* Songs are added in random order */
+                ario_util_ptr_array_shuffle (sample);
+                for (i = sample->len - 1; i >= 0; --i)
+                        filenames = g_slist_prepend (filenames, g_ptr_array_index (sample, i));
+                g_ptr_array_free (sample, TRUE);
+        } else {
+                filenames = g_slist_reverse (filenames);
         }
 
         /* Add songs to playlist */
@@ -1041,8 +1854,9 @@ ario_server_playlist_append_server_songs (const GSList *songs,
         for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
                 /* Append song filename to list */
                 song = tmp->data;
-                char_songs = g_slist_append (char_songs, song->file);
+                char_songs = g_slist_prepend (char_songs, song->file);
         }
+        char_songs = g_slist_reverse (char_songs);
 
         /* Add songs to playlist */
         ario_server_playlist_add_songs (char_songs, -1, action);
@@ -1069,8 +1883,9 @@ ario_server_playlist_append_artists (const GSList *artists,
                 atomic_criteria->value = g_strdup (tmp->data);
 
                 criteria = g_slist_append (criteria, atomic_criteria);
-                criterias = g_slist_append (criterias, criteria);
+                criterias = g_slist_prepend (criterias, criteria);
         }
+        criterias = g_slist_reverse (criterias);
 
         /* Add songs matching criteria to playlist */
         ario_server_playlist_append_criterias (criterias, action, nb_entries);
@@ -1120,6 +1935,35 @@ ario_server_free_song (ArioServerSong *song)
         }
 }
 
+ArioServerSong *
+ario_server_copy_song (const ArioServerSong *song)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerSong *ret = NULL;
+
+        if (song) {
+                ret = (ArioServerSong *) g_malloc (sizeof (ArioServerSong));
+                ret->file = g_strdup (song->file);
+                ret->artist = g_strdup (song->artist);
+                ret->title = g_strdup (song->title);
+                ret->album = g_strdup (song->album);
+                ret->album_artist = g_strdup (song->album_artist);
+                ret->track = g_strdup (song->track);
+                ret->name = g_strdup (song->name);
+                ret->date = g_strdup (song->date);
+                ret->genre = g_strdup (song->genre);
+                ret->composer = g_strdup (song->composer);
+                ret->performer = g_strdup (song->performer);
+                ret->disc = g_strdup (song->disc);
+                ret->comment = g_strdup (song->comment);
+                ret->time = song->time;
+                ret->pos = song->pos;
+                ret->id = song->id;
+        }
+
+        return ret;
+}
+
 void
 ario_server_free_output (ArioServerOutput *output)
 {
@@ -21,6 +21,7 @@
 #define __ARIO_SERVER_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -141,6 +142,9 @@ typedef struct
 
 typedef GSList ArioServerCriteria; /* A criteria is a list of atomic criterias */
 
+typedef void (*ArioServerSongFunc) (const ArioServerSong *song,
+                                    gpointer data);
+
 typedef enum
 {
         ArioServerMpd,
@@ -153,7 +157,9 @@ typedef enum
         ARIO_SERVER_ACTION_DELETE_ID,
         ARIO_SERVER_ACTION_DELETE_POS,
         ARIO_SERVER_ACTION_MOVE,
-        ARIO_SERVER_ACTION_MOVEID
+        ARIO_SERVER_ACTION_MOVEID,
+        ARIO_SERVER_ACTION_DELETE_RANGE,
+        ARIO_SERVER_ACTION_MOVE_RANGE
 }ArioServerActionType;
 
 typedef struct ArioServerQueueAction {
@@ -166,6 +172,11 @@ typedef struct ArioServerQueueAction {
                         int old_pos;
                         int new_pos;
                 };
+                struct {                // For ARIO_SERVER_ACTION_DELETE_RANGE and ARIO_SERVER_ACTION_MOVE_RANGE
+                        int start;      // First position of the range
+                        int end;        // Position after the last one of the range
+                        int to;         // Position of the range once moved (MOVE_RANGE only)
+                };
         };
 } ArioServerQueueAction;
 
@@ -260,6 +271,9 @@ void                    ario_server_shutdown                               (void
 
 gboolean                ario_server_is_connected                           (void);
 
+/* Used by the server thread, see ArioServerInterfaceClass::thread_connect */
+gboolean                ario_server_thread_connect                         (void);
+
 gboolean                ario_server_update_status                          (void);
 
 void                    ario_server_update_db                              (const gchar *path);
@@ -269,6 +283,11 @@ GSList *                ario_server_list_tags                              (cons
 GSList *                ario_server_get_albums                             (const ArioServerCriteria *criteria);
 GSList *                ario_server_get_songs                              (const ArioServerCriteria *criteria,
                                                                             const gboolean exact);
+/* Full-text search in the library, see ario_index_search. complete (or
+ * NULL) is set to FALSE when some words were not searched and the result
+ * can miss songs matching them */
+GSList *                ario_server_search                                 (const ArioServerCriteria *criteria,
+                                                                            gboolean *complete);
 GSList *                ario_server_get_songs_from_playlist                (char *playlist);
 GSList *                ario_server_get_playlists                          (void);
 
@@ -347,7 +366,16 @@ void                    ario_server_queue_move                             (cons
                                                                             const int new_pos);
 void                    ario_server_queue_moveid                           (const int id,
                                                                             const int pos);
+// delete songs from position start to end (excluded)
+void                    ario_server_queue_delete_range                     (const int start,
+                                                                            const int end);
+// move songs from position start to end (excluded) so that the first one is at position to
+void                    ario_server_queue_move_range                       (const int start,
+                                                                            const int end,
+                                                                            const int to);
 void                    ario_server_queue_commit                           (void);
+// replace range actions of the queue by single ones, for servers without range support
+void                    ario_server_queue_expand_ranges                    (void);
 
 void                    ario_server_insert_at                              (const GSList *songs,
                                                                             const gint pos);
@@ -367,6 +395,31 @@ ArioServerFileList*     ario_server_list_files                             (cons
                                                                             const gboolean recursive);
 void                    ario_server_free_file_list                         (ArioServerFileList *files);
 
+/* Asynchronous versions: the call is made in the server thread and
+ * callback is called in the main loop, use the _finish function in
+ * callback to get the result. Once cancellable is cancelled, the
+ * _finish function returns NULL with G_IO_ERROR_CANCELLED */
+void                    ario_server_list_tags_async                        (const ArioServerTag tag,
+                                                                            const ArioServerCriteria *criteria,
+                                                                            GCancellable *cancellable,
+                                                                            GAsyncReadyCallback callback,
+                                                                            gpointer user_data);
+GSList *                ario_server_list_tags_finish                       (GAsyncResult *result,
+                                                                            GError **error);
+void                    ario_server_get_albums_async                       (const ArioServerCriteria *criteria,
+                                                                            GCancellable *cancellable,
+                                                                            GAsyncReadyCallback callback,
+                                                                            gpointer user_data);
+GSList *                ario_server_get_albums_finish                      (GAsyncResult *result,
+                                                                            GError **error);
+void                    ario_server_get_songs_async                        (const ArioServerCriteria *criteria,
+                                                                            const gboolean exact,
+                                                                            GCancellable *cancellable,
+                                                                            GAsyncReadyCallback callback,
+                                                                            gpointer user_data);
+GSList *                ario_server_get_songs_finish                       (GAsyncResult *result,
+                                                                            GError **error);
+
 ArioServerCriteria *    ario_server_criteria_copy                          (const ArioServerCriteria *criteria);
 
 void                    ario_server_criteria_free                          (ArioServerCriteria *criteria);
@@ -399,6 +452,8 @@ void                    ario_server_playlist_append_criterias              (cons
                                                                             const gint nb_entries);
 void                    ario_server_free_song                              (ArioServerSong *song);
 
+ArioServerSong *        ario_server_copy_song                              (const ArioServerSong *song);
+
 void                    ario_server_free_output                            (ArioServerOutput *output);
 
 G_END_DECLS
@@ -0,0 +1,451 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "servers/ario-song-array.h"
+#include <string.h>
+#include <config.h>
+#include "ario-debug.h"
+
+/* Identifier of a NULL string */
+#define ARIO_SONG_ARRAY_NO_STRING G_MAXUINT32
+
+/* The pool is rebuilt once it has more than this number of unused
+ * strings and they are more than half of the pool */
+#define ARIO_SONG_ARRAY_MIN_UNUSED 4096
+
+/* String fields of ArioServerSong */
+typedef enum
+{
+        FILE_FIELD,
+        ARTIST_FIELD,
+        TITLE_FIELD,
+        ALBUM_FIELD,
+        ALBUM_ARTIST_FIELD,
+        TRACK_FIELD,
+        NAME_FIELD,
+        DATE_FIELD,
+        GENRE_FIELD,
+        COMPOSER_FIELD,
+        PERFORMER_FIELD,
+        DISC_FIELD,
+        COMMENT_FIELD,
+        N_FIELDS
+} ArioSongArrayField;
+
+/* Field of each tag (see ArioServerTag) */
+static const ArioSongArrayField ario_song_array_tag_fields[] = {
+        ARTIST_FIELD,           /* ARIO_TAG_ARTIST */
+        ALBUM_FIELD,            /* ARIO_TAG_ALBUM */
+        ALBUM_ARTIST_FIELD,     /* ARIO_TAG_ALBUM_ARTIST */
+        TITLE_FIELD,            /* ARIO_TAG_TITLE */
+        TRACK_FIELD,            /* ARIO_TAG_TRACK */
+        NAME_FIELD,             /* ARIO_TAG_NAME */
+        GENRE_FIELD,            /* ARIO_TAG_GENRE */
+        DATE_FIELD,             /* ARIO_TAG_DATE */
+        COMPOSER_FIELD,         /* ARIO_TAG_COMPOSER */
+        PERFORMER_FIELD,        /* ARIO_TAG_PERFORMER */
+        COMMENT_FIELD,          /* ARIO_TAG_COMMENT */
+        DISC_FIELD,             /* ARIO_TAG_DISC */
+        FILE_FIELD,             /* ARIO_TAG_FILENAME */
+};
+
+struct ArioSongArray
+{
+        /* Storage of the strings of the pool */
+        GStringChunk *chunk;
+        /* String -> identifier + 1 */
+        GHashTable *ids;
+        /* Identifier -> string */
+        GPtrArray *strings;
+        /* Identifier -> number of songs using the string (guint32) */
+        GArray *refs;
+        /* Number of strings used by no song */
+        guint unused;
+        /* Strings given to the caller with ario_song_array_intern or
+         * ario_song_array_intern_static must never move: the pool is
+         * then never rebuilt */
+        gboolean pinned;
+
+        /* For each string field: identifiers of the strings (guint32) */
+        GArray *fields[N_FIELDS];
+        /* Integer fields (gint) */
+        GArray *times;
+        GArray *positions;
+        GArray *song_ids;
+};
+
+static void
+ario_song_array_song_fields (ArioServerSong *song,
+                             gchar **fields[N_FIELDS])
+{
+        fields[FILE_FIELD] = &song->file;
+        fields[ARTIST_FIELD] = &song->artist;
+        fields[TITLE_FIELD] = &song->title;
+        fields[ALBUM_FIELD] = &song->album;
+        fields[ALBUM_ARTIST_FIELD] = &song->album_artist;
+        fields[TRACK_FIELD] = &song->track;
+        fields[NAME_FIELD] = &song->name;
+        fields[DATE_FIELD] = &song->date;
+        fields[GENRE_FIELD] = &song->genre;
+        fields[COMPOSER_FIELD] = &song->composer;
+        fields[PERFORMER_FIELD] = &song->performer;
+        fields[DISC_FIELD] = &song->disc;
+        fields[COMMENT_FIELD] = &song->comment;
+}
+
+ArioSongArray *
+ario_song_array_new (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioSongArray *array;
+        int i;
+
+        array = (ArioSongArray *) g_malloc0 (sizeof (ArioSongArray));
+        array->chunk = g_string_chunk_new (64 * 1024);
+        array->ids = g_hash_table_new (g_str_hash, g_str_equal);
+        array->strings = g_ptr_array_new ();
+        array->refs = g_array_new (FALSE, FALSE, sizeof (guint32));
+        for (i = 0; i < N_FIELDS; ++i)
+                array->fields[i] = g_array_new (FALSE, FALSE, sizeof (guint32));
+        array->times = g_array_new (FALSE, FALSE, sizeof (gint));
+        array->positions = g_array_new (FALSE, FALSE, sizeof (gint));
+        array->song_ids = g_array_new (FALSE, FALSE, sizeof (gint));
+
+        return array;
+}
+
+void
+ario_song_array_free (ArioSongArray *array)
+{
+        ARIO_LOG_FUNCTION_START;
+        int i;
+
+        if (!array)
+                return;
+
+        for (i = 0; i < N_FIELDS; ++i)
+                g_array_free (array->fields[i], TRUE);
+        g_array_free (array->times, TRUE);
+        g_array_free (array->positions, TRUE);
+        g_array_free (array->song_ids, TRUE);
+        g_ptr_array_free (array->strings, TRUE);
+        g_array_free (array->refs, TRUE);
+        g_hash_table_destroy (array->ids);
+        g_string_chunk_free (array->chunk);
+        g_free (array);
+}
+
+guint
+ario_song_array_get_length (const ArioSongArray *array)
+{
+        return array->times->len;
+}
+
+static guint32
+ario_song_array_string_id (ArioSongArray *array,
+                           const gchar *string,
+                           const gboolean copy)
+{
+        guint32 id;
+        gchar *stored;
+
+        if (!string)
+                return ARIO_SONG_ARRAY_NO_STRING;
+
+        /* Identifiers are stored + 1 to distinguish 0 from a missing string */
+        id = GPOINTER_TO_UINT (g_hash_table_lookup (array->ids, string));
+        if (id)
+                return id - 1;
+
+        stored = copy ? g_string_chunk_insert (array->chunk, string) : (gchar *) string;
+        id = array->strings->len;
+        g_ptr_array_add (array->strings, stored);
+        g_hash_table_insert (array->ids, stored, GUINT_TO_POINTER (id + 1));
+        g_array_set_size (array->refs, id + 1);
+        g_array_index (array->refs, guint32, id) = 0;
+        ++array->unused;
+
+        return id;
+}
+
+static void
+ario_song_array_string_ref (ArioSongArray *array,
+                            const guint32 id)
+{
+        if (id == ARIO_SONG_ARRAY_NO_STRING)
+                return;
+
+        if (g_array_index (array->refs, guint32, id)++ == 0)
+                --array->unused;
+}
+
+static void
+ario_song_array_string_unref (ArioSongArray *array,
+                              const guint32 id)
+{
+        if (id == ARIO_SONG_ARRAY_NO_STRING)
+                return;
+
+        if (--g_array_index (array->refs, guint32, id) == 0)
+                ++array->unused;
+}
+
+/* Rebuild the pool with the strings still used by songs only */
+static void
+ario_song_array_compact (ArioSongArray *array)
+{
+        ARIO_LOG_FUNCTION_START;
+        GStringChunk *chunk;
+        GPtrArray *strings;
+        GArray *refs;
+        guint32 *new_ids;
+        guint32 *id;
+        guint32 new_id;
+        guint i, j;
+        gchar *stored;
+
+        chunk = g_string_chunk_new (64 * 1024);
+        strings = g_ptr_array_new ();
+        refs = g_array_new (FALSE, FALSE, sizeof (guint32));
+        new_ids = g_new (guint32, array->strings->len);
+        g_hash_table_remove_all (array->ids);
+
+        for (i = 0; i < array->strings->len; ++i) {
+                if (g_array_index (array->refs, guint32, i) == 0) {
+                        new_ids[i] = ARIO_SONG_ARRAY_NO_STRING;
+                        continue;
+                }
+                stored = g_string_chunk_insert (chunk, g_ptr_array_index (array->strings, i));
+                new_id = strings->len;
+                g_ptr_array_add (strings, stored);
+                g_array_append_val (refs, g_array_index (array->refs, guint32, i));
+                g_hash_table_insert (array->ids, stored, GUINT_TO_POINTER (new_id + 1));
+                new_ids[i] = new_id;
+        }
+
+        for (j = 0; j < N_FIELDS; ++j) {
+                for (i = 0; i < array->fields[j]->len; ++i) {
+                        id = &g_array_index (array->fields[j], guint32, i);
+                        if (*id != ARIO_SONG_ARRAY_NO_STRING)
+                                *id = new_ids[*id];
+                }
+        }
+        g_free (new_ids);
+
+        g_string_chunk_free (array->chunk);
+        array->chunk = chunk;
+        g_ptr_array_free (array->strings, TRUE);
+        array->strings = strings;
+        g_array_free (array->refs, TRUE);
+        array->refs = refs;
+        array->unused = 0;
+}
+
+static void
+ario_song_array_check_unused (ArioSongArray *array)
+{
+        if (!array->pinned
+            && array->unused > ARIO_SONG_ARRAY_MIN_UNUSED
+            && array->unused > array->strings->len / 2)
+                ario_song_array_compact (array);
+}
+
+static const gchar *
+ario_song_array_string (const ArioSongArray *array,
+                        const guint32 id)
+{
+        if (id == ARIO_SONG_ARRAY_NO_STRING)
+                return NULL;
+
+        return g_ptr_array_index (array->strings, id);
+}
+
+const gchar *
+ario_song_array_intern (ArioSongArray *array,
+                        const gchar *string)
+{
+        guint32 id = ario_song_array_string_id (array, string, TRUE);
+
+        /* The string is kept as long as the array exists */
+        array->pinned = TRUE;
+        ario_song_array_string_ref (array, id);
+
+        return ario_song_array_string (array, id);
+}
+
+const gchar *
+ario_song_array_lookup (const ArioSongArray *array,
+                        const gchar *string)
+{
+        guint32 id;
+
+        if (!string)
+                return NULL;
+
+        id = GPOINTER_TO_UINT (g_hash_table_lookup (array->ids, string));
+
+        return id ? g_ptr_array_index (array->strings, id - 1) : NULL;
+}
+
+void
+ario_song_array_intern_static (ArioSongArray *array,
+                               const gchar *string)
+{
+        array->pinned = TRUE;
+        ario_song_array_string_ref (array,
+                                    ario_song_array_string_id (array, string, FALSE));
+}
+
+void
+ario_song_array_set_length (ArioSongArray *array,
+                            const guint length)
+{
+        ARIO_LOG_FUNCTION_START;
+        guint old_length = ario_song_array_get_length (array);
+        guint32 no_string = ARIO_SONG_ARRAY_NO_STRING;
+        gint none = -1;
+        guint i;
+        int j;
+
+        if (length <= old_length) {
+                /* Strings of the removed songs */
+                for (j = 0; j < N_FIELDS; ++j) {
+                        for (i = length; i < old_length; ++i)
+                                ario_song_array_string_unref (array, g_array_index (array->fields[j], guint32, i));
+                        g_array_set_size (array->fields[j], length);
+                }
+                g_array_set_size (array->times, length);
+                g_array_set_size (array->positions, length);
+                g_array_set_size (array->song_ids, length);
+                ario_song_array_check_unused (array);
+                return;
+        }
+
+        /* New songs have no tag */
+        for (i = old_length; i < length; ++i) {
+                for (j = 0; j < N_FIELDS; ++j)
+                        g_array_append_val (array->fields[j], no_string);
+                g_array_append_val (array->times, none);
+                g_array_append_val (array->positions, none);
+                g_array_append_val (array->song_ids, none);
+        }
+}
+
+void
+ario_song_array_set (ArioSongArray *array,
+                     const guint i,
+                     const ArioServerSong *song)
+{
+        gchar **fields[N_FIELDS];
+        guint32 id;
+        int j;
+
+        ario_song_array_song_fields ((ArioServerSong *) song, fields);
+        for (j = 0; j < N_FIELDS; ++j) {
+                id = ario_song_array_string_id (array, *fields[j], TRUE);
+                ario_song_array_string_ref (array, id);
+                ario_song_array_string_unref (array, g_array_index (array->fields[j], guint32, i));
+                g_array_index (array->fields[j], guint32, i) = id;
+        }
+        g_array_index (array->times, gint, i) = song->time;
+        g_array_index (array->positions, gint, i) = song->pos;
+        g_array_index (array->song_ids, gint, i) = song->id;
+
+        ario_song_array_check_unused (array);
+}
+
+guint
+ario_song_array_append (ArioSongArray *array,
+                        const ArioServerSong *song)
+{
+        guint i = ario_song_array_get_length (array);
+
+        ario_song_array_set_length (array, i + 1);
+        ario_song_array_set (array, i, song);
+
+        return i;
+}
+
+static void
+ario_song_array_reorder_array (GArray **garray,
+                               const guint element_size,
+                               const gint *new_order)
+{
+        GArray *reordered;
+        guint i;
+
+        reordered = g_array_sized_new (FALSE, FALSE, element_size, (*garray)->len);
+        g_array_set_size (reordered, (*garray)->len);
+        for (i = 0; i < (*garray)->len; ++i)
+                memcpy (reordered->data + i * element_size,
+                        (*garray)->data + new_order[i] * element_size,
+                        element_size);
+
+        g_array_free (*garray, TRUE);
+        *garray = reordered;
+}
+
+void
+ario_song_array_reorder (ArioSongArray *array,
+                         const gint *new_order)
+{
+        ARIO_LOG_FUNCTION_START;
+        int j;
+
+        for (j = 0; j < N_FIELDS; ++j)
+                ario_song_array_reorder_array (&array->fields[j], sizeof (guint32), new_order);
+        ario_song_array_reorder_array (&array->times, sizeof (gint), new_order);
+        ario_song_array_reorder_array (&array->positions, sizeof (gint), new_order);
+        ario_song_array_reorder_array (&array->song_ids, sizeof (gint), new_order);
+}
+
+void
+ario_song_array_get (const ArioSongArray *array,
+                     const guint i,
+                     ArioServerSong *song)
+{
+        gchar **fields[N_FIELDS];
+        int j;
+
+        ario_song_array_song_fields (song, fields);
+        for (j = 0; j < N_FIELDS; ++j)
+                *fields[j] = (gchar *) ario_song_array_string (array, g_array_index (array->fields[j], guint32, i));
+        song->time = g_array_index (array->times, gint, i);
+        song->pos = g_array_index (array->positions, gint, i);
+        song->id = g_array_index (array->song_ids, gint, i);
+}
+
+const gchar *
+ario_song_array_get_tag (const ArioSongArray *array,
+                         const guint i,
+                         const ArioServerTag tag)
+{
+        if (tag >= ARIO_TAG_ANY)
+                return NULL;
+
+        return ario_song_array_string (array,
+                                       g_array_index (array->fields[ario_song_array_tag_fields[tag]], guint32, i));
+}
+
+gint
+ario_song_array_get_time (const ArioSongArray *array,
+                          const guint i)
+{
+        return g_array_index (array->times, gint, i);
+}
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_SONG_ARRAY_H
+#define __ARIO_SONG_ARRAY_H
+
+#include <glib.h>
+#include "servers/ario-server.h"
+
+G_BEGIN_DECLS
+
+/**
+ * ArioSongArray is a compact storage for a large number of songs.
+ * Each field of the songs is kept in its own array and strings are
+ * stored once in a pool owned by the array: a song only costs a few
+ * integers and songs with the same artist or album share the same
+ * string. Strings no longer used by any song are released when they
+ * become the majority of the pool, unless strings were interned by the
+ * caller. All strings are released with the array.
+ */
+typedef struct ArioSongArray ArioSongArray;
+
+ArioSongArray *         ario_song_array_new             (void);
+
+void                    ario_song_array_free            (ArioSongArray *array);
+
+guint                   ario_song_array_get_length      (const ArioSongArray *array);
+
+guint                   ario_song_array_append          (ArioSongArray *array,
+                                                         const ArioServerSong *song);
+
+void                    ario_song_array_set             (ArioSongArray *array,
+                                                         const guint i,
+                                                         const ArioServerSong *song);
+
+void                    ario_song_array_set_length      (ArioSongArray *array,
+                                                         const guint length);
+
+/* Move songs: song at position new_order[i] is moved to position i */
+void                    ario_song_array_reorder         (ArioSongArray *array,
+                                                         const gint *new_order);
+
+/* Fill song with the fields of song i, strings belong to the array,
+ * must not be freed and are valid until the array is modified */
+void                    ario_song_array_get             (const ArioSongArray *array,
+                                                         const guint i,
+                                                         ArioServerSong *song);
+
+const gchar *           ario_song_array_get_tag         (const ArioSongArray *array,
+                                                         const guint i,
+                                                         const ArioServerTag tag);
+
+gint                    ario_song_array_get_time        (const ArioSongArray *array,
+                                                         const guint i);
+
+/* Strings of the pool: two equal strings of the pool have the same
+ * address and can be compared with pointers. Interned strings stay
+ * valid as long as the array exists */
+const gchar *           ario_song_array_intern          (ArioSongArray *array,
+                                                         const gchar *string);
+
+const gchar *           ario_song_array_lookup          (const ArioSongArray *array,
+                                                         const gchar *string);
+
+/* Add a string to the pool without copy, it must stay valid as long
+ * as the array exists */
+void                    ario_song_array_intern_static   (ArioSongArray *array,
+                                                         const gchar *string);
+
+G_END_DECLS
+
+#endif /* __ARIO_SONG_ARRAY_H */
@@ -35,6 +35,13 @@
 #include <xmmsclient/xmmsclient-glib.h>
 
 #define NORMAL_TIMEOUT 500
+/* Delay before handling the connection again when the server thread
+ * is using it (ms) */
+#define BUSY_TIMEOUT 10
+/* Number of songs looked up before waiting for the answers */
+#define SONGS_INFO_CHUNK 256
+/* Maximum number of songs in the collection of a medialib query */
+#define SONGS_QUERY_CHUNK 4096
 #define LAZY_TIMEOUT 12000
 
 #define GOODCHAR(a) ((((a) >= 'a') && ((a) <= 'z')) || \
@@ -99,8 +106,18 @@ struct ArioXmmsPrivate
         xmmsc_connection_t *connection;
         xmmsc_connection_t *async_connection;
 
+        /* Source handling the IO of connection in the main loop */
+        GSource *source;
+
         int total_time;
 
+        /* Ids and durations of the songs of the current playlist as
+         * sent by the last call to get_playlist_changes, at version
+         * playlist_ids_version */
+        GArray *playlist_ids;
+        GArray *playlist_times;
+        gint64 playlist_ids_version;
+
         GSList *results;
         xmmsc_result_t *res;
 };
@@ -205,6 +222,10 @@ ario_xmms_finalize (GObject *object)
 
         if (xmms->priv->connection)
                 xmmsc_unref (xmms->priv->connection);
+        if (xmms->priv->playlist_ids) {
+                g_array_free (xmms->priv->playlist_ids, TRUE);
+                g_array_free (xmms->priv->playlist_times, TRUE);
+        }
 
         instance = NULL;
         G_OBJECT_CLASS (ario_xmms_parent_class)->finalize (object);
@@ -247,36 +268,146 @@ ario_xmms_get_song_from_res (xmmsc_result_t *result)
         return song;
 }
 /*
+ * Wait for the answer of a request. The answers of other requests
+ * received meanwhile are dispatched to their notifiers. Only used by
+ * queries needing their answer, commands use ario_xmms_result_notify.
+ */
 static void
-wait_cb (xmmsc_result_t *res,
-         gboolean *wait)
+ario_xmms_result_wait (xmmsc_result_t *result)
 {
-        *wait = FALSE;
-        xmmsc_result_unref (res);
+        ARIO_LOG_FUNCTION_START;
+        xmmsc_result_wait (result);
+        if (xmmsc_result_iserror (result)) {
+                ARIO_LOG_ERROR ("Transaction error : %s\n", xmmsc_result_get_error (result));
+        }
 }
-*/
+
 static void
-ario_xmms_result_wait (xmmsc_result_t *result)
+ario_xmms_result_notify_cb (xmmsc_result_t *result,
+                            gpointer data)
+{
+        if (xmmsc_result_iserror (result)) {
+                ARIO_LOG_ERROR ("Transaction error : %s\n", xmmsc_result_get_error (result));
+        }
+}
+
+/*
+ * Send a request without waiting for its answer: it is handled by the
+ * main loop and errors are logged. Many requests can be sent at once.
+ */
+static void
+ario_xmms_result_notify (xmmsc_result_t *result)
 {
         ARIO_LOG_FUNCTION_START;
+        xmmsc_result_notifier_set (result, (xmmsc_result_notifier_t) ario_xmms_result_notify_cb, NULL);
+        xmmsc_result_unref (result);
+}
+
 /*
-        static gboolean block = FALSE;
+ * Main loop integration of the connection, like xmmsclient-glib does
+ * for the broadcasts connection. The connection is also used by the
+ * server thread: it is only handled when the server lock is free, the
+ * server thread reads the answers itself otherwise.
+ */
+typedef struct
+{
+        GSource source;
+        GPollFD poll_fd;
+        xmmsc_connection_t *connection;
+        gboolean busy;
+} ArioXmmsSource;
 
-        while (block)
-                gtk_main_iteration ();
+static gboolean
+ario_xmms_source_prepare (GSource *source,
+                          gint *timeout)
+{
+        ArioXmmsSource *xmms_source = (ArioXmmsSource *) source;
 
-        block = TRUE;
-        gboolean wait = TRUE;
-        xmmsc_result_notifier_set (result, (xmmsc_result_notifier_t) wait_cb, &wait);
+        if (xmms_source->busy) {
+                xmms_source->poll_fd.events = 0;
+                *timeout = BUSY_TIMEOUT;
+                return FALSE;
+        }
 
-        while (wait)
-                gtk_main_iteration ();
-        block = FALSE;
-*/
-        xmmsc_result_wait (result);
-        if (xmmsc_result_iserror (result)) {
-                ARIO_LOG_ERROR ("Transaction error : %s\n", xmmsc_result_get_error (result));
+        xmms_source->poll_fd.events = G_IO_IN | G_IO_ERR | G_IO_HUP;
+        if (xmmsc_io_want_out (xmms_source->connection))
+                xmms_source->poll_fd.events |= G_IO_OUT;
+        *timeout = -1;
+
+        return FALSE;
+}
+
+static gboolean
+ario_xmms_source_check (GSource *source)
+{
+        ArioXmmsSource *xmms_source = (ArioXmmsSource *) source;
+
+        return xmms_source->busy || xmms_source->poll_fd.revents;
+}
+
+static gboolean
+ario_xmms_source_dispatch (GSource *source,
+                           GSourceFunc callback,
+                           gpointer user_data)
+{
+        ArioXmmsSource *xmms_source = (ArioXmmsSource *) source;
+        gushort revents = xmms_source->poll_fd.revents;
+
+        /* The server thread is using the connection: try again later */
+        xmms_source->busy = !ario_server_interface_trylock ();
+        if (xmms_source->busy)
+                return TRUE;
+
+        if (revents & (G_IO_ERR | G_IO_HUP)) {
+                xmmsc_io_disconnect (xmms_source->connection);
+        } else {
+                /* Notifiers of the answers are called here */
+                if (revents & G_IO_IN)
+                        xmmsc_io_in_handle (xmms_source->connection);
+                if (xmmsc_io_want_out (xmms_source->connection))
+                        xmmsc_io_out_handle (xmms_source->connection);
         }
+        ario_server_interface_unlock ();
+
+        return TRUE;
+}
+
+static GSourceFuncs ario_xmms_source_funcs = {
+        ario_xmms_source_prepare,
+        ario_xmms_source_check,
+        ario_xmms_source_dispatch,
+        NULL
+};
+
+static void
+ario_xmms_need_out_cb (int need_out,
+                       gpointer data)
+{
+        /* Requests may be sent by another thread while the main loop
+         * is waiting: it must poll for output now */
+        if (need_out)
+                g_main_context_wakeup (NULL);
+}
+
+static GSource *
+ario_xmms_source_new (xmmsc_connection_t *connection)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSource *source;
+        ArioXmmsSource *xmms_source;
+
+        source = g_source_new (&ario_xmms_source_funcs, sizeof (ArioXmmsSource));
+        xmms_source = (ArioXmmsSource *) source;
+        xmms_source->connection = connection;
+        xmms_source->busy = FALSE;
+        xmms_source->poll_fd.fd = xmmsc_io_fd_get (connection);
+        xmms_source->poll_fd.events = G_IO_IN | G_IO_ERR | G_IO_HUP;
+        g_source_add_poll (source, &xmms_source->poll_fd);
+
+        xmmsc_io_need_out_callback_set (connection, ario_xmms_need_out_cb, NULL);
+        g_source_attach (source, NULL);
+
+        return source;
 }
 
 ArioXmms *
@@ -294,6 +425,9 @@ ario_xmms_get_instance (ArioServer *server)
 static gboolean
 playlist_not_idle (xmmsc_result_t *not_used)
 {
+        /* New version of the playlist, changes since the previous one
+         * are computed by get_playlist_changes */
+        g_object_set (G_OBJECT (instance), "playlist_id", instance->parent.playlist_id + 1, NULL);
         g_signal_emit_by_name (G_OBJECT (server_instance), "playlist_changed");
         return FALSE;
 }
@@ -367,15 +501,17 @@ playback_current_id_not (xmmsc_result_t *res,
 }
 
 static gboolean
-playback_volume_changed_not_idle (xmmsc_result_t *not_used)
+playback_volume_get_idle (xmmsc_result_t *res)
 {
         guint volume;
-        xmmsc_result_t *res;
 
-        res = xmmsc_playback_volume_get (instance->priv->connection);
-        ario_xmms_result_wait (res);
+        if (!instance->priv->connection) {
+                xmmsc_result_unref (res);
+                return FALSE;
+        }
 
-        if (!xmmsc_result_get_dict_entry_uint (res, "left", &volume)) {
+        if (xmmsc_result_iserror (res)
+            || !xmmsc_result_get_dict_entry_uint (res, "left", &volume)) {
                 ARIO_LOG_ERROR ("Result didn't contain right type!");
                 xmmsc_result_unref (res);
                 return FALSE;
@@ -390,11 +526,28 @@ playback_volume_changed_not_idle (xmmsc_result_t *not_used)
         return FALSE;
 }
 
+static void
+playback_volume_get_not (xmmsc_result_t *res,
+                         gpointer data)
+{
+        /* Notifier may be called in the server thread */
+        xmmsc_result_ref (res);
+        g_idle_add ((GSourceFunc) playback_volume_get_idle, res);
+}
+
 static void
 playback_volume_changed_not (xmmsc_result_t *not_used,
                              ArioXmms *xmms)
 {
-        g_idle_add ((GSourceFunc) playback_volume_changed_not_idle, NULL);
+        xmmsc_result_t *res;
+
+        if (!instance->priv->connection)
+                return;
+
+        /* Volume is read without waiting for the answer */
+        res = xmmsc_playback_volume_get (instance->priv->connection);
+        xmmsc_result_notifier_set (res, (xmmsc_result_notifier_t) playback_volume_get_not, NULL);
+        xmmsc_result_unref (res);
 }
 
 static void
@@ -437,17 +590,15 @@ ario_xmms_sync (ArioXmms *xmms)
         /* Sync playlist */
         playlist_not (NULL, xmms);
 
-        /* Sync Playback status */
+        /* Sync Playback status, handled when the answer is received */
         res = xmmsc_playback_status (xmms->priv->connection);
-        ario_xmms_result_wait (res);
-        playback_status_not (res, xmms);
-        instance->priv->results = g_slist_append (instance->priv->results, res);
+        xmmsc_result_notifier_set (res, (xmmsc_result_notifier_t) playback_status_not, xmms);
+        instance->priv->results = g_slist_prepend (instance->priv->results, res);
 
         /* Sync Playback song */
         res = xmmsc_playback_current_id (xmms->priv->connection);
-        ario_xmms_result_wait (res);
-        playback_current_id_not (res, xmms);
-        instance->priv->results = g_slist_append (instance->priv->results, res);
+        xmmsc_result_notifier_set (res, (xmmsc_result_notifier_t) playback_current_id_not, xmms);
+        instance->priv->results = g_slist_prepend (instance->priv->results, res);
 
         /* Sync Volume */
         playback_volume_changed_not (NULL, xmms);
@@ -474,7 +625,7 @@ disconnect_not (ArioXmms *xmms)
         xmmsc_result_t *res = meth (conn); \
         xmmsc_result_notifier_set_full (res, callback, udata, free_func);\
         xmmsc_result_unref (res);\
-        instance->priv->results = g_slist_append (instance->priv->results, res);\
+        instance->priv->results = g_slist_prepend (instance->priv->results, res);\
 }
 
 static gboolean
@@ -529,6 +680,7 @@ ario_xmms_connect_to (ArioXmms *xmms,
         xmmsc_disconnect_callback_set (async_connection, (xmmsc_disconnect_func_t) disconnect_not, xmms);
 
         xmmsc_mainloop_gmain_init (async_connection);
+        xmms->priv->source = ario_xmms_source_new (connection);
         ario_xmms_sync (xmms);
 
         return TRUE;
@@ -581,9 +733,23 @@ ario_xmms_disconnect (void)
                 instance->priv->res = NULL;
         }
 
+        if (instance->priv->source) {
+                g_source_destroy (instance->priv->source);
+                g_source_unref (instance->priv->source);
+                instance->priv->source = NULL;
+        }
+
         xmmsc_unref (instance->priv->connection);
         instance->priv->connection = NULL;
 
+        if (instance->priv->playlist_ids) {
+                g_array_free (instance->priv->playlist_ids, TRUE);
+                g_array_free (instance->priv->playlist_times, TRUE);
+                instance->priv->playlist_ids = NULL;
+                instance->priv->playlist_times = NULL;
+        }
+        instance->priv->total_time = 0;
+
         ario_server_interface_set_default (ARIO_SERVER_INTERFACE (instance));
         ario_server_interface_emit (ARIO_SERVER_INTERFACE (instance), server_instance);
 }
@@ -598,8 +764,7 @@ ario_xmms_update_db (const gchar *path)
         if (!instance->priv->connection)
                 return;
         res = xmmsc_medialib_rehash (instance->priv->connection, 0);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 static gboolean
@@ -664,8 +829,9 @@ ario_xmms_list_tags (const ArioServerTag tag,
                 if (!char_tag)
                         char_tag = ARIO_SERVER_UNKNOWN;
 
-                tags = g_slist_append (tags, g_strdup (char_tag));
+                tags = g_slist_prepend (tags, g_strdup (char_tag));
         }
+        tags = g_slist_reverse (tags);
 
         g_free (pattern);
         xmmsc_coll_unref (coll);
@@ -737,8 +903,9 @@ ario_xmms_get_albums (const ArioServerCriteria *criteria)
                 ario_xmms_album->artist = g_strdup (artist);
                 ario_xmms_album->album = g_strdup (album);
 
-                albums = g_slist_append (albums, ario_xmms_album);
+                albums = g_slist_prepend (albums, ario_xmms_album);
         }
+        albums = g_slist_reverse (albums);
 
         g_free (pattern);
         xmmsc_coll_unref(coll);
@@ -798,8 +965,9 @@ ario_xmms_get_songs (const ArioServerCriteria *criteria,
         ario_xmms_result_wait (res);
         for (; xmmsc_result_list_valid (res); xmmsc_result_list_next (res)) {
                 xmms_song = ario_xmms_get_song_from_res (res);
-                songs = g_slist_append (songs, xmms_song);
+                songs = g_slist_prepend (songs, xmms_song);
         }
+        songs = g_slist_reverse (songs);
 
         g_free (pattern);
         xmmsc_coll_unref(coll);
@@ -808,39 +976,180 @@ ario_xmms_get_songs (const ArioServerCriteria *criteria,
         return songs;
 }
 
-static GSList *
-ario_xmms_get_songs_from_playlist (char *playlist)
+/*
+ * Infos of songs from their ids: id -> ArioServerSong. Infos are
+ * fetched with collection queries returning all the properties of
+ * many songs at once instead of one request per song.
+ */
+static GHashTable *
+ario_xmms_get_songs_by_id (const guint *ids,
+                           const guint n)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
+        GHashTable *songs;
+        GSList *results = NULL, *tmp;
         xmmsc_result_t *res;
-        xmmsc_result_t *res2;
-        guint i;
-        int pos = 0;
+        xmmsc_coll_t *coll;
+        const char *properties[] = { "id", "artist", "album", "title", "genre", "url", "tracknr", "duration", NULL };
+        const char *order[] = { "id", NULL };
+        const char *group_by[] = { "id", NULL };
         ArioServerSong *song;
+        guint i, j;
+
+        songs = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                       NULL, (GDestroyNotify) ario_server_free_song);
+
+        /* Send the queries of all chunks before waiting for the first answer */
+        for (i = 0; i < n; i += SONGS_QUERY_CHUNK) {
+                coll = xmmsc_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+                for (j = i; j < n && j < i + SONGS_QUERY_CHUNK; ++j)
+                        xmmsc_coll_idlist_append (coll, ids[j]);
+                res = xmmsc_coll_query_infos (instance->priv->connection, coll, order,
+                                              0, 0, properties, group_by);
+                xmmsc_coll_unref (coll);
+                results = g_slist_prepend (results, res);
+        }
+        results = g_slist_reverse (results);
 
-        res = xmmsc_playlist_list_entries (instance->priv->connection, playlist);
+        for (tmp = results; tmp; tmp = g_slist_next (tmp)) {
+                res = tmp->data;
+                ario_xmms_result_wait (res);
+                for (; xmmsc_result_list_valid (res); xmmsc_result_list_next (res)) {
+                        song = ario_xmms_get_song_from_res (res);
+                        g_hash_table_insert (songs, GINT_TO_POINTER (song->id), song);
+                }
+                xmmsc_result_unref (res);
+        }
+        g_slist_free (results);
 
-        ario_xmms_result_wait (res);
+        return songs;
+}
 
-        instance->priv->total_time = 0;
+/* Ids of the entries of a playlist (NULL for the current one) */
+static GArray *
+ario_xmms_get_playlist_ids (const char *playlist)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *ids;
+        xmmsc_result_t *res;
+        guint id;
+
+        ids = g_array_new (FALSE, FALSE, sizeof (guint));
+
+        res = xmmsc_playlist_list_entries (instance->priv->connection, playlist);
+        ario_xmms_result_wait (res);
         for (; xmmsc_result_list_valid (res); xmmsc_result_list_next (res)) {
-                if (!xmmsc_result_get_uint(res, &i))
+                if (xmmsc_result_get_uint (res, &id))
+                        g_array_append_val (ids, id);
+                else
                         ARIO_LOG_ERROR ("Broken result");
-                res2 = xmmsc_medialib_get_info (instance->priv->connection, i);
-                ario_xmms_result_wait (res2);
+        }
+        xmmsc_result_unref (res);
 
-                song = ario_xmms_get_song_from_res (res2);
+        return ids;
+}
 
+/*
+ * Songs of a playlist at positions (all positions if NULL), with their
+ * position set
+ */
+static GSList *
+ario_xmms_get_playlist_songs (GArray *ids,
+                              GArray *positions)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *songs = NULL;
+        GHashTable *infos;
+        ArioServerSong *song;
+        guint *wanted;
+        guint i, n, pos;
+
+        n = positions ? positions->len : ids->len;
+        wanted = g_new (guint, n);
+        for (i = 0; i < n; ++i) {
+                pos = positions ? g_array_index (positions, guint, i) : i;
+                wanted[i] = g_array_index (ids, guint, pos);
+        }
+        infos = ario_xmms_get_songs_by_id (wanted, n);
+        g_free (wanted);
+
+        for (i = n; i > 0; --i) {
+                pos = positions ? g_array_index (positions, guint, i - 1) : i - 1;
+                song = g_hash_table_lookup (infos, GINT_TO_POINTER (g_array_index (ids, guint, pos)));
+                if (!song) {
+                        ARIO_LOG_ERROR ("Song %d not found in medialib", g_array_index (ids, guint, pos));
+                        continue;
+                }
+
+                /* A song may be several times in the playlist */
+                song = ario_server_copy_song (song);
                 song->pos = pos;
-                ++pos;
-                xmmsc_result_unref (res2);
-                songs = g_slist_append (songs, song);
-                instance->priv->total_time += song->time;
+                songs = g_slist_prepend (songs, song);
         }
-        instance->parent.playlist_length = pos;
+        g_hash_table_destroy (infos);
 
-        xmmsc_result_unref (res);
+        return songs;
+}
+
+/* Songs from their encoded urls, in the same order */
+static GSList *
+ario_xmms_get_songs_by_url (const GSList *urls)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *ids;
+        GHashTable *infos;
+        GSList *songs = NULL;
+        const GSList *tmp;
+        ArioServerSong *song;
+        xmmsc_result_t *res[SONGS_INFO_CHUNK];
+        guint id;
+        int i, n;
+
+        /* Ids are looked up by chunks: requests of a chunk are sent
+         * before waiting for the first answer */
+        ids = g_array_new (FALSE, FALSE, sizeof (guint));
+        tmp = urls;
+        while (tmp) {
+                for (n = 0; tmp && n < SONGS_INFO_CHUNK; tmp = g_slist_next (tmp), ++n)
+                        res[n] = xmmsc_medialib_get_id (instance->priv->connection, tmp->data);
+
+                for (i = 0; i < n; ++i) {
+                        ario_xmms_result_wait (res[i]);
+                        if (xmmsc_result_get_uint (res[i], &id) && id > 0)
+                                g_array_append_val (ids, id);
+                        else
+                                ARIO_LOG_ERROR ("Broken result or path not found");
+                        xmmsc_result_unref (res[i]);
+                }
+        }
+
+        /* Then infos of all songs at once */
+        infos = ario_xmms_get_songs_by_id ((guint *) ids->data, ids->len);
+        for (i = ids->len; i > 0; --i) {
+                song = g_hash_table_lookup (infos, GINT_TO_POINTER (g_array_index (ids, guint, i - 1)));
+                if (song)
+                        songs = g_slist_prepend (songs, ario_server_copy_song (song));
+        }
+        g_hash_table_destroy (infos);
+        g_array_free (ids, TRUE);
+
+        return songs;
+}
+
+static GSList *
+ario_xmms_get_songs_from_playlist (char *playlist)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *songs;
+        GArray *ids;
+
+        /* check if there is a connection */
+        if (!instance->priv->connection)
+                return NULL;
+
+        ids = ario_xmms_get_playlist_ids (playlist);
+        songs = ario_xmms_get_playlist_songs (ids, NULL);
+        g_array_free (ids, TRUE);
 
         return songs;
 }
@@ -859,8 +1168,9 @@ ario_xmms_get_playlists (void)
         for (; xmmsc_result_list_valid (res); xmmsc_result_list_next (res)) {
                 xmmsc_result_get_string (res, &playlist);
                 if (playlist && *playlist != '_')
-                        playlists = g_slist_append (playlists, g_strdup (playlist));
+                        playlists = g_slist_prepend (playlists, g_strdup (playlist));
         }
+        playlists = g_slist_reverse (playlists);
         xmmsc_result_unref (res);
 
         return playlists;
@@ -890,7 +1200,64 @@ static GSList *
 ario_xmms_get_playlist_changes (gint64 playlist_id)
 {
         ARIO_LOG_FUNCTION_START;
-        return ario_xmms_get_songs_from_playlist (NULL);
+        GSList *songs, *tmp;
+        GArray *ids, *positions, *times;
+        ArioServerSong *song;
+        guint pos, old_length = 0;
+
+        /* check if there is a connection */
+        if (!instance->priv->connection)
+                return NULL;
+
+        ids = ario_xmms_get_playlist_ids (NULL);
+
+        /* Like MPD plchanges: only songs at positions that changed since
+         * the version known by the caller, which is the version of the
+         * ids sent last time */
+        if (!instance->priv->playlist_ids
+            || playlist_id < 0
+            || playlist_id != instance->priv->playlist_ids_version) {
+                if (instance->priv->playlist_ids) {
+                        g_array_free (instance->priv->playlist_ids, TRUE);
+                        g_array_free (instance->priv->playlist_times, TRUE);
+                }
+                instance->priv->playlist_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+                instance->priv->playlist_times = g_array_new (FALSE, TRUE, sizeof (gint));
+                instance->priv->total_time = 0;
+        } else {
+                old_length = instance->priv->playlist_ids->len;
+        }
+
+        positions = g_array_new (FALSE, FALSE, sizeof (guint));
+        for (pos = 0; pos < ids->len; ++pos) {
+                if (pos >= old_length
+                    || g_array_index (ids, guint, pos) != g_array_index (instance->priv->playlist_ids, guint, pos))
+                        g_array_append_val (positions, pos);
+        }
+        songs = ario_xmms_get_playlist_songs (ids, positions);
+
+        /* Update total time with the durations of removed and changed songs */
+        times = instance->priv->playlist_times;
+        for (pos = ids->len; pos < old_length; ++pos)
+                instance->priv->total_time -= g_array_index (times, gint, pos);
+        g_array_set_size (times, ids->len);
+        for (pos = 0; pos < positions->len; ++pos) {
+                instance->priv->total_time -= g_array_index (times, gint, g_array_index (positions, guint, pos));
+                g_array_index (times, gint, g_array_index (positions, guint, pos)) = 0;
+        }
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
+                song = tmp->data;
+                g_array_index (times, gint, song->pos) = song->time;
+                instance->priv->total_time += song->time;
+        }
+        g_array_free (positions, TRUE);
+
+        g_array_free (instance->priv->playlist_ids, TRUE);
+        instance->priv->playlist_ids = ids;
+        instance->priv->playlist_ids_version = instance->parent.playlist_id;
+        instance->parent.playlist_length = ids->len;
+
+        return songs;
 }
 
 static ArioServerSong *
@@ -944,12 +1311,10 @@ ario_xmms_do_next (void)
                 return;
 
         res  = xmmsc_playlist_set_next_rel (instance->priv->connection, 1);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 
         res = xmmsc_playback_tickle (instance->priv->connection);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 void
@@ -963,12 +1328,10 @@ ario_xmms_do_prev (void)
                 return;
 
         res = xmmsc_playlist_set_next_rel (instance->priv->connection, -1);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 
         res = xmmsc_playback_tickle (instance->priv->connection);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 
 }
 
@@ -983,8 +1346,7 @@ ario_xmms_do_play (void)
                 return;
 
         res = xmmsc_playback_start (instance->priv->connection);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 void
@@ -997,14 +1359,11 @@ ario_xmms_do_play_pos (gint id)
         if (!instance->priv->connection)
                 return;
         res  = xmmsc_playback_start (instance->priv->connection);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
         res  = xmmsc_playlist_set_next (instance->priv->connection, id);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
         res = xmmsc_playback_tickle (instance->priv->connection);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 void
@@ -1018,8 +1377,7 @@ ario_xmms_do_pause (void)
                 return;
 
         res = xmmsc_playback_pause (instance->priv->connection);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 void
@@ -1033,8 +1391,7 @@ ario_xmms_do_stop (void)
                 return;
 
         res = xmmsc_playback_stop (instance->priv->connection);
-        ario_xmms_result_wait (res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 void
@@ -1048,27 +1405,20 @@ ario_xmms_set_current_elapsed (const gint elapsed)
                 return;
 
         res = xmmsc_playback_seek_ms (instance->priv->connection, elapsed * 1000);
-        ario_xmms_result_wait(res);
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 void
 ario_xmms_set_current_volume (const gint volume)
 {
         ARIO_LOG_FUNCTION_START;
-        xmmsc_result_t *res;
-        xmmsc_result_t *res2;
-
         /* check if there is a connection */
         if (!instance->priv->connection)
                 return;
 
-        res = xmmsc_playback_volume_set (instance->priv->connection, "left", volume);
-        res2 = xmmsc_playback_volume_set (instance->priv->connection, "right", volume);
-        ario_xmms_result_wait (res);
-        ario_xmms_result_wait (res2);
-        xmmsc_result_unref (res);
-        xmmsc_result_unref (res2);
+        /* Both channels are set at the same time */
+        ario_xmms_result_notify (xmmsc_playback_volume_set (instance->priv->connection, "left", volume));
+        ario_xmms_result_notify (xmmsc_playback_volume_set (instance->priv->connection, "right", volume));
 }
 
 void
@@ -1107,10 +1457,8 @@ ario_xmms_set_current_repeat (const gboolean repeat)
                 res = xmmsc_configval_set (instance->priv->connection, "playlist.repeat_all", "1");
         else
                 res = xmmsc_configval_set (instance->priv->connection, "playlist.repeat_all", "0");
-        ario_xmms_result_wait (res);
+        ario_xmms_result_notify (res);
         g_object_set (G_OBJECT (instance), "repeat", repeat, NULL);
-
-        xmmsc_result_unref (res);
 }
 
 void
@@ -1134,9 +1482,7 @@ ario_xmms_clear (void)
         if (!instance->priv->connection)
                 return;
         res = xmmsc_playlist_clear (instance->priv->connection, NULL);
-        ario_xmms_result_wait (res);
-
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 void
@@ -1150,9 +1496,7 @@ ario_xmms_shuffle (void)
                 return;
 
         res = xmmsc_playlist_shuffle (instance->priv->connection, NULL);
-        ario_xmms_result_wait (res);
-
-        xmmsc_result_unref (res);
+        ario_xmms_result_notify (res);
 }
 
 static void
@@ -1167,13 +1511,15 @@ ario_xmms_queue_commit (void)
         if (!instance->priv->connection)
                 return;
 
+        /* XMMS2 has no range commands */
+        ario_server_queue_expand_ranges ();
+
         for (tmp = instance->parent.queue; tmp; tmp = g_slist_next (tmp)) {
                 queue_action = (ArioServerQueueAction *) tmp->data;
                 if (queue_action->type == ARIO_SERVER_ACTION_ADD) {
                         if (queue_action->path) {
                                 res = xmmsc_playlist_add_url (instance->priv->connection, NULL, queue_action->path);
-                                ario_xmms_result_wait(res);
-                                xmmsc_result_unref (res);
+                                ario_xmms_result_notify (res);
                         }
                 } else if (queue_action->type == ARIO_SERVER_ACTION_DELETE_ID) {
                         if(queue_action->id >= 0) {
@@ -1182,14 +1528,12 @@ ario_xmms_queue_commit (void)
                 } else if (queue_action->type == ARIO_SERVER_ACTION_DELETE_POS) {
                         if(queue_action->pos >= 0) {
                                 res = xmmsc_playlist_remove_entry (instance->priv->connection, NULL, queue_action->pos);
-                                ario_xmms_result_wait(res);
-                                xmmsc_result_unref(res);
+                                ario_xmms_result_notify (res);
                         }
                 } else if (queue_action->type == ARIO_SERVER_ACTION_MOVE) {
                         if (queue_action->id >= 0) {
                                 res = xmmsc_playlist_move_entry (instance->priv->connection, NULL, queue_action->old_pos, queue_action->new_pos);
-                                ario_xmms_result_wait(res);
-                                xmmsc_result_unref(res);
+                                ario_xmms_result_notify (res);
                         }
                 } else if (queue_action->type == ARIO_SERVER_ACTION_MOVEID) {
                         /* TODO */
@@ -1260,8 +1604,7 @@ ario_xmms_insert_at (const GSList *songs,
         if (pattern) {
                 if (xmmsc_coll_parse (pattern, &coll)) {
                         res = xmmsc_playlist_insert_collection (instance->priv->connection, NULL, pos + 1, coll, NULL);
-                        ario_xmms_result_wait (res);
-                        xmmsc_result_unref (res);
+                        ario_xmms_result_notify (res);
                         xmmsc_coll_unref (coll);
                 }
                 g_free (pattern);
@@ -1308,8 +1651,7 @@ ario_xmms_delete_playlist (const char *name)
         ARIO_LOG_FUNCTION_START;
         xmmsc_result_t *res;
         res = xmmsc_playlist_remove (instance->priv->connection, name);
-        ario_xmms_result_wait(res);
-        xmmsc_result_unref(res);
+        ario_xmms_result_notify (res);
 }
 
 static GSList *
@@ -1348,36 +1690,27 @@ static GList *
 ario_xmms_get_songs_info (GSList *paths)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *path;
-        GSList *temp;
-        GList *songs = NULL;
-        xmmsc_result_t *res;
-        guint id;
-        ArioServerSong *song;
+        GSList *urls = NULL, *songs, *tmp;
+        GList *ret = NULL;
 
         /* check if there is a connection */
         if (!instance->priv->connection)
                 return NULL;
 
-        for (temp = paths; temp; temp = g_slist_next (temp)) {
-                path = ario_xmms_encode_url (temp->data);
-                res = xmmsc_medialib_get_id (instance->priv->connection, path);
-                ario_xmms_result_wait (res);
-                if (xmmsc_result_get_uint (res, &id) && id > 0) {
-                        xmmsc_result_unref (res);
-                        res = xmmsc_medialib_get_info (instance->priv->connection, id);
-                        ario_xmms_result_wait (res);
+        for (tmp = paths; tmp; tmp = g_slist_next (tmp))
+                urls = g_slist_prepend (urls, ario_xmms_encode_url (tmp->data));
+        urls = g_slist_reverse (urls);
 
-                        song = ario_xmms_get_song_from_res (res);
-                        songs = g_list_append (songs, song);
-                } else {
-                        ARIO_LOG_ERROR ("Broken result or path not found");
-                }
-                xmmsc_result_unref (res);
-                g_free (path);
-        }
+        songs = ario_xmms_get_songs_by_url (urls);
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp))
+                ret = g_list_prepend (ret, tmp->data);
+        ret = g_list_reverse (ret);
 
-        return songs;
+        g_slist_free (songs);
+        g_slist_foreach (urls, (GFunc) g_free, NULL);
+        g_slist_free (urls);
+
+        return ret;
 }
 
 /*
@@ -1410,6 +1743,7 @@ ario_xmms_list_files (const char *path,
         gchar *full_path;
         ArioServerFileList *files;
         GFile *file;
+        GSList *urls = NULL;
 
         files = (ArioServerFileList *) g_malloc0 (sizeof (ArioServerFileList));
 
@@ -1447,27 +1781,19 @@ ario_xmms_list_files (const char *path,
                 decode_url = xmmsc_result_decode_url (res, r);
                 xmmsc_result_get_dict_entry_int (res, "isdir", &d);
                 if (d) {
-                        files->directories = g_slist_append (files->directories, g_strdup (decode_url + url_length));
+                        files->directories = g_slist_prepend (files->directories, g_strdup (decode_url + url_length));
                 } else {
-                        uint32_t id;
-                        xmmsc_result_t *res2;
-                        xmmsc_result_t *res3;
-                        res2 = xmmsc_medialib_get_id (instance->priv->connection, r);
-                        ario_xmms_result_wait (res2);
-                        if (xmmsc_result_get_uint (res2, &id)) {
-                                if (id > 0) {
-                                        res3 = xmmsc_medialib_get_info (instance->priv->connection, id);
-                                        ario_xmms_result_wait (res3);
-                                        files->songs = g_slist_append (files->songs, ario_xmms_get_song_from_res (res3));
-                                        xmmsc_result_unref (res3);
-                                }
-                        } else {
-                                ARIO_LOG_ERROR ("Broken result");
-                        }
-                        xmmsc_result_unref (res2);
+                        /* Songs infos are fetched all at once below */
+                        urls = g_slist_prepend (urls, g_strdup (r));
                 }
         }
         xmmsc_result_unref (res);
+        files->directories = g_slist_reverse (files->directories);
+
+        urls = g_slist_reverse (urls);
+        files->songs = ario_xmms_get_songs_by_url (urls);
+        g_slist_foreach (urls, (GFunc) g_free, NULL);
+        g_slist_free (urls);
 
         return files;
 }
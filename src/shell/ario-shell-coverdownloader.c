@@ -35,17 +35,17 @@ static GObject * ario_shell_coverdownloader_constructor (GType type, guint n_con
 static gboolean ario_shell_coverdownloader_window_delete_cb (GtkWidget *window,
                                                              GdkEventAny *event,
                                                              ArioShellCoverdownloader *ario_shell_coverdownloader);
-static void ario_shell_coverdownloader_get_cover (ArioShellCoverdownloader *ario_shell_coverdownloader,
-                                                  const char *artist,
-                                                  const char *album,
-                                                  const char *path);
+static void ario_shell_coverdownloader_save_cover (const ArioServerAlbum *server_album,
+                                                   GArray *file_size,
+                                                   GSList *file_contents,
+                                                   ArioShellCoverdownloader *ario_shell_coverdownloader);
 static void ario_shell_coverdownloader_close_cb (GtkButton *button,
                                                  ArioShellCoverdownloader *ario_shell_coverdownloader);
 static void ario_shell_coverdownloader_cancel_cb (GtkButton *button,
                                                   ArioShellCoverdownloader *ario_shell_coverdownloader);
-static void ario_shell_coverdownloader_get_cover_from_album (ArioShellCoverdownloader *ario_shell_coverdownloader,
-                                                             const ArioServerAlbum *server_album,
-                                                             const ArioShellCoverdownloaderOperation operation);
+static gboolean ario_shell_coverdownloader_get_cover_from_album (ArioShellCoverdownloader *ario_shell_coverdownloader,
+                                                                 const ArioServerAlbum *server_album,
+                                                                 const ArioShellCoverdownloaderOperation operation);
 
 struct ArioShellCoverdownloaderPrivate
 {
@@ -380,6 +380,7 @@ ario_shell_coverdownloader_get_covers_from_albums_thread (ArioShellCoverdownload
 {
         ARIO_LOG_FUNCTION_START;
         GSList *tmp;
+        GSList *missing_albums = NULL;
 
         if (!ario_shell_coverdownloader->priv->albums)
                 return NULL;
@@ -390,17 +391,31 @@ ario_shell_coverdownloader_get_covers_from_albums_thread (ArioShellCoverdownload
 
         ario_shell_coverdownloader->priv->nb_covers = g_slist_length (ario_shell_coverdownloader->priv->albums);
 
-        /* While there are still covers to search */
+        /* For each album */
         for (tmp = ario_shell_coverdownloader->priv->albums; tmp; tmp = g_slist_next (tmp)) {
                 /* The user has pressed the "cancel button" or has closed the window : we stop the search */
                 if (ario_shell_coverdownloader->priv->cancelled)
                         break;
 
-                /* We search for a new cover */
-                ario_shell_coverdownloader_get_cover_from_album (ario_shell_coverdownloader,
-                                                                 tmp->data,
-                                                                 ario_shell_coverdownloader->priv->operation);
+                /* We keep the albums without cover */
+                if (ario_shell_coverdownloader_get_cover_from_album (ario_shell_coverdownloader,
+                                                                     tmp->data,
+                                                                     ario_shell_coverdownloader->priv->operation))
+                        missing_albums = g_slist_prepend (missing_albums, tmp->data);
         }
+        missing_albums = g_slist_reverse (missing_albums);
+
+        /* We search for the missing covers, many albums at the same time */
+        if (missing_albums) {
+                ario_cover_manager_get_covers_from_albums (ario_cover_manager_get_instance (),
+                                                           missing_albums,
+                                                           GET_FIRST_COVER,
+                                                           (ArioCoverFetcherFunc) ario_shell_coverdownloader_save_cover,
+                                                           ario_shell_coverdownloader,
+                                                           &ario_shell_coverdownloader->priv->cancelled);
+                g_slist_free (missing_albums);
+        }
+
         /* We change the window to show a close button and infos about the search */
         if (ario_shell_coverdownloader->priv->operation == GET_COVERS)
                 g_idle_add ((GSourceFunc) ario_shell_coverdownloader_progress_end, ario_shell_coverdownloader);
@@ -439,6 +454,22 @@ ario_shell_coverdownloader_get_covers_from_albums (ArioShellCoverdownloader *ari
 }
 
 static void
+ario_shell_coverdownloader_progress (ArioShellCoverdownloader *ario_shell_coverdownloader,
+                                     const ArioServerAlbum *server_album)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioShellCoverdownloaderIdleData *data;
+
+        /* We update the progress bar */
+        data = (ArioShellCoverdownloaderIdleData *) g_malloc0 (sizeof (ArioShellCoverdownloaderIdleData));
+
+        data->ario_shell_coverdownloader = ario_shell_coverdownloader;
+        data->artist = g_strdup (server_album->artist);
+        data->album = g_strdup (server_album->album);
+        g_idle_add ((GSourceFunc) ario_shell_coverdownloader_progress_update, data);
+}
+
+static gboolean
 ario_shell_coverdownloader_get_cover_from_album (ArioShellCoverdownloader *ario_shell_coverdownloader,
                                                  const ArioServerAlbum *server_album,
                                                  const ArioShellCoverdownloaderOperation operation)
@@ -446,35 +477,26 @@ ario_shell_coverdownloader_get_cover_from_album (ArioShellCoverdownloader *ario_
         ARIO_LOG_FUNCTION_START;
         const gchar *artist;
         const gchar *album;
-        const gchar *path;
-        ArioShellCoverdownloaderIdleData *data;
 
         if (!server_album)
-                return;
+                return FALSE;
 
         artist = server_album->artist;
         album = server_album->album;
-        path = server_album->path;
 
         if (!album || !artist)
-                return;
+                return FALSE;
 
         switch (operation) {
         case GET_COVERS:
-                /* We update the progress bar */
-                data = (ArioShellCoverdownloaderIdleData *) g_malloc0 (sizeof (ArioShellCoverdownloaderIdleData));
-
-                data->ario_shell_coverdownloader = ario_shell_coverdownloader;
-                data->artist = g_strdup (artist);
-                data->album = g_strdup (album);
-                g_idle_add ((GSourceFunc) ario_shell_coverdownloader_progress_update, data);
-
-                if (ario_cover_cover_exists (artist, album))
+                if (ario_cover_cover_exists (artist, album)) {
                         /* The cover already exists, we do nothing */
                         ++ario_shell_coverdownloader->priv->nb_covers_already_exist;
-                else
-                        /* We search for the cover */
-                        ario_shell_coverdownloader_get_cover (ario_shell_coverdownloader, artist, album, path);
+                        ario_shell_coverdownloader_progress (ario_shell_coverdownloader, server_album);
+                } else {
+                        /* We will search for the cover */
+                        return TRUE;
+                }
                 break;
 
         case REMOVE_COVERS:
@@ -485,47 +507,37 @@ ario_shell_coverdownloader_get_cover_from_album (ArioShellCoverdownloader *ario_
         default:
                 break;
         }
+
+        return FALSE;
 }
 
 static void
-ario_shell_coverdownloader_get_cover (ArioShellCoverdownloader *ario_shell_coverdownloader,
-                                      const char *artist,
-                                      const char *album,
-                                      const char *path)
+ario_shell_coverdownloader_save_cover (const ArioServerAlbum *server_album,
+                                       GArray *file_size,
+                                       GSList *file_contents,
+                                       ArioShellCoverdownloader *ario_shell_coverdownloader)
 {
         ARIO_LOG_FUNCTION_START;
-        GArray *size;
-        GSList *data = NULL;
-        gboolean ret;
-
-        size = g_array_new (TRUE, TRUE, sizeof (int));
-
-        /* If a cover is found, it is loaded in data(0) */
-        ret = ario_cover_manager_get_covers (ario_cover_manager_get_instance (),
-                                             artist,
-                                             album,
-                                             path,
-                                             &size,
-                                             &data,
-                                             GET_FIRST_COVER);
+        gboolean ret = FALSE;
 
         /* If the cover is not too big and not too small (blank image), we save it */
-        if (ret && ario_cover_size_is_valid (g_array_index (size, int, 0))) {
-                ret = ario_cover_save_cover (artist,
-                                             album,
-                                             g_slist_nth_data (data, 0),
-                                             g_array_index (size, int, 0),
+        if (file_size->len > 0
+            && ario_cover_size_is_valid (g_array_index (file_size, int, 0))) {
+                ret = ario_cover_save_cover (server_album->artist,
+                                             server_album->album,
+                                             g_slist_nth_data (file_contents, 0),
+                                             g_array_index (file_size, int, 0),
                                              OVERWRITE_MODE_SKIP);
+        }
 
-                if (ret)
-                        ++ario_shell_coverdownloader->priv->nb_covers_found;
-                else
-                        ++ario_shell_coverdownloader->priv->nb_covers_not_found;
-        } else {
+        if (ret)
+                ++ario_shell_coverdownloader->priv->nb_covers_found;
+        else
                 ++ario_shell_coverdownloader->priv->nb_covers_not_found;
-        }
 
-        g_array_free (size, TRUE);
-        g_slist_foreach (data, (GFunc) g_free, NULL);
-        g_slist_free (data);
+        ario_shell_coverdownloader_progress (ario_shell_coverdownloader, server_album);
+
+        g_array_free (file_size, TRUE);
+        g_slist_foreach (file_contents, (GFunc) g_free, NULL);
+        g_slist_free (file_contents);
 }
@@ -21,6 +21,7 @@
 #include <config.h>
 #include <gtk/gtk.h>
 #include <stdlib.h>
+#include <time.h>
 #include <libxml/parser.h>
 #include <glib/gi18n.h>
 
@@ -46,6 +47,20 @@ G_MODULE_EXPORT void ario_shell_similarartists_addall_cb (GtkButton *button,
 #define MAX_ARTISTS 10
 #define IMAGE_SIZE 120
 
+/* Similar artists are kept in memory during 1 day */
+#define SIMILAR_ARTISTS_TTL 24*60*60
+
+/* Similar artists of an artist, as downloaded at date */
+typedef struct
+{
+        GSList *similar_artists;
+        time_t date;
+} ArioSimilarArtistsCacheEntry;
+
+/* Artist name -> ArioSimilarArtistsCacheEntry */
+static GHashTable *similar_artists_cache = NULL;
+static GStaticMutex similar_artists_cache_lock = G_STATIC_MUTEX_INIT;
+
 /* Private attributes */
 struct ArioShellSimilarartistsPrivate
 {
@@ -165,6 +180,92 @@ ario_shell_similarartists_free_similarartist (ArioSimilarArtist *similar_artist)
         }
 }
 
+static ArioSimilarArtist *
+ario_shell_similarartists_copy_similarartist (const ArioSimilarArtist *similar_artist)
+{
+        ArioSimilarArtist *ret;
+
+        ret = (ArioSimilarArtist *) g_malloc (sizeof (ArioSimilarArtist));
+        ret->name = (guchar *) g_strdup ((gchar *) similar_artist->name);
+        ret->image = (guchar *) g_strdup ((gchar *) similar_artist->image);
+        ret->url = (guchar *) g_strdup ((gchar *) similar_artist->url);
+
+        return ret;
+}
+
+static GSList *
+ario_shell_similarartists_copy_similarartists (const GSList *similar_artists)
+{
+        const GSList *tmp;
+        GSList *ret = NULL;
+
+        for (tmp = similar_artists; tmp; tmp = g_slist_next (tmp))
+                ret = g_slist_prepend (ret, ario_shell_similarartists_copy_similarartist (tmp->data));
+
+        return g_slist_reverse (ret);
+}
+
+static void
+ario_shell_similarartists_free_cache_entry (ArioSimilarArtistsCacheEntry *entry)
+{
+        g_slist_foreach (entry->similar_artists, (GFunc) ario_shell_similarartists_free_similarartist, NULL);
+        g_slist_free (entry->similar_artists);
+        g_free (entry);
+}
+
+static gboolean
+ario_shell_similarartists_cache_entry_expired (gpointer key,
+                                               ArioSimilarArtistsCacheEntry *entry,
+                                               time_t *now)
+{
+        return *now - entry->date >= SIMILAR_ARTISTS_TTL;
+}
+
+static gboolean
+ario_shell_similarartists_cache_lookup (const gchar *artist,
+                                        GSList **similar_artists)
+{
+        ArioSimilarArtistsCacheEntry *entry = NULL;
+
+        g_static_mutex_lock (&similar_artists_cache_lock);
+        if (similar_artists_cache)
+                entry = g_hash_table_lookup (similar_artists_cache, artist);
+        if (entry && time (NULL) - entry->date < SIMILAR_ARTISTS_TTL) {
+                *similar_artists = ario_shell_similarartists_copy_similarartists (entry->similar_artists);
+        } else {
+                entry = NULL;
+        }
+        g_static_mutex_unlock (&similar_artists_cache_lock);
+
+        return entry != NULL;
+}
+
+static void
+ario_shell_similarartists_cache_insert (const gchar *artist,
+                                        const GSList *similar_artists)
+{
+        ArioSimilarArtistsCacheEntry *entry;
+        time_t now = time (NULL);
+
+        entry = (ArioSimilarArtistsCacheEntry *) g_malloc (sizeof (ArioSimilarArtistsCacheEntry));
+        entry->similar_artists = ario_shell_similarartists_copy_similarartists (similar_artists);
+        entry->date = now;
+
+        g_static_mutex_lock (&similar_artists_cache_lock);
+        if (!similar_artists_cache) {
+                similar_artists_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                               g_free,
+                                                               (GDestroyNotify) ario_shell_similarartists_free_cache_entry);
+        }
+
+        /* Old entries are dropped so that the cache doesn't grow forever */
+        g_hash_table_foreach_remove (similar_artists_cache,
+                                     (GHRFunc) ario_shell_similarartists_cache_entry_expired,
+                                     &now);
+        g_hash_table_replace (similar_artists_cache, g_strdup (artist), entry);
+        g_static_mutex_unlock (&similar_artists_cache_lock);
+}
+
 static gboolean
 ario_shell_similarartists_get_images_foreach (GtkTreeModel *model,
                                               GtkTreePath *path,
@@ -257,6 +358,13 @@ ario_shell_similarartists_get_similar_artists (const gchar *artist)
         char *xml_data;
         GSList *similar_artists;
 
+        if (!artist)
+                return NULL;
+
+        /* Similar artists already downloaded recently */
+        if (ario_shell_similarartists_cache_lookup (artist, &similar_artists))
+                return similar_artists;
+
         /* Format artist */
         keyword = ario_util_format_keyword (artist);
 
@@ -279,6 +387,8 @@ ario_shell_similarartists_get_similar_artists (const gchar *artist)
                                                                     xml_size);
         g_free (xml_data);
 
+        ario_shell_similarartists_cache_insert (artist, similar_artists);
+
         return similar_artists;
 }
 
@@ -56,6 +56,8 @@ GType              ario_shell_similarartists_get_type                   (void) G
 
 GtkWidget *        ario_shell_similarartists_new                        (void);
 
+/* Similar artists of artist from last.fm, kept in memory for one day.
+ * Can be called from any thread */
 GSList *           ario_shell_similarartists_get_similar_artists        (const gchar *artist);
 
 void               ario_shell_similarartists_add_similar_to_playlist    (const gchar *artist,
@@ -136,15 +136,18 @@ static void ario_browser_goto_playling_song (ArioSource *source)
         ARIO_LOG_FUNCTION_START;
         ArioBrowser *browser = ARIO_BROWSER (source);
         GSList *tmp;
+        gboolean wait_fill = FALSE;
         ArioServerSong *song = ario_server_get_current_song ();
 
         /* Not playing, do nothing */
         if (!song)
                 return;
 
-        /* Go to playing song in each tree */
+        /* Go to playing song in each tree. Once a tree waits for its
+         * fill, the next ones will be filled again after it. */
         for (tmp = browser->priv->trees; tmp; tmp = g_slist_next (tmp)) {
-                ario_tree_goto_playling_song (ARIO_TREE (tmp->data), song);
+                wait_fill = ario_tree_goto_playling_song (ARIO_TREE (tmp->data),
+                                                          song, wait_fill);
         }
 }
 
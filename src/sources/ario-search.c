@@ -28,11 +28,15 @@
 #include "ario-util.h"
 #include "ario-debug.h"
 #include "servers/ario-server.h"
+#include "servers/ario-index.h"
 
 #ifdef ENABLE_SEARCH
 
 #define SEARCH_DELAY 250
+/* Number of songs added to the list at once */
+#define SEARCH_PAGE_SIZE 200
 
+static void ario_search_finalize (GObject *object);
 static void ario_search_set_property (GObject *object,
                                       guint prop_id,
                                       const GValue *value,
@@ -43,6 +47,8 @@ static void ario_search_get_property (GObject *object,
                                       GParamSpec *pspec);
 static void ario_search_connectivity_changed_cb (ArioServer *server,
                                                  ArioSearch *search);
+static void ario_search_library_changed_cb (ArioServer *server,
+                                            ArioSearch *search);
 static void ario_search_entry_changed (GtkEntry *entry,
                                        ArioSearch *search);
 static void ario_search_entry_clear (GtkEntry *entry,
@@ -62,6 +68,17 @@ struct ArioSearchPrivate
         GtkUIManager *ui_manager;
 
         guint event_id;
+
+        /* Last search and its results, used to refine the search when
+         * words are added to the query */
+        ArioServerCriteria *criteria;
+        GSList *songs;
+        /* Whether songs contains all the songs matching criteria */
+        gboolean complete;
+
+        /* Next song to add to the list */
+        GSList *next;
+        guint page_id;
 };
 
 /* Actions */
@@ -122,6 +139,7 @@ ario_search_class_init (ArioSearchClass *klass)
         ArioSourceClass *source_class = ARIO_SOURCE_CLASS (klass);
 
         /* Virtual GObject methods */
+        object_class->finalize = ario_search_finalize;
         object_class->set_property = ario_search_set_property;
         object_class->get_property = ario_search_get_property;
 
@@ -180,6 +198,44 @@ ario_search_init (ArioSearch *search)
                             TRUE, TRUE, 0);
 }
 
+static void
+ario_search_reset (ArioSearch *search)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (search->priv->page_id > 0) {
+                g_source_remove (search->priv->page_id);
+                search->priv->page_id = 0;
+        }
+        search->priv->next = NULL;
+
+        g_slist_foreach (search->priv->songs, (GFunc) ario_server_free_song, NULL);
+        g_slist_free (search->priv->songs);
+        search->priv->songs = NULL;
+
+        ario_server_criteria_free (search->priv->criteria);
+        search->priv->criteria = NULL;
+        search->priv->complete = FALSE;
+}
+
+static void
+ario_search_finalize (GObject *object)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioSearch *search;
+
+        g_return_if_fail (object != NULL);
+        g_return_if_fail (IS_ARIO_SEARCH (object));
+
+        search = ARIO_SEARCH (object);
+
+        g_return_if_fail (search->priv != NULL);
+        if (search->priv->event_id > 0)
+                g_source_remove (search->priv->event_id);
+        ario_search_reset (search);
+
+        G_OBJECT_CLASS (ario_search_parent_class)->finalize (object);
+}
+
 static void
 ario_search_set_property (GObject *object,
                           guint prop_id,
@@ -235,6 +291,12 @@ ario_search_new (GtkUIManager *mgr,
         g_signal_connect_object (ario_server_get_instance (),
                                  "state_changed", G_CALLBACK (ario_search_connectivity_changed_cb),
                                  search, 0);
+        g_signal_connect_object (ario_server_get_instance (),
+                                 "connectivity_changed", G_CALLBACK (ario_search_library_changed_cb),
+                                 search, 0);
+        g_signal_connect_object (ario_server_get_instance (),
+                                 "updatingdb_changed", G_CALLBACK (ario_search_library_changed_cb),
+                                 search, 0);
 
         /* Search songs list */
         search->priv->searchs = ario_songlist_new (mgr,
@@ -262,6 +324,18 @@ ario_search_connectivity_changed_cb (ArioServer *server,
         search->priv->connected = ario_server_is_connected ();
 }
 
+static void
+ario_search_library_changed_cb (ArioServer *server,
+                                ArioSearch *search)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Library may have changed: next search must not refine the
+         * previous results */
+        ario_server_criteria_free (search->priv->criteria);
+        search->priv->criteria = NULL;
+        search->priv->complete = FALSE;
+}
+
 static void
 ario_search_entry_changed (GtkEntry *entry,
                            ArioSearch *search)
@@ -283,98 +357,107 @@ ario_search_entry_clear (GtkEntry *entry,
         gtk_entry_set_text (GTK_ENTRY (search->priv->entry), "");
 }
 
-static gboolean
-ario_search_do_search (ArioSearch *search)
+static ArioServerCriteria *
+ario_search_get_criteria (ArioSearch *search)
 {
         ARIO_LOG_FUNCTION_START;
         ArioServerAtomicCriteria *atomic_criteria;
-        GSList *criteria = NULL;
-        GSList *tmp;
-        GSList *songs;
-        ArioServerSong *song;
-        GtkTreeIter iter;
-        gchar *title;
-        GtkListStore *liststore;
-        int i, j;
+        ArioServerCriteria *criteria = NULL;
+        ArioServerTag tag;
         gchar **cmp_str;
-        gboolean tagged_search;
-        gchar *sep, *tag, *value;
+        gchar **words;
         gchar **items;
-        gint len;
+        gchar *sep, *name, *value;
+        int i, j;
 
         /* Split on spaces to have multiple filters */
         cmp_str = g_strsplit (gtk_entry_get_text (GTK_ENTRY (search->priv->entry)), " ", -1);
         if (!cmp_str)
-                return FALSE;
+                return NULL;
 
         /* Loop on every filter */
         for (i = 0; cmp_str[i]; ++i) {
-                len = strlen(cmp_str[i]);
-                /* Only keep words of at least 3 chars for performance reasons */
-                if (g_utf8_collate (cmp_str[i], "")
-                    && len > 2)
-                {
-                        /* Check if we are in the case of a search by tag (like title:foo or artist:bar) */
-                        tagged_search = FALSE;
-                        sep = g_strstr_len (cmp_str[i], len, ":");
-                        if (sep)
-                        {
-                                if (sep - cmp_str[i] == len - 1)
-                                {
-                                        /* separator is the last character (for example: 'title:') 
-                                         * We don't take this string into account */
-                                        tagged_search = TRUE;
-                                }
-                                else
+                tag = ARIO_TAG_ANY;
+                value = cmp_str[i];
+
+                /* Check if we are in the case of a search by tag (like title:foo or artist:bar) */
+                sep = strchr (cmp_str[i], ':');
+                if (sep) {
+                        name = g_strndup (cmp_str[i], sep - cmp_str[i]);
+                        items = ario_server_get_items_names ();
+                        for (j = 0; j < ARIO_TAG_COUNT; ++j) {
+                                if (items[j]
+                                    && (! g_ascii_strcasecmp (name, items[j])
+                                        || ! g_ascii_strcasecmp (name, gettext (items[j]))))
                                 {
-                                        tag = g_strndup (cmp_str[i], sep - cmp_str[i]);
-                                        value = g_strdup (sep + 1);
-
-                                        items = ario_server_get_items_names ();
-                                        for (j = 0; j < ARIO_TAG_COUNT; ++j) {
-                                                if (items[j] && tag
-                                                && (! g_ascii_strcasecmp (tag, items[j])
-                                                        || ! g_ascii_strcasecmp (tag, gettext (items[j]))))
-                                                {
-                                                        atomic_criteria = (ArioServerAtomicCriteria *) g_malloc (sizeof (ArioServerAtomicCriteria));
-                                                        atomic_criteria->tag = j;
-                                                        atomic_criteria->value = g_strdup (value);
-                                                        criteria = g_slist_append (criteria, atomic_criteria);
-                                                        tagged_search = TRUE;
-                                                        break;
-                                                }
-                                        }
+                                        tag = j;
+                                        value = sep + 1;
+                                        break;
                                 }
                         }
+                        g_free (name);
+                }
 
-                        /* Not a search by tag: search in any tag */
-                        if (!tagged_search)
-                        {
-                                atomic_criteria = (ArioServerAtomicCriteria *) g_malloc (sizeof (ArioServerAtomicCriteria));
-                                atomic_criteria->tag = ARIO_TAG_ANY;
-                                atomic_criteria->value = g_strdup (cmp_str[i]);
-                                criteria = g_slist_append (criteria, atomic_criteria);
-                        }
+                /* Every word of the filter must match (nothing for 'title:') */
+                words = ario_util_split_words (value);
+                for (j = 0; words[j]; ++j) {
+                        atomic_criteria = (ArioServerAtomicCriteria *) g_malloc (sizeof (ArioServerAtomicCriteria));
+                        atomic_criteria->tag = tag;
+                        atomic_criteria->value = words[j];
+                        criteria = g_slist_prepend (criteria, atomic_criteria);
                 }
+                g_free (words);
         }
         g_strfreev (cmp_str);
 
-        /* Clear song list */
-        liststore = ario_songlist_get_liststore (ARIO_SONGLIST (search->priv->searchs));
-        gtk_list_store_clear (liststore);
+        return g_slist_reverse (criteria);
+}
+
+/*
+ * A search refines the previous one when each word of the previous one
+ * is still searched, in the same tag, with the same or a longer word:
+ * its results are then a part of the previous results.
+ */
+static gboolean
+ario_search_is_refinement (const ArioServerCriteria *criteria,
+                           const ArioServerCriteria *previous)
+{
+        const GSList *tmp, *tmp2;
+        ArioServerAtomicCriteria *atomic_criteria, *previous_criteria;
+        gboolean found;
 
-        if (!criteria)
+        if (!previous)
                 return FALSE;
 
-        /* Get songs corresponding to criteria */
-        songs = ario_server_get_songs (criteria, FALSE);
+        for (tmp = previous; tmp; tmp = g_slist_next (tmp)) {
+                previous_criteria = tmp->data;
+                found = FALSE;
+                for (tmp2 = criteria; tmp2 && !found; tmp2 = g_slist_next (tmp2)) {
+                        atomic_criteria = tmp2->data;
+                        found = atomic_criteria->tag == previous_criteria->tag
+                                && g_str_has_prefix (atomic_criteria->value, previous_criteria->value);
+                }
+                if (!found)
+                        return FALSE;
+        }
 
-        g_slist_foreach (criteria, (GFunc) g_free, NULL);
-        g_slist_free (criteria);
+        return TRUE;
+}
 
-        /* For each retrieved song */
-        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
-                song = tmp->data;
+static gboolean
+ario_search_add_page (ArioSearch *search)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerSong *song;
+        GtkTreeIter iter;
+        gchar *title;
+        GtkListStore *liststore;
+        int i;
+
+        liststore = ario_songlist_get_liststore (ARIO_SONGLIST (search->priv->searchs));
+
+        for (i = 0; search->priv->next && i < SEARCH_PAGE_SIZE; ++i) {
+                song = search->priv->next->data;
 
                 /* Add song to song list */
                 gtk_list_store_append (liststore, &iter);
@@ -385,9 +468,61 @@ ario_search_do_search (ArioSearch *search)
                                     SONGS_ALBUM_COLUMN, song->album,
                                     SONGS_FILENAME_COLUMN, song->file,
                                     -1);
+                g_free (title);
+
+                search->priv->next = g_slist_next (search->priv->next);
         }
-        g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
-        g_slist_free (songs);
+
+        if (search->priv->next)
+                return TRUE;
+
+        search->priv->page_id = 0;
+        return FALSE;
+}
+
+static gboolean
+ario_search_do_search (ArioSearch *search)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerCriteria *criteria;
+        GtkListStore *liststore;
+
+        search->priv->event_id = 0;
+
+        /* Stop adding the previous results */
+        if (search->priv->page_id > 0) {
+                g_source_remove (search->priv->page_id);
+                search->priv->page_id = 0;
+        }
+        search->priv->next = NULL;
+
+        /* Clear song list */
+        liststore = ario_songlist_get_liststore (ARIO_SONGLIST (search->priv->searchs));
+        gtk_list_store_clear (liststore);
+
+        criteria = ario_search_get_criteria (search);
+        if (!criteria || !ario_server_is_connected ()) {
+                ario_server_criteria_free (criteria);
+                ario_search_reset (search);
+                return FALSE;
+        }
+
+        if (search->priv->complete
+            && ario_search_is_refinement (criteria, search->priv->criteria)) {
+                /* Only previous results can match */
+                search->priv->songs = ario_index_search_filter (search->priv->songs, criteria);
+        } else {
+                g_slist_foreach (search->priv->songs, (GFunc) ario_server_free_song, NULL);
+                g_slist_free (search->priv->songs);
+                search->priv->songs = ario_server_search (criteria, &search->priv->complete);
+        }
+        ario_server_criteria_free (search->priv->criteria);
+        search->priv->criteria = criteria;
+
+        /* Results are added page by page to keep the interface responsive */
+        search->priv->next = search->priv->songs;
+        if (ario_search_add_page (search))
+                search->priv->page_id = g_idle_add ((GSourceFunc) ario_search_add_page, search);
 
         return FALSE;
 }
@@ -26,7 +26,7 @@
 #include "ario-debug.h"
 #include "ario-util.h"
 #include "covers/ario-cover.h"
-#include "covers/ario-cover-handler.h"
+#include "covers/ario-cover-cache.h"
 #include "preferences/ario-preferences.h"
 #include "shell/ario-shell-coverselect.h"
 
@@ -35,8 +35,9 @@ static void ario_tree_albums_build_tree (ArioTree *parent_tree,
                                          GtkTreeView *treeview);
 static void ario_tree_albums_fill_tree (ArioTree *parent_tree);
 static GdkPixbuf* ario_tree_albums_get_dnd_pixbuf (ArioTree *tree);
-static void ario_tree_albums_cover_changed_cb (ArioCoverHandler *cover_handler,
-                                               ArioTreeAlbums *tree);
+static void ario_tree_albums_cover_loaded_cb (ArioCoverCache *cover_cache,
+                                              const gchar *key,
+                                              ArioTreeAlbums *tree);
 static void ario_tree_albums_album_sort_changed_cb (guint notification_id,
                                                     ArioTreeAlbums *tree);
 static void ario_tree_albums_covertree_visible_changed_cb (guint notification_id,
@@ -46,6 +47,10 @@ struct ArioTreeAlbumsPrivate
 {
         int album_sort;
 
+        /* Album key (see ario_cover_cache_make_key) -> GSList of GtkTreeIter
+         * of the rows to update when the cover is loaded */
+        GHashTable *cover_rows;
+
         guint covertree_notif;
         guint sort_notif;
 };
@@ -128,11 +133,20 @@ ario_tree_albums_sort_func (GtkTreeModel *model,
         return ret;
 }
 
+static void
+ario_tree_albums_free_iters (GSList *iters)
+{
+        g_slist_foreach (iters, (GFunc) gtk_tree_iter_free, NULL);
+        g_slist_free (iters);
+}
+
 static void
 ario_tree_albums_init (ArioTreeAlbums *tree)
 {
         ARIO_LOG_FUNCTION_START;
         tree->priv = ARIO_TREE_ALBUMS_GET_PRIVATE (tree);
+        tree->priv->cover_rows = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                        g_free, (GDestroyNotify) ario_tree_albums_free_iters);
 }
 
 static gboolean
@@ -174,6 +188,7 @@ ario_tree_albums_finalize (GObject *object)
         gtk_tree_model_foreach (GTK_TREE_MODEL (tree->parent.model),
                                 (GtkTreeModelForeachFunc) ario_tree_albums_album_free,
                                 tree);
+        g_hash_table_destroy (tree->priv->cover_rows);
 
         G_OBJECT_CLASS (ario_tree_albums_parent_class)->finalize (object);
 }
@@ -230,9 +245,9 @@ ario_tree_albums_build_tree (ArioTree *parent_tree,
                                          tree,
                                          NULL);
 
-        /* Connect signal to update covers when they change */
-        g_signal_connect_object (ario_cover_handler_get_instance (),
-                                 "cover_changed", G_CALLBACK (ario_tree_albums_cover_changed_cb),
+        /* Connect signal to update covers when they are loaded */
+        g_signal_connect_object (ario_cover_cache_get_instance (),
+                                 "cover_loaded", G_CALLBACK (ario_tree_albums_cover_loaded_cb),
                                  tree, 0);
 
         tree->priv->covertree_notif = ario_conf_notification_add (PREF_COVER_TREE_HIDDEN,
@@ -263,54 +278,24 @@ get_selected_albums_foreach (GtkTreeModel *model,
         *albums = g_slist_append (*albums, server_album);
 }
 
-static gboolean
-ario_tree_albums_covers_update (GtkTreeModel *model,
-                                GtkTreePath *path,
-                                GtkTreeIter *iter,
-                                gpointer userdata)
+static void
+ario_tree_albums_cover_loaded_cb (ArioCoverCache *cover_cache,
+                                  const gchar *key,
+                                  ArioTreeAlbums *tree)
 {
         ARIO_LOG_FUNCTION_START;
-        ArioTreeAlbums *tree = ARIO_TREE_ALBUMS (userdata);
+        GSList *tmp;
+        GtkTreeIter *iter;
         ArioServerAlbum *album;
-        gchar *cover_path;
-        GdkPixbuf *cover;
-
-        g_return_val_if_fail (IS_ARIO_TREE_ALBUMS (tree), FALSE);
-
-        gtk_tree_model_get (model, iter, ALBUM_ALBUM_COLUMN, &album, -1);
 
-        /* Get cover path */
-        cover_path = ario_cover_make_cover_path (album->artist, album->album, SMALL_COVER);
-
-        /* The small cover exists, we show it */
-        cover = gdk_pixbuf_new_from_file_at_size (cover_path, COVER_SIZE, COVER_SIZE, NULL);
-        g_free (cover_path);
-
-        if (!GDK_IS_PIXBUF (cover)) {
-                /* There is no cover, we show a transparent picture */
-                cover = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, COVER_SIZE, COVER_SIZE);
-                gdk_pixbuf_fill (cover, 0);
+        /* Update the rows of the album */
+        for (tmp = g_hash_table_lookup (tree->priv->cover_rows, key); tmp; tmp = g_slist_next (tmp)) {
+                iter = tmp->data;
+                gtk_tree_model_get (GTK_TREE_MODEL (tree->parent.model), iter, ALBUM_ALBUM_COLUMN, &album, -1);
+                gtk_list_store_set (tree->parent.model, iter,
+                                    ALBUM_COVER_COLUMN, ario_cover_cache_get_cover (cover_cache, album->artist, album->album),
+                                    -1);
         }
-
-        /* Set cover in tree */
-        gtk_list_store_set (tree->parent.model, iter,
-                            ALBUM_COVER_COLUMN, cover,
-                            -1);
-
-        g_object_unref (G_OBJECT (cover));
-
-        return FALSE;
-}
-
-static void
-ario_tree_albums_cover_changed_cb (ArioCoverHandler *cover_handler,
-                                   ArioTreeAlbums *tree)
-{
-        ARIO_LOG_FUNCTION_START;
-        /* Update all covers */
-        gtk_tree_model_foreach (GTK_TREE_MODEL (tree->parent.model),
-                                (GtkTreeModelForeachFunc) ario_tree_albums_covers_update,
-                                tree);
 }
 
 static void
@@ -335,29 +320,18 @@ ario_tree_albums_add_next_albums (ArioTreeAlbums *tree,
         const GSList *tmp;
         ArioServerAlbum *server_album;
         GtkTreeIter album_iter;
-        gchar *cover_path;
         gchar *album;
         gchar *album_date;
-        GdkPixbuf *cover;
+        gchar *key;
+        gpointer old_key;
+        GSList *iters;
+        ArioCoverCache *cover_cache = ario_cover_cache_get_instance ();
 
         /* For each album */
         for (tmp = albums; tmp; tmp = g_slist_next (tmp)) {
                 server_album = tmp->data;
                 album_date = NULL;
 
-                /* Get cover path */
-                cover_path = ario_cover_make_cover_path (server_album->artist, server_album->album, SMALL_COVER);
-
-                /* The small cover exists, we show it */
-                cover = gdk_pixbuf_new_from_file_at_size (cover_path, COVER_SIZE, COVER_SIZE, NULL);
-                g_free (cover_path);
-
-                if (!GDK_IS_PIXBUF (cover)) {
-                        /* There is no cover, we show a transparent picture */
-                        cover = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, COVER_SIZE, COVER_SIZE);
-                        gdk_pixbuf_fill (cover, 0);
-                }
-
                 /* Display date if any */
                 if (server_album->date) {
                         album_date = g_strdup_printf ("%s (%s)", server_album->album, server_album->date);
@@ -373,11 +347,44 @@ ario_tree_albums_add_next_albums (ArioTreeAlbums *tree,
                                     ALBUM_CRITERIA_COLUMN, criteria,
                                     ALBUM_TEXT_COLUMN, album,
                                     ALBUM_ALBUM_COLUMN, server_album,
-                                    ALBUM_COVER_COLUMN, cover,
+                                    ALBUM_COVER_COLUMN, ario_cover_cache_get_cover (cover_cache, server_album->artist, server_album->album),
                                     -1);
-                g_object_unref (cover);
                 g_free (album_date);
+
+                /* Remember the row to show the cover once it is loaded */
+                key = ario_cover_cache_make_key (server_album->artist, server_album->album);
+                iters = NULL;
+                if (g_hash_table_lookup_extended (tree->priv->cover_rows, key, &old_key, (gpointer *) &iters)) {
+                        g_hash_table_steal (tree->priv->cover_rows, key);
+                        g_free (old_key);
+                }
+                g_hash_table_insert (tree->priv->cover_rows, key,
+                                     g_slist_prepend (iters, gtk_tree_iter_copy (&album_iter)));
+        }
+}
+
+static void
+ario_tree_albums_get_albums_cb (GObject *source_object,
+                                GAsyncResult *result,
+                                ArioTreeFillData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *albums;
+        GError *error = NULL;
+
+        albums = ario_server_get_albums_finish (result, &error);
+        if (error) {
+                /* Tree has been filled again in the meantime */
+                g_error_free (error);
+                ario_tree_fill_data_done (data, FALSE);
+                return;
         }
+
+        /* Albums are freed with the rows */
+        ario_tree_albums_add_next_albums (ARIO_TREE_ALBUMS (data->tree), albums, data->criteria);
+        g_slist_free (albums);
+
+        ario_tree_fill_data_done (data, TRUE);
 }
 
 static void
@@ -385,7 +392,8 @@ ario_tree_albums_fill_tree (ArioTree *parent_tree)
 {
         ARIO_LOG_FUNCTION_START;
         ArioTreeAlbums *tree;
-        GSList *albums, *tmp;
+        GSList *tmp;
+        ArioTreeFillData *data;
 
         g_return_if_fail (IS_ARIO_TREE_ALBUMS (parent_tree));
         tree = ARIO_TREE_ALBUMS (parent_tree);
@@ -394,6 +402,7 @@ ario_tree_albums_fill_tree (ArioTree *parent_tree)
         gtk_tree_model_foreach (GTK_TREE_MODEL (tree->parent.model),
                                 (GtkTreeModelForeachFunc) ario_tree_albums_album_free,
                                 tree);
+        g_hash_table_remove_all (tree->priv->cover_rows);
 
         /* Empty tree */
         gtk_list_store_clear (tree->parent.model);
@@ -401,9 +410,11 @@ ario_tree_albums_fill_tree (ArioTree *parent_tree)
         /* For each criteria */
         for (tmp = tree->parent.criterias; tmp; tmp = g_slist_next (tmp)) {
                 /* Append albums corresponding to criteria */
-                albums = ario_server_get_albums (tmp->data);
-                ario_tree_albums_add_next_albums (tree, albums, tmp->data);
-                g_slist_free (albums);
+                data = ario_tree_fill_data_new (parent_tree, tmp->data);
+                ario_server_get_albums_async (tmp->data,
+                                              data->cancellable,
+                                              (GAsyncReadyCallback) ario_tree_albums_get_albums_cb,
+                                              data);
         }
 }
 
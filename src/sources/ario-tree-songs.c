@@ -196,12 +196,38 @@ ario_tree_songs_add_next_songs (ArioTreeSongs *tree,
         }
 }
 
+static void
+ario_tree_songs_get_songs_cb (GObject *source_object,
+                              GAsyncResult *result,
+                              ArioTreeFillData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *songs;
+        GError *error = NULL;
+
+        songs = ario_server_get_songs_finish (result, &error);
+        if (error) {
+                /* Tree has been filled again in the meantime */
+                g_error_free (error);
+                ario_tree_fill_data_done (data, FALSE);
+                return;
+        }
+
+        /* Add songs to tree */
+        ario_tree_songs_add_next_songs (ARIO_TREE_SONGS (data->tree), songs, data->criteria);
+        g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
+        g_slist_free (songs);
+
+        ario_tree_fill_data_done (data, TRUE);
+}
+
 static void
 ario_tree_songs_fill_tree (ArioTree *parent_tree)
 {
         ARIO_LOG_FUNCTION_START;
         ArioTreeSongs *tree;
-        GSList *songs, *tmp;
+        GSList *tmp;
+        ArioTreeFillData *data;
 
         g_return_if_fail (IS_ARIO_TREE_SONGS (parent_tree));
         tree = ARIO_TREE_SONGS (parent_tree);
@@ -212,12 +238,11 @@ ario_tree_songs_fill_tree (ArioTree *parent_tree)
         /* For each criteria */
         for (tmp = tree->parent.criterias; tmp; tmp = g_slist_next (tmp)) {
                 /* Get songs corresponding to criteria */
-                songs = ario_server_get_songs (tmp->data, TRUE);
-
-                /* Add songs to playlist */
-                ario_tree_songs_add_next_songs (tree, songs, tmp->data);
-                g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
-                g_slist_free (songs);
+                data = ario_tree_fill_data_new (parent_tree, tmp->data);
+                ario_server_get_songs_async (tmp->data, TRUE,
+                                             data->cancellable,
+                                             (GAsyncReadyCallback) ario_tree_songs_get_songs_cb,
+                                             data);
         }
 }
 
@@ -83,12 +83,22 @@ static void ario_tree_append_drag_data (ArioTree *tree,
 static void ario_tree_add_to_playlist (ArioTree *tree,
                                        const PlaylistAction action);
 static void ario_tree_add_data_free (ArioTreeAddData *data);
+static void ario_tree_fill_done (ArioTree *tree);
+static void ario_tree_select_tag (ArioTree *tree,
+                                  const char *tag);
 
 struct ArioTreePrivate
 {
         GtkUIManager *ui_manager;
         gboolean idle_fill_running;
         ArioTreeAddData *data;
+
+        GCancellable *cancellable;
+        int pending_fills;
+        GList *selected_paths;
+        GSList *fill_criterias;
+
+        gchar *goto_tag;
 };
 
 typedef struct
@@ -220,6 +230,14 @@ ario_tree_finalize (GObject *object)
         ario_tree_add_data_free (tree->priv->data);
         tree->priv->data = NULL;
 
+        if (tree->priv->cancellable)
+                g_object_unref (tree->priv->cancellable);
+        g_list_foreach (tree->priv->selected_paths, (GFunc) gtk_tree_path_free, NULL);
+        g_list_free (tree->priv->selected_paths);
+        g_slist_foreach (tree->priv->fill_criterias, (GFunc) ario_server_criteria_free, NULL);
+        g_slist_free (tree->priv->fill_criterias);
+        g_free (tree->priv->goto_tag);
+
         G_OBJECT_CLASS (ario_tree_parent_class)->finalize (object);
 }
 
@@ -666,55 +684,122 @@ ario_tree_add_tags (ArioTree *tree,
         }
 }
 
+ArioTreeFillData *
+ario_tree_fill_data_new (ArioTree *tree,
+                         const ArioServerCriteria *criteria)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioTreeFillData *data;
+
+        data = (ArioTreeFillData *) g_malloc0 (sizeof (ArioTreeFillData));
+        data->tree = g_object_ref (tree);
+        /* Copy criteria as they could be destroyed before the answer */
+        data->criteria = ario_server_criteria_copy (criteria);
+        data->cancellable = g_object_ref (tree->priv->cancellable);
+
+        ++tree->priv->pending_fills;
+
+        return data;
+}
+
+void
+ario_tree_fill_data_done (ArioTreeFillData *data,
+                          const gboolean filled)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioTree *tree = data->tree;
+
+        /* Nothing to do if the tree has been filled again in the meantime */
+        if (filled) {
+                /* Rows point to the criteria: keep it until the next fill */
+                if (data->criteria) {
+                        tree->priv->fill_criterias = g_slist_prepend (tree->priv->fill_criterias,
+                                                                      data->criteria);
+                        data->criteria = NULL;
+                }
+
+                /* Last answer received */
+                if (--tree->priv->pending_fills == 0)
+                        ario_tree_fill_done (tree);
+        }
+
+        ario_server_criteria_free (data->criteria);
+        g_object_unref (data->cancellable);
+        g_object_unref (data->tree);
+        g_free (data);
+}
+
+static void
+ario_tree_list_tags_cb (GObject *source_object,
+                        GAsyncResult *result,
+                        ArioTreeFillData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tags;
+        GError *error = NULL;
+
+        tags = ario_server_list_tags_finish (result, &error);
+        if (error) {
+                /* Tree has been filled again in the meantime */
+                g_error_free (error);
+                ario_tree_fill_data_done (data, FALSE);
+                return;
+        }
+
+        /* Fill tree */
+        ario_tree_add_tags (data->tree, data->criteria, tags);
+
+        ario_tree_fill_data_done (data, TRUE);
+}
+
+static void
+ario_tree_list_tags_async (ArioTree *tree,
+                           ArioServerCriteria *criteria)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioTreeFillData *data;
+
+        data = ario_tree_fill_data_new (tree, criteria);
+        ario_server_list_tags_async (tree->tag, criteria,
+                                     data->cancellable,
+                                     (GAsyncReadyCallback) ario_tree_list_tags_cb,
+                                     data);
+}
+
 static void
 ario_tree_fill_tree (ArioTree *tree)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *tmp, *tags;
-        ArioServerCriteria *criteria;
+        GSList *tmp;
 
         gtk_list_store_clear (tree->model);
+
         if (tree->is_first) {
                 /* First tree has not criteria */
-                tags = ario_server_list_tags (tree->tag, NULL);
-
-                /* Fill tree */
-                ario_tree_add_tags (tree, NULL, tags);
+                ario_tree_list_tags_async (tree, NULL);
         } else {
                 for (tmp = tree->criterias; tmp; tmp = g_slist_next (tmp)) {
                         /* Add critreria to filter iems in tree */
-                        criteria = tmp->data;
-                        tags = ario_server_list_tags (tree->tag, criteria);
-
-                        /* Fill tree */
-                        ario_tree_add_tags (tree, criteria, tags);
+                        ario_tree_list_tags_async (tree, tmp->data);
                 }
         }
 }
 
-void
-ario_tree_fill (ArioTree *tree)
+static void
+ario_tree_fill_done (ArioTree *tree)
 {
         ARIO_LOG_FUNCTION_START;
         GtkTreeIter iter;
-        GList *paths = NULL;
+        GList *paths = tree->priv->selected_paths;
         GtkTreePath *path;
-        GtkTreeModel *model = GTK_TREE_MODEL (tree->model);
-
-        /* Block signal handler to avoid useless actions */
-        g_signal_handlers_block_by_func (G_OBJECT (tree->selection),
-                                         G_CALLBACK (ario_tree_selection_changed_cb),
-                                         tree);
-
-        /* Remember the selected row in first tree */
-        if (tree->is_first)
-                paths = gtk_tree_selection_get_selected_rows (tree->selection, &model);
-
-        /* Call virtual method to fill tree */
-        ARIO_TREE_GET_CLASS (tree)->fill_tree (tree);
 
         gtk_tree_selection_unselect_all (tree->selection);
-        if (paths) {
+        if (tree->priv->goto_tag) {
+                /* Go to playing song requested during the fill */
+                ario_tree_select_tag (tree, tree->priv->goto_tag);
+                g_free (tree->priv->goto_tag);
+                tree->priv->goto_tag = NULL;
+        } else if (paths) {
                 /* First tree : select previously selected row */
                 path = paths->data;
                 if (path) {
@@ -736,6 +821,7 @@ ario_tree_fill (ArioTree *tree)
 
         g_list_foreach (paths, (GFunc) gtk_tree_path_free, NULL);
         g_list_free (paths);
+        tree->priv->selected_paths = NULL;
 
         /* Unblock signal handler */
         g_signal_handlers_unblock_by_func (G_OBJECT (tree->selection),
@@ -746,6 +832,49 @@ ario_tree_fill (ArioTree *tree)
         g_signal_emit_by_name (G_OBJECT (tree->selection), "changed", 0);
 }
 
+void
+ario_tree_fill (ArioTree *tree)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreeModel *model = GTK_TREE_MODEL (tree->model);
+        GSList *fill_criterias;
+
+        if (tree->priv->pending_fills) {
+                /* Previous fill is not over: drop its results, signal
+                 * handler is still blocked */
+                g_cancellable_cancel (tree->priv->cancellable);
+                tree->priv->pending_fills = 0;
+        } else {
+                /* Block signal handler to avoid useless actions */
+                g_signal_handlers_block_by_func (G_OBJECT (tree->selection),
+                                                 G_CALLBACK (ario_tree_selection_changed_cb),
+                                                 tree);
+
+                /* Remember the selected row in first tree */
+                if (tree->is_first)
+                        tree->priv->selected_paths = gtk_tree_selection_get_selected_rows (tree->selection, &model);
+        }
+
+        if (tree->priv->cancellable)
+                g_object_unref (tree->priv->cancellable);
+        tree->priv->cancellable = g_cancellable_new ();
+
+        /* Criteria of the previous fill are used by the rows until
+         * the tree is emptied */
+        fill_criterias = tree->priv->fill_criterias;
+        tree->priv->fill_criterias = NULL;
+
+        /* Call virtual method to fill tree */
+        ARIO_TREE_GET_CLASS (tree)->fill_tree (tree);
+
+        g_slist_foreach (fill_criterias, (GFunc) ario_server_criteria_free, NULL);
+        g_slist_free (fill_criterias);
+
+        /* Tree has been filled synchronously */
+        if (!tree->priv->pending_fills)
+                ario_tree_fill_done (tree);
+}
+
 void
 ario_tree_clear_criterias (ArioTree *tree)
 {
@@ -836,14 +965,51 @@ ario_tree_cmd_add (ArioTree *tree,
         ARIO_TREE_GET_CLASS (tree)->add_to_playlist (tree, action);
 }
 
+/* Albums of a cover operation, gathered before the coverdownloader
+ * is launched */
+typedef struct
+{
+        ArioShellCoverdownloaderOperation operation;
+        GSList *albums;
+        int pending;
+} ArioTreeCoverData;
+
+static void
+ario_tree_get_cover_albums_cb (GObject *source_object,
+                               GAsyncResult *result,
+                               ArioTreeCoverData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkWidget *coverdownloader;
+
+        data->albums = g_slist_concat (data->albums,
+                                       ario_server_get_albums_finish (result, NULL));
+
+        /* Wait for the albums of every criteria */
+        if (--data->pending > 0)
+                return;
+
+        /* Create coverdownloader dialog */
+        coverdownloader = ario_shell_coverdownloader_new ();
+        if (coverdownloader) {
+                /* Get covers corresponding to albums */
+                ario_shell_coverdownloader_get_covers_from_albums (ARIO_SHELL_COVERDOWNLOADER (coverdownloader),
+                                                                   data->albums,
+                                                                   data->operation);
+        }
+
+        g_slist_foreach (data->albums, (GFunc) ario_server_free_album, NULL);
+        g_slist_free (data->albums);
+        g_free (data);
+}
+
 void
 ario_tree_get_cover (ArioTree *tree,
                      const ArioShellCoverdownloaderOperation operation)
 {
         ARIO_LOG_FUNCTION_START;
         GSList *criterias = NULL, *tmp;
-        GtkWidget *coverdownloader;
-        GSList *albums = NULL;
+        ArioTreeCoverData *data;
         GtkWidget *dialog;
         gint retval;
 
@@ -863,21 +1029,19 @@ ario_tree_get_cover (ArioTree *tree,
 
         /* Get criteria of current selection */
         criterias = ario_tree_get_criterias (tree);
+        if (!criterias)
+                return;
 
-        /* Create coverdownloader dialog */
-        coverdownloader = ario_shell_coverdownloader_new ();
-        if (coverdownloader) {
-                /* Get albums corresponding to criteria */
-                for (tmp = criterias; tmp; tmp = g_slist_next (tmp)) {
-                        albums = g_slist_concat (albums, ario_server_get_albums (tmp->data));
-                }
-                /* Get covers corresponding to albums */
-                ario_shell_coverdownloader_get_covers_from_albums (ARIO_SHELL_COVERDOWNLOADER (coverdownloader),
-                                                                   albums,
-                                                                   operation);
+        data = (ArioTreeCoverData *) g_malloc0 (sizeof (ArioTreeCoverData));
+        data->operation = operation;
+        data->pending = g_slist_length (criterias);
 
-                g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
-                g_slist_free (albums);
+        /* Get albums corresponding to criteria */
+        for (tmp = criterias; tmp; tmp = g_slist_next (tmp)) {
+                ario_server_get_albums_async (tmp->data,
+                                              NULL,
+                                              (GAsyncReadyCallback) ario_tree_get_cover_albums_cb,
+                                              data);
         }
         g_slist_foreach (criterias, (GFunc) ario_server_criteria_free, NULL);
         g_slist_free (criterias);
@@ -920,19 +1084,41 @@ ario_tree_model_foreach (GtkTreeModel *model,
         return FALSE;
 }
 
-void
-ario_tree_goto_playling_song (ArioTree *tree,
-                              const ArioServerSong *song)
+static void
+ario_tree_select_tag (ArioTree *tree,
+                      const char *tag)
 {
         ARIO_LOG_FUNCTION_START;
         ArioTreeForeachData data;
+
         data.tree = tree;
-        data.tag = ario_server_song_get_tag (song, tree->tag);
-        if (!data.tag)
-                data.tag = ARIO_SERVER_UNKNOWN;
+        data.tag = tag;
 
         /* Loop on each row of the model */
         gtk_tree_model_foreach (GTK_TREE_MODEL (tree->model),
                                 (GtkTreeModelForeachFunc) ario_tree_model_foreach,
                                 &data);
 }
+
+gboolean
+ario_tree_goto_playling_song (ArioTree *tree,
+                              const ArioServerSong *song,
+                              const gboolean wait_fill)
+{
+        ARIO_LOG_FUNCTION_START;
+        const char *tag;
+
+        tag = ario_server_song_get_tag (song, tree->tag);
+        if (!tag)
+                tag = ARIO_SERVER_UNKNOWN;
+
+        if (wait_fill || tree->priv->pending_fills) {
+                /* Select the row when the fill of tree is over */
+                g_free (tree->priv->goto_tag);
+                tree->priv->goto_tag = g_strdup (tag);
+                return TRUE;
+        }
+
+        ario_tree_select_tag (tree, tag);
+        return FALSE;
+}
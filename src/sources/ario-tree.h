@@ -64,6 +64,16 @@ typedef struct
         ArioTree *tree;
 } ArioTreeStringData;
 
+/* Request of an asynchronous fill, see ario_tree_fill_data_new */
+typedef struct
+{
+        ArioTree *tree;
+        /* Copy of the criteria of the request, the rows added by the
+         * answer can point to it */
+        ArioServerCriteria *criteria;
+        GCancellable *cancellable;
+} ArioTreeFillData;
+
 typedef struct
 {
         GtkScrolledWindowClass parent;
@@ -104,13 +114,24 @@ GSList*                 ario_tree_get_criterias         (ArioTree *tree);
 
 void                    ario_tree_cmd_add               (ArioTree *tree,
                                                          const PlaylistAction action);
-void                    ario_tree_goto_playling_song    (ArioTree *tree,
-                                                         const ArioServerSong *song);
+gboolean                ario_tree_goto_playling_song    (ArioTree *tree,
+                                                         const ArioServerSong *song,
+                                                         const gboolean wait_fill);
 void                    ario_tree_add_tags              (ArioTree *tree,
                                                          ArioServerCriteria *criteria,
                                                          GSList *tags);
 void                    ario_tree_get_cover             (ArioTree *tree,
                                                          const ArioShellCoverdownloaderOperation operation);
+
+/* Used by fill_tree implementations to fill the tree asynchronously:
+ * a request is created before each asynchronous call with the
+ * cancellable of the request, and ario_tree_fill_data_done must be
+ * called by the callback, with filled set to FALSE if the call has
+ * been cancelled */
+ArioTreeFillData*       ario_tree_fill_data_new         (ArioTree *tree,
+                                                         const ArioServerCriteria *criteria);
+void                    ario_tree_fill_data_done        (ArioTreeFillData *data,
+                                                         const gboolean filled);
 G_END_DECLS
 
 #endif /* __ARIO_TREE_H */
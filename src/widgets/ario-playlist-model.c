@@ -0,0 +1,682 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "widgets/ario-playlist-model.h"
+#include <gtk/gtk.h>
+#include <string.h>
+#include <config.h>
+#include <glib/gi18n.h>
+#include "servers/ario-song-array.h"
+#include "ario-util.h"
+#include "ario-debug.h"
+
+static void ario_playlist_model_finalize (GObject *object);
+static void ario_playlist_model_tree_model_init (GtkTreeModelIface *iface);
+static void ario_playlist_model_sortable_init (GtkTreeSortableIface *iface);
+
+struct ArioPlaylistModelPrivate
+{
+        gint stamp;
+
+        ArioSongArray *songs;
+        /* Case folded title, artist, album and genre used to search */
+        ArioSongArray *folded;
+        /* File -> number of rows with this file */
+        GHashTable *files;
+
+        /* Sum of the durations of the songs */
+        gint total_time;
+
+        gint playing;
+        GdkPixbuf *play_pixbuf;
+
+        gint sort_column_id;
+        GtkSortType sort_order;
+};
+
+/* Key used to sort rows on a column */
+typedef struct
+{
+        gint pos;
+        gchar *key;
+        gint value;
+} ArioPlaylistModelSortEntry;
+
+#define ARIO_PLAYLIST_MODEL_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TYPE_ARIO_PLAYLIST_MODEL, ArioPlaylistModelPrivate))
+G_DEFINE_TYPE_WITH_CODE (ArioPlaylistModel, ario_playlist_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+                                                ario_playlist_model_tree_model_init)
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_SORTABLE,
+                                                ario_playlist_model_sortable_init))
+
+static void
+ario_playlist_model_class_init (ArioPlaylistModelClass *klass)
+{
+        ARIO_LOG_FUNCTION_START;
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+        /* Virtual methods */
+        object_class->finalize = ario_playlist_model_finalize;
+
+        /* Private attributes */
+        g_type_class_add_private (klass, sizeof (ArioPlaylistModelPrivate));
+}
+
+static void
+ario_playlist_model_init (ArioPlaylistModel *model)
+{
+        ARIO_LOG_FUNCTION_START;
+        model->priv = ARIO_PLAYLIST_MODEL_GET_PRIVATE (model);
+        model->priv->stamp = g_random_int ();
+        model->priv->songs = ario_song_array_new ();
+        model->priv->folded = ario_song_array_new ();
+        model->priv->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        model->priv->playing = -1;
+        model->priv->sort_column_id = GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID;
+        model->priv->sort_order = GTK_SORT_ASCENDING;
+}
+
+static void
+ario_playlist_model_finalize (GObject *object)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistModel *model;
+
+        g_return_if_fail (object != NULL);
+        g_return_if_fail (IS_ARIO_PLAYLIST_MODEL (object));
+
+        model = ARIO_PLAYLIST_MODEL (object);
+
+        g_return_if_fail (model->priv != NULL);
+        ario_song_array_free (model->priv->songs);
+        ario_song_array_free (model->priv->folded);
+        g_hash_table_destroy (model->priv->files);
+        if (model->priv->play_pixbuf)
+                g_object_unref (model->priv->play_pixbuf);
+
+        G_OBJECT_CLASS (ario_playlist_model_parent_class)->finalize (object);
+}
+
+ArioPlaylistModel *
+ario_playlist_model_new (GdkPixbuf *play_pixbuf)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistModel *model;
+
+        model = g_object_new (TYPE_ARIO_PLAYLIST_MODEL, NULL);
+        if (play_pixbuf)
+                model->priv->play_pixbuf = g_object_ref (play_pixbuf);
+
+        return model;
+}
+
+guint
+ario_playlist_model_get_length (ArioPlaylistModel *model)
+{
+        return ario_song_array_get_length (model->priv->songs);
+}
+
+static void
+ario_playlist_model_row_changed (ArioPlaylistModel *model,
+                                 const gint pos)
+{
+        GtkTreePath *path;
+        GtkTreeIter iter;
+
+        iter.stamp = model->priv->stamp;
+        iter.user_data = GINT_TO_POINTER (pos);
+        path = gtk_tree_path_new_from_indices (pos, -1);
+        gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+        gtk_tree_path_free (path);
+}
+
+/* Add count (1 or -1) to the number of rows with file */
+static void
+ario_playlist_model_file_add (ArioPlaylistModel *model,
+                              const gchar *file,
+                              const gint count)
+{
+        gpointer key, value;
+        gint new_count = count;
+
+        if (!file)
+                return;
+
+        if (g_hash_table_lookup_extended (model->priv->files, file, &key, &value)) {
+                new_count += GPOINTER_TO_INT (value);
+                /* Reuse the key instead of copying the file again */
+                g_hash_table_steal (model->priv->files, key);
+        } else {
+                key = g_strdup (file);
+        }
+
+        if (new_count > 0)
+                g_hash_table_insert (model->priv->files, key, GINT_TO_POINTER (new_count));
+        else
+                g_free (key);
+}
+
+static void
+ario_playlist_model_set_folded (ArioPlaylistModel *model,
+                                const ArioServerSong *row)
+{
+        ArioServerSong folded = { NULL, };
+
+        folded.title = ario_util_casefold (row->title);
+        folded.artist = ario_util_casefold (row->artist);
+        folded.album = ario_util_casefold (row->album ? row->album : ARIO_SERVER_UNKNOWN);
+        folded.genre = ario_util_casefold (row->genre);
+        folded.pos = -1;
+        folded.id = -1;
+
+        ario_song_array_set (model->priv->folded, row->pos, &folded);
+
+        g_free (folded.title);
+        g_free (folded.artist);
+        g_free (folded.album);
+        g_free (folded.genre);
+}
+
+void
+ario_playlist_model_set_song (ArioPlaylistModel *model,
+                              ArioServerSong *song)
+{
+        ArioServerSong row;
+        GtkTreePath *path;
+        GtkTreeIter iter;
+        gint pos;
+
+        if (song->pos < 0)
+                return;
+
+        /* The title displayed is stored instead of the title tag */
+        row = *song;
+        row.title = ario_util_format_title (song);
+
+        if ((guint) song->pos < ario_song_array_get_length (model->priv->songs)) {
+                /* Update */
+                model->priv->total_time -= MAX (ario_song_array_get_time (model->priv->songs, song->pos), 0);
+                model->priv->total_time += MAX (row.time, 0);
+                ario_playlist_model_file_add (model, ario_song_array_get_tag (model->priv->songs, song->pos, ARIO_TAG_FILENAME), -1);
+                ario_song_array_set (model->priv->songs, song->pos, &row);
+                ario_playlist_model_file_add (model, row.file, 1);
+                ario_playlist_model_set_folded (model, &row);
+                ario_playlist_model_row_changed (model, song->pos);
+        } else {
+                /* Add, with empty rows before if some songs are missing */
+                for (pos = ario_song_array_get_length (model->priv->songs); pos <= song->pos; ++pos) {
+                        ario_song_array_set_length (model->priv->songs, pos + 1);
+                        ario_song_array_set_length (model->priv->folded, pos + 1);
+                        if (pos == song->pos) {
+                                model->priv->total_time += MAX (row.time, 0);
+                                ario_song_array_set (model->priv->songs, pos, &row);
+                                ario_playlist_model_file_add (model, row.file, 1);
+                                ario_playlist_model_set_folded (model, &row);
+                        }
+
+                        iter.stamp = model->priv->stamp;
+                        iter.user_data = GINT_TO_POINTER (pos);
+                        path = gtk_tree_path_new_from_indices (pos, -1);
+                        gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+                        gtk_tree_path_free (path);
+                }
+        }
+}
+
+void
+ario_playlist_model_truncate (ArioPlaylistModel *model,
+                              const guint length)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreePath *path;
+        guint pos;
+
+        if (length >= ario_song_array_get_length (model->priv->songs))
+                return;
+
+        if (model->priv->playing >= (gint) length)
+                model->priv->playing = -1;
+
+        /* Rows are removed from the end so that other rows keep their path */
+        for (pos = ario_song_array_get_length (model->priv->songs); pos > length; --pos) {
+                model->priv->total_time -= MAX (ario_song_array_get_time (model->priv->songs, pos - 1), 0);
+                ario_playlist_model_file_add (model, ario_song_array_get_tag (model->priv->songs, pos - 1, ARIO_TAG_FILENAME), -1);
+                ario_song_array_set_length (model->priv->songs, pos - 1);
+                ario_song_array_set_length (model->priv->folded, pos - 1);
+                path = gtk_tree_path_new_from_indices (pos - 1, -1);
+                gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+                gtk_tree_path_free (path);
+        }
+
+        /* Strings of an empty playlist are released */
+        if (length == 0) {
+                ario_song_array_free (model->priv->songs);
+                model->priv->songs = ario_song_array_new ();
+                ario_song_array_free (model->priv->folded);
+                model->priv->folded = ario_song_array_new ();
+                g_hash_table_remove_all (model->priv->files);
+                model->priv->total_time = 0;
+        }
+}
+
+gint
+ario_playlist_model_get_total_time (ArioPlaylistModel *model)
+{
+        return model->priv->total_time;
+}
+
+gboolean
+ario_playlist_model_set_playing (ArioPlaylistModel *model,
+                                 const gint pos)
+{
+        ARIO_LOG_FUNCTION_START;
+        gint old_playing = model->priv->playing;
+
+        if (pos >= (gint) ario_song_array_get_length (model->priv->songs))
+                return FALSE;
+
+        model->priv->playing = pos;
+        if (old_playing >= 0 && old_playing != pos)
+                ario_playlist_model_row_changed (model, old_playing);
+        if (pos >= 0)
+                ario_playlist_model_row_changed (model, pos);
+
+        return TRUE;
+}
+
+gint
+ario_playlist_model_get_pos (ArioPlaylistModel *model,
+                             GtkTreeIter *iter)
+{
+        g_return_val_if_fail (iter->stamp == model->priv->stamp, -1);
+
+        return GPOINTER_TO_INT (iter->user_data);
+}
+
+const gchar *
+ario_playlist_model_get_folded (ArioPlaylistModel *model,
+                                GtkTreeIter *iter,
+                                const gint column)
+{
+        gint pos = ario_playlist_model_get_pos (model, iter);
+
+        if (pos < 0 || (guint) pos >= ario_song_array_get_length (model->priv->folded))
+                return NULL;
+
+        switch (column) {
+        case PLAYLIST_TITLE_COLUMN: return ario_song_array_get_tag (model->priv->folded, pos, ARIO_TAG_TITLE);
+        case PLAYLIST_ARTIST_COLUMN: return ario_song_array_get_tag (model->priv->folded, pos, ARIO_TAG_ARTIST);
+        case PLAYLIST_ALBUM_COLUMN: return ario_song_array_get_tag (model->priv->folded, pos, ARIO_TAG_ALBUM);
+        case PLAYLIST_GENRE_COLUMN: return ario_song_array_get_tag (model->priv->folded, pos, ARIO_TAG_GENRE);
+        default: return NULL;
+        }
+}
+
+const gchar *
+ario_playlist_model_get_tag (ArioPlaylistModel *model,
+                             const gint pos,
+                             const ArioServerTag tag)
+{
+        if (pos < 0 || (guint) pos >= ario_song_array_get_length (model->priv->songs))
+                return NULL;
+
+        return ario_song_array_get_tag (model->priv->songs, pos, tag);
+}
+
+gboolean
+ario_playlist_model_has_file (ArioPlaylistModel *model,
+                              const gchar *file)
+{
+        return file && g_hash_table_lookup (model->priv->files, file) != NULL;
+}
+
+static GtkTreeModelFlags
+ario_playlist_model_get_flags (GtkTreeModel *tree_model)
+{
+        return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+ario_playlist_model_get_n_columns (GtkTreeModel *tree_model)
+{
+        return PLAYLIST_N_COLUMN;
+}
+
+static GType
+ario_playlist_model_get_column_type (GtkTreeModel *tree_model,
+                                     gint index)
+{
+        switch (index) {
+        case PLAYLIST_PIXBUF_COLUMN: return GDK_TYPE_PIXBUF;
+        case PLAYLIST_ID_COLUMN:
+        case PLAYLIST_TIME_COLUMN: return G_TYPE_INT;
+        default: return G_TYPE_STRING;
+        }
+}
+
+static gboolean
+ario_playlist_model_iter_nth_child (GtkTreeModel *tree_model,
+                                    GtkTreeIter *iter,
+                                    GtkTreeIter *parent,
+                                    gint n)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (tree_model);
+
+        /* Flat list: only the root has children */
+        if (parent
+            || n < 0
+            || (guint) n >= ario_song_array_get_length (model->priv->songs))
+                return FALSE;
+
+        iter->stamp = model->priv->stamp;
+        iter->user_data = GINT_TO_POINTER (n);
+
+        return TRUE;
+}
+
+static gboolean
+ario_playlist_model_get_iter (GtkTreeModel *tree_model,
+                              GtkTreeIter *iter,
+                              GtkTreePath *path)
+{
+        if (gtk_tree_path_get_depth (path) != 1)
+                return FALSE;
+
+        return ario_playlist_model_iter_nth_child (tree_model, iter, NULL,
+                                                   gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+ario_playlist_model_get_path (GtkTreeModel *tree_model,
+                              GtkTreeIter *iter)
+{
+        g_return_val_if_fail (iter->stamp == ARIO_PLAYLIST_MODEL (tree_model)->priv->stamp, NULL);
+
+        return gtk_tree_path_new_from_indices (GPOINTER_TO_INT (iter->user_data), -1);
+}
+
+static void
+ario_playlist_model_get_value (GtkTreeModel *tree_model,
+                               GtkTreeIter *iter,
+                               gint column,
+                               GValue *value)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (tree_model);
+        gint pos = GPOINTER_TO_INT (iter->user_data);
+        gchar track[ARIO_MAX_TRACK_SIZE];
+        gchar time[ARIO_MAX_TIME_SIZE];
+        ArioServerSong song;
+
+        g_return_if_fail (iter->stamp == model->priv->stamp);
+
+        g_value_init (value, ario_playlist_model_get_column_type (tree_model, column));
+        if ((guint) pos >= ario_song_array_get_length (model->priv->songs))
+                return;
+
+        /* Cells are computed each time they are displayed */
+        ario_song_array_get (model->priv->songs, pos, &song);
+        switch (column) {
+        case PLAYLIST_PIXBUF_COLUMN:
+                if (pos == model->priv->playing)
+                        g_value_set_object (value, model->priv->play_pixbuf);
+                break;
+        case PLAYLIST_TRACK_COLUMN:
+                ario_util_format_track_buf (song.track, track, ARIO_MAX_TRACK_SIZE);
+                g_value_set_string (value, track);
+                break;
+        case PLAYLIST_TITLE_COLUMN:
+                g_value_set_string (value, song.title);
+                break;
+        case PLAYLIST_ARTIST_COLUMN:
+                g_value_set_string (value, song.artist);
+                break;
+        case PLAYLIST_ALBUM_COLUMN:
+                g_value_set_string (value, song.album ? song.album : ARIO_SERVER_UNKNOWN);
+                break;
+        case PLAYLIST_DURATION_COLUMN:
+                ario_util_format_time_buf (song.time, time, ARIO_MAX_TIME_SIZE);
+                g_value_set_string (value, time);
+                break;
+        case PLAYLIST_FILE_COLUMN:
+                g_value_set_string (value, song.file);
+                break;
+        case PLAYLIST_GENRE_COLUMN:
+                g_value_set_string (value, song.genre);
+                break;
+        case PLAYLIST_DATE_COLUMN:
+                g_value_set_string (value, song.date);
+                break;
+        case PLAYLIST_DISC_COLUMN:
+                g_value_set_string (value, song.disc);
+                break;
+        case PLAYLIST_ID_COLUMN:
+                g_value_set_int (value, song.id);
+                break;
+        case PLAYLIST_TIME_COLUMN:
+                g_value_set_int (value, song.time);
+                break;
+        default:
+                break;
+        }
+}
+
+static gboolean
+ario_playlist_model_iter_next (GtkTreeModel *tree_model,
+                               GtkTreeIter *iter)
+{
+        return ario_playlist_model_iter_nth_child (tree_model, iter, NULL,
+                                                   GPOINTER_TO_INT (iter->user_data) + 1);
+}
+
+static gboolean
+ario_playlist_model_iter_children (GtkTreeModel *tree_model,
+                                   GtkTreeIter *iter,
+                                   GtkTreeIter *parent)
+{
+        return ario_playlist_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean
+ario_playlist_model_iter_has_child (GtkTreeModel *tree_model,
+                                    GtkTreeIter *iter)
+{
+        return FALSE;
+}
+
+static gint
+ario_playlist_model_iter_n_children (GtkTreeModel *tree_model,
+                                     GtkTreeIter *iter)
+{
+        if (iter)
+                return 0;
+
+        return ario_song_array_get_length (ARIO_PLAYLIST_MODEL (tree_model)->priv->songs);
+}
+
+static gboolean
+ario_playlist_model_iter_parent (GtkTreeModel *tree_model,
+                                 GtkTreeIter *iter,
+                                 GtkTreeIter *child)
+{
+        return FALSE;
+}
+
+static void
+ario_playlist_model_tree_model_init (GtkTreeModelIface *iface)
+{
+        iface->get_flags = ario_playlist_model_get_flags;
+        iface->get_n_columns = ario_playlist_model_get_n_columns;
+        iface->get_column_type = ario_playlist_model_get_column_type;
+        iface->get_iter = ario_playlist_model_get_iter;
+        iface->get_path = ario_playlist_model_get_path;
+        iface->get_value = ario_playlist_model_get_value;
+        iface->iter_next = ario_playlist_model_iter_next;
+        iface->iter_children = ario_playlist_model_iter_children;
+        iface->iter_has_child = ario_playlist_model_iter_has_child;
+        iface->iter_n_children = ario_playlist_model_iter_n_children;
+        iface->iter_nth_child = ario_playlist_model_iter_nth_child;
+        iface->iter_parent = ario_playlist_model_iter_parent;
+}
+
+static gint
+ario_playlist_model_sort_compare (const ArioPlaylistModelSortEntry *a,
+                                  const ArioPlaylistModelSortEntry *b,
+                                  ArioPlaylistModel *model)
+{
+        gint ret;
+
+        if (a->key && b->key)
+                ret = strcmp (a->key, b->key);
+        else
+                ret = a->value - b->value;
+
+        if (model->priv->sort_order == GTK_SORT_DESCENDING)
+                ret = -ret;
+
+        /* Rows with the same value keep their order */
+        return ret ? ret : a->pos - b->pos;
+}
+
+static void
+ario_playlist_model_sort (ArioPlaylistModel *model)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistModelSortEntry *entries;
+        GtkTreePath *path;
+        GtkTreeIter iter;
+        GValue value = {0, };
+        gint *new_order;
+        gint i, length, playing;
+
+        length = ario_song_array_get_length (model->priv->songs);
+        if (length < 2)
+                return;
+
+        /* Compute the key of each row only once */
+        entries = g_new0 (ArioPlaylistModelSortEntry, length);
+        iter.stamp = model->priv->stamp;
+        for (i = 0; i < length; ++i) {
+                entries[i].pos = i;
+                iter.user_data = GINT_TO_POINTER (i);
+                ario_playlist_model_get_value (GTK_TREE_MODEL (model), &iter,
+                                               model->priv->sort_column_id, &value);
+                if (G_VALUE_HOLDS_STRING (&value))
+                        entries[i].key = g_utf8_collate_key (g_value_get_string (&value) ? g_value_get_string (&value) : "", -1);
+                else if (G_VALUE_HOLDS_INT (&value))
+                        entries[i].value = g_value_get_int (&value);
+                g_value_unset (&value);
+        }
+
+        g_qsort_with_data (entries, length, sizeof (ArioPlaylistModelSortEntry),
+                           (GCompareDataFunc) ario_playlist_model_sort_compare, model);
+
+        new_order = g_new (gint, length);
+        playing = model->priv->playing;
+        for (i = 0; i < length; ++i) {
+                new_order[i] = entries[i].pos;
+                if (entries[i].pos == playing)
+                        model->priv->playing = i;
+                g_free (entries[i].key);
+        }
+        g_free (entries);
+
+        ario_song_array_reorder (model->priv->songs, new_order);
+        ario_song_array_reorder (model->priv->folded, new_order);
+
+        /* Only one signal for the whole list */
+        path = gtk_tree_path_new ();
+        gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model), path, NULL, new_order);
+        gtk_tree_path_free (path);
+        g_free (new_order);
+}
+
+static gboolean
+ario_playlist_model_get_sort_column_id (GtkTreeSortable *sortable,
+                                        gint *sort_column_id,
+                                        GtkSortType *order)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (sortable);
+
+        if (sort_column_id)
+                *sort_column_id = model->priv->sort_column_id;
+        if (order)
+                *order = model->priv->sort_order;
+
+        return model->priv->sort_column_id != GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID
+                && model->priv->sort_column_id != GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+}
+
+static void
+ario_playlist_model_set_sort_column_id (GtkTreeSortable *sortable,
+                                        gint sort_column_id,
+                                        GtkSortType order)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (sortable);
+
+        if (model->priv->sort_column_id == sort_column_id
+            && model->priv->sort_order == order)
+                return;
+
+        model->priv->sort_column_id = sort_column_id;
+        model->priv->sort_order = order;
+
+        gtk_tree_sortable_sort_column_changed (sortable);
+
+        /* Default order is the order of the playlist: nothing to sort */
+        if (sort_column_id >= 0)
+                ario_playlist_model_sort (model);
+}
+
+static void
+ario_playlist_model_set_sort_func (GtkTreeSortable *sortable,
+                                   gint sort_column_id,
+                                   GtkTreeIterCompareFunc func,
+                                   gpointer data,
+                                   GDestroyNotify destroy)
+{
+        /* Columns are always sorted by their values */
+        g_warning ("ArioPlaylistModel does not support custom sort functions");
+}
+
+static void
+ario_playlist_model_set_default_sort_func (GtkTreeSortable *sortable,
+                                           GtkTreeIterCompareFunc func,
+                                           gpointer data,
+                                           GDestroyNotify destroy)
+{
+        /* Default order is always the order of the playlist */
+        g_warning ("ArioPlaylistModel does not support custom sort functions");
+}
+
+static gboolean
+ario_playlist_model_has_default_sort_func (GtkTreeSortable *sortable)
+{
+        return TRUE;
+}
+
+static void
+ario_playlist_model_sortable_init (GtkTreeSortableIface *iface)
+{
+        iface->get_sort_column_id = ario_playlist_model_get_sort_column_id;
+        iface->set_sort_column_id = ario_playlist_model_set_sort_column_id;
+        iface->set_sort_func = ario_playlist_model_set_sort_func;
+        iface->set_default_sort_func = ario_playlist_model_set_default_sort_func;
+        iface->has_default_sort_func = ario_playlist_model_has_default_sort_func;
+}
@@ -0,0 +1,115 @@
+/*
+ *  Copyright (C) 2009 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_PLAYLIST_MODEL_H
+#define __ARIO_PLAYLIST_MODEL_H
+
+#include <gtk/gtk.h>
+#include <config.h>
+#include "servers/ario-server.h"
+
+G_BEGIN_DECLS
+
+/* Columns of the playlist model */
+enum
+{
+        PLAYLIST_PIXBUF_COLUMN,
+        PLAYLIST_TRACK_COLUMN,
+        PLAYLIST_TITLE_COLUMN,
+        PLAYLIST_ARTIST_COLUMN,
+        PLAYLIST_ALBUM_COLUMN,
+        PLAYLIST_DURATION_COLUMN,
+        PLAYLIST_FILE_COLUMN,
+        PLAYLIST_GENRE_COLUMN,
+        PLAYLIST_DATE_COLUMN,
+        PLAYLIST_DISC_COLUMN,
+        PLAYLIST_ID_COLUMN,
+        PLAYLIST_TIME_COLUMN,
+        PLAYLIST_N_COLUMN
+};
+
+#define TYPE_ARIO_PLAYLIST_MODEL         (ario_playlist_model_get_type ())
+#define ARIO_PLAYLIST_MODEL(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), TYPE_ARIO_PLAYLIST_MODEL, ArioPlaylistModel))
+#define ARIO_PLAYLIST_MODEL_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), TYPE_ARIO_PLAYLIST_MODEL, ArioPlaylistModelClass))
+#define IS_ARIO_PLAYLIST_MODEL(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), TYPE_ARIO_PLAYLIST_MODEL))
+#define IS_ARIO_PLAYLIST_MODEL_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), TYPE_ARIO_PLAYLIST_MODEL))
+#define ARIO_PLAYLIST_MODEL_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), TYPE_ARIO_PLAYLIST_MODEL, ArioPlaylistModelClass))
+
+typedef struct ArioPlaylistModelPrivate ArioPlaylistModelPrivate;
+
+/*
+ * ArioPlaylistModel is the GtkTreeModel of the playlist. Songs are
+ * kept in an ArioSongArray and cells are only computed when they are
+ * displayed.
+ */
+typedef struct
+{
+        GObject parent;
+
+        ArioPlaylistModelPrivate *priv;
+} ArioPlaylistModel;
+
+typedef struct
+{
+        GObjectClass parent;
+} ArioPlaylistModelClass;
+
+GType                   ario_playlist_model_get_type    (void) G_GNUC_CONST;
+
+ArioPlaylistModel *     ario_playlist_model_new         (GdkPixbuf *play_pixbuf);
+
+guint                   ario_playlist_model_get_length  (ArioPlaylistModel *model);
+
+/* Update or add the song at position song->pos */
+void                    ario_playlist_model_set_song    (ArioPlaylistModel *model,
+                                                         ArioServerSong *song);
+
+/* Remove songs at the end of the playlist */
+void                    ario_playlist_model_truncate    (ArioPlaylistModel *model,
+                                                         const guint length);
+
+/* Sum of the durations of the songs, kept up to date on each change */
+gint                    ario_playlist_model_get_total_time (ArioPlaylistModel *model);
+
+/* Show the 'playing' pixbuf on song at position pos (-1 for none) */
+gboolean                ario_playlist_model_set_playing (ArioPlaylistModel *model,
+                                                         const gint pos);
+
+/* Position of the row of iter */
+gint                    ario_playlist_model_get_pos     (ArioPlaylistModel *model,
+                                                         GtkTreeIter *iter);
+
+/* Case folded value of a searchable column (title, artist, album or
+ * genre), see ario_util_casefold */
+const gchar *           ario_playlist_model_get_folded  (ArioPlaylistModel *model,
+                                                         GtkTreeIter *iter,
+                                                         const gint column);
+
+/* Tag of the song at position pos, the string belongs to the model */
+const gchar *           ario_playlist_model_get_tag     (ArioPlaylistModel *model,
+                                                         const gint pos,
+                                                         const ArioServerTag tag);
+
+/* Whether a song of the playlist has this file */
+gboolean                ario_playlist_model_has_file    (ArioPlaylistModel *model,
+                                                         const gchar *file);
+
+G_END_DECLS
+
+#endif /* __ARIO_PLAYLIST_MODEL_H */
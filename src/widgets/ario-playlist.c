@@ -33,6 +33,7 @@
 #include "shell/ario-shell-songinfos.h"
 #include "sources/ario-source-manager.h"
 #include "widgets/ario-dnd-tree.h"
+#include "widgets/ario-playlist-model.h"
 
 typedef struct ArioPlaylistColumn ArioPlaylistColumn;
 
@@ -104,12 +105,19 @@ static void ario_playlist_popup_menu_cb (ArioDndTree* tree,
 static void ario_playlist_activate_cb (ArioDndTree* tree,
                                        ArioPlaylist *playlist);
 
+/* Above this number of changed rows, the treeview is detached from
+ * the model during the update */
+#define ARIO_PLAYLIST_MAX_ROW_CHANGES 500
+
+/* Columns used by the search box */
+#define ARIO_PLAYLIST_N_SEARCH_COLUMNS 4
+
 static ArioPlaylist *instance = NULL;
 
 struct ArioPlaylistPrivate
 {
         GtkWidget *tree;
-        GtkListStore *model;
+        ArioPlaylistModel *model;
         GtkTreeSelection *selection;
         GtkTreeModelFilter *filter;
 
@@ -117,6 +125,16 @@ struct ArioPlaylistPrivate
         GtkWidget *search_entry;
         gboolean in_search;
         const gchar *search_text;
+        /* Case folded words of the search text */
+        gchar **search_tokens;
+        /* Visible columns in which words are searched */
+        gint search_columns[ARIO_PLAYLIST_N_SEARCH_COLUMNS];
+        gint n_search_columns;
+        /* Previous search and whether each row matched it (guint8): when
+         * the search text is only extended, rows that didn't match can
+         * be hidden without evaluating the filter again */
+        gchar *search_previous;
+        GArray *search_matches;
         gulong dnd_handler;
 
         gint64 playlist_id;
@@ -165,24 +183,6 @@ enum
         PROP_UI_MANAGER
 };
 
-/* Treeview columns */
-enum
-{
-        PIXBUF_COLUMN,
-        TRACK_COLUMN,
-        TITLE_COLUMN,
-        ARTIST_COLUMN,
-        ALBUM_COLUMN,
-        DURATION_COLUMN,
-        FILE_COLUMN,
-        GENRE_COLUMN,
-        DATE_COLUMN,
-        DISC_COLUMN,
-        ID_COLUMN,
-        TIME_COLUMN,
-        N_COLUMN
-};
-
 /*
  * ArioPlaylistColumn is used to initialise a column in the
  * playlist treeview and defines various column properties
@@ -230,16 +230,16 @@ struct ArioPlaylistColumn {
 
 /* Definition of all columns with the preperties */
 static ArioPlaylistColumn all_columns []  = {
-        { PIXBUF_COLUMN, NULL, 20, PREF_PIXBUF_COLUMN_ORDER, PREF_PIXBUF_COLUMN_ORDER_DEFAULT, NULL, TRUE, TRUE, FALSE, FALSE, NULL },
-        { TRACK_COLUMN, PREF_TRACK_COLUMN_SIZE, PREF_TRACK_COLUMN_SIZE_DEFAULT, PREF_TRACK_COLUMN_ORDER, PREF_TRACK_COLUMN_ORDER_DEFAULT, PREF_TRACK_COLUMN_VISIBLE, PREF_TRACK_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
-        { TITLE_COLUMN, PREF_TITLE_COLUMN_SIZE, PREF_TITLE_COLUMN_SIZE_DEFAULT, PREF_TITLE_COLUMN_ORDER, PREF_TITLE_COLUMN_ORDER_DEFAULT, PREF_TITLE_COLUMN_VISIBLE, PREF_TITLE_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
-        { ARTIST_COLUMN, PREF_ARTIST_COLUMN_SIZE, PREF_ARTIST_COLUMN_SIZE_DEFAULT, PREF_ARTIST_COLUMN_ORDER, PREF_ARTIST_COLUMN_ORDER_DEFAULT, PREF_ARTIST_COLUMN_VISIBLE, PREF_ARTIST_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
-        { ALBUM_COLUMN, PREF_ALBUM_COLUMN_SIZE, PREF_ALBUM_COLUMN_SIZE_DEFAULT, PREF_ALBUM_COLUMN_ORDER, PREF_ALBUM_COLUMN_ORDER_DEFAULT, PREF_ALBUM_COLUMN_VISIBLE, PREF_ALBUM_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
-        { DURATION_COLUMN, PREF_DURATION_COLUMN_SIZE, PREF_DURATION_COLUMN_SIZE_DEFAULT, PREF_DURATION_COLUMN_ORDER, PREF_DURATION_COLUMN_ORDER_DEFAULT, PREF_DURATION_COLUMN_VISIBLE, PREF_DURATION_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
-        { FILE_COLUMN, PREF_FILE_COLUMN_SIZE, PREF_FILE_COLUMN_SIZE_DEFAULT, PREF_FILE_COLUMN_ORDER, PREF_FILE_COLUMN_ORDER_DEFAULT, PREF_FILE_COLUMN_VISIBLE, PREF_FILE_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
-        { GENRE_COLUMN, PREF_GENRE_COLUMN_SIZE, PREF_GENRE_COLUMN_SIZE_DEFAULT, PREF_GENRE_COLUMN_ORDER, PREF_GENRE_COLUMN_ORDER_DEFAULT, PREF_GENRE_COLUMN_VISIBLE, PREF_GENRE_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
-        { DATE_COLUMN, PREF_DATE_COLUMN_SIZE, PREF_DATE_COLUMN_SIZE_DEFAULT, PREF_DATE_COLUMN_ORDER, PREF_DATE_COLUMN_ORDER_DEFAULT, PREF_DATE_COLUMN_VISIBLE, PREF_DATE_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
-        { DISC_COLUMN, PREF_DISC_COLUMN_SIZE, PREF_DISC_COLUMN_SIZE_DEFAULT, PREF_DISC_COLUMN_ORDER, PREF_DISC_COLUMN_ORDER_DEFAULT, PREF_DISC_COLUMN_VISIBLE, PREF_DISC_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_PIXBUF_COLUMN, NULL, 20, PREF_PIXBUF_COLUMN_ORDER, PREF_PIXBUF_COLUMN_ORDER_DEFAULT, NULL, TRUE, TRUE, FALSE, FALSE, NULL },
+        { PLAYLIST_TRACK_COLUMN, PREF_TRACK_COLUMN_SIZE, PREF_TRACK_COLUMN_SIZE_DEFAULT, PREF_TRACK_COLUMN_ORDER, PREF_TRACK_COLUMN_ORDER_DEFAULT, PREF_TRACK_COLUMN_VISIBLE, PREF_TRACK_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_TITLE_COLUMN, PREF_TITLE_COLUMN_SIZE, PREF_TITLE_COLUMN_SIZE_DEFAULT, PREF_TITLE_COLUMN_ORDER, PREF_TITLE_COLUMN_ORDER_DEFAULT, PREF_TITLE_COLUMN_VISIBLE, PREF_TITLE_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_ARTIST_COLUMN, PREF_ARTIST_COLUMN_SIZE, PREF_ARTIST_COLUMN_SIZE_DEFAULT, PREF_ARTIST_COLUMN_ORDER, PREF_ARTIST_COLUMN_ORDER_DEFAULT, PREF_ARTIST_COLUMN_VISIBLE, PREF_ARTIST_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_ALBUM_COLUMN, PREF_ALBUM_COLUMN_SIZE, PREF_ALBUM_COLUMN_SIZE_DEFAULT, PREF_ALBUM_COLUMN_ORDER, PREF_ALBUM_COLUMN_ORDER_DEFAULT, PREF_ALBUM_COLUMN_VISIBLE, PREF_ALBUM_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_DURATION_COLUMN, PREF_DURATION_COLUMN_SIZE, PREF_DURATION_COLUMN_SIZE_DEFAULT, PREF_DURATION_COLUMN_ORDER, PREF_DURATION_COLUMN_ORDER_DEFAULT, PREF_DURATION_COLUMN_VISIBLE, PREF_DURATION_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_FILE_COLUMN, PREF_FILE_COLUMN_SIZE, PREF_FILE_COLUMN_SIZE_DEFAULT, PREF_FILE_COLUMN_ORDER, PREF_FILE_COLUMN_ORDER_DEFAULT, PREF_FILE_COLUMN_VISIBLE, PREF_FILE_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_GENRE_COLUMN, PREF_GENRE_COLUMN_SIZE, PREF_GENRE_COLUMN_SIZE_DEFAULT, PREF_GENRE_COLUMN_ORDER, PREF_GENRE_COLUMN_ORDER_DEFAULT, PREF_GENRE_COLUMN_VISIBLE, PREF_GENRE_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_DATE_COLUMN, PREF_DATE_COLUMN_SIZE, PREF_DATE_COLUMN_SIZE_DEFAULT, PREF_DATE_COLUMN_ORDER, PREF_DATE_COLUMN_ORDER_DEFAULT, PREF_DATE_COLUMN_VISIBLE, PREF_DATE_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
+        { PLAYLIST_DISC_COLUMN, PREF_DISC_COLUMN_SIZE, PREF_DISC_COLUMN_SIZE_DEFAULT, PREF_DISC_COLUMN_ORDER, PREF_DISC_COLUMN_ORDER_DEFAULT, PREF_DISC_COLUMN_VISIBLE, PREF_DISC_COLUMN_VISIBLE_DEFAULT, FALSE, TRUE, TRUE, NULL },
         { -1, NULL, 0, NULL, 0, NULL, FALSE, FALSE, FALSE, FALSE, NULL }
 };
 
@@ -369,7 +369,7 @@ static void
 ario_playlist_reorder_columns (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GtkTreeViewColumn *orders[N_COLUMN] = {NULL};
+        GtkTreeViewColumn *orders[PLAYLIST_N_COLUMN] = {NULL};
         GtkTreeViewColumn *current, *prev = NULL;
         int i, order;
 
@@ -377,12 +377,12 @@ ario_playlist_reorder_columns (void)
         for (i = 0; all_columns[i].columnnb != -1; ++i)
         {
                 order = ario_conf_get_integer (all_columns[i].pref_order, all_columns[i].default_order);
-                if (order < N_COLUMN)
+                if (order < PLAYLIST_N_COLUMN)
                         orders[order] = all_columns[i].column;
         }
 
         /* Move columns in the order computed in orders[] */
-        for (i = 0; i < N_COLUMN; ++i) {
+        for (i = 0; i < PLAYLIST_N_COLUMN; ++i) {
                 current = orders[i];
                 if (current)
                         gtk_tree_view_move_column_after (GTK_TREE_VIEW (instance->priv->tree), current, prev);
@@ -390,7 +390,7 @@ ario_playlist_reorder_columns (void)
         }
 
         /* Resize the last visible column */
-        for (i = N_COLUMN - 1; i >= 0; --i) {
+        for (i = PLAYLIST_N_COLUMN - 1; i >= 0; --i) {
                 if (!orders[i])
                         continue;
                 if (gtk_tree_view_column_get_visible (orders[i])) {
@@ -400,85 +400,126 @@ ario_playlist_reorder_columns (void)
         }
 }
 
-static gint
-ario_playlist_no_sort (G_GNUC_UNUSED GtkTreeModel *model,
-                       G_GNUC_UNUSED GtkTreeIter *a,
-                       G_GNUC_UNUSED GtkTreeIter *b,
-                       G_GNUC_UNUSED gpointer user_data)
-{
-        /* Default sort always return 0 */
-        return 0;
-}
-
 static gboolean
 ario_playlist_filter_func (GtkTreeModel *model,
                            GtkTreeIter  *iter,
                            ArioPlaylist *playlist)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *title, *artist, *album, *genre;
+        ArioPlaylistModel *playlist_model = ARIO_PLAYLIST_MODEL (model);
+        GArray *matches = playlist->priv->search_matches;
+        const gchar *value;
         gboolean visible = TRUE, filter;
-        int i;
-        gchar **cmp_str;
+        gint pos;
+        int i, j;
 
         /* There is no filter if the search box is empty */
-        if (!playlist->priv->search_text || *playlist->priv->search_text == '\0')
-                return TRUE;
-
-        /* Split on spaces to have multiple filters */
-        cmp_str = g_strsplit (playlist->priv->search_text, " ", -1);
-        if (!cmp_str)
+        if (!playlist->priv->search_tokens || !playlist->priv->search_tokens[0])
                 return TRUE;
 
-        /* Get data needed to filter */
-        gtk_tree_model_get (model, iter,
-                            TITLE_COLUMN, &title,
-                            ARTIST_COLUMN, &artist,
-                            ALBUM_COLUMN, &album,
-                            GENRE_COLUMN, &genre,
-                            -1);
+        /* Rows that didn't match the previous search don't match this one */
+        pos = ario_playlist_model_get_pos (playlist_model, iter);
+        if (matches
+            && pos >= 0 && (guint) pos < matches->len
+            && !g_array_index (matches, guint8, pos))
+                return FALSE;
 
         /* Loop on every filter */
-        for (i = 0; cmp_str[i] && visible; ++i) {
-                if (g_utf8_collate (cmp_str[i], ""))
-                {
-                        /* By default the row doesn't match the filter */
-                        filter = FALSE;
-
-                        /* The row match the filter if one of the visible column contains
-                         * the filter */
-                        if (title
-                            && ario_conf_get_boolean (PREF_TITLE_COLUMN_VISIBLE, PREF_TITLE_COLUMN_VISIBLE_DEFAULT)
-                            && ario_util_stristr (title, cmp_str[i])) {
+        for (i = 0; playlist->priv->search_tokens[i] && visible; ++i) {
+                /* By default the row doesn't match the filter */
+                filter = FALSE;
+
+                /* The row match the filter if one of the visible column contains
+                 * the filter */
+                for (j = 0; j < playlist->priv->n_search_columns && !filter; ++j) {
+                        value = ario_playlist_model_get_folded (playlist_model, iter,
+                                                                playlist->priv->search_columns[j]);
+                        if (value && strstr (value, playlist->priv->search_tokens[i]))
                                 filter = TRUE;
-                        } else if (artist
-                                   && ario_conf_get_boolean (PREF_ARTIST_COLUMN_VISIBLE, PREF_ARTIST_COLUMN_VISIBLE_DEFAULT)
-                                   && ario_util_stristr (artist, cmp_str[i])) {
-                                filter = TRUE;
-                        } else if (album
-                                   && ario_conf_get_boolean (PREF_ALBUM_COLUMN_VISIBLE, PREF_ALBUM_COLUMN_VISIBLE_DEFAULT)
-                                   && ario_util_stristr (album, cmp_str[i])) {
-                                filter = TRUE;
-                        } else if (genre
-                                   && ario_conf_get_boolean (PREF_GENRE_COLUMN_VISIBLE, PREF_GENRE_COLUMN_VISIBLE_DEFAULT)
-                                   && ario_util_stristr (genre, cmp_str[i])) {
-                                filter = TRUE;
-                        }
-
-                        /* The row must match all the filters to be shown */
-                        visible &= filter;
                 }
+
+                /* The row must match all the filters to be shown */
+                visible &= filter;
         }
 
-        g_strfreev (cmp_str);
-        g_free (title);
-        g_free (artist);
-        g_free (album);
-        g_free (genre);
+        if (matches
+            && pos >= 0 && (guint) pos < matches->len)
+                g_array_index (matches, guint8, pos) = visible;
 
         return visible;
 }
 
+static void
+ario_playlist_search_reset (ArioPlaylist *playlist)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_free (playlist->priv->search_previous);
+        playlist->priv->search_previous = NULL;
+
+        if (playlist->priv->search_matches) {
+                g_array_free (playlist->priv->search_matches, TRUE);
+                playlist->priv->search_matches = NULL;
+        }
+}
+
+static void
+ario_playlist_search_compile (ArioPlaylist *playlist)
+{
+        ARIO_LOG_FUNCTION_START;
+        const gchar *text = playlist->priv->search_text;
+        gchar **words;
+        gint columns[ARIO_PLAYLIST_N_SEARCH_COLUMNS];
+        gint n_columns = 0;
+        guint8 match = TRUE;
+        guint length;
+        int i, j;
+
+        /* Split on spaces to have multiple filters */
+        g_strfreev (playlist->priv->search_tokens);
+        playlist->priv->search_tokens = NULL;
+        if (text) {
+                words = g_strsplit (text, " ", -1);
+                playlist->priv->search_tokens = g_new0 (gchar *, g_strv_length (words) + 1);
+                for (i = 0, j = 0; words[i]; ++i) {
+                        if (*words[i] != '\0')
+                                playlist->priv->search_tokens[j++] = ario_util_casefold (words[i]);
+                }
+                g_strfreev (words);
+        }
+
+        /* Only visible columns are searched */
+        if (ario_conf_get_boolean (PREF_TITLE_COLUMN_VISIBLE, PREF_TITLE_COLUMN_VISIBLE_DEFAULT))
+                columns[n_columns++] = PLAYLIST_TITLE_COLUMN;
+        if (ario_conf_get_boolean (PREF_ARTIST_COLUMN_VISIBLE, PREF_ARTIST_COLUMN_VISIBLE_DEFAULT))
+                columns[n_columns++] = PLAYLIST_ARTIST_COLUMN;
+        if (ario_conf_get_boolean (PREF_ALBUM_COLUMN_VISIBLE, PREF_ALBUM_COLUMN_VISIBLE_DEFAULT))
+                columns[n_columns++] = PLAYLIST_ALBUM_COLUMN;
+        if (ario_conf_get_boolean (PREF_GENRE_COLUMN_VISIBLE, PREF_GENRE_COLUMN_VISIBLE_DEFAULT))
+                columns[n_columns++] = PLAYLIST_GENRE_COLUMN;
+
+        /* Previous results can only be reused if the text has been extended
+         * on the same columns: every word is then the same or longer */
+        if (!text
+            || !playlist->priv->search_previous
+            || !g_str_has_prefix (text, playlist->priv->search_previous)
+            || n_columns != playlist->priv->n_search_columns
+            || memcmp (columns, playlist->priv->search_columns, n_columns * sizeof (gint)))
+                ario_playlist_search_reset (playlist);
+
+        memcpy (playlist->priv->search_columns, columns, sizeof (columns));
+        playlist->priv->n_search_columns = n_columns;
+
+        if (!playlist->priv->search_matches) {
+                length = ario_playlist_model_get_length (playlist->priv->model);
+                playlist->priv->search_matches = g_array_sized_new (FALSE, FALSE, sizeof (guint8), length);
+                for (i = 0; (guint) i < length; ++i)
+                        g_array_append_val (playlist->priv->search_matches, match);
+        }
+
+        g_free (playlist->priv->search_previous);
+        playlist->priv->search_previous = g_strdup (text);
+}
+
 static void
 ario_playlist_search_close (GtkButton *button,
                             ArioPlaylist *playlist)
@@ -491,6 +532,9 @@ ario_playlist_search_close (GtkButton *button,
                                  GTK_TREE_MODEL (playlist->priv->model));
         gtk_tree_view_set_headers_clickable (GTK_TREE_VIEW (playlist->priv->tree), TRUE);
         playlist->priv->in_search = FALSE;
+        g_strfreev (playlist->priv->search_tokens);
+        playlist->priv->search_tokens = NULL;
+        ario_playlist_search_reset (playlist);
 
         /* Stop handling drag & drop differently */
         if (playlist->priv->dnd_handler) {
@@ -514,6 +558,7 @@ ario_playlist_search_entry_changed (GtkEntry *entry,
                 gtk_widget_grab_focus (playlist->priv->tree);
         } else {
                 /* Refilter all rows if filter has changed */
+                ario_playlist_search_compile (playlist);
                 gtk_tree_model_filter_refilter (playlist->priv->filter);
         }
 }
@@ -572,19 +617,7 @@ ario_playlist_init (ArioPlaylist *playlist)
         ario_playlist_reorder_columns ();
 
         /* Create tree model */
-        playlist->priv->model = gtk_list_store_new (N_COLUMN,
-                                                    GDK_TYPE_PIXBUF,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_INT,
-                                                    G_TYPE_INT);
+        playlist->priv->model = ario_playlist_model_new (playlist->priv->play_pixbuf);
 
         /* Create the filter used when the search box is activated */
         playlist->priv->filter = GTK_TREE_MODEL_FILTER (gtk_tree_model_filter_new (GTK_TREE_MODEL (playlist->priv->model), NULL));
@@ -596,9 +629,6 @@ ario_playlist_init (ArioPlaylist *playlist)
         /* Set various treeview properties */
         gtk_tree_view_set_model (GTK_TREE_VIEW (playlist->priv->tree),
                                  GTK_TREE_MODEL (playlist->priv->model));
-        gtk_tree_sortable_set_default_sort_func (GTK_TREE_SORTABLE (playlist->priv->model),
-                                                 ario_playlist_no_sort,
-                                                 NULL, NULL);
         gtk_tree_view_set_rules_hint (GTK_TREE_VIEW (playlist->priv->tree),
                                       TRUE);
         gtk_tree_view_set_enable_search (GTK_TREE_VIEW (playlist->priv->tree), FALSE);
@@ -703,7 +733,7 @@ ario_playlist_shutdown (void)
 {
         ARIO_LOG_FUNCTION_START;
         int width;
-        int orders[N_COLUMN];
+        int orders[PLAYLIST_N_COLUMN];
         GtkTreeViewColumn *column;
         int i, j = 1;
         GList *columns, *tmp;
@@ -712,7 +742,7 @@ ario_playlist_shutdown (void)
         columns = gtk_tree_view_get_columns (GTK_TREE_VIEW (instance->priv->tree));
         for (tmp = columns; tmp; tmp = g_list_next (tmp)) {
                 column = tmp->data;
-                for (i = 0; i < N_COLUMN; ++i) {
+                for (i = 0; i < PLAYLIST_N_COLUMN; ++i) {
                         if (all_columns[i].column == column)
                                 orders[i] = j;
                 }
@@ -744,6 +774,8 @@ ario_playlist_finalize (GObject *object)
 
         g_return_if_fail (playlist->priv != NULL);
         g_object_unref (playlist->priv->play_pixbuf);
+        g_strfreev (playlist->priv->search_tokens);
+        ario_playlist_search_reset (playlist);
 
         G_OBJECT_CLASS (ario_playlist_parent_class)->finalize (object);
 }
@@ -796,8 +828,6 @@ ario_playlist_sync_song (void)
         ARIO_LOG_FUNCTION_START;
         int state = ario_server_get_current_state ();
         ArioServerSong *song = ario_server_get_current_song ();
-        GtkTreePath *path;
-        GtkTreeIter iter;
 
         /* If we are still playing and the song has not changed we don't do anything */
         if (song
@@ -816,28 +846,16 @@ ario_playlist_sync_song (void)
 
         /* Remove the 'playing' icon from previous song */
         if (instance->priv->pos >= 0) {
-                path = gtk_tree_path_new_from_indices (instance->priv->pos, -1);
-                if (gtk_tree_model_get_iter (GTK_TREE_MODEL (instance->priv->model), &iter, path)) {
-                        gtk_list_store_set (instance->priv->model, &iter,
-                                            PIXBUF_COLUMN, NULL,
-                                            -1);
-                        instance->priv->pos = -1;
-                }
-                gtk_tree_path_free (path);
+                ario_playlist_model_set_playing (instance->priv->model, -1);
+                instance->priv->pos = -1;
         }
 
         /* Add 'playing' icon to new song */
         if (song
             && state != ARIO_STATE_UNKNOWN
             && state != ARIO_STATE_STOP) {
-                path = gtk_tree_path_new_from_indices (song->pos, -1);
-                if (gtk_tree_model_get_iter (GTK_TREE_MODEL (instance->priv->model), &iter, path)) {
-                        gtk_list_store_set (instance->priv->model, &iter,
-                                            PIXBUF_COLUMN, instance->priv->play_pixbuf,
-                                            -1);
+                if (ario_playlist_model_set_playing (instance->priv->model, song->pos))
                         instance->priv->pos = song->pos;
-                }
-                gtk_tree_path_free (path);
         }
 }
 
@@ -847,20 +865,17 @@ ario_playlist_changed_cb (ArioServer *server,
 {
         ARIO_LOG_FUNCTION_START;
         gint old_length;
-        GtkTreeIter iter;
-        gchar track[ARIO_MAX_TRACK_SIZE];
-        gchar time[ARIO_MAX_TIME_SIZE];
-        gchar *title;
         GSList *songs, *tmp;
-        ArioServerSong *song;
-        gboolean need_set;
-        GtkTreePath *path;
+        gboolean detach;
+
+        /* Results of the previous search are not valid anymore */
+        ario_playlist_search_reset (playlist);
 
         /* Clear the playlist if ario is not connected to the server */
         if (!ario_server_is_connected ()) {
                 playlist->priv->playlist_length = 0;
                 playlist->priv->playlist_id = -1;
-                gtk_list_store_clear (playlist->priv->model);
+                ario_playlist_model_truncate (playlist->priv->model, 0);
                 return;
         }
 
@@ -869,59 +884,31 @@ ario_playlist_changed_cb (ArioServer *server,
         playlist->priv->playlist_id = ario_server_get_current_playlist_id ();
 
         old_length = playlist->priv->playlist_length;
+        playlist->priv->playlist_length = ario_server_get_current_playlist_length ();
 
-        /* For each change in playlist */
-        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
-                song = tmp->data;
-                need_set = FALSE;
-                /* Decide whether to update or to add */
-                if (song->pos < old_length) {
-                        /* Update */
-                        path = gtk_tree_path_new_from_indices (song->pos, -1);
-                        if (gtk_tree_model_get_iter (GTK_TREE_MODEL (playlist->priv->model), &iter, path)) {
-                                need_set = TRUE;
-                        }
-                        gtk_tree_path_free (path);
-                } else {
-                        /* Add */
-                        gtk_list_store_append (playlist->priv->model, &iter);
-                        need_set = TRUE;
-                }
-                if (need_set) {
-                        /* Set appropriate data in playlist row */
-                        ario_util_format_time_buf (song->time, time, ARIO_MAX_TIME_SIZE);
-                        ario_util_format_track_buf (song->track, track, ARIO_MAX_TRACK_SIZE);
-                        title = ario_util_format_title (song);
-                        gtk_list_store_set (playlist->priv->model, &iter,
-                                            TRACK_COLUMN, track,
-                                            TITLE_COLUMN, title,
-                                            ARTIST_COLUMN, song->artist,
-                                            ALBUM_COLUMN, song->album ? song->album : ARIO_SERVER_UNKNOWN,
-                                            DURATION_COLUMN, time,
-                                            FILE_COLUMN, song->file,
-                                            GENRE_COLUMN, song->genre,
-                                            DATE_COLUMN, song->date,
-                                            ID_COLUMN, song->id,
-                                            TIME_COLUMN, song->time,
-                                            DISC_COLUMN, song->disc,
-                                            -1);
-                }
-        }
+        /* The treeview is detached from the model during big changes (clear,
+         * shuffle...) so that it is not updated for each row */
+        detach = g_slist_length (songs) + MAX (old_length - playlist->priv->playlist_length, 0) > ARIO_PLAYLIST_MAX_ROW_CHANGES;
+        if (detach)
+                gtk_tree_view_set_model (GTK_TREE_VIEW (playlist->priv->tree), NULL);
+
+        /* For each change in playlist: update or add the song */
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp))
+                ario_playlist_model_set_song (playlist->priv->model, tmp->data);
 
         g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
         g_slist_free (songs);
 
-        playlist->priv->playlist_length = ario_server_get_current_playlist_length ();
-
         /* Remove rows at the end of playlist if playlist size has decreased */
-        if (playlist->priv->playlist_length < old_length) {
-                path = gtk_tree_path_new_from_indices (playlist->priv->playlist_length, -1);
-
-                if (gtk_tree_model_get_iter (GTK_TREE_MODEL (playlist->priv->model), &iter, path)) {
-                        while (gtk_list_store_remove (playlist->priv->model, &iter)) { }
-                }
+        ario_playlist_model_truncate (playlist->priv->model, playlist->priv->playlist_length);
 
-                gtk_tree_path_free (path);
+        if (detach) {
+                if (playlist->priv->in_search)
+                        gtk_tree_view_set_model (GTK_TREE_VIEW (playlist->priv->tree),
+                                                 GTK_TREE_MODEL (playlist->priv->filter));
+                else
+                        gtk_tree_view_set_model (GTK_TREE_VIEW (playlist->priv->tree),
+                                                 GTK_TREE_MODEL (playlist->priv->model));
         }
 
         /* Synchronize 'playing' pixbuf in playlist */
@@ -987,7 +974,7 @@ ario_playlist_rows_reordered_foreach (GtkTreeModel *model,
         gint *id;
 
         id = g_malloc (sizeof (gint));
-        gtk_tree_model_get (model, iter, ID_COLUMN, id, -1);
+        gtk_tree_model_get (model, iter, PLAYLIST_ID_COLUMN, id, -1);
 
         *ids = g_slist_append (*ids, id);
 
@@ -1234,7 +1221,7 @@ ario_playlist_copy_rows (const int x, const int y)
         for (; list; list = g_list_next (list)) {
                 /* Get start pos */
                 gtk_tree_model_get_iter (model, &iter, (GtkTreePath *) list->data);
-                gtk_tree_model_get (model, &iter, FILE_COLUMN, &filename, -1);
+                gtk_tree_model_get (model, &iter, PLAYLIST_FILE_COLUMN, &filename, -1);
                 songs = g_slist_append (songs, filename);
         }
         /* Insert songs in playlist */
@@ -1517,10 +1504,8 @@ ario_playlist_selection_crop_foreach (GtkTreeModel *model,
 
         if (indice >= 0) {
                 /* Remove all rows between the last kept row and the current row */
-                while (data->deleted + data->kept < indice) {
-                        ario_server_queue_delete_pos (data->kept);
-                        ++data->deleted;
-                }
+                ario_server_queue_delete_range (data->kept, indice - data->deleted);
+                data->deleted = indice - data->kept;
 
                 /* Keep the current row */
                 ++data->kept;
@@ -1543,10 +1528,7 @@ ario_playlist_cmd_crop (GtkAction *action,
                                              &data);
 
         /* Delete all songs after the last selected one */
-        while (data.deleted + data.kept < instance->priv->playlist_length) {
-                ario_server_queue_delete_pos (data.kept);
-                ++data.deleted;
-        }
+        ario_server_queue_delete_range (data.kept, instance->priv->playlist_length - data.deleted);
 
         /* Commit song deletions */
         ario_server_queue_commit ();
@@ -1598,7 +1580,7 @@ ario_playlist_selection_properties_foreach (GtkTreeModel *model,
         GSList **paths = (GSList **) userdata;
         gchar *val = NULL;
 
-        gtk_tree_model_get (model, iter, FILE_COLUMN, &val, -1);
+        gtk_tree_model_get (model, iter, PLAYLIST_FILE_COLUMN, &val, -1);
 
         *paths = g_slist_append (*paths, val);
 }
@@ -1635,7 +1617,7 @@ ario_playlist_cmd_goto_playing_song_foreach (GtkTreeModel *model,
 {
         int song_id;
 
-        gtk_tree_model_get (model, iter, ID_COLUMN, &song_id, -1);
+        gtk_tree_model_get (model, iter, PLAYLIST_ID_COLUMN, &song_id, -1);
 
         /* The song is the currently playing song */
         if (song_id == ario_server_get_current_song_id ()) {
@@ -1781,31 +1763,26 @@ ario_playlist_column_visible_changed_cb (guint notification_id,
                                           ario_conf_get_integer (ario_column->pref_is_visible, ario_column->default_is_visible));
 }
 
-static gboolean
-ario_playlist_get_total_time_foreach (GtkTreeModel *model,
-                                      GtkTreePath *p,
-                                      GtkTreeIter *iter,
-                                      int *total_time)
-{
-        gint time;
-
-        gtk_tree_model_get (model, iter, TIME_COLUMN, &time, -1);
-        *total_time += time;
-
-        return FALSE;
-}
-
 gint
 ario_playlist_get_total_time (void)
 {
         ARIO_LOG_FUNCTION_START;
-        int total_time = 0;
+        /* Total time is kept up to date by the model on each change */
+        return ario_playlist_model_get_total_time (instance->priv->model);
+}
 
-        /* Compute total time by adding all song times */
-        gtk_tree_model_foreach (GTK_TREE_MODEL (instance->priv->model),
-                                (GtkTreeModelForeachFunc) ario_playlist_get_total_time_foreach,
-                                &total_time);
+const gchar *
+ario_playlist_get_tag (const gint pos,
+                       const ArioServerTag tag)
+{
+        ARIO_LOG_FUNCTION_START;
+        return ario_playlist_model_get_tag (instance->priv->model, pos, tag);
+}
 
-        return total_time;
+gboolean
+ario_playlist_has_file (const gchar *file)
+{
+        ARIO_LOG_FUNCTION_START;
+        return ario_playlist_model_has_file (instance->priv->model, file);
 }
 
@@ -22,6 +22,7 @@
 
 #include <gtk/gtk.h>
 #include "sources/ario-source.h"
+#include "servers/ario-server.h"
 
 G_BEGIN_DECLS
 
@@ -59,6 +60,13 @@ void            ario_playlist_shutdown          (void);
 
 gint            ario_playlist_get_total_time    (void);
 
+/* Tag of the song at position pos, the string must be copied to be kept */
+const gchar *   ario_playlist_get_tag           (const gint pos,
+                                                 const ArioServerTag tag);
+
+/* Whether file is in the playlist */
+gboolean        ario_playlist_has_file          (const gchar *file);
+
 G_END_DECLS
 
 #endif /* __ARIO_PLAYLIST_H */